@@ -28,6 +28,7 @@
 #include <list>
 #include <utility>
 #include <QMultiMap>
+#include <QMutex>
 #include <QPair>
 #include <QString>
 #include <QObject>
@@ -45,6 +46,8 @@
 /**
 This is the logging class.
 One for each document. Responsible of getting an history of the logging message printed out by filters.
+Filters may run on a worker thread while the GUI reads the log: all the accesses
+to the stored messages are serialized, and the accessors return (implicitly shared) copies.
 */
 class ML_DLL_EXPORT 
 		GLLogStream : public QObject
@@ -85,9 +88,9 @@ public:
 	void setBookmark();
 	void clearBookmark();
 	void backToBookmark();
-	const QList<std::pair<int, QString> >& logStringList() const;
+	QList<std::pair<int, QString> > logStringList() const;
 
-	const QMultiMap<QString, QPair<QString, QString> >& realTimeLogMultiMap() const;
+	QMultiMap<QString, QPair<QString, QString> > realTimeLogMultiMap() const;
 	void clearRealTimeLog();
 
 	template <typename... Ts>
@@ -107,6 +110,7 @@ signals:
 	void logUpdated();
 
 private:
+	mutable QMutex mutex;
 	int bookmark; /// this field is used to place a bookmark for restoring the log. Useful for previeweing
 	QList<std::pair<int, QString> > logTextList;
 
@@ -17,7 +17,7 @@ void MeshDocumentStateData::create(MeshDocument& md)
 {
 	QWriteLocker locker(&_lock);
 	for (MeshModel& mm : md.meshIterator()) {
-		insert(mm.id(), MeshModelStateData(mm.dataMask(), mm.cm.VN(), mm.cm.FN(), mm.cm.EN()));
+		insert(mm.id(), MeshModelStateData(mm.dataMask(), mm.cm.VN(), mm.cm.FN(), mm.cm.EN(), mm.cm.bbox, mm.cm.Tr));
 	}
 }
 
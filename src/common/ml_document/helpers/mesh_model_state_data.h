@@ -26,15 +26,20 @@
 
 #include <cstddef>
 
+#include "../base_types.h"
+
 struct MeshModelStateData
 {
 	int _mask;
 	size_t _nvert;
 	size_t _nface;
 	size_t _nedge;
+	// used to detect the meshes moved by filters that did not declare to change them
+	Box3m _bbox;
+	Matrix44m _tr;
 
-	MeshModelStateData(int mask, size_t nvert, size_t nface, size_t nedge):
-		_mask(mask), _nvert(nvert), _nface(nface), _nedge(nedge)
+	MeshModelStateData(int mask, size_t nvert, size_t nface, size_t nedge, const Box3m& bbox, const Matrix44m& tr):
+		_mask(mask), _nvert(nvert), _nface(nface), _nedge(nedge), _bbox(bbox), _tr(tr)
 	{}
 };
 
@@ -67,7 +67,8 @@ QString nameDisambiguator(std::list<LayerElement> &elemList, QString meshLabel)
 	return newName;
 }
 
-MeshDocument::MeshDocument() 
+MeshDocument::MeshDocument() :
+	undoHistory(*this)
 {
 	meshIdCounter=0;
 	rasterIdCounter=0;
@@ -82,7 +83,9 @@ MeshDocument::~MeshDocument()
 
 void MeshDocument::clear()
 {
+	undoHistory.clear();
 	meshList.clear();
+	trashedMeshList.clear();
 	rasterList.clear();
 
 	meshIdCounter=0;
@@ -235,6 +238,16 @@ MeshDocumentStateData& MeshDocument::meshDocStateData()
 	return mdstate;
 }
 
+MeshDocumentHistory& MeshDocument::history()
+{
+	return undoHistory;
+}
+
+const MeshDocumentHistory& MeshDocument::history() const
+{
+	return undoHistory;
+}
+
 void MeshDocument::setDocLabel(const QString& docLb)
 {
 	documentLabel = docLb;
@@ -274,6 +287,9 @@ bool MeshDocument::isBusy()
 void MeshDocument::setBusy(bool _busy)
 {
 	busy=_busy;
+	// the meshes erased by an operation that is being recorded are taken by the history
+	if (!busy && !undoHistory.isRecording())
+		trashedMeshList.clear();
 }
 
 /**
@@ -384,7 +400,17 @@ MeshDocument::MeshIterator MeshDocument::eraseMesh(MeshIterator it)
 				setCurrentMesh(this->meshList.front().id());
 		}
 
-		it = meshList.erase(it);
+		if (busy || undoHistory.isRecording()) {
+			// while the document is busy, the viewers may still draw the
+			// buffers of this mesh: it is released only in setBusy(false).
+			// If the history is recording, the mesh is moved in the history
+			auto next = std::next(it);
+			trashedMeshList.splice(trashedMeshList.end(), meshList, it);
+			it = next;
+		}
+		else {
+			it = meshList.erase(it);
+		}
 
 		emit meshSetChanged();
 		emit meshRemoved(id);
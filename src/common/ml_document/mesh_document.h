@@ -26,12 +26,14 @@
 
 #include "mesh_model.h"
 #include "raster_model.h"
+#include "mesh_document_history.h"
 
 #include "helpers/mesh_document_state_data.h"
 
 class MeshDocument : public QObject
 {
 	Q_OBJECT
+	friend class MeshDocumentHistory;
 
 public:
 
@@ -127,6 +129,8 @@ public:
 	void requestUpdatingPerMeshDecorators(int mesh_id);
 
 	MeshDocumentStateData& meshDocStateData();
+	MeshDocumentHistory& history();
+	const MeshDocumentHistory& history() const;
 	void setDocLabel(const QString& docLb);
 	QString docLabel() const;
 	QString pathName() const;
@@ -185,6 +189,13 @@ private:
 	/// The very important member:
 	/// The list of MeshModels.
 	std::list<MeshModel> meshList;
+	/// Meshes deleted while the document was busy or while the history is
+	/// recording an operation; freed when it is released
+	std::list<MeshModel> trashedMeshList;
+
+	/// The undo/redo history of the operations applied to the document
+	MeshDocumentHistory undoHistory;
+
 	/// The list of the raster models of the project
 	std::list<RasterModel> rasterList;
 
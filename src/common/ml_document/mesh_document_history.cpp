@@ -0,0 +1,966 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "mesh_document_history.h"
+
+#include <algorithm>
+#include <cstring>
+#include <set>
+#include <type_traits>
+
+#include <QDir>
+#include <QTemporaryFile>
+
+#include "mesh_document.h"
+#include "../mlexception.h"
+
+/*
+An array saved by the history. It is kept in memory until spill() moves it to
+a temporary file, that is removed when the buffer is destroyed.
+*/
+class MeshDocumentHistory::Buffer
+{
+public:
+	Buffer(std::vector<char>&& bytes) : bytes(std::move(bytes))
+	{
+		byteSize = this->bytes.size();
+	}
+
+	size_t size() const { return byteSize; }
+	bool isSpilled() const { return file != nullptr; }
+
+	bool spill(const QString& dir)
+	{
+		if (isSpilled())
+			return true;
+		std::unique_ptr<QTemporaryFile> f(new QTemporaryFile(QDir(dir).filePath("meshlab_history_XXXXXX")));
+		if (!f->open())
+			return false;
+		if (f->write(bytes.data(), bytes.size()) != (qint64) bytes.size() || !f->flush())
+			return false;
+		f->close();
+		file = std::move(f);
+		std::vector<char>().swap(bytes);
+		return true;
+	}
+
+	std::vector<char> data() const
+	{
+		if (!isSpilled())
+			return bytes;
+		std::vector<char> res(byteSize);
+		if (!file->open() || file->read(res.data(), byteSize) != (qint64) byteSize) {
+			file->close();
+			throw MLException("Unable to read the undo history cache file " + file->fileName());
+		}
+		file->close();
+		return res;
+	}
+
+private:
+	std::vector<char> bytes;
+	size_t byteSize;
+	std::unique_ptr<QTemporaryFile> file;
+};
+
+namespace {
+
+const int TOPOLOGY_MASK =
+		MeshModel::MM_VERTNUMBER | MeshModel::MM_FACENUMBER | MeshModel::MM_FACEVERT |
+		MeshModel::MM_UNKNOWN;
+
+// the components that a snapshot can save
+const int RECORDED_MASK =
+		TOPOLOGY_MASK | MeshModel::MM_VERTCOORD | MeshModel::MM_VERTNORMAL |
+		MeshModel::MM_VERTFLAG | MeshModel::MM_VERTCOLOR | MeshModel::MM_VERTQUALITY |
+		MeshModel::MM_VERTTEXCOORD | MeshModel::MM_FACENORMAL | MeshModel::MM_FACEFLAG |
+		MeshModel::MM_FACECOLOR | MeshModel::MM_FACEQUALITY | MeshModel::MM_WEDGTEXCOORD |
+		MeshModel::MM_VERTFLAGSELECT | MeshModel::MM_FACEFLAGSELECT;
+
+// components that are saved only if the mesh has them, and that are enabled
+// or disabled again when restored
+const int OPTIONAL_MASK =
+		MeshModel::MM_VERTCOLOR | MeshModel::MM_VERTQUALITY | MeshModel::MM_VERTTEXCOORD |
+		MeshModel::MM_FACECOLOR | MeshModel::MM_FACEQUALITY | MeshModel::MM_WEDGTEXCOORD;
+
+template <typename T, typename Container, typename Getter>
+std::vector<char> gather(const Container& c, Getter get)
+{
+	std::vector<char> bytes(c.size() * sizeof(T));
+	T* dst = reinterpret_cast<T*>(bytes.data());
+	for (size_t i = 0; i < c.size(); ++i)
+		dst[i] = get(c[i]);
+	return bytes;
+}
+
+template <typename T, typename Container, typename Setter>
+void scatter(const std::vector<char>& bytes, Container& c, Setter set)
+{
+	const T* src = reinterpret_cast<const T*>(bytes.data());
+	for (size_t i = 0; i < c.size(); ++i)
+		set(c[i], src[i]);
+}
+
+// same as vcg::tri::Allocator does when the vectors of the mesh are resized
+template <typename AttrContainer>
+void resizeAttributes(AttrContainer& c, size_t sz)
+{
+	for (auto ai = c.begin(); ai != c.end(); ++ai)
+		((CMeshO::PointerToAttribute)(*ai)).Resize(sz);
+}
+
+template <typename AttrContainer>
+std::vector<char> gatherAttribute(const AttrContainer& c, const std::string& name, size_t n, size_t& elemSize)
+{
+	for (const auto& a : c) {
+		if (a._name != name)
+			continue;
+		elemSize = a._handle->SizeOf();
+		std::vector<char> bytes(n * elemSize);
+		if (n > 0)
+			std::memcpy(bytes.data(), a._handle->DataBegin(), bytes.size());
+		return bytes;
+	}
+	elemSize = 0;
+	return std::vector<char>();
+}
+
+// copies back the values of the attribute, if it still exists with the same type size
+template <typename AttrContainer>
+void scatterAttribute(AttrContainer& c, const std::string& name, size_t elemSize, const std::vector<char>& bytes)
+{
+	for (const auto& a : c) {
+		if (a._name == name && a._handle->SizeOf() == elemSize && !bytes.empty())
+			std::memcpy(a._handle->DataBegin(), bytes.data(), bytes.size());
+	}
+}
+
+template <typename AttrContainer>
+size_t attributeSize(const AttrContainer& c, size_t n)
+{
+	size_t res = 0;
+	for (const auto& a : c)
+		if (!a._name.empty())
+			res += n * a._handle->SizeOf();
+	return res;
+}
+
+struct FaceVerts { int v[3]; };
+struct EdgeVerts { int v[2]; };
+struct WedgeTexCoords { CFaceO::TexCoordType t[3]; };
+
+}
+
+MeshDocumentHistory::MeshDocumentHistory(MeshDocument& md) :
+	md(md),
+	enabled(true),
+	recording(false),
+	captured(false),
+	memoryBudget(512 * 1024 * 1024),
+	diskBudget(2048ull * 1024 * 1024),
+	cacheDir(QDir::tempPath())
+{
+}
+
+MeshDocumentHistory::~MeshDocumentHistory()
+{
+}
+
+/**
+ * @brief A disabled history does not record the operations, and is cleared.
+ */
+void MeshDocumentHistory::setEnabled(bool enabled)
+{
+	this->enabled = enabled;
+	if (!enabled)
+		clear();
+}
+
+bool MeshDocumentHistory::isEnabled() const
+{
+	return enabled;
+}
+
+void MeshDocumentHistory::setMemoryBudget(size_t bytes)
+{
+	memoryBudget = bytes;
+	enforceBudgets();
+}
+
+void MeshDocumentHistory::setDiskBudget(size_t bytes)
+{
+	diskBudget = bytes;
+	enforceBudgets();
+}
+
+void MeshDocumentHistory::setCacheDirectory(const QString& dir)
+{
+	cacheDir = dir;
+}
+
+/**
+ * @brief Starts the recording of an operation that is going to change the
+ * <mask> portion of the meshes with the given ids. Nothing is saved here:
+ * the meshes are saved by captureOperation.
+ */
+void MeshDocumentHistory::beginOperation(
+		const QString& label,
+		const std::vector<int>& meshIds,
+		int mask)
+{
+	if (!enabled)
+		return;
+	pending = Entry();
+	pending.label = label;
+	pending.mask = mask;
+	pending.currentMeshId = md.mm() != nullptr ? md.mm()->id() : -1;
+	operationMeshIds = meshIds;
+	meshIdsBeforeOperation.clear();
+	for (const MeshModel& m : md.meshIterator())
+		meshIdsBeforeOperation.push_back(m.id());
+	recording = true;
+	captured = false;
+}
+
+/**
+ * @brief Saves the meshes of the operation started by beginOperation. It must
+ * be called just before the meshes are modified, and it can be called from the
+ * thread that runs the operation.
+ *
+ * The arrays that did not change since they were last saved or restored are
+ * shared with the previous entries instead of being read again.
+ */
+void MeshDocumentHistory::captureOperation()
+{
+	if (!recording || captured)
+		return;
+	// an operation that does not fit in the budgets is not saved, and so
+	// commitOperation clears the history
+	size_t size = 0;
+	for (int id : operationMeshIds) {
+		MeshModel* m = md.getMesh(id);
+		if (m != nullptr)
+			size += snapshotSize(*m, pending.mask);
+	}
+	if (size > memoryBudget + diskBudget)
+		return;
+	for (int id : operationMeshIds) {
+		MeshModel* m = md.getMesh(id);
+		if (m != nullptr)
+			pending.snapshots.push_back(createSnapshot(*m, pending.mask));
+	}
+	// the saved arrays are going to be modified by the operation
+	for (const MeshSnapshot& s : pending.snapshots) {
+		if (s.topology) {
+			meshChanged(s.meshId);
+		}
+		else {
+			for (int t = 0; t < BUFFER_TYPE_NUMBER; ++t)
+				if (s.buffers[t])
+					currentBuffers.erase(std::make_pair(s.meshId, t));
+		}
+	}
+	captured = true;
+}
+
+/**
+ * @brief Ends the recording of the current operation and pushes it on the
+ * undo stack. The layers erased by the operation are moved in the history.
+ *
+ * changedMask is the portion of the meshes that the operation actually
+ * changed (e.g. the postConditionMask returned by the filter), that can be
+ * wider than the mask given to beginOperation. If the saved arrays do not
+ * cover it, the state before the operation cannot be restored: the history
+ * is cleared and false is returned.
+ */
+bool MeshDocumentHistory::commitOperation(int changedMask)
+{
+	if (!recording)
+		return true;
+	recording = false;
+
+	// the state before an operation that has not been saved cannot be
+	// restored anymore, and neither the ones before it
+	if (!captured) {
+		md.trashedMeshList.clear();
+		clear();
+		return true;
+	}
+	for (const MeshSnapshot& s : pending.snapshots) {
+		if (!s.topology && (changedMask & RECORDED_MASK & ~s.mask) != 0) {
+			md.trashedMeshList.clear();
+			clear();
+			return false;
+		}
+	}
+
+	for (const MeshModel& m : md.meshIterator()) {
+		if (std::find(meshIdsBeforeOperation.begin(), meshIdsBeforeOperation.end(), m.id()) == meshIdsBeforeOperation.end())
+			pending.createdMeshIds.push_back(m.id());
+	}
+	for (const MeshModel& m : md.trashedMeshList) {
+		if (std::find(meshIdsBeforeOperation.begin(), meshIdsBeforeOperation.end(), m.id()) != meshIdsBeforeOperation.end())
+			pending.erasedMeshIds.push_back(m.id());
+	}
+	pending.detachedMeshes.splice(pending.detachedMeshes.end(), md.trashedMeshList);
+
+	if (pending.snapshots.empty() && pending.createdMeshIds.empty() && pending.erasedMeshIds.empty()) {
+		pending = Entry();
+		return true;
+	}
+
+	undoStack.push_back(std::move(pending));
+	pending = Entry();
+	redoStack.clear();
+	enforceBudgets();
+	return true;
+}
+
+/**
+ * @brief Ends the recording of the current operation restoring the state of
+ * the document before it (e.g. when the filter has failed or has been canceled).
+ * Returns false if the meshes have not been restored, because they were not
+ * saved yet (i.e. the operation did not start to modify them) or because the
+ * saved state does not match anymore the meshes.
+ */
+bool MeshDocumentHistory::rollbackOperation()
+{
+	if (!recording)
+		return false;
+	recording = false;
+
+	std::vector<int> created;
+	for (const MeshModel& m : md.meshIterator()) {
+		if (std::find(meshIdsBeforeOperation.begin(), meshIdsBeforeOperation.end(), m.id()) == meshIdsBeforeOperation.end())
+			created.push_back(m.id());
+	}
+	std::list<MeshModel> createdMeshes;
+	detachMeshes(created, createdMeshes);
+	attachMeshes(md.trashedMeshList);
+
+	bool ok = captured;
+	for (const MeshSnapshot& s : pending.snapshots) {
+		MeshModel* m = md.getMesh(s.meshId);
+		if (m == nullptr || !isApplicable(s, *m))
+			ok = false;
+	}
+	if (ok) {
+		for (const MeshSnapshot& s : pending.snapshots)
+			applySnapshot(s, *md.getMesh(s.meshId));
+		if (md.getMesh(pending.currentMeshId) != nullptr)
+			md.setCurrentMesh(pending.currentMeshId);
+	}
+	pending = Entry();
+	return ok;
+}
+
+bool MeshDocumentHistory::isRecording() const
+{
+	return recording;
+}
+
+bool MeshDocumentHistory::canUndo() const
+{
+	return !recording && !undoStack.empty();
+}
+
+bool MeshDocumentHistory::canRedo() const
+{
+	return !recording && !redoStack.empty();
+}
+
+QString MeshDocumentHistory::undoLabel() const
+{
+	return undoStack.empty() ? QString() : undoStack.back().label;
+}
+
+QString MeshDocumentHistory::redoLabel() const
+{
+	return redoStack.empty() ? QString() : redoStack.back().label;
+}
+
+bool MeshDocumentHistory::undo(int& restoredMask)
+{
+	restoredMask = MeshModel::MM_NONE;
+	if (!canUndo())
+		return false;
+	Entry e = std::move(undoStack.back());
+	undoStack.pop_back();
+	std::vector<int> created = e.createdMeshIds;
+	if (!swapState(e, created, restoredMask)) {
+		clear();
+		return false;
+	}
+	redoStack.push_back(std::move(e));
+	enforceBudgets();
+	return true;
+}
+
+bool MeshDocumentHistory::redo(int& restoredMask)
+{
+	restoredMask = MeshModel::MM_NONE;
+	if (!canRedo())
+		return false;
+	Entry e = std::move(redoStack.back());
+	redoStack.pop_back();
+	std::vector<int> erased = e.erasedMeshIds;
+	if (!swapState(e, erased, restoredMask)) {
+		clear();
+		return false;
+	}
+	undoStack.push_back(std::move(e));
+	enforceBudgets();
+	return true;
+}
+
+void MeshDocumentHistory::clear()
+{
+	undoStack.clear();
+	redoStack.clear();
+	pending = Entry();
+	recording = false;
+	captured = false;
+	operationMeshIds.clear();
+	meshIdsBeforeOperation.clear();
+	currentBuffers.clear();
+}
+
+/**
+ * @brief Must be called when the mesh with the given id has been modified
+ * outside an operation recorded by the history (e.g. by an edit tool): its
+ * saved arrays cannot be shared anymore with the next saved states.
+ */
+void MeshDocumentHistory::meshChanged(int meshId)
+{
+	currentBuffers.erase(
+		currentBuffers.lower_bound(std::make_pair(meshId, 0)),
+		currentBuffers.lower_bound(std::make_pair(meshId + 1, 0)));
+}
+
+void MeshDocumentHistory::documentChanged()
+{
+	currentBuffers.clear();
+}
+
+size_t MeshDocumentHistory::memoryUsage() const
+{
+	std::set<const Buffer*> counted;
+	size_t res = 0;
+	auto count = [&](const Entry& e) {
+		for (const MeshSnapshot& s : e.snapshots) {
+			for (const std::shared_ptr<Buffer>& b : s.buffers)
+				if (b && !b->isSpilled() && counted.insert(b.get()).second)
+					res += b->size();
+			for (const AttributeSnapshot& a : s.attributes)
+				if (!a.data->isSpilled())
+					res += a.data->size();
+		}
+		for (const MeshModel& m : e.detachedMeshes)
+			res += m.cm.vert.size() * sizeof(CVertexO) + m.cm.face.size() * sizeof(CFaceO);
+	};
+	for (const Entry& e : undoStack)
+		count(e);
+	for (const Entry& e : redoStack)
+		count(e);
+	return res;
+}
+
+size_t MeshDocumentHistory::diskUsage() const
+{
+	std::set<const Buffer*> counted;
+	size_t res = 0;
+	auto count = [&](const Entry& e) {
+		for (const MeshSnapshot& s : e.snapshots) {
+			for (const std::shared_ptr<Buffer>& b : s.buffers)
+				if (b && b->isSpilled() && counted.insert(b.get()).second)
+					res += b->size();
+			for (const AttributeSnapshot& a : s.attributes)
+				if (a.data->isSpilled())
+					res += a.data->size();
+		}
+	};
+	for (const Entry& e : undoStack)
+		count(e);
+	for (const Entry& e : redoStack)
+		count(e);
+	return res;
+}
+
+/**
+ * @brief Returns the mask of the components saved by a snapshot of the given
+ * mesh for an operation that changes the <mask> portion of it: a change of the
+ * topology requires all the arrays of the mesh. The optional components are
+ * then saved only if the mesh has them.
+ */
+int MeshDocumentHistory::snapshotMask(const MeshModel& m, int mask)
+{
+	if (mask & TOPOLOGY_MASK) {
+		mask |= MeshModel::MM_VERTCOORD | MeshModel::MM_VERTNORMAL | MeshModel::MM_VERTFLAG |
+				MeshModel::MM_FACENORMAL | MeshModel::MM_FACEFLAG | (m.dataMask() & OPTIONAL_MASK);
+	}
+	return mask;
+}
+
+/**
+ * @brief Returns the bytes taken by a snapshot of the given mesh that does not
+ * share any array with the previous ones.
+ */
+size_t MeshDocumentHistory::snapshotSize(const MeshModel& m, int mask)
+{
+	const CMeshO& cm = m.cm;
+	mask = snapshotMask(m, mask);
+	const int present = ~OPTIONAL_MASK | m.dataMask();
+	const size_t vn = cm.vert.size();
+	const size_t fn = cm.face.size();
+	const size_t en = cm.edge.size();
+	size_t res = 0;
+	auto add = [&](int component, size_t n, size_t size) {
+		if (mask & present & component)
+			res += n * size;
+	};
+	add(MeshModel::MM_VERTCOORD, vn, sizeof(Point3m));
+	add(MeshModel::MM_VERTNORMAL, vn, sizeof(Point3m));
+	add(MeshModel::MM_VERTCOLOR, vn, sizeof(vcg::Color4b));
+	add(MeshModel::MM_VERTQUALITY, vn, sizeof(Scalarm));
+	add(MeshModel::MM_VERTTEXCOORD, vn, sizeof(CVertexO::TexCoordType));
+	add(MeshModel::MM_VERTFLAG | MeshModel::MM_VERTFLAGSELECT, vn, sizeof(int));
+	add(MeshModel::MM_FACENORMAL, fn, sizeof(Point3m));
+	add(MeshModel::MM_FACECOLOR, fn, sizeof(vcg::Color4b));
+	add(MeshModel::MM_FACEQUALITY, fn, sizeof(Scalarm));
+	add(MeshModel::MM_WEDGTEXCOORD, fn, sizeof(WedgeTexCoords));
+	add(MeshModel::MM_FACEFLAG | MeshModel::MM_FACEFLAGSELECT, fn, sizeof(int));
+	if (mask & TOPOLOGY_MASK) {
+		res += fn * sizeof(FaceVerts) + en * (sizeof(EdgeVerts) + sizeof(int));
+		res += attributeSize(cm.vert_attr, vn) + attributeSize(cm.face_attr, fn) +
+				attributeSize(cm.edge_attr, en);
+	}
+	return res;
+}
+
+MeshDocumentHistory::MeshSnapshot MeshDocumentHistory::createSnapshot(MeshModel& m, int mask)
+{
+	CMeshO& cm = m.cm;
+	MeshSnapshot s;
+	s.meshId = m.id();
+	s.topology = (mask & TOPOLOGY_MASK) != 0;
+	s.mask = snapshotMask(m, mask);
+	s.dataMask = m.dataMask();
+	s.vertNumber = cm.vert.size();
+	s.faceNumber = cm.face.size();
+	s.edgeNumber = cm.edge.size();
+	s.Tr = cm.Tr;
+	s.shot = cm.shot;
+
+	if (s.topology || (s.mask & (MeshModel::MM_VERTTEXCOORD | MeshModel::MM_WEDGTEXCOORD))) {
+		s.hasTextures = true;
+		s.textureNames = cm.textures;
+		s.textureImages = m.getTextures();
+	}
+
+	// an array that is still current in the cache is shared, not read again
+	auto save = [&](BufferType type, const auto& c, auto get) {
+		using T = typename std::decay<decltype(get(c[0]))>::type;
+		std::shared_ptr<Buffer> b = currentBuffer(s.meshId, type, c.size() * sizeof(T));
+		if (!b) {
+			b = std::make_shared<Buffer>(gather<T>(c, get));
+			setCurrentBuffer(s.meshId, type, b);
+		}
+		s.buffers[type] = b;
+	};
+
+	if (s.mask & MeshModel::MM_VERTCOORD)
+		save(VERT_COORD, cm.vert, [](const CVertexO& v) { return v.cP(); });
+	if (s.mask & MeshModel::MM_VERTNORMAL)
+		save(VERT_NORMAL, cm.vert, [](const CVertexO& v) { return v.cN(); });
+	if ((s.mask & MeshModel::MM_VERTCOLOR) && m.hasDataMask(MeshModel::MM_VERTCOLOR))
+		save(VERT_COLOR, cm.vert, [](const CVertexO& v) { return v.cC(); });
+	if ((s.mask & MeshModel::MM_VERTQUALITY) && m.hasDataMask(MeshModel::MM_VERTQUALITY))
+		save(VERT_QUALITY, cm.vert, [](const CVertexO& v) { return v.cQ(); });
+	if ((s.mask & MeshModel::MM_VERTTEXCOORD) && m.hasDataMask(MeshModel::MM_VERTTEXCOORD))
+		save(VERT_TEXCOORD, cm.vert, [](const CVertexO& v) { return v.cT(); });
+	if (s.mask & (MeshModel::MM_VERTFLAG | MeshModel::MM_VERTFLAGSELECT))
+		save(VERT_FLAGS, cm.vert, [](const CVertexO& v) { return v.cFlags(); });
+	if (s.topology) {
+		const CVertexO* base = cm.vert.empty() ? nullptr : &cm.vert[0];
+		save(FACE_VERTS, cm.face, [base](const CFaceO& f) {
+			FaceVerts fv;
+			for (int i = 0; i < 3; ++i)
+				fv.v[i] = (f.IsD() || f.cV(i) == nullptr) ? -1 : int(f.cV(i) - base);
+			return fv;
+		});
+		save(EDGE_VERTS, cm.edge, [base](const CEdgeO& e) {
+			EdgeVerts ev;
+			for (int i = 0; i < 2; ++i)
+				ev.v[i] = (e.IsD() || e.cV(i) == nullptr) ? -1 : int(e.cV(i) - base);
+			return ev;
+		});
+		save(EDGE_FLAGS, cm.edge, [](const CEdgeO& e) { return e.cFlags(); });
+
+		// the custom attributes are not shared: whoever changes them does not
+		// declare it in the masks
+		auto saveAttributes = [&](AttributeElement element, const auto& c, size_t n) {
+			for (const auto& a : c) {
+				if (a._name.empty())
+					continue;
+				AttributeSnapshot as;
+				as.element = element;
+				as.name = a._name;
+				as.data = std::make_shared<Buffer>(gatherAttribute(c, a._name, n, as.elemSize));
+				s.attributes.push_back(std::move(as));
+			}
+		};
+		saveAttributes(VERT_ATTRIBUTE, cm.vert_attr, cm.vert.size());
+		saveAttributes(FACE_ATTRIBUTE, cm.face_attr, cm.face.size());
+		saveAttributes(EDGE_ATTRIBUTE, cm.edge_attr, cm.edge.size());
+	}
+	if (s.mask & MeshModel::MM_FACENORMAL)
+		save(FACE_NORMAL, cm.face, [](const CFaceO& f) { return f.cN(); });
+	if ((s.mask & MeshModel::MM_FACECOLOR) && m.hasDataMask(MeshModel::MM_FACECOLOR))
+		save(FACE_COLOR, cm.face, [](const CFaceO& f) { return f.cC(); });
+	if ((s.mask & MeshModel::MM_FACEQUALITY) && m.hasDataMask(MeshModel::MM_FACEQUALITY))
+		save(FACE_QUALITY, cm.face, [](const CFaceO& f) { return f.cQ(); });
+	if ((s.mask & MeshModel::MM_WEDGTEXCOORD) && m.hasDataMask(MeshModel::MM_WEDGTEXCOORD)) {
+		save(FACE_WEDGETEXCOORD, cm.face, [](const CFaceO& f) {
+			WedgeTexCoords wt;
+			for (int i = 0; i < 3; ++i)
+				wt.t[i] = f.cWT(i);
+			return wt;
+		});
+	}
+	if (s.mask & (MeshModel::MM_FACEFLAG | MeshModel::MM_FACEFLAGSELECT))
+		save(FACE_FLAGS, cm.face, [](const CFaceO& f) { return f.cFlags(); });
+	return s;
+}
+
+/**
+ * @brief A snapshot that does not store the topology can be applied only to
+ * a mesh having the same number of elements (deleted ones included).
+ */
+bool MeshDocumentHistory::isApplicable(const MeshSnapshot& s, const MeshModel& m) const
+{
+	if (s.meshId != m.id())
+		return false;
+	if (s.topology)
+		return true;
+	return s.vertNumber == m.cm.vert.size() && s.faceNumber == m.cm.face.size();
+}
+
+void MeshDocumentHistory::applySnapshot(const MeshSnapshot& s, MeshModel& m)
+{
+	CMeshO& cm = m.cm;
+
+	// optional components enabled or disabled by the operation
+	int optional = s.mask & OPTIONAL_MASK;
+	m.clearDataMask(optional & ~s.dataMask & m.dataMask());
+	m.updateDataMask(optional & s.dataMask & ~m.dataMask());
+
+	if (s.topology) {
+		// all the vertex references are rebuilt from the saved indices, the
+		// adjacencies are recomputed below; the custom attributes are resized
+		// with the elements and their saved values are copied back
+		cm.vert.resize(s.vertNumber);
+		cm.face.resize(s.faceNumber);
+		cm.edge.resize(s.edgeNumber);
+		resizeAttributes(cm.vert_attr, s.vertNumber);
+		resizeAttributes(cm.face_attr, s.faceNumber);
+		resizeAttributes(cm.edge_attr, s.edgeNumber);
+		restoreAttributes(s, cm);
+
+		CVertexO* base = cm.vert.empty() ? nullptr : &cm.vert[0];
+		scatter<FaceVerts>(s.buffers[FACE_VERTS]->data(), cm.face, [&](CFaceO& f, const FaceVerts& fv) {
+			for (int i = 0; i < 3; ++i)
+				f.V(i) = fv.v[i] < 0 ? nullptr : base + fv.v[i];
+		});
+		scatter<EdgeVerts>(s.buffers[EDGE_VERTS]->data(), cm.edge, [&](CEdgeO& e, const EdgeVerts& ev) {
+			for (int i = 0; i < 2; ++i)
+				e.V(i) = ev.v[i] < 0 ? nullptr : base + ev.v[i];
+		});
+		scatter<int>(s.buffers[EDGE_FLAGS]->data(), cm.edge, [](CEdgeO& e, int flags) { e.Flags() = flags; });
+	}
+
+	if (s.buffers[VERT_COORD])
+		scatter<Point3m>(s.buffers[VERT_COORD]->data(), cm.vert, [](CVertexO& v, const Point3m& p) { v.P() = p; });
+	if (s.buffers[VERT_NORMAL])
+		scatter<Point3m>(s.buffers[VERT_NORMAL]->data(), cm.vert, [](CVertexO& v, const Point3m& n) { v.N() = n; });
+	if (s.buffers[VERT_COLOR])
+		scatter<vcg::Color4b>(s.buffers[VERT_COLOR]->data(), cm.vert, [](CVertexO& v, const vcg::Color4b& c) { v.C() = c; });
+	if (s.buffers[VERT_QUALITY])
+		scatter<Scalarm>(s.buffers[VERT_QUALITY]->data(), cm.vert, [](CVertexO& v, Scalarm q) { v.Q() = q; });
+	if (s.buffers[VERT_TEXCOORD])
+		scatter<CVertexO::TexCoordType>(s.buffers[VERT_TEXCOORD]->data(), cm.vert, [](CVertexO& v, const CVertexO::TexCoordType& t) { v.T() = t; });
+	if (s.buffers[VERT_FLAGS]) {
+		if (s.mask & MeshModel::MM_VERTFLAG) {
+			scatter<int>(s.buffers[VERT_FLAGS]->data(), cm.vert, [](CVertexO& v, int flags) { v.Flags() = flags; });
+		}
+		else {
+			scatter<int>(s.buffers[VERT_FLAGS]->data(), cm.vert, [](CVertexO& v, int flags) {
+				v.Flags() = (v.Flags() & ~CVertexO::SELECTED) | (flags & CVertexO::SELECTED);
+			});
+		}
+	}
+	if (s.buffers[FACE_NORMAL])
+		scatter<Point3m>(s.buffers[FACE_NORMAL]->data(), cm.face, [](CFaceO& f, const Point3m& n) { f.N() = n; });
+	if (s.buffers[FACE_COLOR])
+		scatter<vcg::Color4b>(s.buffers[FACE_COLOR]->data(), cm.face, [](CFaceO& f, const vcg::Color4b& c) { f.C() = c; });
+	if (s.buffers[FACE_QUALITY])
+		scatter<Scalarm>(s.buffers[FACE_QUALITY]->data(), cm.face, [](CFaceO& f, Scalarm q) { f.Q() = q; });
+	if (s.buffers[FACE_WEDGETEXCOORD]) {
+		scatter<WedgeTexCoords>(s.buffers[FACE_WEDGETEXCOORD]->data(), cm.face, [](CFaceO& f, const WedgeTexCoords& wt) {
+			for (int i = 0; i < 3; ++i)
+				f.WT(i) = wt.t[i];
+		});
+	}
+	if (s.buffers[FACE_FLAGS]) {
+		if (s.mask & MeshModel::MM_FACEFLAG) {
+			scatter<int>(s.buffers[FACE_FLAGS]->data(), cm.face, [](CFaceO& f, int flags) { f.Flags() = flags; });
+		}
+		else {
+			scatter<int>(s.buffers[FACE_FLAGS]->data(), cm.face, [](CFaceO& f, int flags) {
+				f.Flags() = (f.Flags() & ~CFaceO::SELECTED) | (flags & CFaceO::SELECTED);
+			});
+		}
+	}
+
+	if (s.topology) {
+		cm.vn = std::count_if(cm.vert.begin(), cm.vert.end(), [](const CVertexO& v) { return !v.IsD(); });
+		cm.fn = std::count_if(cm.face.begin(), cm.face.end(), [](const CFaceO& f) { return !f.IsD(); });
+		cm.en = std::count_if(cm.edge.begin(), cm.edge.end(), [](const CEdgeO& e) { return !e.IsD(); });
+		if (m.hasDataMask(MeshModel::MM_FACEFACETOPO))
+			vcg::tri::UpdateTopology<CMeshO>::FaceFace(cm);
+		if (m.hasDataMask(MeshModel::MM_VERTFACETOPO))
+			vcg::tri::UpdateTopology<CMeshO>::VertexFace(cm);
+	}
+	if (s.mask & (MeshModel::MM_VERTCOORD | MeshModel::MM_TRANSFMATRIX))
+		vcg::tri::UpdateBounding<CMeshO>::Box(cm);
+
+	if (s.mask & MeshModel::MM_TRANSFMATRIX)
+		cm.Tr = s.Tr;
+	if (s.mask & MeshModel::MM_CAMERA)
+		cm.shot = s.shot;
+	if (s.hasTextures) {
+		m.clearTextures();
+		cm.textures = s.textureNames;
+		for (const auto& t : s.textureImages)
+			m.addTexture(t.first, t.second);
+	}
+
+	// the restored arrays are now the current ones of the mesh
+	if (s.topology)
+		meshChanged(s.meshId);
+	for (int t = 0; t < BUFFER_TYPE_NUMBER; ++t) {
+		if (!s.buffers[t])
+			continue;
+		bool onlySelection =
+			(t == VERT_FLAGS && !(s.mask & MeshModel::MM_VERTFLAG)) ||
+			(t == FACE_FLAGS && !(s.mask & MeshModel::MM_FACEFLAG));
+		if (onlySelection)
+			currentBuffers.erase(std::make_pair(s.meshId, t));
+		else
+			setCurrentBuffer(s.meshId, BufferType(t), s.buffers[t]);
+	}
+}
+
+/**
+ * @brief Restores the values of the custom attributes saved by a topology
+ * snapshot; the named attributes added after it are removed.
+ */
+void MeshDocumentHistory::restoreAttributes(const MeshSnapshot& s, CMeshO& cm)
+{
+	auto saved = [&](AttributeElement element, const std::string& name) {
+		return std::any_of(s.attributes.begin(), s.attributes.end(), [&](const AttributeSnapshot& a) {
+			return a.element == element && a.name == name;
+		});
+	};
+	auto addedNames = [&](AttributeElement element, const auto& c) {
+		std::vector<std::string> names;
+		for (const auto& a : c)
+			if (!a._name.empty() && !saved(element, a._name))
+				names.push_back(a._name);
+		return names;
+	};
+	for (const std::string& name : addedNames(VERT_ATTRIBUTE, cm.vert_attr))
+		vcg::tri::Allocator<CMeshO>::DeletePerVertexAttribute(cm, name);
+	for (const std::string& name : addedNames(FACE_ATTRIBUTE, cm.face_attr))
+		vcg::tri::Allocator<CMeshO>::DeletePerFaceAttribute(cm, name);
+	for (const std::string& name : addedNames(EDGE_ATTRIBUTE, cm.edge_attr))
+		vcg::tri::Allocator<CMeshO>::DeletePerEdgeAttribute(cm, name);
+
+	for (const AttributeSnapshot& a : s.attributes) {
+		std::vector<char> bytes = a.data->data();
+		switch (a.element) {
+		case VERT_ATTRIBUTE: scatterAttribute(cm.vert_attr, a.name, a.elemSize, bytes); break;
+		case FACE_ATTRIBUTE: scatterAttribute(cm.face_attr, a.name, a.elemSize, bytes); break;
+		case EDGE_ATTRIBUTE: scatterAttribute(cm.edge_attr, a.name, a.elemSize, bytes); break;
+		}
+	}
+}
+
+/**
+ * @brief Returns the buffer saved (or restored) for the given mesh and type if
+ * the mesh has not been modified since then, nullptr otherwise.
+ */
+std::shared_ptr<MeshDocumentHistory::Buffer> MeshDocumentHistory::currentBuffer(
+		int meshId,
+		BufferType type,
+		size_t byteSize) const
+{
+	auto it = currentBuffers.find(std::make_pair(meshId, int(type)));
+	if (it == currentBuffers.end())
+		return nullptr;
+	std::shared_ptr<Buffer> b = it->second.lock();
+	if (b && b->size() != byteSize)
+		return nullptr;
+	return b;
+}
+
+void MeshDocumentHistory::setCurrentBuffer(
+		int meshId,
+		BufferType type,
+		const std::shared_ptr<Buffer>& b)
+{
+	currentBuffers[std::make_pair(meshId, int(type))] = b;
+}
+
+/**
+ * @brief Saves the current state of the meshes of the entry, restores the
+ * one stored in the entry and swaps the layers created/erased by the operation.
+ */
+bool MeshDocumentHistory::swapState(
+		Entry& e,
+		const std::vector<int>& toDetach,
+		int& restoredMask)
+{
+	for (const MeshSnapshot& s : e.snapshots) {
+		MeshModel* m = findMesh(s.meshId, e);
+		if (m == nullptr || !isApplicable(s, *m))
+			return false;
+	}
+
+	std::vector<MeshSnapshot> current;
+	for (const MeshSnapshot& s : e.snapshots) {
+		MeshModel* m = findMesh(s.meshId, e);
+		current.push_back(createSnapshot(*m, e.mask));
+	}
+
+	std::list<MeshModel> detached;
+	detachMeshes(toDetach, detached);
+	attachMeshes(e.detachedMeshes);
+	e.detachedMeshes.splice(e.detachedMeshes.end(), detached);
+
+	restoredMask = e.mask;
+	for (const MeshSnapshot& s : e.snapshots) {
+		MeshModel* m = md.getMesh(s.meshId);
+		if (m != nullptr) {
+			applySnapshot(s, *m);
+			restoredMask |= s.mask;
+		}
+	}
+	e.snapshots = std::move(current);
+
+	int currentMeshId = md.mm() != nullptr ? md.mm()->id() : -1;
+	if (md.getMesh(e.currentMeshId) != nullptr)
+		md.setCurrentMesh(e.currentMeshId);
+	e.currentMeshId = currentMeshId;
+	return true;
+}
+
+MeshModel* MeshDocumentHistory::findMesh(int id, Entry& e)
+{
+	MeshModel* m = md.getMesh(id);
+	if (m != nullptr)
+		return m;
+	for (MeshModel& dm : e.detachedMeshes)
+		if (dm.id() == id)
+			return &dm;
+	return nullptr;
+}
+
+void MeshDocumentHistory::attachMeshes(std::list<MeshModel>& meshes)
+{
+	std::vector<int> ids;
+	for (const MeshModel& m : meshes)
+		ids.push_back(m.id());
+	md.meshList.splice(md.meshList.end(), meshes);
+	for (int id : ids) {
+		emit md.meshSetChanged();
+		emit md.meshAdded(id);
+	}
+}
+
+void MeshDocumentHistory::detachMeshes(const std::vector<int>& ids, std::list<MeshModel>& meshes)
+{
+	for (int id : ids) {
+		auto it = std::find_if(md.meshList.begin(), md.meshList.end(), [id](const MeshModel& m) {
+			return m.id() == id;
+		});
+		if (it == md.meshList.end())
+			continue;
+		if (md.currentMesh == &*it) {
+			auto other = std::find_if(md.meshList.begin(), md.meshList.end(), [id](const MeshModel& m) {
+				return m.id() != id;
+			});
+			md.setCurrentMesh(other != md.meshList.end() ? other->id() : -1);
+		}
+		meshes.splice(meshes.end(), md.meshList, it);
+		emit md.meshSetChanged();
+		emit md.meshRemoved(id);
+	}
+}
+
+/**
+ * @brief Moves the oldest arrays to the disk cache while the history exceeds
+ * the memory budget. The oldest entries are discarded only while the disk
+ * budget is exceeded, or while what cannot be moved on disk (the detached
+ * layers and the arrays that could not be written) exceeds the memory budget,
+ * up to the entry nearest to the current state.
+ */
+void MeshDocumentHistory::enforceBudgets()
+{
+	size_t memory = memoryUsage();
+	if (memory > memoryBudget) {
+		auto spill = [&](const std::shared_ptr<Buffer>& b) {
+			if (memory > memoryBudget && b && !b->isSpilled() && b->spill(cacheDir))
+				memory -= b->size();
+		};
+		auto spillEntry = [&](Entry& e) {
+			for (MeshSnapshot& s : e.snapshots) {
+				for (std::shared_ptr<Buffer>& b : s.buffers)
+					spill(b);
+				for (AttributeSnapshot& a : s.attributes)
+					spill(a.data);
+			}
+		};
+		for (Entry& e : undoStack)
+			spillEntry(e);
+		// the first entries of the redo stack are the farthest from the current state
+		for (Entry& e : redoStack)
+			spillEntry(e);
+	}
+	auto overBudget = [&]() {
+		return memoryUsage() > memoryBudget || diskUsage() > diskBudget;
+	};
+	while (!undoStack.empty() && overBudget())
+		undoStack.pop_front();
+	while (!redoStack.empty() && overBudget())
+		redoStack.erase(redoStack.begin());
+}
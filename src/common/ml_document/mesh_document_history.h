@@ -0,0 +1,218 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef MESHLAB_MESH_DOCUMENT_HISTORY_H
+#define MESHLAB_MESH_DOCUMENT_HISTORY_H
+
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <QImage>
+#include <QString>
+
+#include "mesh_model.h"
+
+class MeshDocument;
+class QTemporaryFile;
+
+/*
+The undo/redo history of a MeshDocument.
+
+Each operation (e.g. the application of a filter) is recorded between a
+beginOperation and a commitOperation call. The meshes are saved by
+captureOperation, called just before the operation starts to modify them
+(the filter execution engine calls it on its worker thread). Only the per
+element arrays declared by the mask passed to beginOperation (usually the
+postCondition of the filter) and present in the mesh are saved (e.g. the
+vertex colors are not saved for a mesh without them); if the mask says that
+the topology changes (MM_VERTNUMBER, MM_FACENUMBER or MM_FACEVERT, and so
+MM_ALL) all the arrays of the mesh, its custom attributes and its textures are
+saved, and such an operation costs a copy of the arrays changed since the
+previous saved state. commitOperation checks that the saved arrays cover the
+mask of the changes actually made (a filter can return a postConditionMask
+wider than its postCondition); when they do not, the history is cleared
+instead of keeping an entry that would restore a wrong state. Layers created
+or deleted by the operation are kept alive by the history.
+
+Saved arrays are copy-on-write: the history remembers which saved arrays are
+still equal to the ones of the meshes (the ones saved or restored and not
+modified since then), and shares them instead of reading the mesh again.
+Whoever modifies a mesh outside a recorded operation must call meshChanged
+(or documentChanged).
+
+When the history takes more memory than the given budget, the arrays of the
+oldest entries are moved to temporary files in the cache directory; the
+oldest entries are discarded while the disk budget is exceeded. The budgets
+are hard limits: an operation whose meshes alone do not fit in them is not
+saved, and the history is cleared. A disabled history saves nothing.
+
+Note: the values of the per vertex, face and edge custom attributes are
+copied byte by byte (as vcg does for the padded attributes), and the custom
+attributes erased by an operation are not restored. The changes made by the edit tools are not
+recorded.
+*/
+class MeshDocumentHistory
+{
+public:
+	MeshDocumentHistory(MeshDocument& md);
+	~MeshDocumentHistory();
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+	void setMemoryBudget(size_t bytes);
+	void setDiskBudget(size_t bytes);
+	void setCacheDirectory(const QString& dir);
+
+	void beginOperation(const QString& label, const std::vector<int>& meshIds, int mask);
+	void captureOperation();
+	bool commitOperation(int changedMask);
+	bool rollbackOperation();
+	bool isRecording() const;
+
+	bool canUndo() const;
+	bool canRedo() const;
+	QString undoLabel() const;
+	QString redoLabel() const;
+
+	// restore the state before (after) the last (undone) operation;
+	// restoredMask is the mask of the attributes that have been changed
+	bool undo(int& restoredMask);
+	bool redo(int& restoredMask);
+
+	void clear();
+
+	// the given mesh (all the meshes) has been modified outside a recorded operation
+	void meshChanged(int meshId);
+	void documentChanged();
+
+	size_t memoryUsage() const;
+	size_t diskUsage() const;
+
+private:
+	class Buffer;
+
+	enum BufferType {
+		VERT_COORD = 0,
+		VERT_NORMAL,
+		VERT_COLOR,
+		VERT_QUALITY,
+		VERT_TEXCOORD,
+		VERT_FLAGS,
+		FACE_VERTS,
+		FACE_NORMAL,
+		FACE_COLOR,
+		FACE_QUALITY,
+		FACE_WEDGETEXCOORD,
+		FACE_FLAGS,
+		EDGE_VERTS,
+		EDGE_FLAGS,
+		BUFFER_TYPE_NUMBER
+	};
+
+	enum AttributeElement {
+		VERT_ATTRIBUTE = 0,
+		FACE_ATTRIBUTE,
+		EDGE_ATTRIBUTE
+	};
+
+	struct AttributeSnapshot
+	{
+		AttributeElement element;
+		std::string name;
+		size_t elemSize;
+		std::shared_ptr<Buffer> data;
+	};
+
+	struct MeshSnapshot
+	{
+		int meshId;
+		int mask;
+		int dataMask;
+		bool topology;
+		size_t vertNumber;
+		size_t faceNumber;
+		size_t edgeNumber;
+		std::shared_ptr<Buffer> buffers[BUFFER_TYPE_NUMBER];
+		std::vector<AttributeSnapshot> attributes;
+		Matrix44m Tr;
+		Shotm shot;
+		bool hasTextures = false;
+		std::vector<std::string> textureNames;
+		std::map<std::string, QImage> textureImages;
+	};
+
+	struct Entry
+	{
+		QString label;
+		int mask;
+		// the state restored by the next undo (or redo) of this entry
+		std::vector<MeshSnapshot> snapshots;
+		std::vector<int> createdMeshIds;
+		std::vector<int> erasedMeshIds;
+		// the layers that are not in the document in the current state of the
+		// entry: the erased ones while the entry is done, the created ones
+		// while it is undone
+		std::list<MeshModel> detachedMeshes;
+		int currentMeshId;
+	};
+
+	static int snapshotMask(const MeshModel& m, int mask);
+	static size_t snapshotSize(const MeshModel& m, int mask);
+	MeshSnapshot createSnapshot(MeshModel& m, int mask);
+	bool isApplicable(const MeshSnapshot& s, const MeshModel& m) const;
+	void applySnapshot(const MeshSnapshot& s, MeshModel& m);
+	static void restoreAttributes(const MeshSnapshot& s, CMeshO& cm);
+	std::shared_ptr<Buffer> currentBuffer(int meshId, BufferType type, size_t byteSize) const;
+	void setCurrentBuffer(int meshId, BufferType type, const std::shared_ptr<Buffer>& b);
+
+	bool swapState(Entry& e, const std::vector<int>& toDetach, int& restoredMask);
+	MeshModel* findMesh(int id, Entry& e);
+	void attachMeshes(std::list<MeshModel>& meshes);
+	void detachMeshes(const std::vector<int>& ids, std::list<MeshModel>& meshes);
+	void enforceBudgets();
+
+	MeshDocument& md;
+	std::deque<Entry> undoStack;
+	std::vector<Entry> redoStack;
+
+	bool enabled;
+	bool recording;
+	bool captured;
+	Entry pending;
+	std::vector<int> operationMeshIds;
+	std::vector<int> meshIdsBeforeOperation;
+
+	// for each mesh and buffer type, the saved array that is still equal to
+	// the one of the mesh
+	std::map<std::pair<int, int>, std::weak_ptr<Buffer>> currentBuffers;
+
+	size_t memoryBudget;
+	size_t diskBudget;
+	QString cacheDir;
+};
+
+#endif // MESHLAB_MESH_DOCUMENT_HISTORY_H
@@ -26,11 +26,16 @@
 #include <QFileInfo>
 
 #include "mesh_model.h"
+#include "texture_cache.h"
+#include "../mlexception.h"
 #include "../utilities/load_save.h"
 
 #include <wrap/gl/math.h>
 
 #include <QDir>
+#include <algorithm>
+#include <iostream>
+#include <mutex>
 #include <utility>
 
 using namespace vcg;
@@ -79,6 +84,43 @@ QString MeshModel::relativePathName(const QString& path) const
 	return relPath;
 }
 
+namespace {
+
+void logDummyTexture(GLLogStream* log, const std::string& textName)
+{
+	if (log){
+		log->log(
+			GLLogStream::WARNING, "Failed loading " + textName +
+			"; using a dummy texture");
+	}
+	else {
+		std::cerr <<
+			"Failed loading " + textName + "; using a dummy texture\n";
+	}
+}
+
+QImage waitTexture(const std::shared_future<QImage>& img)
+{
+	QImage res = img.get();
+	if (res.isNull())
+		throw MLException("Null image");
+	return res;
+}
+
+// waits the decoding of a texture, without holding the textures mutex
+QImage waitTextureOrDummy(const std::string& textName, const std::shared_future<QImage>& img)
+{
+	try {
+		return waitTexture(img);
+	}
+	catch (const std::exception&) {
+		logDummyTexture(nullptr, textName);
+		return QImage(":/resources/images/dummy.png");
+	}
+}
+
+}
+
 /**
  * @brief Starting from the (still unloaded) textures contained in the contained
  * CMeshO, loads the textures in the map of QImages contained in the MeshModel.
@@ -87,44 +129,92 @@ QString MeshModel::relativePathName(const QString& path) const
  * and these names will be mapped with the actual loaded image in the map
  * "textures".
  *
+ * The images are decoded concurrently by the shared TextureCache: meshes
+ * that use the same file share the same image. If lazy is true, the function
+ * does not wait for the decoding, and each image is waited the first time it
+ * is used.
+ *
+ * A relative texture name is searched in the folder of the mesh file, and
+ * never in the current directory.
+ *
  * When a texture is not found, a dummy texture will be used (":/resources/images/dummy.png").
  *
  * Returns the list of non-loaded textures that have been modified with
- * ":/img/dummy.png" in the contained mesh.
+ * ":/img/dummy.png" in the contained mesh. When lazy is true, only the missing
+ * files are listed: the textures that fail to be decoded are replaced
+ * by the dummy texture when they are first used.
  */
 std::list<std::string> MeshModel::loadTextures(
 		GLLogStream* log,
-		vcg::CallBackPos* cb)
+		vcg::CallBackPos* cb,
+		bool lazy)
 {
 	std::list<std::string> unloadedTextures;
+	std::vector<std::pair<std::string, std::shared_future<QImage>>> requests;
+	std::unique_lock<std::mutex> lock(texturesMutex);
 	for (std::string& textName : cm.textures){
-		if (textures.find(textName) == textures.end()){
-			QImage img(":/resources/images/dummy.png");
+		if (textures.find(textName) == textures.end() &&
+			pendingTextures.find(textName) == pendingTextures.end()){
 			QFileInfo finfo(QString::fromStdString(textName));
-			try {
-				img = meshlab::loadImage(finfo.absoluteFilePath(), log, cb);
+			// a relative name is relative to the meshmodel, never to the
+			// current directory, that can be changed by other loading threads
+			bool relativeToMesh = finfo.isRelative() && !fullName().isEmpty();
+			QFileInfo mfi(QFileInfo(fullName()).absolutePath() + "/" + finfo.filePath());
+			QString path;
+			if (!relativeToMesh && finfo.exists()) {
+				path = finfo.absoluteFilePath();
 				textName = finfo.fileName().toStdString();
-			} catch (const MLException& e) {
-				try { //could be relative to the meshmodel
-					QFileInfo mfi(fullName());
-					QString fn2 = mfi.absolutePath() + "/" + finfo.filePath();
-					img = meshlab::loadImage(fn2, log, cb);
-					textName = finfo.filePath().toStdString();
-				} catch (const MLException& e) {
-					if (log){
-						log->log(
-							GLLogStream::WARNING, "Failed loading " + textName +
-							"; using a dummy texture");
-					}
-					else {
-						std::cerr <<
-							"Failed loading " + textName + "; using a dummy texture\n";
-					}
-					unloadedTextures.push_back(textName);
-					textName = "dummy.png";
-				}
 			}
-			textures[textName] = img;
+			else if (relativeToMesh && mfi.exists()) {
+				path = mfi.absoluteFilePath();
+				textName = finfo.filePath().toStdString();
+			}
+			else {
+				logDummyTexture(log, textName);
+				unloadedTextures.push_back(textName);
+				textName = "dummy.png";
+				textures[textName] = QImage(":/resources/images/dummy.png");
+				continue;
+			}
+			std::shared_future<QImage> img = TextureCache::instance().request(path);
+			pendingTextures[textName] = img;
+			requests.push_back(std::make_pair(textName, img));
+		}
+	}
+	lock.unlock();
+	if (lazy)
+		return unloadedTextures;
+
+	// the decoding is waited without the lock, as in getTexture
+	for (unsigned int i = 0; i < requests.size(); ++i) {
+		if (cb != nullptr)
+			cb(100 * i / requests.size(), "Loading textures");
+		const std::string& textName = requests[i].first;
+		QImage img;
+		bool failed = false;
+		try {
+			img = waitTexture(requests[i].second);
+		}
+		catch (const std::exception&) {
+			failed = true;
+		}
+		lock.lock();
+		// the texture may have been resolved by getTexture in the meantime
+		auto pit = pendingTextures.find(textName);
+		if (pit != pendingTextures.end()) {
+			pendingTextures.erase(pit);
+			if (!failed) {
+				textures[textName] = img;
+			}
+			else {
+				std::replace(cm.textures.begin(), cm.textures.end(), textName, std::string("dummy.png"));
+				textures["dummy.png"] = QImage(":/resources/images/dummy.png");
+			}
+		}
+		lock.unlock();
+		if (failed) {
+			logDummyTexture(log, textName);
+			unloadedTextures.push_back(textName);
 		}
 	}
 	return unloadedTextures;
@@ -136,15 +226,39 @@ void MeshModel::saveTextures(
 		GLLogStream* log,
 		CallBackPos* cb)
 {
-	for (const std::string& tname : cm.textures){
+	resolvePendingTextures();
+	// the images are shared, not copied: they are saved without the lock
+	std::vector<std::pair<std::string, QImage>> images;
+	{
+		std::lock_guard<std::mutex> lock(texturesMutex);
+		for (const std::string& tname : cm.textures)
+			images.push_back(std::make_pair(tname, textures.at(tname)));
+	}
+	for (const auto& img : images){
 		meshlab::saveImage(
-				basePath + "/" + QString::fromStdString(tname),
-				textures.at(tname), quality, log, cb);
+				basePath + "/" + QString::fromStdString(img.first),
+				img.second, quality, log, cb);
 	}
 }
 
 QImage MeshModel::getTexture(const std::string& tn) const
 {
+	std::unique_lock<std::mutex> lock(texturesMutex);
+	auto pit = pendingTextures.find(tn);
+	if (pit != pendingTextures.end()) {
+		// the decoding is waited without the lock, so that other threads can
+		// get the textures already decoded
+		std::shared_future<QImage> pending = pit->second;
+		lock.unlock();
+		QImage img = waitTextureOrDummy(tn, pending);
+		lock.lock();
+		// the texture may have been set or resolved in the meantime
+		pit = pendingTextures.find(tn);
+		if (pit != pendingTextures.end()) {
+			textures[tn] = img;
+			pendingTextures.erase(pit);
+		}
+	}
 	auto it = textures.find(tn);
 	if (it != textures.end())
 		return it->second;
@@ -152,20 +266,28 @@ QImage MeshModel::getTexture(const std::string& tn) const
 		return QImage();
 }
 
+/**
+ * @brief Returns all the textures, waiting the ones still being decoded. The
+ * map is not guarded: use getTexture while another thread can change them.
+ */
 const std::map<std::string, QImage>& MeshModel::getTextures() const
 {
+	resolvePendingTextures();
 	return textures;
 }
 
 void MeshModel::clearTextures()
 {
+	std::lock_guard<std::mutex> lock(texturesMutex);
+	pendingTextures.clear();
 	textures.clear();
 	cm.textures.clear();
 }
 
 void MeshModel::addTexture(std::string name, const QImage& txt)
 {
-	if (textures.find(name) == textures.end()){
+	std::lock_guard<std::mutex> lock(texturesMutex);
+	if (textures.find(name) == textures.end() && pendingTextures.find(name) == pendingTextures.end()){
 		// just to be sure to not make duplicates in the contained mesh list of textures
 		if (std::find(cm.textures.begin(), cm.textures.end(), name) == cm.textures.end())
 			cm.textures.push_back(name);
@@ -175,6 +297,10 @@ void MeshModel::addTexture(std::string name, const QImage& txt)
 
 void MeshModel::setTexture(std::string name, const QImage& txt)
 {
+	std::lock_guard<std::mutex> lock(texturesMutex);
+	// a texture still being decoded is simply replaced
+	if (pendingTextures.erase(name) > 0)
+		textures[name] = txt;
 	auto it = textures.find(name);
 	if (it != textures.end())
 		it->second = txt;
@@ -184,6 +310,8 @@ void MeshModel::changeTextureName(
 		const std::string& oldName,
 		std::string newName)
 {
+	resolvePendingTextures();
+	std::lock_guard<std::mutex> lock(texturesMutex);
 	if (oldName != newName) {
 		auto mit = textures.find(oldName);
 		auto tit = std::find(cm.textures.begin(), cm.textures.end(), oldName);
@@ -196,6 +324,30 @@ void MeshModel::changeTextureName(
 	}
 }
 
+/**
+ * @brief Waits for the decoding of all the textures loaded lazily.
+ */
+void MeshModel::resolvePendingTextures() const
+{
+	std::unique_lock<std::mutex> lock(texturesMutex);
+	if (pendingTextures.empty())
+		return;
+	// the decoding is waited without the lock, as in getTexture
+	std::map<std::string, std::shared_future<QImage>> pending = pendingTextures;
+	lock.unlock();
+	std::map<std::string, QImage> decoded;
+	for (const auto& p : pending)
+		decoded[p.first] = waitTextureOrDummy(p.first, p.second);
+	lock.lock();
+	for (auto& d : decoded) {
+		auto pit = pendingTextures.find(d.first);
+		if (pit != pendingTextures.end()) {
+			textures[d.first] = d.second;
+			pendingTextures.erase(pit);
+		}
+	}
+}
+
 int MeshModel::io2mm(int single_iobit)
 {
 	switch(single_iobit)
@@ -387,6 +539,16 @@ bool MeshModel::meshModified() const
 	return modified;
 }
 
+/**
+ * @brief Returns true if the mesh contains deleted elements (i.e. it must be
+ * compacted before being accessed by index). The test is O(1): the deleted
+ * elements are not counted in the vn, fn and en counters of the mesh.
+ */
+bool MeshModel::hasDeletedElements() const
+{
+	return cm.vn != (int) cm.vert.size() || cm.fn != (int) cm.face.size() || cm.en != (int) cm.edge.size();
+}
+
 void MeshModel::setMeshModified(bool b)
 {
 	modified = b;
@@ -27,7 +27,9 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <future>
 #include <map>
+#include <mutex>
 
 #include "cmesh.h"
 #include "../GLLogStream.h"
@@ -167,7 +169,7 @@ public:
 	bool isVisible() const { return visible; }
 	void setVisible(bool vis = true) { visible = vis;}
 
-	std::list<std::string> loadTextures(GLLogStream* log = nullptr, vcg::CallBackPos* cb = nullptr);
+	std::list<std::string> loadTextures(GLLogStream* log = nullptr, vcg::CallBackPos* cb = nullptr, bool lazy = false);
 	void saveTextures(const QString& basePath, int quality = -1, GLLogStream* log = nullptr, vcg::CallBackPos* cb = nullptr);
 
 	QImage getTexture(const std::string& tn) const;
@@ -199,6 +201,7 @@ public:
 
 	bool meshModified() const;
 	void setMeshModified(bool b = true);
+	bool hasDeletedElements() const;
 	static int io2mm(int single_iobit);
 
 	CMeshO cm;
@@ -217,7 +220,14 @@ private:
 	int idInsideFile = -1;
 
 	//textures associated to mesh
-	std::map<std::string, QImage> textures;
+	mutable std::map<std::string, QImage> textures;
+	//textures still being decoded by the TextureCache, moved in textures on first use
+	mutable std::map<std::string, std::shared_future<QImage>> pendingTextures;
+	//guards textures and pendingTextures, that can be resolved by const methods
+	//while the textures are still being loaded by another thread
+	mutable std::mutex texturesMutex;
+
+	void resolvePendingTextures() const;
 };// end class MeshModel
 
 #endif
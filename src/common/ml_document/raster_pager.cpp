@@ -0,0 +1,402 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+
+#include "raster_pager.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <QImageReader>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "../utilities/load_save.h"
+
+namespace {
+
+/**
+ * @brief Returns the image downsampled so that its larger side is maxSide, or
+ * a null image if it is not larger than that.
+ */
+QImage downsample(const QImage& img, int maxSide)
+{
+	if (maxSide <= 0 || (img.width() <= maxSide && img.height() <= maxSide))
+		return QImage();
+	return img.scaled(maxSide, maxSide, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
+
+/*
+Decodes the image in fileName and, if maxSide is not 0, its low resolution
+copy. If lowResOnly is true only the low resolution image is returned: the
+formats supported by QImageReader are then decoded directly at the reduced
+size (that for JPEG skips most of the decoding work), the others are decoded
+at full resolution and then downsampled. Throws an MLException if the image
+cannot be decoded.
+*/
+RasterPlane::Decoded decode(const QString& fileName, int maxSide, bool lowResOnly)
+{
+	RasterPlane::Decoded decoded;
+	if (lowResOnly) {
+		QImageReader reader(fileName);
+		QSize        size = reader.size();
+		if (reader.canRead() && size.isValid()) {
+			if (size.width() > maxSide || size.height() > maxSide)
+				reader.setScaledSize(size.scaled(maxSide, maxSide, Qt::KeepAspectRatio));
+			decoded.lowRes = reader.read();
+			decoded.size   = size;
+			if (!decoded.lowRes.isNull())
+				return decoded;
+		}
+	}
+	decoded.image  = meshlab::loadImage(fileName);
+	decoded.lowRes = downsample(decoded.image, maxSide);
+	decoded.size   = decoded.image.size();
+	if (lowResOnly) {
+		if (decoded.lowRes.isNull())
+			decoded.lowRes = decoded.image;
+		decoded.image = QImage();
+	}
+	return decoded;
+}
+
+class DecodeTask : public QRunnable
+{
+public:
+	DecodeTask(
+		const QString&                                      fileName,
+		int                                                 maxSide,
+		std::shared_ptr<std::promise<RasterPlane::Decoded>> promise) :
+			fileName(fileName), maxSide(maxSide), promise(promise)
+	{
+	}
+
+	void run() override
+	{
+		try {
+			promise->set_value(decode(fileName, maxSide, false));
+		}
+		catch (...) {
+			promise->set_exception(std::current_exception());
+		}
+	}
+
+private:
+	QString fileName;
+	int maxSide;
+	std::shared_ptr<std::promise<RasterPlane::Decoded>> promise;
+};
+
+} // namespace
+
+RasterPager& RasterPager::instance()
+{
+	static RasterPager pager;
+	return pager;
+}
+
+RasterPager::RasterPager() : used(0), budget((size_t) 2048 * 1024 * 1024), lowResSize(1024)
+{
+}
+
+void RasterPager::setMemoryBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	budget = bytes;
+	trim(nullptr);
+}
+
+size_t RasterPager::memoryBudget() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return budget;
+}
+
+/**
+ * @brief Returns the memory taken by the decoded images of the paged planes.
+ * The images that are still being decoded are not counted.
+ */
+size_t RasterPager::memoryUsage() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return used;
+}
+
+/**
+ * @brief Sets the maximum side of the low resolution images; 0 disables them,
+ * and lowResolutionImage() returns the full resolution image.
+ */
+void RasterPager::setLowResolutionSize(int maxSide)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	lowResSize = std::max(0, maxSide);
+}
+
+int RasterPager::lowResolutionSize() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return lowResSize;
+}
+
+QImage RasterPager::image(RasterPlane& plane)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	// a discard while waiting drops the decoding: it is requested again
+	while (plane.paged && plane.img.isNull()) {
+		request(plane);
+		std::shared_future<RasterPlane::Decoded> decoding = plane.pending;
+		lock.unlock();
+		decoding.wait();
+		lock.lock();
+		claim(plane);
+	}
+	if (plane.paged) {
+		touch(plane);
+		trim(&plane);
+	}
+	return plane.img;
+}
+
+QImage RasterPager::lowResolutionImage(RasterPlane& plane)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (!plane.lowRes.isNull()) {
+		if (plane.paged)
+			touch(plane);
+		return plane.lowRes;
+	}
+	if (lowResSize > 0 && !plane.img.isNull()) {
+		assign(plane, plane.lowRes, downsample(plane.img, lowResSize));
+		if (plane.lowRes.isNull()) // not larger than the low resolution
+			return plane.img;
+		if (plane.paged) {
+			touch(plane);
+			trim(&plane);
+		}
+		return plane.lowRes;
+	}
+	if (lowResSize == 0 || !plane.paged) {
+		lock.unlock();
+		return image(plane);
+	}
+
+	// decode only the low resolution image
+	const QString fileName = plane.fullPathFileName;
+	const int     maxSide  = lowResSize;
+	lock.unlock();
+	RasterPlane::Decoded decoded;
+	try {
+		decoded = decode(fileName, maxSide, true);
+	}
+	catch (...) {
+		return image(plane); // fails again, and falls back to the dummy image
+	}
+	lock.lock();
+	if (plane.lowRes.isNull())
+		assign(plane, plane.lowRes, decoded.lowRes);
+	if (!plane.size.isValid())
+		plane.size = decoded.size;
+	touch(plane);
+	trim(&plane);
+	return plane.lowRes;
+}
+
+/**
+ * @brief Returns the size of the full resolution image of the plane, decoding
+ * it only if its size is not known yet (i.e. neither the image nor its low
+ * resolution copy have ever been decoded).
+ */
+QSize RasterPager::imageSize(RasterPlane& plane)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (plane.size.isValid())
+			return plane.size;
+	}
+	return image(plane).size();
+}
+
+bool RasterPager::isInCore(const RasterPlane& plane) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return !plane.img.isNull();
+}
+
+/**
+ * @brief Starts decoding the image of the plane in the global QThreadPool, if
+ * it is not in memory; the image is then available to the first access.
+ */
+void RasterPager::prefetch(RasterPlane& plane)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (plane.paged && plane.img.isNull())
+		request(plane);
+}
+
+/**
+ * @brief Releases the images of a paged plane; a plane that is not paged keeps
+ * its image, that could not be decoded again.
+ */
+void RasterPager::discard(RasterPlane& plane)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (plane.paged)
+		release(plane);
+}
+
+/**
+ * @brief Copies the images and the state of source into a newly constructed
+ * plane, and registers it, so that its images, shared with source, are
+ * counted and paged as the ones of the other planes.
+ */
+void RasterPager::copy(RasterPlane& plane, const RasterPlane& source)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	plane.img     = source.img;
+	plane.lowRes  = source.lowRes;
+	plane.size    = source.size;
+	plane.paged   = source.paged;
+	plane.pending = source.pending;
+	if (plane.paged && (!plane.img.isNull() || !plane.lowRes.isNull())) {
+		touch(plane);
+		trim(&plane);
+	}
+}
+
+void RasterPager::remove(RasterPlane& plane)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (plane.inLru) {
+		used -= plane.img.sizeInBytes() + plane.lowRes.sizeInBytes();
+		lru.erase(plane.lruPosition);
+		plane.inLru = false;
+	}
+}
+
+/*
+Starts decoding the image of the plane, if it is not already being decoded.
+Must be called with the mutex locked.
+*/
+void RasterPager::request(RasterPlane& plane)
+{
+	if (plane.pending.valid())
+		return;
+	auto promise  = std::make_shared<std::promise<RasterPlane::Decoded>>();
+	plane.pending = promise->get_future().share();
+	QThreadPool::globalInstance()->start(
+		new DecodeTask(plane.fullPathFileName, lowResSize, promise));
+}
+
+/*
+Moves the decoded images of the plane from its decoding, if not already done
+by another thread; an image that cannot be decoded is replaced by the dummy
+image, and the plane is no longer paged. Must be called with the mutex locked.
+*/
+void RasterPager::claim(RasterPlane& plane)
+{
+	if (!plane.pending.valid())
+		return;
+	try {
+		RasterPlane::Decoded decoded = plane.pending.get();
+		assign(plane, plane.img, decoded.image);
+		plane.size = decoded.size;
+		if (!decoded.lowRes.isNull())
+			assign(plane, plane.lowRes, decoded.lowRes);
+	}
+	catch (...) {
+		qWarning("Unable to decode the raster image %s: replaced by a dummy image", qUtf8Printable(plane.fullPathFileName));
+		release(plane);
+		plane.img   = meshlab::getDummyTexture();
+		plane.size  = plane.img.size();
+		plane.paged = false;
+	}
+	plane.pending = std::shared_future<RasterPlane::Decoded>();
+}
+
+/*
+Marks the plane as the most recently used. Must be called with the mutex
+locked.
+*/
+void RasterPager::touch(RasterPlane& plane)
+{
+	if (plane.inLru) {
+		lru.splice(lru.begin(), lru, plane.lruPosition);
+	}
+	else {
+		lru.push_front(&plane);
+		plane.lruPosition = lru.begin();
+		plane.inLru       = true;
+		used += plane.img.sizeInBytes() + plane.lowRes.sizeInBytes();
+	}
+}
+
+/*
+Releases the images of the plane. Must be called with the mutex locked.
+*/
+void RasterPager::release(RasterPlane& plane)
+{
+	if (plane.inLru) {
+		used -= plane.img.sizeInBytes() + plane.lowRes.sizeInBytes();
+		lru.erase(plane.lruPosition);
+		plane.inLru = false;
+	}
+	plane.img     = QImage();
+	plane.lowRes  = QImage();
+	plane.pending = std::shared_future<RasterPlane::Decoded>();
+}
+
+/*
+Replaces one of the images of the plane, keeping the count of the used
+memory. Must be called with the mutex locked.
+*/
+void RasterPager::assign(RasterPlane& plane, QImage& which, const QImage& image)
+{
+	if (plane.inLru)
+		used = used - which.sizeInBytes() + image.sizeInBytes();
+	which = image;
+}
+
+/*
+Releases the images of the least recently used planes, except keep, until
+the budget is met: first the full resolution images, then the low
+resolution ones. Must be called with the mutex locked.
+*/
+void RasterPager::trim(const RasterPlane* keep)
+{
+	for (int pass = 0; pass < 2 && used > budget; ++pass) {
+		auto it = lru.end();
+		while (it != lru.begin() && used > budget) {
+			--it;
+			RasterPlane* p = *it;
+			if (p == keep)
+				continue;
+			QImage& victim = pass == 0 ? p->img : p->lowRes;
+			used -= victim.sizeInBytes();
+			victim = QImage();
+			if (p->img.isNull() && p->lowRes.isNull()) {
+				p->inLru = false;
+				it       = lru.erase(it);
+			}
+		}
+	}
+}
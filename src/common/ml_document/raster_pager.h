@@ -0,0 +1,89 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+
+#ifndef MESHLAB_RASTER_PAGER_H
+#define MESHLAB_RASTER_PAGER_H
+
+#include <list>
+#include <mutex>
+
+#include "render_raster.h"
+
+/*
+A process wide pager of the images of the paged raster planes.
+
+Loading a project keeps only the file names and the cameras of its rasters;
+the images are decoded on their first access (or in background by the
+global QThreadPool, if prefetched) and kept until their total size exceeds
+the memory budget: then the images of the least recently used planes are
+released, and decoded again if accessed later. The plane being accessed is
+never released. The images are returned by value: a released image stays
+alive (and valid) until its last user drops its copy.
+
+If the low resolution size is not 0, a copy of each image downsampled to
+that size is built along with the decoding, for the users that do not need
+the full resolution: it is released only after all the full resolution
+images, and a low resolution image of a plane not in memory is decoded
+without keeping the full one.
+*/
+class RasterPager
+{
+public:
+	static RasterPager& instance();
+
+	void setMemoryBudget(size_t bytes);
+	size_t memoryBudget() const;
+	size_t memoryUsage() const;
+
+	void setLowResolutionSize(int maxSide);
+	int lowResolutionSize() const;
+
+	QImage image(RasterPlane& plane);
+	QImage lowResolutionImage(RasterPlane& plane);
+	QSize imageSize(RasterPlane& plane);
+	bool isInCore(const RasterPlane& plane) const;
+	void prefetch(RasterPlane& plane);
+	void discard(RasterPlane& plane);
+
+	void copy(RasterPlane& plane, const RasterPlane& source);
+	void remove(RasterPlane& plane);
+
+private:
+	RasterPager();
+
+	void request(RasterPlane& plane);
+	void claim(RasterPlane& plane);
+	void touch(RasterPlane& plane);
+	void release(RasterPlane& plane);
+	void assign(RasterPlane& plane, QImage& which, const QImage& image);
+	void trim(const RasterPlane* keep);
+
+	mutable std::mutex mutex;
+	std::list<RasterPlane*> lru; // most recently used first
+	size_t used; // bytes of the images of the planes in lru
+	size_t budget;
+	int lowResSize;
+};
+
+#endif // MESHLAB_RASTER_PAGER_H
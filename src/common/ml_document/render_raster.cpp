@@ -22,30 +22,71 @@
 ****************************************************************************/
 
 #include "render_raster.h"
+#include "raster_pager.h"
 
 RasterPlane::RasterPlane(const RasterPlane& pl)
+    : paged(false), inLru(false)
 {
     semantic = pl.semantic;
     fullPathFileName = pl.fullPathFileName;
-    image = QImage(pl.image);
+    RasterPager::instance().copy(*this, pl);
 }
 
 RasterPlane::RasterPlane(const QString& pathName, const int _semantic)
+    : paged(true), inLru(false)
 {
     semantic =_semantic;
     fullPathFileName = pathName;
-
-    image = QImage(pathName);
 }
 
 RasterPlane::RasterPlane(
-        const QImage& img,
+        const QImage& image,
         const QString& pathName,
         const int _semantic)
+    : img(image), size(image.size()), paged(false), inLru(false)
 {
     semantic =_semantic;
     fullPathFileName = pathName;
-    image = img;
+}
+
+RasterPlane::~RasterPlane()
+{
+    RasterPager::instance().remove(*this);
+}
+
+QImage RasterPlane::image()
+{
+    return RasterPager::instance().image(*this);
+}
+
+QImage RasterPlane::lowResolutionImage()
+{
+    return RasterPager::instance().lowResolutionImage(*this);
+}
+
+QSize RasterPlane::imageSize()
+{
+    return RasterPager::instance().imageSize(*this);
+}
+
+bool RasterPlane::IsInCore() const
+{
+    return RasterPager::instance().isInCore(*this);
+}
+
+void RasterPlane::Load()
+{
+    image();
+}
+
+void RasterPlane::Prefetch()
+{
+    RasterPager::instance().prefetch(*this);
+}
+
+void RasterPlane::Discard()
+{
+    RasterPager::instance().discard(*this);
 }
 
 MeshLabRenderRaster::MeshLabRenderRaster()
@@ -24,6 +24,9 @@
 #ifndef RENDER_RASTER_H
 #define RENDER_RASTER_H
 
+#include <future>
+#include <list>
+
 #include <QString>
 #include <QImage>
 #include <QFileInfo>
@@ -32,6 +35,11 @@
 /*
 RasterPlane Class
 the base class for a registered image that contains the path, the semantic and the data of the image
+
+A plane created from a file name only is paged: its image is decoded on the
+first access, and can be released by the RasterPager when the memory taken
+by the decoded raster images exceeds its budget, to be decoded again when
+needed. A plane created from an image keeps it in memory.
 */
 
 class RasterPlane
@@ -57,10 +65,22 @@ public:
 
     int semantic;
     QString fullPathFileName;
-    QImage image;
 
-    bool IsInCore() { return !image.isNull(); }
+    /// the image of the plane, decoded if needed. The returned QImage shares
+    /// the data with the plane: it stays valid also if the RasterPager
+    /// releases the image of the plane, so fetch it once and keep it while
+    /// needed instead of calling image() for each pixel
+    QImage image();
+    /// the image downsampled to RasterPager::lowResolutionSize(), or the
+    /// image itself if it is not larger
+    QImage lowResolutionImage();
+    /// the size of the full resolution image, that is not decoded if its
+    /// size is already known
+    QSize imageSize();
+
+    bool IsInCore() const;
     void Load();
+    void Prefetch(); //start decoding the image in background
     void Discard(); //discard  the loaded image freeing the mem.
 
     /// The whole full path name of the mesh
@@ -71,7 +91,29 @@ public:
     RasterPlane(const RasterPlane& pl);
     RasterPlane(const QString& pathName, const int _semantic);
     RasterPlane(const QImage& image, const QString& pathName, const int _semantic);
+    ~RasterPlane();
+
+    RasterPlane& operator=(const RasterPlane&) = delete;
+
+    /// the result of the decoding of a paged plane
+    struct Decoded
+    {
+        QImage image;
+        QImage lowRes;
+        QSize size;
+    };
 
+private:
+    friend class RasterPager;
+
+    // all guarded by the RasterPager mutex
+    QImage img;
+    QImage lowRes;
+    QSize size;
+    bool paged;
+    std::shared_future<Decoded> pending;
+    bool inLru;
+    std::list<RasterPlane*>::iterator lruPosition;
 }; //end class Plane
 
 class MeshLabRenderRaster
@@ -0,0 +1,190 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+
+#include "texture_cache.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "../utilities/load_save.h"
+
+namespace {
+
+class DecodeTask : public QRunnable
+{
+public:
+	DecodeTask(
+		const QString&                        fileName,
+		std::shared_ptr<std::promise<QImage>> promise,
+		std::function<void()>                 decoded) :
+			fileName(fileName), promise(promise), decoded(decoded)
+	{
+	}
+
+	void run() override
+	{
+		try {
+			promise->set_value(meshlab::loadImage(fileName));
+		}
+		catch (...) {
+			promise->set_exception(std::current_exception());
+		}
+		decoded();
+	}
+
+private:
+	QString fileName;
+	std::shared_ptr<std::promise<QImage>> promise;
+	std::function<void()> decoded;
+};
+
+} // namespace
+
+TextureCache& TextureCache::instance()
+{
+	static TextureCache cache;
+	return cache;
+}
+
+TextureCache::TextureCache() : state(std::make_shared<State>())
+{
+	state->budget = 1024 * 1024 * 1024;
+}
+
+void TextureCache::setMemoryBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+	state->budget = bytes;
+	state->trim();
+}
+
+size_t TextureCache::memoryBudget() const
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+	return state->budget;
+}
+
+/**
+ * @brief Returns the memory taken by the decoded images kept by the cache.
+ * The images that are still being decoded are not counted.
+ */
+size_t TextureCache::memoryUsage() const
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+	size_t usage = 0;
+	for (const auto& p : state->entries)
+		usage += imageSize(p.second);
+	return usage;
+}
+
+std::shared_future<QImage> TextureCache::request(const QString& fileName)
+{
+	const QDateTime lastModified = QFileInfo(fileName).lastModified();
+	std::lock_guard<std::mutex> lock(state->mutex);
+	std::map<QString, Entry>& entries = state->entries;
+	std::list<QString>& lru = state->lru;
+	auto it = entries.find(fileName);
+	if (it != entries.end()) {
+		if (it->second.lastModified == lastModified) {
+			lru.splice(lru.begin(), lru, it->second.lruPosition);
+			return it->second.image;
+		}
+		// the file has changed: the image is decoded again
+		lru.erase(it->second.lruPosition);
+		entries.erase(it);
+	}
+
+	auto promise = std::make_shared<std::promise<QImage>>();
+	Entry e;
+	e.image = promise->get_future().share();
+	e.lastModified = lastModified;
+	lru.push_front(fileName);
+	e.lruPosition = lru.begin();
+	entries[fileName] = e;
+	// the budget is checked again when the image is ready: the images
+	// still being decoded are not counted by trim. The task keeps the state
+	// alive, since it can outlive the cache
+	std::shared_ptr<State> shared = state;
+	QThreadPool::globalInstance()->start(new DecodeTask(fileName, promise, [shared]() {
+		std::lock_guard<std::mutex> lock(shared->mutex);
+		shared->trim();
+	}));
+	state->trim();
+	return e.image;
+}
+
+void TextureCache::clear()
+{
+	std::lock_guard<std::mutex> lock(state->mutex);
+	state->entries.clear();
+	state->lru.clear();
+}
+
+bool TextureCache::isReady(const Entry& e)
+{
+	return e.image.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+size_t TextureCache::imageSize(const Entry& e)
+{
+	if (!isReady(e))
+		return 0;
+	try {
+		return e.image.get().sizeInBytes();
+	}
+	catch (...) {
+		return 0;
+	}
+}
+
+/*
+Releases the least recently requested images until the budget is met. The
+images still being decoded are kept, so that concurrent requests of the
+same file keep sharing the decoding; the failed decodings are released, so
+that they can be retried. Must be called with the mutex locked.
+*/
+void TextureCache::State::trim()
+{
+	size_t usage = 0;
+	for (const auto& p : entries)
+		usage += imageSize(p.second);
+	auto it = lru.end();
+	while (it != lru.begin()) {
+		--it;
+		auto e = entries.find(*it);
+		if (!isReady(e->second))
+			continue;
+		size_t size = imageSize(e->second);
+		if (size == 0 || usage > budget) {
+			usage -= size;
+			entries.erase(e);
+			it = lru.erase(it);
+		}
+	}
+}
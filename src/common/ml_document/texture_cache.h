@@ -0,0 +1,100 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+
+#ifndef MESHLAB_TEXTURE_CACHE_H
+#define MESHLAB_TEXTURE_CACHE_H
+
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <QDateTime>
+#include <QImage>
+#include <QString>
+
+/*
+A process wide cache of the decoded texture images.
+
+Images are decoded by the global QThreadPool: request() returns immediately
+with a future of the image, so that many textures can be decoded
+concurrently and waited only when they are actually needed. Requests of the
+same file share the same decoding and the same (implicitly shared) QImage,
+so meshes referencing the same texture file do not keep duplicate copies.
+A file modified after it has been decoded is decoded again.
+
+The cache keeps the decoded images until their total size exceeds the
+memory budget; then the least recently requested ones are released (the
+meshes that use them keep their copy). The budget is checked on each
+request and each time an image has been decoded. A budget of 0 disables the
+cache: the images are released as soon as they have been decoded and
+delivered to the futures of their requests.
+
+The state of the cache is shared with the decoding tasks, that can still be
+queued or running in the global QThreadPool when the cache is destroyed at
+exit.
+*/
+class TextureCache
+{
+public:
+	static TextureCache& instance();
+
+	void setMemoryBudget(size_t bytes);
+	size_t memoryBudget() const;
+	size_t memoryUsage() const;
+
+	// fileName must be an absolute path; the future throws an MLException
+	// if the image cannot be decoded
+	std::shared_future<QImage> request(const QString& fileName);
+
+	void clear();
+
+private:
+	TextureCache();
+
+	struct Entry
+	{
+		std::shared_future<QImage> image;
+		QDateTime lastModified; // of the file when it has been requested
+		std::list<QString>::iterator lruPosition;
+	};
+
+	struct State
+	{
+		std::mutex mutex;
+		std::map<QString, Entry> entries;
+		std::list<QString> lru; // most recently requested first
+		size_t budget;
+
+		void trim();
+	};
+
+	static bool isReady(const Entry& e);
+	static size_t imageSize(const Entry& e);
+
+	std::shared_ptr<State> state;
+};
+
+#endif // MESHLAB_TEXTURE_CACHE_H
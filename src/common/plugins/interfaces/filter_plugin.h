@@ -158,6 +158,24 @@ public:
 	 */
 	virtual int postCondition(const QAction*) const { return MeshModel::MM_ALL; }
 
+	/**
+	 * @brief The framework compacts the meshes that have deleted elements after
+	 * the application of each filter. A filter that correctly skips deleted
+	 * elements (e.g. using the IsD() flag) can return true here: when it is the
+	 * next step of a script, the compaction of the previous step is postponed,
+	 * so that a sequence of such filters pays a single compaction at its end.
+	 */
+	virtual bool supportsDeletedElements(const QAction*) const { return false; }
+
+	/**
+	 * @brief The framework applies a filter on a worker thread, keeping the
+	 * GUI responsive, only if this function returns true; the other filters
+	 * are applied on the GUI thread. Return true only for filters that do not
+	 * use the glContext, the GUI or any state shared with other filters.
+	 * Default value is false.
+	 */
+	virtual bool supportsBackgroundExecution(const QAction*) const { return false; }
+
 	/**
 	 * @brief This function is called to initialized the list of parameters.
 	 * If a filter does not need parameters, do not implement this function and
@@ -28,9 +28,16 @@ void IOPlugin::open(
 	maskList.push_back(mask);
 }
 
+// the innermost WarningCollector of the current thread, if any
+static thread_local IOPlugin::WarningCollector* currentCollector = nullptr;
+
 void IOPlugin::reportWarning(const QString& warningMessage) const
 {
 	if (!warningMessage.isEmpty()){
+		if (currentCollector != nullptr) {
+			currentCollector->list.push_back(warningMessage);
+			return;
+		}
 		MeshLabPluginLogger::log(GLLogStream::WARNING, warningMessage.toStdString());
 		warnString += "\n" + warningMessage;
 	}
@@ -52,3 +59,13 @@ QString IOPlugin::warningMessageString() const
 	warnString.clear();
 	return tmp;
 }
+
+IOPlugin::WarningCollector::WarningCollector() : previous(currentCollector)
+{
+	currentCollector = this;
+}
+
+IOPlugin::WarningCollector::~WarningCollector()
+{
+	currentCollector = previous;
+}
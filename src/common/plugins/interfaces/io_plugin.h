@@ -24,6 +24,8 @@
 #ifndef MESHLAB_IO_PLUGIN_H
 #define MESHLAB_IO_PLUGIN_H
 
+#include <QStringList>
+
 #include <wrap/callback.h>
 
 #include "meshlab_plugin_logger.h"
@@ -164,6 +166,20 @@ public:
 			const RichParameterList & par,
 			vcg::CallBackPos *cb = nullptr) = 0;
 
+	/**
+	 * @brief The isOpenReentrant function tells to the framework if the open
+	 * function can load files of the given format from several threads at
+	 * the same time (each one into its own meshes). The framework loads
+	 * concurrently only the files of the formats for which this function
+	 * returns true; the other files are loaded one at a time.
+	 * Default value is false: re-implement this function only if the
+	 * importer of the format does not use any shared state.
+	 */
+	virtual bool isOpenReentrant(const QString& /*format*/) const
+	{
+		return false;
+	}
+
 	/***********************
 	 * Save Mesh Functions *
 	 ***********************/
@@ -432,6 +448,29 @@ public:
 	 */
 	QString warningMessageString() const;
 
+	/**
+	 * @brief While a WarningCollector lives, the warnings reported by any
+	 * IOPlugin on the thread that created it are collected in it, instead of
+	 * being logged and appended to the warning string of the plugin. Used by
+	 * the framework to open files concurrently: the collected warnings are
+	 * then reported again by the calling thread, in file order.
+	 */
+	class WarningCollector
+	{
+	public:
+		WarningCollector();
+		~WarningCollector();
+		WarningCollector(const WarningCollector&) = delete;
+		WarningCollector& operator=(const WarningCollector&) = delete;
+
+		const QStringList& warnings() const { return list; }
+
+	private:
+		friend class IOPlugin;
+		WarningCollector* previous;
+		QStringList       list;
+	};
+
 private:
 	mutable QString warnString;
 };
@@ -24,6 +24,7 @@
 #include "eigen_mesh_conversions.h"
 #include "../mlexception.h"
 #include <vcg/complex/algorithms/polygon_support.h>
+#include <utility>
 
 namespace vcg {
 class PEdge;
@@ -69,6 +70,51 @@ class PolyMesh :
 {
 };
 
+namespace {
+
+/*
+ * Returns the address of the attribute of the first element of the container,
+ * and the distance (in number of T) between the attributes of two consecutive
+ * elements: the size of the element for the attributes stored in the element
+ * itself, the size of the attribute for the optional ones, stored in a
+ * separate vector.
+ */
+template <typename T, typename Container, typename Accessor>
+std::pair<T*, Eigen::Index>
+attributeLayout(Container& c, Eigen::Index n, Eigen::Index defaultStride, Accessor attr)
+{
+	if (n == 0)
+		return std::make_pair((T*) nullptr, defaultStride);
+	T* first = attr(c[0]);
+	if (n == 1)
+		return std::make_pair(first, defaultStride);
+	std::ptrdiff_t bytes =
+		reinterpret_cast<const char*>(attr(c[1])) - reinterpret_cast<const char*>(first);
+	if (bytes <= 0 || bytes % sizeof(T) != 0) {
+		throw MLException(
+			"Error while creating a view over a mesh attribute: "
+			"the stride of the attribute is not a multiple of its scalar type.");
+	}
+	return std::make_pair(first, Eigen::Index(bytes / sizeof(T)));
+}
+
+template <typename View, typename T, typename Container, typename Accessor>
+View matrixView(Container& c, Eigen::Index n, Accessor attr)
+{
+	const Eigen::Index cols = View::ColsAtCompileTime;
+	std::pair<T*, Eigen::Index> l = attributeLayout<T>(c, n, cols, attr);
+	return View(l.first, n, cols, Eigen::OuterStride<>(l.second));
+}
+
+template <typename View, typename T, typename Container, typename Accessor>
+View vectorView(Container& c, Eigen::Index n, Accessor attr)
+{
+	std::pair<T*, Eigen::Index> l = attributeLayout<T>(c, n, 1, attr);
+	return View(l.first, n, Eigen::InnerStride<>(l.second));
+}
+
+} // namespace
+
 /**
  * @brief Creates a CMeshO mesh from the data contained in the given matrices.
  * The only matrix required to be non-empty is the 'vertices' matrix.
@@ -78,6 +124,9 @@ class PolyMesh :
  * the sizes of vertex and face matrices. If this requirement is not satisfied,
  * a MLException will be thrown.
  *
+ * The matrices may also be maps over external buffers with any memory layout
+ * (e.g. row major arrays): their data is copied once, directly in the mesh.
+ *
  * @param vertices: #V×3 matrix of scalars (vertex coordinates)
  * @param faces: #F×3 matrix of integers (vertex indices composing the faces)
  * @param vertexNormals: #V×3 matrix of scalars (vertex normals)
@@ -91,23 +140,21 @@ class PolyMesh :
  * @return a CMeshO made of the given components
  */
 CMeshO meshlab::meshFromMatrices(
-	const EigenMatrixX3m&   vertices,
-	const Eigen::MatrixX3i& faces,
-	const Eigen::MatrixX2i& edges,
-	const EigenMatrixX3m&   vertexNormals,
-	const EigenMatrixX3m&   faceNormals,
-	const EigenVectorXm&    vertexQuality,
-	const EigenVectorXm&    faceQuality,
-	const EigenMatrixX4m&   vertexColor,
-	const EigenMatrixX4m&   faceColor,
-	const EigenMatrixX2m&   vertexTexCoords,
-	const EigenMatrixX2m&   wedgeTexCoords)
+	const EigenMatrixX3mConstRef& vertices,
+	const EigenMatrixX3iConstRef& faces,
+	const EigenMatrixX2iConstRef& edges,
+	const EigenMatrixX3mConstRef& vertexNormals,
+	const EigenMatrixX3mConstRef& faceNormals,
+	const EigenVectorXmConstRef&  vertexQuality,
+	const EigenVectorXmConstRef&  faceQuality,
+	const EigenMatrixX4mConstRef& vertexColor,
+	const EigenMatrixX4mConstRef& faceColor,
+	const EigenMatrixX2mConstRef& vertexTexCoords,
+	const EigenMatrixX2mConstRef& wedgeTexCoords)
 {
 	CMeshO m;
 	if (vertices.rows() > 0) {
 		// add vertices and their associated normals and quality if any
-		std::vector<CMeshO::VertexPointer> ivp(vertices.rows());
-
 		bool hasVNormals   = vertexNormals.rows() > 0;
 		bool hasVQuality   = vertexQuality.rows() > 0;
 		bool hasVColors    = vertexColor.rows() > 0;
@@ -135,26 +182,22 @@ CMeshO meshlab::meshFromMatrices(
 			}
 			m.vert.EnableTexCoord();
 		}
-		CMeshO::VertexIterator vi = vcg::tri::Allocator<CMeshO>::AddVertices(m, vertices.rows());
-		for (unsigned int i = 0; i < vertices.rows(); ++i, ++vi) {
-			ivp[i]  = &*vi;
-			vi->P() = CMeshO::CoordType(vertices(i, 0), vertices(i, 1), vertices(i, 2));
-			if (hasVNormals) {
-				vi->N() = CMeshO::CoordType(
-					vertexNormals(i, 0), vertexNormals(i, 1), vertexNormals(i, 2));
-			}
-			if (hasVQuality) {
-				vi->Q() = vertexQuality(i);
-			}
-			if (hasVColors) {
-				vi->C() = CMeshO::VertexType::ColorType(
-					vertexColor(i, 0) * 255,
-					vertexColor(i, 1) * 255,
-					vertexColor(i, 2) * 255,
-					vertexColor(i, 3) * 255);
-			}
-			if (hasVTexCoords) {
-				vi->T() = CMeshO::VertexType::TexCoordType(
+
+		// the attributes are copied in bulk through views over the vertex storage
+		vcg::tri::Allocator<CMeshO>::AddVertices(m, vertices.rows());
+		vertexMatrixView(m) = vertices;
+		if (hasVNormals) {
+			vertexNormalMatrixView(m) = vertexNormals;
+		}
+		if (hasVQuality) {
+			vertexQualityArrayView(m) = vertexQuality;
+		}
+		if (hasVColors) {
+			vertexColorMatrixView(m) = (vertexColor * Scalarm(255)).cast<unsigned char>();
+		}
+		if (hasVTexCoords) {
+			for (unsigned int i = 0; i < vertices.rows(); ++i) {
+				m.vert[i].T() = CMeshO::VertexType::TexCoordType(
 					vertexTexCoords(i, 0),
 					vertexTexCoords(i, 1));
 			}
@@ -196,56 +239,60 @@ CMeshO meshlab::meshFromMatrices(
 			}
 			m.face.EnableWedgeTexCoord();
 		}
-		CMeshO::FaceIterator fi = vcg::tri::Allocator<CMeshO>::AddFaces(m, faces.rows());
-		for (unsigned int i = 0; i < faces.rows(); ++i, ++fi) {
-			for (unsigned int j = 0; j < 3; j++) {
-				if ((unsigned int) faces(i, j) >= ivp.size()) {
-					throw MLException(
-						"Error while creating mesh: bad vertex index " +
-						QString::number(faces(i, j)) + " in face " + QString::number(i) +
-						"; vertex " + QString::number(j) + ".");
+		if (faces.rows() > 0 && (faces.minCoeff() < 0 || faces.maxCoeff() >= vertices.rows())) {
+			for (unsigned int i = 0; i < faces.rows(); ++i) {
+				for (unsigned int j = 0; j < 3; j++) {
+					if ((unsigned int) faces(i, j) >= m.vert.size()) {
+						throw MLException(
+							"Error while creating mesh: bad vertex index " +
+							QString::number(faces(i, j)) + " in face " + QString::number(i) +
+							"; vertex " + QString::number(j) + ".");
+					}
 				}
 			}
-			fi->V(0) = ivp[faces(i, 0)];
-			fi->V(1) = ivp[faces(i, 1)];
-			fi->V(2) = ivp[faces(i, 2)];
-
-			if (hasFNormals) {
-				fi->N() =
-					CMeshO::CoordType(faceNormals(i, 0), faceNormals(i, 1), faceNormals(i, 2));
-			}
-			if (hasFQuality) {
-				fi->Q() = faceQuality(i);
-			}
-			if (hasFColors) {
-				fi->C() = CMeshO::FaceType::ColorType(
-					faceColor(i, 0) * 255,
-					faceColor(i, 1) * 255,
-					faceColor(i, 2) * 255,
-					faceColor(i, 3) * 255);
-			}
-			if (hasFWedgeTexCoords) {
+		}
+		vcg::tri::Allocator<CMeshO>::AddFaces(m, faces.rows());
+		for (unsigned int i = 0; i < faces.rows(); ++i) {
+			m.face[i].V(0) = &m.vert[faces(i, 0)];
+			m.face[i].V(1) = &m.vert[faces(i, 1)];
+			m.face[i].V(2) = &m.vert[faces(i, 2)];
+		}
+		if (hasFNormals) {
+			faceNormalMatrixView(m) = faceNormals;
+		}
+		if (hasFQuality) {
+			faceQualityArrayView(m) = faceQuality;
+		}
+		if (hasFColors) {
+			faceColorMatrixView(m) = (faceColor * Scalarm(255)).cast<unsigned char>();
+		}
+		if (hasFWedgeTexCoords) {
+			for (unsigned int i = 0; i < faces.rows(); ++i) {
 				for (uint j = 0; j < 3; j++) {
-					fi->WT(j).U() = wedgeTexCoords(i*3 + j, 0);
-					fi->WT(j).V() = wedgeTexCoords(i*3 + j, 1);
+					m.face[i].WT(j).U() = wedgeTexCoords(i*3 + j, 0);
+					m.face[i].WT(j).V() = wedgeTexCoords(i*3 + j, 1);
 				}
 			}
 		}
 
 		// add edges
 
-		CMeshO::EdgeIterator ei = vcg::tri::Allocator<CMeshO>::AddEdges(m, edges.rows());
-		for (unsigned int i = 0; i < edges.rows(); ++i, ++ei) {
-			for (unsigned int j = 0; j < 2; j++) {
-				if ((unsigned int) edges(i, j) >= ivp.size()) {
-					throw MLException(
-						"Error while creating mesh: bad vertex index " +
-						QString::number(edges(i, j)) + " in edge " + QString::number(i) +
-						"; vertex " + QString::number(j) + ".");
+		if (edges.rows() > 0 && (edges.minCoeff() < 0 || edges.maxCoeff() >= vertices.rows())) {
+			for (unsigned int i = 0; i < edges.rows(); ++i) {
+				for (unsigned int j = 0; j < 2; j++) {
+					if ((unsigned int) edges(i, j) >= m.vert.size()) {
+						throw MLException(
+							"Error while creating mesh: bad vertex index " +
+							QString::number(edges(i, j)) + " in edge " + QString::number(i) +
+							"; vertex " + QString::number(j) + ".");
+					}
 				}
 			}
-			ei->V(0) = ivp[edges(i, 0)];
-			ei->V(1) = ivp[edges(i, 1)];
+		}
+		vcg::tri::Allocator<CMeshO>::AddEdges(m, edges.rows());
+		for (unsigned int i = 0; i < edges.rows(); ++i) {
+			m.edge[i].V(0) = &m.vert[edges(i, 0)];
+			m.edge[i].V(1) = &m.vert[edges(i, 1)];
 		}
 
 		if (!hasFNormals) {
@@ -572,29 +619,186 @@ void meshlab::addFaceVectorAttribute(
 }
 
 /**
- * @brief Get a #V*3 Eigen matrix of scalars containing the coordinates of the
- * vertices of a CMeshO.
+ * @brief Get a #V*3 Eigen view over the coordinates of the vertices of a
+ * CMeshO. No copies are made: the view reads and writes directly the vertex
+ * storage of the mesh, and it is valid until the vertex container is not
+ * reallocated.
  * The vertices in the mesh must be compact (no deleted vertices).
  * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
  *
  * @param mesh: input mesh
- * @return #V*3 matrix of scalars (vertex coordinates)
+ * @return #V*3 view of scalars (vertex coordinates)
  */
-EigenMatrixX3m meshlab::vertexMatrix(const CMeshO& mesh)
+EigenMatrixX3mView meshlab::vertexMatrixView(CMeshO& mesh)
 {
 	vcg::tri::RequireVertexCompactness(mesh);
+	return matrixView<EigenMatrixX3mView, Scalarm>(
+		mesh.vert, mesh.VN(), [](CMeshO::VertexType& v) { return v.P().V(); });
+}
 
-	// create eigen matrix of vertices
-	EigenMatrixX3m vert(mesh.VN(), 3);
+EigenMatrixX3mConstView meshlab::vertexMatrixView(const CMeshO& mesh)
+{
+	vcg::tri::RequireVertexCompactness(mesh);
+	return matrixView<EigenMatrixX3mConstView, const Scalarm>(
+		mesh.vert, mesh.VN(), [](const CMeshO::VertexType& v) { return v.cP().V(); });
+}
 
-	// copy vertices
-	for (int i = 0; i < mesh.VN(); i++) {
-		for (int j = 0; j < 3; j++) {
-			vert(i, j) = mesh.vert[i].P()[j];
-		}
-	}
+/**
+ * @brief Get a #V*3 Eigen view over the normals of the vertices of a CMeshO.
+ * No copies are made, see vertexMatrixView.
+ * The vertices in the mesh must be compact (no deleted vertices).
+ * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
+ *
+ * @param mesh: input mesh
+ * @return #V*3 view of scalars (vertex normals)
+ */
+EigenMatrixX3mView meshlab::vertexNormalMatrixView(CMeshO& mesh)
+{
+	vcg::tri::RequireVertexCompactness(mesh);
+	return matrixView<EigenMatrixX3mView, Scalarm>(
+		mesh.vert, mesh.VN(), [](CMeshO::VertexType& v) { return v.N().V(); });
+}
 
-	return vert;
+EigenMatrixX3mConstView meshlab::vertexNormalMatrixView(const CMeshO& mesh)
+{
+	vcg::tri::RequireVertexCompactness(mesh);
+	return matrixView<EigenMatrixX3mConstView, const Scalarm>(
+		mesh.vert, mesh.VN(), [](const CMeshO::VertexType& v) { return v.cN().V(); });
+}
+
+/**
+ * @brief Get a #F*3 Eigen view over the normals of the faces of a CMeshO.
+ * No copies are made, see vertexMatrixView.
+ * The faces in the mesh must be compact (no deleted faces).
+ * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
+ *
+ * @param mesh: input mesh
+ * @return #F*3 view of scalars (face normals)
+ */
+EigenMatrixX3mView meshlab::faceNormalMatrixView(CMeshO& mesh)
+{
+	vcg::tri::RequireFaceCompactness(mesh);
+	return matrixView<EigenMatrixX3mView, Scalarm>(
+		mesh.face, mesh.FN(), [](CMeshO::FaceType& f) { return f.N().V(); });
+}
+
+EigenMatrixX3mConstView meshlab::faceNormalMatrixView(const CMeshO& mesh)
+{
+	vcg::tri::RequireFaceCompactness(mesh);
+	return matrixView<EigenMatrixX3mConstView, const Scalarm>(
+		mesh.face, mesh.FN(), [](const CMeshO::FaceType& f) { return f.cN().V(); });
+}
+
+/**
+ * @brief Get a #V*4 Eigen view over the RGBA colors (values in [0, 255]) of
+ * the vertices of a CMeshO. No copies are made, see vertexMatrixView.
+ * The vertices in the mesh must be compact (no deleted vertices).
+ * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
+ *
+ * @param mesh: input mesh
+ * @return #V*4 view of unsigned chars (vertex colors)
+ */
+EigenMatrixX4ubView meshlab::vertexColorMatrixView(CMeshO& mesh)
+{
+	vcg::tri::RequireVertexCompactness(mesh);
+	return matrixView<EigenMatrixX4ubView, unsigned char>(
+		mesh.vert, mesh.VN(), [](CMeshO::VertexType& v) { return v.C().V(); });
+}
+
+EigenMatrixX4ubConstView meshlab::vertexColorMatrixView(const CMeshO& mesh)
+{
+	vcg::tri::RequireVertexCompactness(mesh);
+	return matrixView<EigenMatrixX4ubConstView, const unsigned char>(
+		mesh.vert, mesh.VN(), [](const CMeshO::VertexType& v) { return v.cC().V(); });
+}
+
+/**
+ * @brief Get a #F*4 Eigen view over the RGBA colors (values in [0, 255]) of
+ * the faces of a CMeshO. No copies are made, see vertexMatrixView.
+ * The faces in the mesh must be compact (no deleted faces).
+ * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
+ *
+ * @param mesh: input mesh
+ * @return #F*4 view of unsigned chars (face colors)
+ */
+EigenMatrixX4ubView meshlab::faceColorMatrixView(CMeshO& mesh)
+{
+	vcg::tri::RequireFaceCompactness(mesh);
+	vcg::tri::RequirePerFaceColor(mesh);
+	return matrixView<EigenMatrixX4ubView, unsigned char>(
+		mesh.face, mesh.FN(), [](CMeshO::FaceType& f) { return f.C().V(); });
+}
+
+EigenMatrixX4ubConstView meshlab::faceColorMatrixView(const CMeshO& mesh)
+{
+	vcg::tri::RequireFaceCompactness(mesh);
+	vcg::tri::RequirePerFaceColor(mesh);
+	return matrixView<EigenMatrixX4ubConstView, const unsigned char>(
+		mesh.face, mesh.FN(), [](const CMeshO::FaceType& f) { return f.cC().V(); });
+}
+
+/**
+ * @brief Get a #V Eigen view over the quality of the vertices of a CMeshO.
+ * No copies are made, see vertexMatrixView.
+ * The vertices in the mesh must be compact (no deleted vertices).
+ * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
+ *
+ * @param mesh: input mesh
+ * @return #V view of scalars (vertex quality)
+ */
+EigenVectorXmView meshlab::vertexQualityArrayView(CMeshO& mesh)
+{
+	vcg::tri::RequireVertexCompactness(mesh);
+	vcg::tri::RequirePerVertexQuality(mesh);
+	return vectorView<EigenVectorXmView, Scalarm>(
+		mesh.vert, mesh.VN(), [](CMeshO::VertexType& v) { return &v.Q(); });
+}
+
+EigenVectorXmConstView meshlab::vertexQualityArrayView(const CMeshO& mesh)
+{
+	vcg::tri::RequireVertexCompactness(mesh);
+	vcg::tri::RequirePerVertexQuality(mesh);
+	return vectorView<EigenVectorXmConstView, const Scalarm>(
+		mesh.vert, mesh.VN(), [](const CMeshO::VertexType& v) { return &v.cQ(); });
+}
+
+/**
+ * @brief Get a #F Eigen view over the quality of the faces of a CMeshO.
+ * No copies are made, see vertexMatrixView.
+ * The faces in the mesh must be compact (no deleted faces).
+ * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
+ *
+ * @param mesh: input mesh
+ * @return #F view of scalars (face quality)
+ */
+EigenVectorXmView meshlab::faceQualityArrayView(CMeshO& mesh)
+{
+	vcg::tri::RequireFaceCompactness(mesh);
+	vcg::tri::RequirePerFaceQuality(mesh);
+	return vectorView<EigenVectorXmView, Scalarm>(
+		mesh.face, mesh.FN(), [](CMeshO::FaceType& f) { return &f.Q(); });
+}
+
+EigenVectorXmConstView meshlab::faceQualityArrayView(const CMeshO& mesh)
+{
+	vcg::tri::RequireFaceCompactness(mesh);
+	vcg::tri::RequirePerFaceQuality(mesh);
+	return vectorView<EigenVectorXmConstView, const Scalarm>(
+		mesh.face, mesh.FN(), [](const CMeshO::FaceType& f) { return &f.cQ(); });
+}
+
+/**
+ * @brief Get a #V*3 Eigen matrix of scalars containing the coordinates of the
+ * vertices of a CMeshO.
+ * The vertices in the mesh must be compact (no deleted vertices).
+ * If the mesh is not compact, a vcg::MissingCompactnessException will be thrown.
+ *
+ * @param mesh: input mesh
+ * @return #V*3 matrix of scalars (vertex coordinates)
+ */
+EigenMatrixX3m meshlab::vertexMatrix(const CMeshO& mesh)
+{
+	return vertexMatrixView(mesh);
 }
 
 /**
@@ -715,19 +919,7 @@ std::list<EigenVectorXui> meshlab::polygonalFaceList(const CMeshO& mesh)
  */
 EigenMatrixX3m meshlab::vertexNormalMatrix(const CMeshO& mesh)
 {
-	vcg::tri::RequireVertexCompactness(mesh);
-
-	// create eigen matrix of vertex normals
-	EigenMatrixX3m vertexNormals(mesh.VN(), 3);
-
-	// per vertices normals
-	for (int i = 0; i < mesh.VN(); i++) {
-		for (int j = 0; j < 3; j++) {
-			vertexNormals(i, j) = mesh.vert[i].N()[j];
-		}
-	}
-
-	return vertexNormals;
+	return vertexNormalMatrixView(mesh);
 }
 
 /**
@@ -777,29 +969,7 @@ EigenMatrixX3m meshlab::transformedVertexNormalMatrix(const CMeshO &mesh)
  */
 EigenMatrixX3m meshlab::faceNormalMatrix(const CMeshO& mesh)
 {
-	vcg::tri::RequireFaceCompactness(mesh);
-
-	CMeshO::ScalarType scale;
-
-	vcg::Matrix33<CMeshO::ScalarType> mat33(mesh.Tr,3);
-	scale = pow(mat33.Determinant(),(CMeshO::ScalarType)(1.0/3.0));
-	CMeshO::CoordType scaleV(scale,scale,scale);
-	vcg::Matrix33<CMeshO::ScalarType> S;
-	S.SetDiagonal(scaleV.V());
-	mat33*=S;
-
-	// create eigen matrix of face normals
-	EigenMatrixX3m faceNormals(mesh.FN(), 3);
-
-	// per face normals
-	for (int i = 0; i < mesh.FN(); i++) {
-		CMeshO::CoordType n = mat33 * mesh.face[i].N();
-		for (int j = 0; j < 3; j++) {
-			faceNormals(i, j) = n[j];
-		}
-	}
-
-	return faceNormals;
+	return faceNormalMatrixView(mesh);
 }
 
 /**
@@ -815,13 +985,23 @@ EigenMatrixX3m meshlab::transformedFaceNormalMatrix(const CMeshO &mesh)
 {
 	vcg::tri::RequireFaceCompactness(mesh);
 
+	CMeshO::ScalarType scale;
+
+	vcg::Matrix33<CMeshO::ScalarType> mat33(mesh.Tr,3);
+	scale = pow(mat33.Determinant(),(CMeshO::ScalarType)(1.0/3.0));
+	CMeshO::CoordType scaleV(scale,scale,scale);
+	vcg::Matrix33<CMeshO::ScalarType> S;
+	S.SetDiagonal(scaleV.V());
+	mat33*=S;
+
 	// create eigen matrix of face normals
 	EigenMatrixX3m faceNormals(mesh.FN(), 3);
 
 	// per face normals
 	for (int i = 0; i < mesh.FN(); i++) {
+		CMeshO::CoordType n = mat33 * mesh.face[i].N();
 		for (int j = 0; j < 3; j++) {
-			faceNormals(i, j) = mesh.face[i].N()[j];
+			faceNormals(i, j) = n[j];
 		}
 	}
 
@@ -840,16 +1020,7 @@ EigenMatrixX3m meshlab::transformedFaceNormalMatrix(const CMeshO &mesh)
  */
 EigenMatrixX4m meshlab::vertexColorMatrix(const CMeshO& mesh)
 {
-	vcg::tri::RequireVertexCompactness(mesh);
-	EigenMatrixX4m vertexColors(mesh.VN(), 4);
-
-	for (int i = 0; i < mesh.VN(); i++) {
-		for (int j = 0; j < 4; j++) {
-			vertexColors(i, j) = mesh.vert[i].C()[j] / 255.0;
-		}
-	}
-
-	return vertexColors;
+	return vertexColorMatrixView(mesh).cast<Scalarm>() / Scalarm(255);
 }
 
 /**
@@ -863,18 +1034,7 @@ EigenMatrixX4m meshlab::vertexColorMatrix(const CMeshO& mesh)
  */
 EigenMatrixX4m meshlab::faceColorMatrix(const CMeshO& mesh)
 {
-	vcg::tri::RequireFaceCompactness(mesh);
-	vcg::tri::RequirePerFaceColor(mesh);
-
-	EigenMatrixX4m faceColors(mesh.FN(), 4);
-
-	for (int i = 0; i < mesh.FN(); i++) {
-		for (int j = 0; j < 4; j++) {
-			faceColors(i, j) = mesh.face[i].C()[j] / 255.0;
-		}
-	}
-
-	return faceColors;
+	return faceColorMatrixView(mesh).cast<Scalarm>() / Scalarm(255);
 }
 
 /**
@@ -934,14 +1094,7 @@ EigenVectorXui meshlab::faceColorArray(const CMeshO& mesh)
  */
 EigenVectorXm meshlab::vertexQualityArray(const CMeshO& mesh)
 {
-	vcg::tri::RequireVertexCompactness(mesh);
-	vcg::tri::RequirePerVertexQuality(mesh);
-
-	EigenVectorXm qv(mesh.VN());
-	for (int i = 0; i < mesh.VN(); i++) {
-		qv(i) = mesh.vert[i].Q();
-	}
-	return qv;
+	return vertexQualityArrayView(mesh);
 }
 
 /**
@@ -955,14 +1108,7 @@ EigenVectorXm meshlab::vertexQualityArray(const CMeshO& mesh)
  */
 EigenVectorXm meshlab::faceQualityArray(const CMeshO& mesh)
 {
-	vcg::tri::RequireFaceCompactness(mesh);
-	vcg::tri::RequirePerFaceQuality(mesh);
-
-	EigenVectorXm qf(mesh.FN());
-	for (int i = 0; i < mesh.FN(); i++) {
-		qf(i) = mesh.face[i].Q();
-	}
-	return qf;
+	return faceQualityArrayView(mesh);
 }
 
 /**
@@ -38,21 +38,46 @@ typedef Eigen::Matrix<Scalarm, Eigen::Dynamic, 4> EigenMatrixX4m;
 
 typedef Eigen::Matrix<Scalarm, Eigen::Dynamic, Eigen::Dynamic> EigenMatrixXm;
 
+typedef Eigen::Matrix<Scalarm, Eigen::Dynamic, 3, Eigen::RowMajor>       EigenRowMatrixX3m;
+typedef Eigen::Matrix<unsigned char, Eigen::Dynamic, 4, Eigen::RowMajor> EigenRowMatrixX4ub;
+
+// Views over the attribute arrays stored in a CMeshO (no copies are made).
+// The stride between two rows is the distance between two consecutive elements
+// of the mesh in memory.
+typedef Eigen::Map<EigenRowMatrixX3m, Eigen::Unaligned, Eigen::OuterStride<>> EigenMatrixX3mView;
+typedef Eigen::Map<const EigenRowMatrixX3m, Eigen::Unaligned, Eigen::OuterStride<>>
+	EigenMatrixX3mConstView;
+typedef Eigen::Map<EigenVectorXm, Eigen::Unaligned, Eigen::InnerStride<>>       EigenVectorXmView;
+typedef Eigen::Map<const EigenVectorXm, Eigen::Unaligned, Eigen::InnerStride<>> EigenVectorXmConstView;
+typedef Eigen::Map<EigenRowMatrixX4ub, Eigen::Unaligned, Eigen::OuterStride<>> EigenMatrixX4ubView;
+typedef Eigen::Map<const EigenRowMatrixX4ub, Eigen::Unaligned, Eigen::OuterStride<>>
+	EigenMatrixX4ubConstView;
+
+// Read only references that bind without copies both to Eigen matrices and to
+// maps over external buffers with any memory layout (e.g. row major numpy arrays)
+typedef Eigen::Stride<Eigen::Dynamic, Eigen::Dynamic> EigenAnyStride;
+typedef Eigen::Ref<const EigenMatrixX3m, 0, EigenAnyStride>   EigenMatrixX3mConstRef;
+typedef Eigen::Ref<const EigenMatrixX4m, 0, EigenAnyStride>   EigenMatrixX4mConstRef;
+typedef Eigen::Ref<const EigenMatrixX2m, 0, EigenAnyStride>   EigenMatrixX2mConstRef;
+typedef Eigen::Ref<const EigenVectorXm, 0, Eigen::InnerStride<>> EigenVectorXmConstRef;
+typedef Eigen::Ref<const Eigen::MatrixX3i, 0, EigenAnyStride> EigenMatrixX3iConstRef;
+typedef Eigen::Ref<const Eigen::MatrixX2i, 0, EigenAnyStride> EigenMatrixX2iConstRef;
+
 namespace meshlab {
 
 // From eigen to CMeshO
 CMeshO meshFromMatrices(
-	const EigenMatrixX3m&   vertices,
-	const Eigen::MatrixX3i& faces           = Eigen::MatrixX3i(),
-	const Eigen::MatrixX2i& edges           = Eigen::MatrixX2i(),
-	const EigenMatrixX3m&   vertexNormals   = EigenMatrixX3m(),
-	const EigenMatrixX3m&   faceNormals     = EigenMatrixX3m(),
-	const EigenVectorXm&    vertexQuality   = EigenVectorXm(),
-	const EigenVectorXm&    faceQuality     = EigenVectorXm(),
-	const EigenMatrixX4m&   vertexColor     = EigenMatrixX4m(),
-	const EigenMatrixX4m&   faceColor       = EigenMatrixX4m(),
-	const EigenMatrixX2m&   vertexTexCoords = EigenMatrixX2m(),
-	const EigenMatrixX2m&   wedgeTexCoords  = EigenMatrixX2m());
+	const EigenMatrixX3mConstRef& vertices,
+	const EigenMatrixX3iConstRef& faces           = Eigen::MatrixX3i(),
+	const EigenMatrixX2iConstRef& edges           = Eigen::MatrixX2i(),
+	const EigenMatrixX3mConstRef& vertexNormals   = EigenMatrixX3m(),
+	const EigenMatrixX3mConstRef& faceNormals     = EigenMatrixX3m(),
+	const EigenVectorXmConstRef&  vertexQuality   = EigenVectorXm(),
+	const EigenVectorXmConstRef&  faceQuality     = EigenVectorXm(),
+	const EigenMatrixX4mConstRef& vertexColor     = EigenMatrixX4m(),
+	const EigenMatrixX4mConstRef& faceColor       = EigenMatrixX4m(),
+	const EigenMatrixX2mConstRef& vertexTexCoords = EigenMatrixX2m(),
+	const EigenMatrixX2mConstRef& wedgeTexCoords  = EigenMatrixX2m());
 
 // From eigen to polygonal CMeshO
 CMeshO polyMeshFromMatrices(
@@ -86,6 +111,22 @@ void addFaceVectorAttribute(
 	const EigenMatrixX3m& attributeValues,
 	const std::string&    attributeName);
 
+// Views over CMeshO attributes
+EigenMatrixX3mView       vertexMatrixView(CMeshO& mesh);
+EigenMatrixX3mConstView  vertexMatrixView(const CMeshO& mesh);
+EigenMatrixX3mView       vertexNormalMatrixView(CMeshO& mesh);
+EigenMatrixX3mConstView  vertexNormalMatrixView(const CMeshO& mesh);
+EigenMatrixX3mView       faceNormalMatrixView(CMeshO& mesh);
+EigenMatrixX3mConstView  faceNormalMatrixView(const CMeshO& mesh);
+EigenMatrixX4ubView      vertexColorMatrixView(CMeshO& mesh);
+EigenMatrixX4ubConstView vertexColorMatrixView(const CMeshO& mesh);
+EigenMatrixX4ubView      faceColorMatrixView(CMeshO& mesh);
+EigenMatrixX4ubConstView faceColorMatrixView(const CMeshO& mesh);
+EigenVectorXmView        vertexQualityArrayView(CMeshO& mesh);
+EigenVectorXmConstView   vertexQualityArrayView(const CMeshO& mesh);
+EigenVectorXmView        faceQualityArrayView(CMeshO& mesh);
+EigenVectorXmConstView   faceQualityArrayView(const CMeshO& mesh);
+
 // From CMeshO to Eigen
 EigenMatrixX3m            vertexMatrix(const CMeshO& mesh);
 EigenMatrixX3m            transformedVertexMatrix(const CMeshO& mesh);
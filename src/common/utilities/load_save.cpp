@@ -23,8 +23,14 @@
 
 #include "load_save.h"
 
+#include <chrono>
+#include <future>
+#include <mutex>
+
 #include <QDir>
 #include <QElapsedTimer>
+#include <QRunnable>
+#include <QThreadPool>
 
 #include "../globals.h"
 #include "../plugins/plugin_manager.h"
@@ -33,51 +39,45 @@
 
 namespace meshlab {
 
-/**
- * @brief This function assumes that you already have the following data:
- * - the plugin that is needed to load the mesh
- * - the number of meshes that will be loaded from the file
- * - the list of MeshModel(s) that will contain the loaded mesh(es)
- * - the open parameters that will be used to load the mesh(es)
- *
- * The function will take care to load the mesh, load textures if needed
- * and make all the clean operations after loading the meshes.
- * If load fails, throws a MLException.
- *
- * @param[i] fileName: the filename
- * @param[i] ioPlugin: the plugin that supports the file format to load
- * @param[i] prePar: the pre open parameters
- * @param[i/o] meshList: the list of meshes that will be loaded from the file
- * @param[o] maskList: masks of loaded components for each loaded mesh
- * @param cb: callback
- * @return the list of texture names that could not be loaded
- */
-std::list<std::string> loadMesh(
-	const QString&               fileName,
-	IOPlugin*                    ioPlugin,
-	const RichParameterList&     prePar,
-	const std::list<MeshModel*>& meshList,
-	std::list<int>&              maskList,
-	vcg::CallBackPos*            cb)
+namespace {
+
+std::recursive_mutex& currentDirMutex()
 {
-	std::list<std::string> unloadedTextures;
-	QFileInfo              fi(fileName);
-	QString                extension = fi.suffix();
+	static std::recursive_mutex m;
+	return m;
+}
 
-	QDir oldDir = QDir::current();
-	QDir::setCurrent(fi.absolutePath());
-	ioPlugin->open(extension, fi.fileName(), meshList, maskList, prePar, cb);
-	QDir::setCurrent(oldDir.absolutePath());
+/*
+Starts decoding the textures of the meshes just loaded: they are decoded in
+background and waited on first use. Returns the list of texture names that
+could not be loaded.
+*/
+std::list<std::string> requestTextures(const std::list<MeshModel*>& meshList, vcg::CallBackPos* cb)
+{
+	std::list<std::string> unloadedTextures;
+	for (MeshModel* mm : meshList) {
+		std::list<std::string> tmp = mm->loadTextures(nullptr, cb, true);
+		unloadedTextures.insert(unloadedTextures.end(), tmp.begin(), tmp.end());
+	}
+	return unloadedTextures;
+}
 
+/*
+Completes the load of the meshes just opened by ioPlugin: removes the
+degenerate elements and updates normals and bounding boxes. The textures are
+requested separately, by requestTextures.
+*/
+void finalizeLoadedMeshes(
+	IOPlugin*                    ioPlugin,
+	const std::list<MeshModel*>& meshList,
+	const std::list<int>&        maskList)
+{
 	auto itmesh = meshList.begin();
 	auto itmask = maskList.begin();
 	for (unsigned int i = 0; i < meshList.size(); ++i) {
 		MeshModel* mm   = *itmesh;
 		int        mask = *itmask;
 
-		std::list<std::string> tmp = mm->loadTextures(nullptr, cb);
-		unloadedTextures.insert(unloadedTextures.end(), tmp.begin(), tmp.end());
-
 		int delVertNum = vcg::tri::Clean<CMeshO>::RemoveDegenerateVertex(mm->cm);
 		int delFaceNum = vcg::tri::Clean<CMeshO>::RemoveDegenerateFace(mm->cm);
 		vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm->cm);
@@ -113,32 +113,20 @@ std::list<std::string> loadMesh(
 		++itmesh;
 		++itmask;
 	}
-	return unloadedTextures;
 }
 
-/**
- * @brief loads the given filename and puts the loaded mesh(es) into the
- * given MeshDocument. Returns the list of loaded meshes.
- *
- * If you already know the open parameters that could be used to load the mesh,
- * you can pass a RichParameterList containing them.
- * Note: only parameters of your RPL that are actually required by the plugin
- * will be given as input to the load function.
- * If you don't know any parameter, leave the RichParameterList parameter empty.
- *
- * The function takes care to:
- * - find the plugin that loads the format of the file
- * - create the required MeshModels into the MeshDocument
- * - load the meshes and their textures, with standard parameters
- *
- * if an error occurs, an exception will be thrown, and MeshDocument won't
- * contain new meshes.
- */
-std::list<MeshModel*> loadMeshWithStandardParameters(
-	const QString&    filename,
-	MeshDocument&     md,
-	vcg::CallBackPos* cb,
-	RichParameterList prePar)
+/*
+Finds the plugin that loads the format of filename and creates in md the
+layers that will contain the meshes of the file; openParams are the open
+parameters of the plugin, with the values given in prePar. Throws an
+MLException if there is no plugin for the format.
+*/
+IOPlugin* createMeshLayers(
+	const QString&           filename,
+	MeshDocument&            md,
+	const RichParameterList& prePar,
+	RichParameterList&       openParams,
+	std::list<MeshModel*>&   meshList)
 {
 	QFileInfo      fi(filename);
 	QString        extension = fi.suffix();
@@ -155,12 +143,12 @@ std::list<MeshModel*> loadMeshWithStandardParameters(
 	ioPlugin->setLog(&md.Log);
 
 	// get the open parameters for the given extension
-	RichParameterList openParams = ioPlugin->initPreOpenParameter(extension);
+	openParams = ioPlugin->initPreOpenParameter(extension);
 
 	// if some parameters were given in the prePar, then set their values into
 	// openParams.
 	// we need to be sure that openParams contains only parameters allowed by the plugin
-	for (RichParameter& rp : prePar) {
+	for (const RichParameter& rp : prePar) {
 		auto it = openParams.findParameter(rp.name());
 		if (it != openParams.end()) {
 			it->setValue(rp.value());
@@ -172,7 +160,6 @@ std::list<MeshModel*> loadMeshWithStandardParameters(
 	// - if specified in prePar, the values into prePar
 
 	unsigned int nMeshes = ioPlugin->numberMeshesContainedInFile(extension, filename, openParams);
-	std::list<MeshModel*> meshList;
 	for (unsigned int i = 0; i < nMeshes; i++) {
 		MeshModel* mm = md.addNewMesh(filename, fi.fileName());
 		if (nMeshes != 1) {
@@ -182,21 +169,276 @@ std::list<MeshModel*> loadMeshWithStandardParameters(
 		}
 		meshList.push_back(mm);
 	}
+	return ioPlugin;
+}
+
+class LoadMeshTask : public QRunnable
+{
+public:
+	LoadMeshTask(
+		IOPlugin*                    ioPlugin,
+		const QString&               fileName,
+		const RichParameterList&     openParams,
+		const std::list<MeshModel*>& meshList,
+		QStringList&                 warnings,
+		std::promise<void>&          promise) :
+			ioPlugin(ioPlugin),
+			fileName(fileName),
+			openParams(openParams),
+			meshList(meshList),
+			warnings(warnings),
+			promise(promise)
+	{
+	}
+
+	void run() override
+	{
+		// the plugin is shared by the tasks: its warnings are collected here
+		// and reported by the calling thread
+		IOPlugin::WarningCollector collector;
+		try {
+			QFileInfo      fi(fileName);
+			std::list<int> masks;
+			if (ioPlugin->isOpenReentrant(fi.suffix())) {
+				// the reentrant importers open their side files next to the file
+				ioPlugin->open(fi.suffix(), fi.absoluteFilePath(), meshList, masks, openParams, nullptr);
+			}
+			else {
+				// as in loadMesh, the side files are opened from the mesh folder
+				CurrentDirGuard dir(fi.absolutePath());
+				ioPlugin->open(fi.suffix(), fi.fileName(), meshList, masks, openParams, nullptr);
+			}
+			// the textures are requested by the calling thread, after the join
+			finalizeLoadedMeshes(ioPlugin, meshList, masks);
+			warnings = collector.warnings();
+			promise.set_value();
+		}
+		catch (...) {
+			warnings = collector.warnings();
+			promise.set_exception(std::current_exception());
+		}
+	}
+
+private:
+	IOPlugin*             ioPlugin;
+	QString               fileName;
+	RichParameterList     openParams;
+	std::list<MeshModel*> meshList;
+	QStringList&          warnings;
+	std::promise<void>&   promise;
+};
+
+} // namespace
+
+CurrentDirGuard::CurrentDirGuard(const QString& dir)
+{
+	currentDirMutex().lock();
+	oldDir = QDir::currentPath();
+	QDir::setCurrent(dir);
+}
+
+CurrentDirGuard::~CurrentDirGuard()
+{
+	QDir::setCurrent(oldDir);
+	currentDirMutex().unlock();
+}
+
+/**
+ * @brief This function assumes that you already have the following data:
+ * - the plugin that is needed to load the mesh
+ * - the number of meshes that will be loaded from the file
+ * - the list of MeshModel(s) that will contain the loaded mesh(es)
+ * - the open parameters that will be used to load the mesh(es)
+ *
+ * The function will take care to load the mesh, load textures if needed
+ * and make all the clean operations after loading the meshes.
+ * If load fails, throws a MLException.
+ *
+ * @param[i] fileName: the filename
+ * @param[i] ioPlugin: the plugin that supports the file format to load
+ * @param[i] prePar: the pre open parameters
+ * @param[i/o] meshList: the list of meshes that will be loaded from the file
+ * @param[o] maskList: masks of loaded components for each loaded mesh
+ * @param cb: callback
+ * @return the list of texture names that could not be loaded
+ */
+std::list<std::string> loadMesh(
+	const QString&               fileName,
+	IOPlugin*                    ioPlugin,
+	const RichParameterList&     prePar,
+	const std::list<MeshModel*>& meshList,
+	std::list<int>&              maskList,
+	vcg::CallBackPos*            cb)
+{
+	QFileInfo fi(fileName);
+	QString   extension = fi.suffix();
+
+	{
+		// the side files are opened from the mesh folder
+		CurrentDirGuard dir(fi.absolutePath());
+		ioPlugin->open(extension, fi.fileName(), meshList, maskList, prePar, cb);
+	}
+
+	finalizeLoadedMeshes(ioPlugin, meshList, maskList);
+	return requestTextures(meshList, cb);
+}
+
+/**
+ * @brief loads the given filename and puts the loaded mesh(es) into the
+ * given MeshDocument. Returns the list of loaded meshes.
+ *
+ * If you already know the open parameters that could be used to load the mesh,
+ * you can pass a RichParameterList containing them.
+ * Note: only parameters of your RPL that are actually required by the plugin
+ * will be given as input to the load function.
+ * If you don't know any parameter, leave the RichParameterList parameter empty.
+ *
+ * The function takes care to:
+ * - find the plugin that loads the format of the file
+ * - create the required MeshModels into the MeshDocument
+ * - load the meshes and their textures, with standard parameters
+ *
+ * if an error occurs, an exception will be thrown, and MeshDocument won't
+ * contain new meshes.
+ */
+std::list<MeshModel*> loadMeshWithStandardParameters(
+	const QString&    filename,
+	MeshDocument&     md,
+	vcg::CallBackPos* cb,
+	RichParameterList prePar)
+{
+	RichParameterList     openParams;
+	std::list<MeshModel*> meshList;
+	IOPlugin* ioPlugin = createMeshLayers(filename, md, prePar, openParams, meshList);
 
 	std::list<int> masks;
 
 	try {
 		loadMesh(filename, ioPlugin, openParams, meshList, masks, cb);
 	}
-	catch (const MLException& e) {
+	catch (const MLException&) {
 		for (const MeshModel* mm : meshList)
 			md.delMesh(mm->id());
-		throw e;
+		throw;
 	}
 
 	return meshList;
 }
 
+/**
+ * @brief loads the given files and puts the loaded meshes into the given
+ * MeshDocument, with standard parameters. Returns, for each file, the list
+ * of its meshes.
+ *
+ * The layers of all the files are created first, in the order of the files,
+ * so that the document is modified only by the calling thread and always in
+ * the same order; then the files of the formats that can be opened
+ * concurrently (see IOPlugin::isOpenReentrant) are loaded by the global
+ * QThreadPool, while the other ones are loaded one at a time by the calling
+ * thread. The reentrant formats are opened with their absolute path, without
+ * changing the current directory, that is shared by the loading threads; the
+ * other ones are opened from their folder, through a CurrentDirGuard; also a
+ * reentrant importer can fall back to a guard (e.g. the OBJ files that are not
+ * parsed in parallel), so the caller must not hold one.
+ * The progress, in loaded files, and the warnings of the plugins are reported
+ * by the calling thread, that also requests the textures of the meshes once
+ * all the files have been loaded.
+ *
+ * if an error occurs, the exception of the first file (in order) that could
+ * not be loaded will be thrown, and MeshDocument won't contain any of the
+ * new meshes.
+ */
+std::vector<std::list<MeshModel*>> loadMeshesWithStandardParameters(
+	const QStringList& filenames,
+	MeshDocument&      md,
+	vcg::CallBackPos*  cb)
+{
+	const int                          n = filenames.size();
+	std::vector<std::list<MeshModel*>> meshLists(n);
+	std::vector<RichParameterList>     openParams(n);
+	std::vector<IOPlugin*>             ioPlugins(n);
+
+	auto deleteLayers = [&]() {
+		for (const std::list<MeshModel*>& meshList : meshLists)
+			for (const MeshModel* mm : meshList)
+				md.delMesh(mm->id());
+	};
+
+	try {
+		for (int i = 0; i < n; ++i)
+			ioPlugins[i] = createMeshLayers(
+				filenames[i], md, RichParameterList(), openParams[i], meshLists[i]);
+	}
+	catch (const MLException&) {
+		deleteLayers();
+		throw;
+	}
+
+	std::vector<std::promise<void>> loaded(n);
+	std::vector<std::future<void>>  results;
+	std::vector<QStringList>        warnings(n);
+	results.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		results.push_back(loaded[i].get_future());
+		if (ioPlugins[i]->isOpenReentrant(QFileInfo(filenames[i]).suffix()))
+			QThreadPool::globalInstance()->start(new LoadMeshTask(
+				ioPlugins[i], filenames[i], openParams[i], meshLists[i], warnings[i], loaded[i]));
+	}
+	// progress of the files loaded so far, also by the pool
+	auto reportProgress = [&]() {
+		if (cb == nullptr)
+			return;
+		int done = 0;
+		for (const std::future<void>& r : results)
+			if (r.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+				++done;
+		cb(100 * done / n, "Loading meshes...");
+	};
+	for (int i = 0; i < n; ++i) {
+		if (!ioPlugins[i]->isOpenReentrant(QFileInfo(filenames[i]).suffix())) {
+			reportProgress();
+			LoadMeshTask task(
+				ioPlugins[i], filenames[i], openParams[i], meshLists[i], warnings[i], loaded[i]);
+			task.run();
+		}
+	}
+
+	// all the files must have been loaded (or failed) before deleting the
+	// layers they were loaded into
+	for (int i = 0; i < n; ++i) {
+		results[i].wait();
+		if (cb != nullptr)
+			cb(100 * (i + 1) / n, "Loading meshes...");
+	}
+	for (int i = 0; i < n; ++i)
+		for (const QString& w : warnings[i])
+			ioPlugins[i]->reportWarning(w);
+	for (int i = 0; i < n; ++i) {
+		try {
+			results[i].get();
+		}
+		catch (const MLException&) {
+			deleteLayers();
+			throw;
+		}
+		catch (const std::exception& e) {
+			deleteLayers();
+			throw MLException("Mesh " + filenames[i] + " cannot be opened: " + e.what());
+		}
+		catch (...) {
+			deleteLayers();
+			throw MLException("Mesh " + filenames[i] + " cannot be opened");
+		}
+	}
+
+	// the textures are requested here, and not by the loading threads, since
+	// the layers are already in the document and can be drawn meanwhile
+	for (const std::list<MeshModel*>& meshList : meshLists)
+		requestTextures(meshList, nullptr);
+
+	return meshLists;
+}
+
 void reloadMesh(
 	const QString&               filename,
 	const std::list<MeshModel*>& meshList,
@@ -405,12 +647,12 @@ void loadRaster(const QString& filename, RasterModel& rm, GLLogStream* log, vcg:
 	}
 
 	if (code || ImageInfo.FocalLengthIn35mm == 0.0f) {
-		rm.shot.Intrinsics.ViewportPx =
-			vcg::Point2i(rm.currentPlane->image.width(), rm.currentPlane->image.height());
+		const QSize size = rm.currentPlane->imageSize();
+		rm.shot.Intrinsics.ViewportPx = vcg::Point2i(size.width(), size.height());
 		rm.shot.Intrinsics.CenterPx = Point2m(
-			float(rm.currentPlane->image.width() / 2.0),
-			float(rm.currentPlane->image.width() / 2.0));
-		rm.shot.Intrinsics.PixelSizeMm[0] = 36.0f / (float) rm.currentPlane->image.width();
+			float(size.width() / 2.0),
+			float(size.width() / 2.0));
+		rm.shot.Intrinsics.PixelSizeMm[0] = 36.0f / (float) size.width();
 		rm.shot.Intrinsics.PixelSizeMm[1] = rm.shot.Intrinsics.PixelSizeMm[0];
 		rm.shot.Intrinsics.FocalMm        = 50.0f;
 	}
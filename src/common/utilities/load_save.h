@@ -34,6 +34,27 @@
 
 namespace meshlab {
 
+/**
+ * @brief Sets the current directory of the process to dir while it lives,
+ * and restores the previous one when destroyed. The guards of all the threads
+ * are serialized (a thread can nest them): an importer that opens its side
+ * files relative to the current directory can use it while other files are
+ * loaded concurrently by loadMeshesWithStandardParameters; for the same
+ * reason, loadMeshesWithStandardParameters must not be called while holding
+ * a guard, or it would deadlock with the loading threads that need one.
+ */
+class CurrentDirGuard
+{
+public:
+	CurrentDirGuard(const QString& dir);
+	~CurrentDirGuard();
+	CurrentDirGuard(const CurrentDirGuard&) = delete;
+	CurrentDirGuard& operator=(const CurrentDirGuard&) = delete;
+
+private:
+	QString oldDir;
+};
+
 std::list<std::string> loadMesh(
 	const QString&               fileName,
 	IOPlugin*                    ioPlugin,
@@ -48,6 +69,11 @@ std::list<MeshModel*> loadMeshWithStandardParameters(
 	vcg::CallBackPos* cb     = nullptr,
 	RichParameterList prePar = RichParameterList());
 
+std::vector<std::list<MeshModel*>> loadMeshesWithStandardParameters(
+	const QStringList& filenames,
+	MeshDocument&      md,
+	vcg::CallBackPos*  cb = nullptr);
+
 void reloadMesh(
 	const QString&               filename,
 	const std::list<MeshModel*>& meshList,
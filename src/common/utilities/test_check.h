@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_TEST_CHECK_H
+#define MESHLAB_TEST_CHECK_H
+
+#include <cstdio>
+
+/*
+Minimal harness shared by the unit tests: check() reports every failed
+condition, and the main of the test returns testResult().
+*/
+
+namespace meshlab {
+namespace test {
+
+inline int& failures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline void check(bool cond, const char* what)
+{
+	if (!cond) {
+		std::fprintf(stderr, "FAILED: %s\n", what);
+		++failures();
+	}
+}
+
+/// prints the outcome of the test called name, and returns its exit code
+inline int testResult(const char* name)
+{
+	if (failures() == 0)
+		std::printf("%s: all tests passed\n", name);
+	return failures() == 0 ? 0 : 1;
+}
+
+} // namespace test
+} // namespace meshlab
+
+#endif // MESHLAB_TEST_CHECK_H
@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "eigen_mesh_conversions.h"
+#include "test_check.h"
+
+using namespace vcg;
+using meshlab::test::check;
+
+/*
+A mesh of two triangles, with per face color and quality enabled: these are
+optional components, stored by vector_ocf in a side vector, so their views
+have a different stride than the attributes stored in the elements.
+*/
+static CMeshO testMesh()
+{
+	CMeshO m;
+	tri::Allocator<CMeshO>::AddVertices(m, 4);
+	for (int i = 0; i < 4; ++i) {
+		m.vert[i].P() = Point3m(i, 2 * i, 3 * i);
+		m.vert[i].N() = Point3m(1, 0, i);
+		m.vert[i].Q() = Scalarm(i) / 2;
+		m.vert[i].C() = Color4b(i, 10 * i, 20 * i, 255);
+	}
+	tri::Allocator<CMeshO>::AddFace(m, &m.vert[0], &m.vert[1], &m.vert[2]);
+	tri::Allocator<CMeshO>::AddFace(m, &m.vert[1], &m.vert[3], &m.vert[2]);
+	m.face.EnableColor();
+	m.face.EnableQuality();
+	for (int i = 0; i < 2; ++i) {
+		m.face[i].N() = Point3m(0, i, 1);
+		m.face[i].Q() = Scalarm(i + 5);
+		m.face[i].C() = Color4b(30 * i, 0, 60, 255);
+	}
+	return m;
+}
+
+/*
+The views read the same values of the copying getters, and of the elements.
+*/
+static void testRead()
+{
+	const CMeshO m = testMesh();
+
+	check(meshlab::vertexMatrixView(m) == meshlab::vertexMatrix(m), "vertexMatrixView");
+	check(meshlab::vertexNormalMatrixView(m) == meshlab::vertexNormalMatrix(m), "vertexNormalMatrixView");
+	check(meshlab::faceNormalMatrixView(m) == meshlab::faceNormalMatrix(m), "faceNormalMatrixView");
+	check(meshlab::vertexQualityArrayView(m) == meshlab::vertexQualityArray(m), "vertexQualityArrayView");
+	check(meshlab::faceQualityArrayView(m) == meshlab::faceQualityArray(m), "faceQualityArrayView");
+	check(
+		(meshlab::vertexColorMatrixView(m).cast<Scalarm>() / Scalarm(255)).eval() ==
+			meshlab::vertexColorMatrix(m),
+		"vertexColorMatrixView");
+	check(
+		(meshlab::faceColorMatrixView(m).cast<Scalarm>() / Scalarm(255)).eval() ==
+			meshlab::faceColorMatrix(m),
+		"faceColorMatrixView");
+
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 3; ++j)
+			check(meshlab::vertexMatrixView(m)(i, j) == m.vert[i].cP()[j], "vertex coordinates");
+	for (int i = 0; i < 2; ++i) {
+		check(meshlab::faceQualityArrayView(m)(i) == m.face[i].cQ(), "face quality");
+		for (int j = 0; j < 4; ++j)
+			check(meshlab::faceColorMatrixView(m)(i, j) == m.face[i].cC()[j], "face color");
+	}
+}
+
+/*
+Writing through a view changes the mesh.
+*/
+static void testWrite()
+{
+	CMeshO m = testMesh();
+
+	meshlab::vertexMatrixView(m).col(1).setConstant(7);
+	meshlab::faceQualityArrayView(m)(1) = 42;
+	meshlab::faceColorMatrixView(m).row(0) << 1, 2, 3, 4;
+
+	for (int i = 0; i < 4; ++i)
+		check(m.vert[i].P()[1] == 7 && m.vert[i].P()[0] == i, "vertex coordinates written");
+	check(m.face[1].Q() == 42 && m.face[0].Q() == 5, "face quality written");
+	check(m.face[0].C() == Color4b(1, 2, 3, 4) && m.face[1].C() == Color4b(30, 0, 60, 255), "face color written");
+}
+
+/*
+meshFromMatrices accepts a row major map over an external buffer.
+*/
+static void testFromRowMajor()
+{
+	Scalarm buffer[] = {0, 0, 0, 1, 0, 0, 0, 1, 0};
+	Eigen::Map<EigenRowMatrixX3m> vertices(buffer, 3, 3);
+	Eigen::MatrixX3i faces(1, 3);
+	faces << 0, 1, 2;
+
+	CMeshO m = meshlab::meshFromMatrices(vertices, faces);
+	check(m.VN() == 3 && m.FN() == 1, "row major mesh size");
+	check(meshlab::vertexMatrix(m) == vertices, "row major vertices");
+}
+
+int main()
+{
+	testRead();
+	testWrite();
+	testFromRowMajor();
+	return meshlab::test::testResult("eigen_mesh_conversions");
+}
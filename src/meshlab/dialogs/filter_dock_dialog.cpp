@@ -44,6 +44,7 @@ FilterDockDialog::FilterDockDialog(
 	mask(plugin->postCondition(filter)),
 	currentGLArea(glArea),
 	isPreviewMeshStateValid(false),
+	isWaitingForApply(false),
 	prevParams(rpl),
 	mw(nullptr),
 	md(nullptr),
@@ -81,6 +82,7 @@ FilterDockDialog::FilterDockDialog(
 				noPreviewMeshState.create(mask, mesh);
 				connect(ui->parameterFrame, SIGNAL(parameterChanged()), this, SLOT(applyDynamic()));
 				connect(md, SIGNAL(currentMeshChanged(int)), this, SLOT(changeCurrentMesh(int)));
+				connect(mw, SIGNAL(filterExecuted()), this, SLOT(filterExecuted()));
 			}
 		}
 		else {
@@ -122,6 +124,8 @@ FilterDockDialog::~FilterDockDialog()
 
 void FilterDockDialog::on_previewCheckBox_stateChanged(int state)
 {
+	if (isPreviewBlocked())
+		return;
 	if (state == Qt::Checked) { // enable preview
 		ui->parameterFrame->writeValuesOnParameterList(parameters);
 
@@ -152,6 +156,12 @@ void FilterDockDialog::on_applyPushButton_clicked()
 {
 	ui->parameterFrame->writeValuesOnParameterList(parameters);
 
+	if (isPreviewBlocked()) {
+		// the filter is queued after the running one, on the current state of the mesh
+		emit applyButtonClicked(filter, parameters, false, true);
+		return;
+	}
+
 	if (isPreviewable()) {
 		if (mesh) {
 			// first, restore the mesh to the no-preview state
@@ -164,10 +174,14 @@ void FilterDockDialog::on_applyPushButton_clicked()
 		previewMeshState.apply(mesh);
 		updateRenderingData(mw, mesh);
 	}
-	else
+	else {
+		// the filter may be executed in background: the no-preview state is
+		// saved when it has been completed (see filterExecuted())
+		isWaitingForApply = isPreviewable();
 		emit applyButtonClicked(filter, parameters, false, true);
+	}
 
-	if (isPreviewable()) {
+	if (isPreviewable() && !isWaitingForApply) {
 		// save the no-preview state, after the filter was applied
 		noPreviewMeshState.create(mask, mesh);
 	}
@@ -196,7 +210,7 @@ void FilterDockDialog::on_defaultPushButton_clicked()
 
 void FilterDockDialog::applyDynamic()
 {
-	if (ui->previewCheckBox->isChecked()) {
+	if (ui->previewCheckBox->isChecked() && !isPreviewBlocked()) {
 		prevParams = parameters;
 		ui->parameterFrame->writeValuesOnParameterList(parameters);
 		ui->parameterFrame->writeValuesOnParameterList(prevParams);
@@ -216,7 +230,7 @@ void FilterDockDialog::applyDynamic()
 
 void FilterDockDialog::changeCurrentMesh(int meshId)
 {
-	if (isPreviewable()) {
+	if (isPreviewable() && !isPreviewBlocked()) {
 		noPreviewMeshState.apply(mesh);
 		mesh = md->getMesh(meshId);
 		noPreviewMeshState.create(mask, mesh);
@@ -232,6 +246,24 @@ bool FilterDockDialog::isPreviewable() const
 	return ui->previewCheckBox->isVisible();
 }
 
+/**
+ * @brief returns true when the mesh of the preview cannot be touched, because a
+ * filter is modifying the document
+ */
+bool FilterDockDialog::isPreviewBlocked() const
+{
+	return isPreviewable() && md != nullptr && md->isBusy();
+}
+
+void FilterDockDialog::filterExecuted()
+{
+	if (isWaitingForApply) {
+		isWaitingForApply = false;
+		// save the no-preview state, after the filter was applied
+		noPreviewMeshState.create(mask, mesh);
+	}
+}
+
 bool FilterDockDialog::isFilterPreviewable(FilterPlugin* plugin, const QAction* filter)
 {
 	unsigned int mask = plugin->postCondition(filter);
@@ -61,11 +61,13 @@ private slots:
 	// preview slots
 	void applyDynamic();
 	void changeCurrentMesh(int meshId);
+	void filterExecuted();
 
 	void on_copyToClipBoardPushButton_clicked();
 
 private:
 	bool isPreviewable() const;
+	bool isPreviewBlocked() const;
 
 	static bool isFilterPreviewable(FilterPlugin* plugin, const QAction* filter);
 	static void updateRenderingData(MainWindow* mw, MeshModel* mesh);
@@ -80,6 +82,7 @@ private:
 
 	// preview
 	bool              isPreviewMeshStateValid;
+	bool              isWaitingForApply;
 	MeshModelState    noPreviewMeshState;
 	MeshModelState    previewMeshState;
 	RichParameterList prevParams;
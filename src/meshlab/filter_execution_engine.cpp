@@ -0,0 +1,307 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "filter_execution_engine.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <QElapsedTimer>
+
+#include <common/mlexception.h>
+#include <common/ml_shared_data_context/ml_plugin_gl_context.h>
+
+std::atomic<FilterExecutionEngine*> FilterExecutionEngine::activeEngine(nullptr);
+std::atomic<qint64> FilterExecutionEngine::lastProgress(-1);
+
+bool FilterExecutionEngine::Job::runsOnGUIThread() const
+{
+	// previews must be applied before returning to the dialog, the GL
+	// context given to the filter can be made current only on the GUI thread,
+	// and only the filters that declare it can run on a worker thread
+	return isPreview || plugin == nullptr || plugin->requiresGLContext(action) ||
+		   !plugin->supportsBackgroundExecution(action);
+}
+
+FilterExecutionEngine::FilterExecutionEngine(QObject* parent) :
+		QObject(parent),
+		running(false),
+		worker(nullptr),
+		currentMeshIdBeforeJob(-1),
+		deferCompaction(false),
+		cancelRequested(false)
+{
+}
+
+FilterExecutionEngine::~FilterExecutionEngine()
+{
+	cancel();
+	if (worker != nullptr) {
+		worker->wait();
+		delete worker;
+	}
+}
+
+/**
+ * @brief Submits a filter job. If no other job is running, the job is started
+ * immediately; otherwise it is queued after the running (and the already
+ * queued) jobs.
+ */
+void FilterExecutionEngine::submit(const Job& job)
+{
+	pendingJobs.enqueue(job);
+	if (!running)
+		startNextJob();
+}
+
+bool FilterExecutionEngine::isRunning() const
+{
+	return running;
+}
+
+bool FilterExecutionEngine::isRunningInBackground() const
+{
+	return worker != nullptr;
+}
+
+int FilterExecutionEngine::queuedJobs() const
+{
+	return pendingJobs.size();
+}
+
+bool FilterExecutionEngine::isCancelRequested() const
+{
+	return cancelRequested;
+}
+
+/**
+ * @brief Requests the cancellation of the running job, and drops all the
+ * queued ones. Returns immediately: the running job is finished (and
+ * jobFinished is emitted) when the filter stops.
+ */
+void FilterExecutionEngine::cancel()
+{
+	pendingJobs.clear();
+	if (running)
+		cancelRequested = true;
+}
+
+/**
+ * @brief Cancels the running job and waits for the worker thread to stop.
+ */
+void FilterExecutionEngine::cancelAndWait()
+{
+	cancel();
+	if (worker != nullptr) {
+		worker->wait();
+		backgroundJobFinished();
+	}
+}
+
+/**
+ * @brief The vcg::CallBackPos given to the filters executed by the engine.
+ * It can be called from the worker thread: the progress is forwarded to the
+ * GUI through the (queued) progressChanged signal. Returns false when the
+ * running job has been canceled.
+ */
+bool FilterExecutionEngine::callBack(const int pos, const char* str)
+{
+	FilterExecutionEngine* engine = activeEngine;
+	if (engine == nullptr)
+		return true;
+	if (engine->cancelRequested)
+		return false;
+	// the filter can call it from many threads: only one of them emits
+	const qint64 now  = steadyMsecs();
+	qint64       last = lastProgress;
+	if ((last < 0 || now - last >= 100) && lastProgress.compare_exchange_strong(last, now))
+		emit engine->progressChanged(pos, QString(str));
+	return true;
+}
+
+qint64 FilterExecutionEngine::steadyMsecs()
+{
+	using namespace std::chrono;
+	return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void FilterExecutionEngine::startNextJob()
+{
+	while (!running && !pendingJobs.isEmpty()) {
+		current = Result();
+		current.job = pendingJobs.dequeue();
+		deferCompaction = canDeferCompaction();
+		running = true;
+		cancelRequested = false;
+		activeEngine = this;
+		lastProgress = -1;
+		emit runningChanged(true);
+
+		MeshDocument* md = current.job.md;
+		emit jobAboutToStart(current.job);
+		md->setBusy(true);
+
+		if (current.job.runsOnGUIThread()) {
+			execute(current);
+			finishJob();
+		}
+		else {
+			// the document signals would be delivered to the GUI while the
+			// filter is still modifying the meshes: they are held back and
+			// the changes of the layer set are notified at the end of the job
+			meshIdsBeforeJob.clear();
+			for (const MeshModel& mm : md->meshIterator())
+				meshIdsBeforeJob.push_back(mm.id());
+			currentMeshIdBeforeJob = md->mm() != nullptr ? md->mm()->id() : -1;
+			md->blockSignals(true);
+
+			worker = QThread::create([this]() { execute(current); });
+			connect(worker, &QThread::finished, this, &FilterExecutionEngine::backgroundJobFinished);
+			worker->start();
+		}
+	}
+}
+
+void FilterExecutionEngine::execute(Result& res)
+{
+	const Job& job = res.job;
+	QElapsedTimer tt;
+	tt.start();
+	try {
+		if (job.plugin->requiresGLContext(job.action) &&
+			(job.plugin->glContext == nullptr || !job.plugin->glContext->isValid()))
+			throw MLException("A valid GLContext is required by the filter to work.\n");
+
+		// the previous steps of the script may have left deleted elements
+		if (!job.plugin->supportsDeletedElements(job.action))
+			compactMeshes(*job.md);
+
+		// the meshes are saved in the undo history here, out of the GUI thread;
+		// the changes made by the jobs not recorded (e.g. previews) are unknown
+		MeshDocumentHistory& history = job.md->history();
+		if (history.isRecording())
+			history.captureOperation();
+		else
+			history.documentChanged();
+
+		res.outputValues = job.plugin->applyFilter(
+			job.action, job.parameters, *job.md, res.postConditionMask, callBack);
+		if (res.postConditionMask == MeshModel::MM_UNKNOWN)
+			res.postConditionMask = job.plugin->postCondition(job.action);
+		if (!deferCompaction)
+			compactMeshes(*job.md);
+		res.success = true;
+	}
+	catch (const std::bad_alloc& bdall) {
+		res.badAlloc = true;
+		res.errorMessage = bdall.what();
+	}
+	catch (const MLException& exc) {
+		res.errorMessage = exc.what();
+	}
+	catch (const std::exception& exc) {
+		res.errorMessage = exc.what();
+	}
+	res.canceled = cancelRequested;
+	res.elapsedMsec = tt.elapsed();
+}
+
+void FilterExecutionEngine::backgroundJobFinished()
+{
+	if (worker == nullptr)
+		return;
+	worker->wait();
+	worker->deleteLater();
+	worker = nullptr;
+
+	MeshDocument* md = current.job.md;
+	md->blockSignals(false);
+	bool layersChanged = false;
+	for (int id : meshIdsBeforeJob) {
+		if (md->getMesh(id) == nullptr) {
+			emit md->meshRemoved(id);
+			layersChanged = true;
+		}
+	}
+	for (const MeshModel& mm : md->meshIterator()) {
+		if (std::find(meshIdsBeforeJob.begin(), meshIdsBeforeJob.end(), mm.id()) == meshIdsBeforeJob.end()) {
+			emit md->meshAdded(mm.id());
+			layersChanged = true;
+		}
+	}
+	if (layersChanged)
+		emit md->meshSetChanged();
+	int currentMeshId = md->mm() != nullptr ? md->mm()->id() : -1;
+	if (currentMeshId != currentMeshIdBeforeJob)
+		emit md->currentMeshChanged(currentMeshId);
+
+	finishJob();
+	startNextJob();
+}
+
+void FilterExecutionEngine::finishJob()
+{
+	current.job.md->setBusy(false);
+	// a failed or canceled job invalidates the jobs queued after it
+	// (e.g. the following steps of a filter script)
+	if (!current.success || current.canceled)
+		pendingJobs.clear();
+	// the step that would have compacted the meshes is not going to run
+	if (deferCompaction && !canDeferCompaction())
+		compactMeshes(*current.job.md);
+	deferCompaction = false;
+	running = false;
+	activeEngine = nullptr;
+	Result res = current;
+	emit jobFinished(res);
+	if (!running)
+		emit runningChanged(false);
+}
+
+/**
+ * @brief Returns true if the compaction of the meshes after the current job
+ * can be left to the next queued job, i.e. the next step of the same script
+ * applies a filter that supports deleted elements.
+ */
+bool FilterExecutionEngine::canDeferCompaction() const
+{
+	if (!current.job.fromScript || pendingJobs.isEmpty())
+		return false;
+	const Job& next = pendingJobs.head();
+	return next.fromScript && next.md == current.job.md && next.plugin != nullptr &&
+		   next.plugin->supportsDeletedElements(next.action);
+}
+
+/**
+ * @brief Compacts the vectors of the meshes of the document that contain
+ * deleted elements; the other meshes are left untouched.
+ */
+void FilterExecutionEngine::compactMeshes(MeshDocument& md)
+{
+	for (MeshModel& mm : md.meshIterator()) {
+		if (mm.hasDeletedElements()) {
+			vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm.cm);
+			md.history().meshChanged(mm.id());
+		}
+	}
+}
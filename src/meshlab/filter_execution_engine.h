@@ -0,0 +1,142 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* Visual and Computer Graphics Library                            o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2004-2021                                           \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef FILTER_EXECUTION_ENGINE_H
+#define FILTER_EXECUTION_ENGINE_H
+
+#include <atomic>
+#include <list>
+#include <map>
+
+#include <QObject>
+#include <QQueue>
+#include <QThread>
+
+#include <common/plugins/interfaces/filter_plugin.h>
+
+/**
+ * @brief The FilterExecutionEngine class runs the filters of a MeshDocument
+ * without freezing the GUI.
+ *
+ * Filters are submitted as jobs and executed one at a time, in submission
+ * order: jobs submitted while another one is running are queued and started
+ * as soon as the running one finishes.
+ *
+ * Previews and the filters that do not declare
+ * FilterPlugin::supportsBackgroundExecution (or that require a GL context)
+ * are executed on the GUI thread, immediately inside submit(). The other jobs
+ * call FilterPlugin::applyFilter on a worker thread: while the job runs the
+ * document is busy, its signals are held back, and the viewers neither draw
+ * it nor update its GPU buffers: they show the frame they drew just before
+ * the job started.
+ *
+ * After each job only the meshes that contain deleted elements are compacted.
+ * When the next queued job is a step of the same script and its filter
+ * supports deleted elements, the compaction is postponed to the end of the
+ * sequence of such steps.
+ *
+ * Cancellation is cooperative: after cancel() is called, the vcg::CallBackPos
+ * passed to the filter returns false, so filters that check the return value
+ * of the callback can stop their computation.
+ */
+class FilterExecutionEngine : public QObject
+{
+	Q_OBJECT
+public:
+	class Job
+	{
+	public:
+		const QAction* action = nullptr;
+		FilterPlugin* plugin = nullptr;
+		MeshDocument* md = nullptr;
+		RichParameterList parameters;        // passed to applyFilter
+		RichParameterList historyParameters; // saved in the filter history
+		bool isPreview = false;
+		bool saveOnHistory = false;
+		bool fromScript = false;
+
+		bool runsOnGUIThread() const;
+	};
+
+	class Result
+	{
+	public:
+		Job job;
+		bool success = false;
+		bool canceled = false;
+		bool badAlloc = false;
+		QString errorMessage;
+		unsigned int postConditionMask = MeshModel::MM_UNKNOWN;
+		std::map<std::string, QVariant> outputValues;
+		qint64 elapsedMsec = 0;
+	};
+
+	FilterExecutionEngine(QObject* parent = nullptr);
+	~FilterExecutionEngine();
+
+	void submit(const Job& job);
+
+	bool isRunning() const;
+	bool isRunningInBackground() const;
+	int queuedJobs() const;
+	bool isCancelRequested() const;
+
+	void cancel();
+	void cancelAndWait();
+
+	static bool callBack(const int pos, const char* str);
+
+signals:
+	/// emitted on the GUI thread just before applyFilter is called
+	void jobAboutToStart(const FilterExecutionEngine::Job& job);
+	/// emitted on the GUI thread after the job has been completed
+	void jobFinished(const FilterExecutionEngine::Result& res);
+	void progressChanged(int pos, const QString& text);
+	void runningChanged(bool running);
+
+private slots:
+	void backgroundJobFinished();
+
+private:
+	void startNextJob();
+	void execute(Result& res);
+	void finishJob();
+	bool canDeferCompaction() const;
+	static void compactMeshes(MeshDocument& md);
+
+	QQueue<Job> pendingJobs;
+	Result current;
+	bool running;
+	QThread* worker;
+	std::list<int> meshIdsBeforeJob;
+	int currentMeshIdBeforeJob;
+	bool deferCompaction;
+	std::atomic<bool> cancelRequested;
+
+	// read by callBack on the worker thread, written on the GUI thread
+	static std::atomic<FilterExecutionEngine*> activeEngine;
+	static std::atomic<qint64> lastProgress; // msecs of the steady clock, -1 if none
+	static qint64 steadyMsecs();
+};
+
+#endif // FILTER_EXECUTION_ENGINE_H
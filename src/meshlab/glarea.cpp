@@ -70,6 +70,7 @@ GLArea::GLArea(QWidget *parent, MultiViewer_Container *mvcont, RichParameterList
     //hasToUpdateTexture=false;
     helpVisible=false;
     takeSnapTile=false;
+    hasToCaptureBusySnapshot=false;
     activeDefaultTrackball=true;
     infoAreaVisible = true;
     trackBallVisible = glas.startupShowTrackball;
@@ -179,6 +180,15 @@ void GLArea::initializeGL()
 	//doneCurrent();
 }
 
+void GLArea::captureBusySnapshot()
+{
+    if (md()->isBusy())
+        return;
+    hasToCaptureBusySnapshot = true;
+    repaint();
+    hasToCaptureBusySnapshot = false;
+}
+
 void GLArea::pasteTile()
 {
 	QString outfile;
@@ -250,10 +260,11 @@ void GLArea::pasteTile()
 
 						RasterModel* rastm = md()->rm();
 						rastm->shot        = shot_tmp;
-						float ratio        = (float) rastm->currentPlane->image.height() /
+						const QSize size   = rastm->currentPlane->imageSize();
+						float ratio        = (float) size.height() /
 									  (float) rastm->shot.Intrinsics.ViewportPx[1];
-						rastm->shot.Intrinsics.ViewportPx[0] = rastm->currentPlane->image.width();
-						rastm->shot.Intrinsics.ViewportPx[1] = rastm->currentPlane->image.height();
+						rastm->shot.Intrinsics.ViewportPx[0] = size.width();
+						rastm->shot.Intrinsics.ViewportPx[1] = size.height();
 						rastm->shot.Intrinsics.PixelSizeMm[1] /= ratio;
 						rastm->shot.Intrinsics.PixelSizeMm[0] /= ratio;
 						rastm->shot.Intrinsics.CenterPx[0] =
@@ -454,8 +465,24 @@ void GLArea::paintEvent(QPaintEvent* /*event*/)
     glDepthMask(GL_TRUE);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+    // while a filter is modifying the document on a worker thread neither the
+    // meshes nor their buffers (that the shared context reads along with the
+    // meshes) are accessed: the frame captured before the filter started is
+    // shown instead, and the document is drawn again when the filter ends
+    const bool drawBusySnapshot = md()->isBusy() && !busySnapshot.isNull();
+    if (drawBusySnapshot)
+    {
+        painter.endNativePainting();
+        painter.drawImage(rect(), busySnapshot);
+        painter.beginNativePainting();
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+    }
+    else if (!md()->isBusy())
+        busySnapshot = QImage();
+
     setView();  // Set Modelview and Projection matrix
-    if((!takeSnapTile) || (takeSnapTile && (ss.background==0)) )
+    if(!drawBusySnapshot && ((!takeSnapTile) || (takeSnapTile && (ss.background==0))))
         drawGradient();  // draws the background
 
     drawLight();
@@ -566,13 +593,24 @@ void GLArea::paintEvent(QPaintEvent* /*event*/)
 
     glPopMatrix(); // We restore the state to immediately after the trackball (and before the bbox scaling/translating)
 
-    if(trackBallVisible && !takeSnapTile && !(iEdit && !suspendedEditor))
+    // the frame shown while busy has the document, but not the trackball
+    if (hasToCaptureBusySnapshot)
+    {
+        busySnapshot = grabFrameBuffer();
+        hasToCaptureBusySnapshot = false;
+    }
+
+    // the snapshot cannot follow the trackball: it is not drawn while busy
+    if(trackBallVisible && !takeSnapTile && !(iEdit && !suspendedEditor) && !drawBusySnapshot)
         trackball.DrawPostApply();
 
-    foreach(QAction * p, iPerDocDecoratorlist)
+    if(!this->md()->isBusy())
     {
-        DecoratePlugin * decorInterface = qobject_cast<DecoratePlugin *>(p->parent());
-        decorInterface->decorateDoc(p, *this->md(), this->glas.currentGlobalParamSet, this, &painter, md()->Log);
+        foreach(QAction * p, iPerDocDecoratorlist)
+        {
+            DecoratePlugin * decorInterface = qobject_cast<DecoratePlugin *>(p->parent());
+            decorInterface->decorateDoc(p, *this->md(), this->glas.currentGlobalParamSet, this, &painter, md()->Log);
+        }
     }
 
     // The picking of the surface position has to be done in object space,
@@ -613,7 +651,7 @@ void GLArea::paintEvent(QPaintEvent* /*event*/)
 
     glPopMatrix(); // We restore the state to immediately before the trackball
     //If it is a raster viewer draw the image as a texture
-    if (isRaster())
+    if (isRaster() && !md()->isBusy())
     {
         if ((md()->rm() != NULL) && (lastloadedraster != md()->rm()->id()))
             loadRaster(md()->rm()->id());
@@ -662,8 +700,11 @@ void GLArea::paintEvent(QPaintEvent* /*event*/)
     {
         glPushAttrib(GL_ENABLE_BIT);
         glDisable(GL_DEPTH_TEST);
-        renderingFacilityString();
-        displayInfo(&painter);
+        if (!md()->isBusy())
+        {
+            renderingFacilityString();
+            displayInfo(&painter);
+        }
         displayRealTimeLog(&painter);
         updateFps(time.elapsed());
         glPopAttrib();
@@ -1877,11 +1918,8 @@ void GLArea::loadRaster(int id)
 	for(RasterModel& rm: md()->rasterIterator()) {
 		if(rm.id() == id) {
 			this->md()->setCurrentRaster(id);
-			if (rm.currentPlane->image.isNull()) {
-				Logf(0,"Image file %s has not been correctly loaded, a fake image is going to be shown.",rm.currentPlane->fullPathFileName.toUtf8().constData());
-				rm.currentPlane->image.load(":/images/dummy.png");
-			}
-			setTarget(rm.currentPlane->image);
+			// an image that cannot be decoded is replaced by a dummy one by the RasterPager
+			setTarget(rm.currentPlane->image());
 			//load his shot or a default shot
 
 			if (rm.shot.IsValid()) {
@@ -1920,8 +1958,8 @@ void GLArea::drawTarget()
     if(!targetTex) return;
 
     if(this->md()->rm()==0) return;
-    QImage &curImg = this->md()->rm()->currentPlane->image;
-    float imageRatio = float(curImg.width())/float(curImg.height());
+    QSize curImgSize = this->md()->rm()->currentPlane->imageSize();
+    float imageRatio = float(curImgSize.width())/float(curImgSize.height());
     float screenRatio = float(this->width())/float(this->height());
     //set orthogonal view
     glPushMatrix();
@@ -1964,7 +2002,7 @@ void GLArea::drawTarget()
 }
 
 
-void GLArea::setTarget(QImage &image) {
+void GLArea::setTarget(const QImage &image) {
 	makeCurrent();
     if (image.isNull())
         return;
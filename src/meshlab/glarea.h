@@ -178,6 +178,9 @@ public:
     bool isTrackBallVisible()		{return trackBallVisible;}
     bool isDefaultTrackBall()   {return activeDefaultTrackball;}
     void saveSnapshot();
+    /// repaints the viewer and keeps its frame, shown while a filter runs in
+    /// background and the document cannot be drawn
+    void captureBusySnapshot();
     void toggleHelpVisible()      {helpVisible = !helpVisible; update();}
   /*  void setBackFaceCulling(bool enabled);
     void setLight(bool state);
@@ -509,6 +512,9 @@ private:
     QImage snapBuffer;
     bool takeSnapTile;
 
+    QImage busySnapshot;
+    bool hasToCaptureBusySnapshot;
+
     enum AnimMode { AnimNone, AnimSpin, AnimInterp};
     AnimMode animMode;
     int tileCol, tileRow, totalCols, totalRows;   // snapshot: total number of subparts and current subpart rendered
@@ -530,7 +536,7 @@ public:
     void setIsRaster(bool viewMode);
     void loadRaster(int id);
 
-    void setTarget(QImage &image);
+    void setTarget(const QImage &image);
 
 private:
     void drawTarget();
@@ -38,6 +38,7 @@
 #include "dialogs/filter_dock_dialog.h"
 #include "multiViewer_Container.h"
 #include "ml_render_gui.h"
+#include "filter_execution_engine.h"
 
 #include <QDir>
 #include <QMainWindow>
@@ -47,6 +48,7 @@
 #include <QMdiSubWindow>
 #include <QSplitter>
 #include <QProgressBar>
+#include <QPushButton>
 #include <QNetworkAccessManager>
 
 // Note the number of recent files is limited by the number of 
@@ -101,6 +103,24 @@ public:
 
 	bool sendAnonymousData;
 	inline static QString sendAnonymousDataParam() {return "MeshLab::System::sendAnonymousData"; }
+
+	bool undoHistoryEnabled;
+	inline static QString undoHistoryEnabledParam() {return "MeshLab::System::undoHistoryEnabled"; }
+
+	size_t undoHistoryMemory;
+	inline static QString undoHistoryMemoryParam() {return "MeshLab::System::undoHistoryMemory"; }
+
+	size_t undoHistoryDiskCache;
+	inline static QString undoHistoryDiskCacheParam() {return "MeshLab::System::undoHistoryDiskCache"; }
+
+	size_t textureCacheMemory;
+	inline static QString textureCacheMemoryParam() {return "MeshLab::System::textureCacheMemory"; }
+
+	size_t rasterMemory;
+	inline static QString rasterMemoryParam() {return "MeshLab::System::rasterMemory"; }
+
+	int rasterLowResolutionSize;
+	inline static QString rasterLowResolutionSizeParam() {return "MeshLab::System::rasterLowResolutionSize"; }
 };
 
 class MainWindow : public QMainWindow
@@ -153,6 +173,7 @@ public slots:
 
 private:
 	void updateRenderingDataAccordingToActionsCommonCode(int meshid, const QList<MLRenderingAction*>& acts);
+	void updateOutdatedDocument();
 	void updateRenderingDataAccordingToActionCommonCode(int meshid, MLRenderingAction* act);
 
 private slots:
@@ -161,6 +182,11 @@ private slots:
 	void endEdit();
 	void updateProgressBar(const int pos,const QString& text);
 	void updateTexture(int meshid);
+	void prepareFilterJob(const FilterExecutionEngine::Job& job);
+	void finishFilterJob(const FilterExecutionEngine::Result& res);
+	void updateFilterProgress(const int pos, const QString& text);
+	void filterEngineRunningChanged(bool running);
+	void cancelFilter();
 public:
 
 	bool exportMesh(QString fileName,MeshModel* mod,const bool saveAllPossibleAttributes);
@@ -173,7 +199,7 @@ public:
 
 	unsigned int viewsRequiringRenderingActions(int meshid,MLRenderingAction* act);
 
-	void updateSharedContextDataAfterFilterExecution(int postcondmask,int fclasses,bool& newmeshcreated);
+	void updateSharedContextDataAfterFilterExecution(int postcondmask,int fclasses,bool& newmeshcreated,const QList<MeshModel*>* modifiedmeshes = nullptr);
 	void readViewFromFile(QString const& filename);
 
 private slots:
@@ -188,6 +214,8 @@ private slots:
 	bool saveSnapshot();
 	void changeFileExtension(const QString&);
 	///////////Slot Menu Edit ////////////////////////
+	void undo();
+	void redo();
 	void applyEditMode();
 	void suspendEditMode();
 	///////////Slot Menu Filter ////////////////////////
@@ -282,6 +310,7 @@ private:
 	void addToMenu(QList<QAction *>, QMenu *menu, const char *slot);
 
 	void setCurrentMeshBestTab();
+	void applyHistory(bool undo);
 
 
 	QNetworkAccessManager httpReq;
@@ -291,6 +320,16 @@ private:
 
 	FilterDockDialog* filterDockDialog;
 	static QProgressBar *qb;
+	QPushButton* cancelFilterButton;
+
+	FilterExecutionEngine* filterEngine;
+	QGLWidget* filterGLWidget; // parent of the GL context of the running filter, if any
+	// documents modified by filters completed while they were not the current
+	// one, with the postcondition masks and the classes of those filters
+	QMap<MeshDocument*, QPair<int, int>> outdatedDocuments;
+	// per document, the meshes whose rendering data were not updated because they
+	// contained deleted elements, with the update masks of the skipped steps
+	QMap<MeshDocument*, QMap<int, int>> deferredMeshUpdates;
 
 	QMdiArea *mdiarea;
 	LayerDialog *layerDialog;
@@ -446,6 +485,8 @@ private:
 	QAction* showFilterScriptAct;
 	//QAction* showFilterEditAct;
 	/////////// Actions Menu Edit  /////////////////////
+	QAction* undoAct;
+	QAction* redoAct;
 	QAction* suspendEditModeAct;
 
 	///////////Actions Menu View ////////////////////////
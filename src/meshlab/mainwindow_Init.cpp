@@ -38,6 +38,8 @@
 #include <common/mlapplication.h>
 #include <common/mlexception.h>
 #include <common/globals.h>
+#include <common/ml_document/raster_pager.h>
+#include <common/ml_document/texture_cache.h>
 #include "dialogs/options_dialog.h"
 #include "dialogs/save_snapshot_dialog.h"
 #include "dialogs/congrats_dialog.h"
@@ -47,6 +49,9 @@ QProgressBar *MainWindow::qb;
 
 MainWindow::MainWindow() :
 		filterDockDialog(nullptr),
+		cancelFilterButton(nullptr),
+		filterEngine(nullptr),
+		filterGLWidget(nullptr),
 		searcher(meshlab::actionSearcherInstance()),
 		httpReq(this),
 		gpumeminfo(NULL),
@@ -137,6 +142,17 @@ MainWindow::MainWindow() :
 	qb->setMinimum(0);
 	qb->reset();
 	statusBar()->addPermanentWidget(qb, 0);
+	cancelFilterButton = new QPushButton(tr("Cancel"), this);
+	cancelFilterButton->setToolTip(tr("Stop the running filter and drop the queued ones"));
+	cancelFilterButton->setVisible(false);
+	statusBar()->addPermanentWidget(cancelFilterButton, 0);
+	connect(cancelFilterButton, SIGNAL(clicked()), this, SLOT(cancelFilter()));
+
+	filterEngine = new FilterExecutionEngine(this);
+	connect(filterEngine, &FilterExecutionEngine::jobAboutToStart, this, &MainWindow::prepareFilterJob);
+	connect(filterEngine, &FilterExecutionEngine::jobFinished, this, &MainWindow::finishFilterJob);
+	connect(filterEngine, &FilterExecutionEngine::progressChanged, this, &MainWindow::updateFilterProgress);
+	connect(filterEngine, &FilterExecutionEngine::runningChanged, this, &MainWindow::filterEngineRunningChanged);
 
 	nvgpumeminfo = new QProgressBar(this);
     nvgpumeminfo->setStyleSheet(" QProgressBar { background-color: #d0d0d0; border: 2px solid grey; border-radius: 0px; text-align: center; }"
@@ -151,6 +167,8 @@ MainWindow::MainWindow() :
 
 MainWindow::~MainWindow()
 {
+	// the running filter must not outlive the documents it is working on
+	filterEngine->cancelAndWait();
 	delete gpumeminfo;
 }
 
@@ -315,6 +333,16 @@ connectRenderModeActionList(rendlist);*/
 	connect(showRasterAct, SIGNAL(triggered()), this, SLOT(showRaster()));
 
 	//////////////Action Menu EDIT /////////////////////////////////////////////////////////////////////////
+	undoAct = new QAction(tr("&Undo"), this);
+	undoAct->setShortcut(QKeySequence::Undo);
+	undoAct->setEnabled(false);
+	connect(undoAct, SIGNAL(triggered()), this, SLOT(undo()));
+
+	redoAct = new QAction(tr("&Redo"), this);
+	redoAct->setShortcut(QKeySequence::Redo);
+	redoAct->setEnabled(false);
+	connect(redoAct, SIGNAL(triggered()), this, SLOT(redo()));
+
 	suspendEditModeAct = new QAction(QIcon(":/images/no_edit.png"), tr("Not editing"), this);
 	suspendEditModeAct->setShortcut(Qt::Key_Escape);
 	suspendEditModeAct->setCheckable(true);
@@ -858,6 +886,9 @@ void MainWindow::fillShadersMenu()
 void MainWindow::fillEditMenu()
 {
 	clearMenu(editMenu);
+	editMenu->addAction(undoAct);
+	editMenu->addAction(redoAct);
+	editMenu->addSeparator();
 	editMenu->addAction(suspendEditModeAct);
 	for(EditPlugin *iEditFactory: PM.editPluginFactoryIterator())
 	{
@@ -874,7 +905,7 @@ void MainWindow::clearMenu(QMenu* menu)
 	for (QAction *action : menu->actions()) {
 		if (action->menu()) {
 			clearMenu(action->menu());
-		} else if (!action->isSeparator() && !(action==suspendEditModeAct)){
+		} else if (!action->isSeparator() && !(action==suspendEditModeAct) && !(action==undoAct) && !(action==redoAct)){
 			disconnect(action, SIGNAL(triggered()), 0, 0);
 		}
 	}
@@ -1281,6 +1312,12 @@ void MainWindowSetting::initGlobalParameterList(RichParameterList& gbllist)
 	gbllist.addParam(RichString(meshSetNameParam(), "ms", "Name of the MeshSet object.", "Set the MeshSet name object in the PyMeshLab call copied in the clipboard from the filter dock dialog."));
 	gbllist.addParam(RichBool(checkForUpdateParam(), true, "Automatic online check for updated version of MeshLab", "If true, MeshLab periodically will check online if a new version has been released"));
 	gbllist.addParam(RichBool(sendAnonymousDataParam(), true, "Send anonymous and aggregate statistics", "If true, MeshLab periodically will send a few aggregated statistic of usage (number of opened and saved mesh and total number of vertices loaded)"));
+	gbllist.addParam(RichBool(undoHistoryEnabledParam(), true, "Undo History", "If true, the parts of the meshes changed by each filter are saved, so that the filter can be undone. Disable it to apply the filters without the time and memory spent to save the meshes."));
+	gbllist.addParam(RichInt(undoHistoryMemoryParam(), 512, "Undo History Memory (in MB)", "The maximum quantity of memory used to store the undo history of each project. When it is exceeded, the oldest steps are moved in the disk cache."));
+	gbllist.addParam(RichInt(undoHistoryDiskCacheParam(), 2048, "Undo History Disk Cache (in MB)", "The maximum quantity of disk space used to store the undo history of each project. When it is exceeded, the oldest steps are discarded."));
+	gbllist.addParam(RichInt(textureCacheMemoryParam(), 1024, "Texture Cache Memory (in MB)", "The maximum quantity of memory used to keep the decoded texture images, shared by all the meshes that use them. When it is exceeded, the least recently loaded images are released. 0 disables the cache."));
+	gbllist.addParam(RichInt(rasterMemoryParam(), 2048, "Raster Memory (in MB)", "The maximum quantity of memory used to keep the decoded images of the rasters of a project. The images are decoded when first used; when it is exceeded, the images of the least recently used rasters are released, and decoded again if needed."));
+	gbllist.addParam(RichInt(rasterLowResolutionSizeParam(), 1024, "Raster Low Resolution Size (px)", "The size of the larger side of the downsampled copy of the raster images, used when the full resolution is not needed. 0 disables the downsampled copies."));
 }
 
 void MainWindowSetting::updateGlobalParameterList(const RichParameterList& rpl)
@@ -1297,6 +1334,15 @@ void MainWindowSetting::updateGlobalParameterList(const RichParameterList& rpl)
 	meshSetName = rpl.getString(meshSetNameParam());
 	checkForUpdate = rpl.getBool(checkForUpdateParam());
 	sendAnonymousData = rpl.getBool(sendAnonymousDataParam());
+	undoHistoryEnabled = rpl.getBool(undoHistoryEnabledParam());
+	undoHistoryMemory = (size_t) rpl.getInt(undoHistoryMemoryParam()) * (1024 * 1024);
+	undoHistoryDiskCache = (size_t) rpl.getInt(undoHistoryDiskCacheParam()) * (1024 * 1024);
+	textureCacheMemory = (size_t) rpl.getInt(textureCacheMemoryParam()) * (1024 * 1024);
+	TextureCache::instance().setMemoryBudget(textureCacheMemory);
+	rasterMemory = (size_t) rpl.getInt(rasterMemoryParam()) * (1024 * 1024);
+	RasterPager::instance().setMemoryBudget(rasterMemory);
+	rasterLowResolutionSize = rpl.getInt(rasterLowResolutionSizeParam());
+	RasterPager::instance().setLowResolutionSize(rasterLowResolutionSize);
 }
 
 void MainWindow::defaultPerViewRenderingData(MLRenderingData& dt) const
@@ -310,21 +310,26 @@ void MainWindow::updateMenus()
 	
 	bool activeDoc = !(mdiarea->subWindowList().empty()) && (mdiarea->currentSubWindow() != NULL);
 	bool notEmptyActiveDoc = activeDoc && (meshDoc() != NULL) && !(meshDoc()->meshNumber() == 0);
+	// while a filter runs in background, the document cannot be loaded, saved or closed
+	bool busyDoc = (filterEngine != nullptr) && filterEngine->isRunningInBackground();
 	
 	//std::cout << "SubWindowsList empty: " << mdiarea->subWindowList().empty() << " Valid Current Sub Windows: " << (mdiarea->currentSubWindow() != NULL) << " MeshList empty: " << meshDoc()->meshList.empty() << "\n";
 	
-	importMeshAct->setEnabled(activeDoc);
+	importMeshAct->setEnabled(activeDoc && !busyDoc);
 	
-	exportMeshAct->setEnabled(notEmptyActiveDoc);
-	exportMeshAsAct->setEnabled(notEmptyActiveDoc);
-	reloadMeshAct->setEnabled(notEmptyActiveDoc);
-	reloadAllMeshAct->setEnabled(notEmptyActiveDoc);
-	importRasterAct->setEnabled(activeDoc);
+	exportMeshAct->setEnabled(notEmptyActiveDoc && !busyDoc);
+	exportMeshAsAct->setEnabled(notEmptyActiveDoc && !busyDoc);
+	reloadMeshAct->setEnabled(notEmptyActiveDoc && !busyDoc);
+	reloadAllMeshAct->setEnabled(notEmptyActiveDoc && !busyDoc);
+	importRasterAct->setEnabled(activeDoc && !busyDoc);
 	
-	saveProjectAct->setEnabled(activeDoc);
-	closeProjectAct->setEnabled(activeDoc);
+	saveProjectAct->setEnabled(activeDoc && !busyDoc);
+	closeProjectAct->setEnabled(activeDoc && !busyDoc);
 	
 	saveSnapshotAct->setEnabled(activeDoc);
+	// the layers cannot be changed while a filter works on them
+	if (layerDialog != NULL)
+		layerDialog->setEnabled(!busyDoc);
 	
 	updateRecentFileActions();
 	updateRecentProjActions();
@@ -363,7 +368,7 @@ void MainWindow::updateMenus()
 		for (EditPlugin* ep : PM.editPluginFactoryIterator())
 			for (QAction* a : ep->actions()) {
 				a->setChecked(false);
-				a->setEnabled(GLA()->getCurrentEditAction() == nullptr);
+				a->setEnabled(GLA()->getCurrentEditAction() == nullptr && !busyDoc);
 		}
 		
 		suspendEditModeAct->setChecked(GLA()->suspendedEditor);
@@ -409,6 +414,14 @@ void MainWindow::updateMenus()
 			}
 		}
 	}
+	// the history cannot be changed while a filter or an edit tool are working on the meshes
+	bool historyAvailable = activeDoc && (meshDoc() != NULL) && (filterEngine == nullptr || !filterEngine->isRunning()) &&
+			(GLA() == NULL || GLA()->getCurrentEditAction() == NULL);
+	undoAct->setEnabled(historyAvailable && meshDoc()->history().canUndo());
+	redoAct->setEnabled(historyAvailable && meshDoc()->history().canRedo());
+	undoAct->setText(undoAct->isEnabled() ? tr("&Undo %1").arg(meshDoc()->history().undoLabel()) : tr("&Undo"));
+	redoAct->setText(redoAct->isEnabled() ? tr("&Redo %1").arg(meshDoc()->history().redoLabel()) : tr("&Redo"));
+
 	GLArea* tmp = GLA();
 	if(tmp != NULL)
 	{
@@ -641,6 +654,8 @@ void MainWindow::endEdit()
 		addRenderingDataIfNewlyGeneratedMesh(mm.id());
 	}
 	meshDoc()->meshDocStateData().clear();
+	// the edit tools are not recorded by the undo history
+	meshDoc()->history().documentChanged();
 	
 	GLA()->endEdit();
 	updateLayerDialog();
@@ -669,112 +684,34 @@ void MainWindow::runFilterScript()
 {
 	if (meshDoc() == nullptr)
 		return;
-	QString filterName;
-	try {
-		for (FilterNameParameterValuesPair& pair : meshDoc()->filterHistory)
-		{
-			filterName = pair.filterName();
-			int classes = 0;
-			unsigned int postCondMask = MeshModel::MM_UNKNOWN;
-			QAction *action = PM.filterAction(filterName);
-			FilterPlugin *iFilter = qobject_cast<FilterPlugin *>(action->parent());
-
-			int req=iFilter->getRequirements(action);
-			if (meshDoc()->mm() != NULL)
-				meshDoc()->mm()->updateDataMask(req);
-			iFilter->setLog(&meshDoc()->Log);
-
-			bool created = false;
-			MLSceneGLSharedDataContext* shar = NULL;
-			if (currentViewContainer() != NULL)
-			{
-				shar = currentViewContainer()->sharedDataContext();
-				//GLA() is only the parent
-				QGLWidget* filterWidget = new QGLWidget(GLA(),shar);
-				QGLFormat defForm = QGLFormat::defaultFormat();
-				iFilter->glContext = new MLPluginGLContext(defForm,filterWidget->context()->device(),*shar);
-				created = iFilter->glContext->create(filterWidget->context());
-				shar->addView(iFilter->glContext);
-				MLRenderingData dt;
-				MLRenderingData::RendAtts atts;
-				atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION] = true;
-				atts[MLRenderingData::ATT_NAMES::ATT_VERTNORMAL] = true;
-
-
-				if (iFilter->filterArity(action) == FilterPlugin::SINGLE_MESH) {
-					MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(meshDoc()->mm());
-					if ((pm != MLRenderingData::PR_ARITY) && (meshDoc()->mm() != nullptr)) {
-						dt.set(pm,atts);
-						shar->setRenderingDataPerMeshView(meshDoc()->mm()->id(),iFilter->glContext,dt);
-					}
-				}
-				else {
-					for(const MeshModel& mm : meshDoc()->meshIterator()) {
-						MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(&mm);
-						if ((pm != MLRenderingData::PR_ARITY)) {
-							dt.set(pm,atts);
-							shar->setRenderingDataPerMeshView(mm.id(),iFilter->glContext,dt);
-						}
-					}
-				}
-
-			}
-			if ((!created) || (!iFilter->glContext->isValid()))
-				throw MLException("A valid GLContext is required by the filter to work.\n");
-			meshDoc()->setBusy(true);
-			iFilter->applyFilter(action, pair.second, *meshDoc(), postCondMask, QCallBack);
-			if (postCondMask == MeshModel::MM_UNKNOWN)
-				postCondMask = iFilter->postCondition(action);
-			for (MeshModel* mm = meshDoc()->nextMesh(); mm != NULL; mm = meshDoc()->nextMesh(mm))
-				vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm->cm);
-			meshDoc()->setBusy(false);
-			if (shar != NULL)
-				shar->removeView(iFilter->glContext);
-			delete iFilter->glContext;
-			classes = int(iFilter->getClass(action));
-
-			if (meshDoc()->mm() != NULL)
-			{
-				if(classes & FilterPlugin::FaceColoring )
-				{
-					meshDoc()->mm()->updateDataMask(MeshModel::MM_FACECOLOR);
-				}
-				if(classes & FilterPlugin::VertexColoring )
-				{
-					meshDoc()->mm()->updateDataMask(MeshModel::MM_VERTCOLOR);
-				}
-				if(classes & MeshModel::MM_COLOR)
-				{
-					meshDoc()->mm()->updateDataMask(MeshModel::MM_COLOR);
-				}
-				if(classes & MeshModel::MM_CAMERA)
-					meshDoc()->mm()->updateDataMask(MeshModel::MM_CAMERA);
-			}
-
-			bool newmeshcreated = false;
-			if (classes & FilterPlugin::MeshCreation)
-				newmeshcreated = true;
-			updateSharedContextDataAfterFilterExecution(postCondMask, classes, newmeshcreated);
-			meshDoc()->meshDocStateData().clear();
-
-			if(classes & FilterPlugin::MeshCreation)
-				GLA()->resetTrackBall();
-			/* to be changed */
+	if (GLA() != nullptr && GLA()->getCurrentEditAction() != nullptr)
+		endEdit();
 
-			qb->reset();
-			GLA()->update();
-			GLA()->Logf(GLLogStream::SYSTEM,"Re-Applied filter %s",qUtf8Printable(pair.filterName()));
-			if (_currviewcontainer != NULL)
-				_currviewcontainer->updateAllDecoratorsForAllViewers();
+	// all the steps of the script are queued in the filter engine: each step
+	// starts when the previous one has been completed, and a failure (or a
+	// cancellation) drops the remaining steps
+	std::list<FilterExecutionEngine::Job> jobs;
+	for (FilterNameParameterValuesPair& pair : meshDoc()->filterHistory)
+	{
+		QAction *action = PM.filterAction(pair.filterName());
+		if (action == nullptr) {
+			QMessageBox::warning(
+					this,
+					tr("Filter Failure"),
+					"Unknown filter <font color=red>: '" + pair.filterName() + "'</font><br><br>The script has not been applied.");
+			return;
 		}
+		FilterExecutionEngine::Job job;
+		job.action = action;
+		job.plugin = qobject_cast<FilterPlugin *>(action->parent());
+		job.md = meshDoc();
+		job.parameters = pair.second;
+		job.historyParameters = pair.second;
+		job.fromScript = true;
+		jobs.push_back(job);
 	}
-	catch(const MLException& exc){
-		QMessageBox::warning(
-				this,
-				tr("Filter Failure"),
-				"Failure of filter <font color=red>: '" + filterName + "'</font><br><br>" + exc.what());
-		meshDoc()->Log.log(GLLogStream::SYSTEM, filterName + " failed: " + exc.what());
-	}
+	for (const FilterExecutionEngine::Job& job : jobs)
+		filterEngine->submit(job);
 }
 
 // Receives the action that wants to show a tooltip and display it
@@ -797,6 +734,12 @@ void MainWindow::startFilter(const QAction* action)
 {
 	if(currentViewContainer() == NULL) return;
 	if(GLA() == NULL) return;
+	if (filterEngine->isRunning()) {
+		// the parameters of a filter are initialized on the current state of
+		// the document, that is being modified by the running filter
+		MainWindow::globalStatusBar()->showMessage("Wait for the running filter to finish, or cancel it...",3000);
+		return;
+	}
 	
 	// In order to avoid that a filter changes something assumed by the current editing tool,
 	// before actually starting the filter we close the current editing tool (if any).
@@ -864,7 +807,13 @@ void MainWindow::closeFilterDockDialog()
 }
 
 
-void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,int fclasses,bool& newmeshcreated)
+/*
+updates the GPU buffers of the meshes changed by a filter. postcondmask and fclasses
+describe the changes of the meshes in modifiedmeshes (all the meshes when it is null);
+the buffers of the other meshes are invalidated only if the meshes have been
+apparently changed anyway (different data mask, element counts, bbox or matrix).
+*/
+void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,int fclasses,bool& newmeshcreated,const QList<MeshModel*>* modifiedmeshes)
 {
 	MultiViewer_Container* mvc = currentViewContainer();
 	if ((meshDoc() != NULL) && (mvc != NULL))
@@ -874,10 +823,27 @@ void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,in
 		MLSceneGLSharedDataContext* shared = mvc->sharedDataContext();
 		if (shared != NULL)
 		{
+			const int declaredpostcondmask = postcondmask;
+			MeshDocument* md = meshDoc();
+			if (!deferredMeshUpdates.contains(md))
+				connect(md, &QObject::destroyed, this, [this, md]() { deferredMeshUpdates.remove(md); });
+			QMap<int, int>& deferredmasks = deferredMeshUpdates[md];
 			for(MeshModel* mm = meshDoc()->nextMesh();mm != NULL;mm = meshDoc()->nextMesh(mm))
 			{
 				if (mm == NULL)
 					continue;
+				QMap<int,MeshModelStateData>::Iterator existit = meshDoc()->meshDocStateData().find(mm->id());
+				const bool declared = (modifiedmeshes == nullptr) || modifiedmeshes->contains(mm);
+				const bool deferred = deferredmasks.contains(mm->id());
+				if (!declared && !deferred && existit != meshDoc()->meshDocStateData().end())
+				{
+					if ((existit->_mask == mm->dataMask()) &&
+						((unsigned int)mm->cm.VN() == existit->_nvert) && ((unsigned int)mm->cm.FN() == existit->_nface) &&
+						((unsigned int)mm->cm.EN() == existit->_nedge) &&
+						(existit->_bbox == mm->cm.bbox) && (existit->_tr == mm->cm.Tr))
+						continue;
+				}
+				postcondmask = declared ? declaredpostcondmask : MeshModel::MM_NONE;
 				//Just to be sure that the filter author didn't forget to add changing tags to the postCondition field
 				if ((mm->hasDataMask(MeshModel::MM_FACECOLOR)) && (fclasses & FilterPlugin::FaceColoring ))
 					postcondmask = postcondmask | MeshModel::MM_FACECOLOR;
@@ -894,8 +860,20 @@ void MainWindow::updateSharedContextDataAfterFilterExecution(int postcondmask,in
 				if ((mm->hasDataMask(MeshModel::MM_VERTQUALITY)) && (fclasses & FilterPlugin::Quality ))
 					postcondmask = postcondmask | MeshModel::MM_VERTQUALITY;
 
+				//a step of a script left deleted elements to be compacted by the next one:
+				//the buffers will be updated once, after the compaction, with the changes of all the skipped steps
+				if (mm->hasDeletedElements())
+				{
+					if (existit != meshDoc()->meshDocStateData().end())
+						postcondmask |= existit->_mask ^ mm->dataMask();
+					deferredmasks[mm->id()] |= postcondmask;
+					continue;
+				}
+				//the compaction renumbered the vertices and the faces
+				if (deferred)
+					postcondmask |= deferredmasks.take(mm->id()) | MeshModel::MM_VERTNUMBER | MeshModel::MM_FACENUMBER;
+
 				MLRenderingData dttoberendered;
-				QMap<int,MeshModelStateData>::Iterator existit = meshDoc()->meshDocStateData().find(mm->id());
 				if (existit != meshDoc()->meshDocStateData().end())
 				{
 					shared->getRenderInfoPerMeshView(mm->id(),GLA()->context(),dttoberendered);
@@ -1018,56 +996,122 @@ from the user defined dialog
 void MainWindow::executeFilter(
 	const QAction* action, const RichParameterList& params, bool isPreview, bool saveOnHistory)
 {
-	FilterPlugin *iFilter = qobject_cast<FilterPlugin *>(action->parent());
+	if (meshDoc() == nullptr)
+		return;
+	if (isPreview && filterEngine->isRunning()) {
+		// a preview is computed on the current state of the mesh, that is
+		// being modified by the running filter
+		MainWindow::globalStatusBar()->showMessage("Preview not available while a filter is running...",2000);
+		return;
+	}
+
+	FilterExecutionEngine::Job job;
+	job.action = action;
+	job.plugin = qobject_cast<FilterPlugin *>(action->parent());
+	job.md = meshDoc();
+	job.parameters = params;
+	job.parameters.join(currentGlobalParams);
+	job.historyParameters = params;
+	job.isPreview = isPreview;
+	job.saveOnHistory = saveOnHistory;
+
+	if (filterEngine->isRunning())
+		MainWindow::globalStatusBar()->showMessage("Filter " + action->text() + " queued...",2000);
+	filterEngine->submit(job);
+}
+
+/*
+called by the filter engine on the GUI thread, just before the filter of the
+job is applied: satisfies the filter requirements and, if the filter needs it,
+sets up the GL context.
+*/
+void MainWindow::prepareFilterJob(const FilterExecutionEngine::Job& job)
+{
+	FilterPlugin *iFilter = job.plugin;
+	const QAction* action = job.action;
+	MeshDocument* md = job.md;
 	qb->show();
-	iFilter->setLog(&meshDoc()->Log);
-	
+	iFilter->setLog(&md->Log);
+
 	// Ask for filter requirements (eg a filter can need topology, border flags etc)
 	// and satisfy them
 	qApp->setOverrideCursor(QCursor(Qt::WaitCursor));
 	MainWindow::globalStatusBar()->showMessage("Starting Filter...",5000);
 	int req=iFilter->getRequirements(action);
-	if (!(meshDoc()->meshNumber() == 0))
-		meshDoc()->mm()->updateDataMask(req);
+	if (!(md->meshNumber() == 0))
+		md->mm()->updateDataMask(req);
 	qApp->restoreOverrideCursor();
-	
+
 	// (3) save the current filter and its parameters in the history
-	if(!isPreview)
-		meshDoc()->Log.clearBookmark();
-	else
-		meshDoc()->Log.backToBookmark();
+	if (!job.fromScript) {
+		if(!job.isPreview)
+			md->Log.clearBookmark();
+		else
+			md->Log.backToBookmark();
+	}
+
+	// save in the undo history the attributes of the meshes that the filter declares to change
+	if (!job.isPreview) {
+		std::vector<int> meshIds;
+		switch(iFilter->filterArity(action))
+		{
+		case (FilterPlugin::SINGLE_MESH):
+			if (md->mm() != NULL)
+				meshIds.push_back(md->mm()->id());
+			break;
+		case (FilterPlugin::FIXED):
+			for(const RichParameter& p : job.parameters)
+				if (p.isOfType<RichMesh>())
+					meshIds.push_back(p.value().getInt());
+			break;
+		case (FilterPlugin::VARIABLE):
+			for(const MeshModel& mm : md->meshIterator())
+				if (mm.isVisible())
+					meshIds.push_back(mm.id());
+			break;
+		default:
+			break;
+		}
+		md->history().setEnabled(mwsettings.undoHistoryEnabled);
+		md->history().setMemoryBudget(mwsettings.undoHistoryMemory);
+		md->history().setDiskBudget(mwsettings.undoHistoryDiskCache);
+		md->history().beginOperation(action->text(), meshIds, iFilter->postCondition(action));
+	}
+
 	// (4) Apply the Filter
-	qApp->setOverrideCursor(QCursor(Qt::WaitCursor));
-	QElapsedTimer tt; tt.start();
-	meshDoc()->setBusy(true);
-	RichParameterList mergedenvironment(params);
-	mergedenvironment.join(currentGlobalParams);
-	
-	MLSceneGLSharedDataContext* shar = NULL;
-	QGLWidget* filterWidget = NULL;
-	if (currentViewContainer() != NULL)
+	MultiViewer_Container* mvc = currentViewContainer();
+	if (job.runsOnGUIThread())
+		qApp->setOverrideCursor(QCursor(Qt::WaitCursor));
+	else if (mvc != nullptr && &mvc->meshDoc == md)
 	{
-		shar = currentViewContainer()->sharedDataContext();
+		// the viewers show their last frame until the filter ends
+		for (GLArea* gla : mvc->viewerList)
+			gla->captureBusySnapshot();
+	}
+
+	if (iFilter->requiresGLContext(action) && mvc != nullptr && &mvc->meshDoc == md)
+	{
+		MLSceneGLSharedDataContext* shar = mvc->sharedDataContext();
 		//GLA() is only the parent
-		filterWidget = new QGLWidget(NULL,shar);
+		filterGLWidget = new QGLWidget(NULL,shar);
 		QGLFormat defForm = QGLFormat::defaultFormat();
-		iFilter->glContext = new MLPluginGLContext(defForm,filterWidget->context()->device(),*shar);
-		iFilter->glContext->create(filterWidget->context());
-		
+		iFilter->glContext = new MLPluginGLContext(defForm,filterGLWidget->context()->device(),*shar);
+		iFilter->glContext->create(filterGLWidget->context());
+
 		MLRenderingData dt;
 		MLRenderingData::RendAtts atts;
 		atts[MLRenderingData::ATT_NAMES::ATT_VERTPOSITION] = true;
 		atts[MLRenderingData::ATT_NAMES::ATT_VERTNORMAL] = true;
-		
+
 		if (iFilter->filterArity(action) == FilterPlugin::SINGLE_MESH) {
-			MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(meshDoc()->mm());
-			if ((pm != MLRenderingData::PR_ARITY) && (meshDoc()->mm() != NULL)) {
+			MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(md->mm());
+			if ((pm != MLRenderingData::PR_ARITY) && (md->mm() != NULL)) {
 				dt.set(pm,atts);
-				iFilter->glContext->initPerViewRenderingData(meshDoc()->mm()->id(),dt);
+				iFilter->glContext->initPerViewRenderingData(md->mm()->id(),dt);
 			}
 		}
 		else {
-			for(const MeshModel& mm : meshDoc()->meshIterator()) {
+			for(const MeshModel& mm : md->meshIterator()) {
 				MLRenderingData::PRIMITIVE_MODALITY pm = MLPoliciesStandAloneFunctions::bestPrimitiveModalityAccordingToMesh(&mm);
 				if (pm != MLRenderingData::PR_ARITY) {
 					dt.set(pm,atts);
@@ -1076,56 +1120,116 @@ void MainWindow::executeFilter(
 			}
 		}
 	}
-	bool newmeshcreated = false;
-	try {
-		meshDoc()->meshDocStateData().clear();
-		meshDoc()->meshDocStateData().create(*meshDoc());
-		unsigned int postCondMask = MeshModel::MM_UNKNOWN;
-		iFilter->applyFilter(action, mergedenvironment, *(meshDoc()), postCondMask, QCallBack);
-		if (postCondMask == MeshModel::MM_UNKNOWN)
-			postCondMask = iFilter->postCondition(action);
-		for (MeshModel& mm : meshDoc()->meshIterator())
-			vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm.cm);
-		
-		if (shar != NULL) {
-			shar->removeView(iFilter->glContext);
-			delete filterWidget;
-		}
-		
-		meshDoc()->setBusy(false);
-		
+
+	// the state of an outdated document is kept as it was before the filters
+	// that modified it, until its rendering data are updated
+	if (!outdatedDocuments.contains(md)) {
+		md->meshDocStateData().clear();
+		md->meshDocStateData().create(*md);
+	}
+}
+
+/*
+called by the filter engine on the GUI thread when the filter of the job has
+been completed (or has failed): applies the post filter actions and updates
+the rendering data of the modified meshes.
+*/
+void MainWindow::finishFilterJob(const FilterExecutionEngine::Result& res)
+{
+	const FilterExecutionEngine::Job& job = res.job;
+	FilterPlugin *iFilter = job.plugin;
+	const QAction* action = job.action;
+	MeshDocument* md = job.md;
+
+	if (iFilter->glContext != nullptr) {
+		MultiViewer_Container* mvc = currentViewContainer();
+		if (mvc != nullptr && &mvc->meshDoc == md)
+			mvc->sharedDataContext()->removeView(iFilter->glContext);
+		delete iFilter->glContext;
+		iFilter->glContext = nullptr;
+	}
+	delete filterGLWidget;
+	filterGLWidget = nullptr;
+
+	if (job.runsOnGUIThread())
 		qApp->restoreOverrideCursor();
-		
+
+	// a failed or canceled filter leaves the meshes as they were before it
+	bool reverted = false;
+	if (res.success) {
+		if (!md->history().commitOperation(res.postConditionMask))
+			md->Log.logf(
+				GLLogStream::WARNING,
+				"%s changed parts of the meshes it does not declare: the undo history has been cleared",
+				qUtf8Printable(action->text()));
+	}
+	else
+		reverted = md->history().rollbackOperation();
+	if (reverted) {
+		// the restored state can contain the deleted elements left by the previous step of a script
+		for (MeshModel& mm : md->meshIterator()) {
+			if (mm.hasDeletedElements()) {
+				vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm.cm);
+				md->history().meshChanged(mm.id());
+			}
+		}
+	}
+
+	// the user may have switched to another project while the filter was running
+	// in background: the rendering data of that project are updated when it is
+	// activated again (see updateOutdatedDocument)
+	if ((res.success || reverted) && md != meshDoc()) {
+		if (!outdatedDocuments.contains(md))
+			connect(md, &QObject::destroyed, this, [this, md]() { outdatedDocuments.remove(md); });
+		QPair<int, int>& changes = outdatedDocuments[md];
+		changes.first |= res.success ? int(res.postConditionMask) : int(iFilter->postCondition(action));
+		if (res.success)
+			changes.second |= iFilter->getClass(action);
+	}
+	// the changes of the filters completed while the current document was not
+	// the current one (e.g. activated while this filter was running)
+	bool outdated = false;
+	QPair<int, int> outdatedChanges(0, 0);
+	if (md == meshDoc() && outdatedDocuments.contains(md)) {
+		outdated = true;
+		outdatedChanges = outdatedDocuments.take(md);
+	}
+
+	bool newmeshcreated = false;
+	if (res.success && md == meshDoc())
+	{
 		// (5) Apply post filter actions (e.g. recompute non updated stuff if needed)
-		
-		meshDoc()->Log.logf(GLLogStream::SYSTEM,"Applied filter %s in %i msec",qUtf8Printable(action->text()),tt.elapsed());
-		if (meshDoc()->mm() != NULL)
-			meshDoc()->mm()->setMeshModified();
-		MainWindow::globalStatusBar()->showMessage("Filter successfully completed...",2000);
-		if(GLA()) {
-			GLA()->setLastAppliedFilter(action);
+		if (job.fromScript) {
+			md->Log.logf(GLLogStream::SYSTEM,"Re-Applied filter %s",qUtf8Printable(action->text()));
+		}
+		else {
+			md->Log.logf(GLLogStream::SYSTEM,"Applied filter %s in %i msec",qUtf8Printable(action->text()),int(res.elapsedMsec));
+			if (md->mm() != NULL)
+				md->mm()->setMeshModified();
+			MainWindow::globalStatusBar()->showMessage("Filter successfully completed...",2000);
+			if(GLA()) {
+				GLA()->setLastAppliedFilter(action);
+			}
+			lastFilterAct->setText(QString("Apply filter ") + action->text());
+			lastFilterAct->setEnabled(true);
 		}
-		lastFilterAct->setText(QString("Apply filter ") + action->text());
-		lastFilterAct->setEnabled(true);
 
-		
-		
 		FilterPlugin::FilterArity arity = iFilter->filterArity(action);
 		QList<MeshModel*> tmp;
 		switch(arity)
 		{
 		case (FilterPlugin::SINGLE_MESH):
 		{
-			tmp.push_back(meshDoc()->mm());
+			tmp.push_back(md->mm());
 			break;
 		}
 		case (FilterPlugin::FIXED):
 		{
-			for(const RichParameter& p : mergedenvironment)
+			for(const RichParameter& p : job.parameters)
 			{
 				if (p.isOfType<RichMesh>())
 				{
-					MeshModel* mm = meshDoc()->getMesh(p.value().getInt());
+					MeshModel* mm = md->getMesh(p.value().getInt());
 					if (mm != NULL)
 						tmp.push_back(mm);
 				}
@@ -1134,7 +1238,7 @@ void MainWindow::executeFilter(
 		}
 		case (FilterPlugin::VARIABLE):
 		{
-			for(MeshModel* mm = meshDoc()->nextMesh();mm != NULL;mm=meshDoc()->nextMesh(mm))
+			for(MeshModel* mm = md->nextMesh();mm != NULL;mm=md->nextMesh(mm))
 			{
 				if (mm->isVisible())
 					tmp.push_back(mm);
@@ -1144,67 +1248,80 @@ void MainWindow::executeFilter(
 		default:
 			break;
 		}
-		
-		if(iFilter->getClass(action) & FilterPlugin::MeshCreation )
+
+		if((iFilter->getClass(action) & FilterPlugin::MeshCreation) && GLA())
 			GLA()->resetTrackBall();
-		
+
 		for(int jj = 0;jj < tmp.size();++jj) {
 			MeshModel* mm = tmp[jj];
 			if (mm != NULL) {
 				// at the end for filters that change the color, or selection set the appropriate rendering mode
 				if(iFilter->getClass(action) & FilterPlugin::FaceColoring )
 					mm->updateDataMask(MeshModel::MM_FACECOLOR);
-				
+
 				if(iFilter->getClass(action) & FilterPlugin::VertexColoring )
 					mm->updateDataMask(MeshModel::MM_VERTCOLOR);
-				
+
 				if(iFilter->getClass(action) & FilterPlugin::MeshColoring )
 					mm->updateDataMask(MeshModel::MM_COLOR);
-				
-				if(postCondMask & MeshModel::MM_CAMERA)
+
+				if(res.postConditionMask & MeshModel::MM_CAMERA)
 					mm->updateDataMask(MeshModel::MM_CAMERA);
-				
+
 				if(iFilter->getClass(action) & FilterPlugin::Texture )
 					updateTexture(mm->id());
 			}
 		}
-		
-		int fclasses =	iFilter->getClass(action);
-		//MLSceneGLSharedDataContext* sharedcont = GLA()->getSceneGLSharedContext();
-		
-		updateSharedContextDataAfterFilterExecution(postCondMask,fclasses,newmeshcreated);
-		meshDoc()->meshDocStateData().clear();
 
-		if (saveOnHistory){
+		int fclasses =	iFilter->getClass(action) | outdatedChanges.second;
+		int postcondmask = res.postConditionMask | outdatedChanges.first;
+		updateSharedContextDataAfterFilterExecution(postcondmask,fclasses,newmeshcreated,outdated ? nullptr : &tmp);
+	}
+	else if (reverted && md == meshDoc()) {
+		updateSharedContextDataAfterFilterExecution(iFilter->postCondition(action) | outdatedChanges.first,outdatedChanges.second,newmeshcreated);
+	}
+	else if (outdated) {
+		updateSharedContextDataAfterFilterExecution(outdatedChanges.first,outdatedChanges.second,newmeshcreated);
+	}
+	if (!outdatedDocuments.contains(md))
+		md->meshDocStateData().clear();
+	if (reverted)
+		md->Log.logf(GLLogStream::SYSTEM,"Reverted the changes of filter %s",qUtf8Printable(action->text()));
+
+	if (res.success) {
+		if (job.saveOnHistory){
 			//Insert the filter to filterHistory
 			FilterNameParameterValuesPair tmp;
 			tmp.first = action->text();
-			tmp.second = params;
-			meshDoc()->filterHistory.append(tmp);
+			tmp.second = job.historyParameters;
+			md->filterHistory.append(tmp);
 		}
+		if (res.canceled)
+			md->Log.logf(GLLogStream::SYSTEM,"Filter %s completed before being canceled",qUtf8Printable(action->text()));
 	}
-	catch (const std::bad_alloc& bdall) {
-		meshDoc()->setBusy(false);
-		qApp->restoreOverrideCursor();
+	else if (res.canceled) {
+		md->Log.logf(GLLogStream::SYSTEM,"Filter %s canceled",qUtf8Printable(action->text()));
+		MainWindow::globalStatusBar()->showMessage("Filter canceled...",2000);
+	}
+	else if (res.badAlloc) {
 		QMessageBox::warning(
 					this, tr("Filter Failure"),
 					QString("Operating system was not able to allocate the requested memory.<br><b>"
-					"Failure of filter <font color=red>: '%1'</font><br>").arg(action->text())+bdall.what()); // text
+					"Failure of filter <font color=red>: '%1'</font><br>").arg(action->text())+res.errorMessage); // text
 		MainWindow::globalStatusBar()->showMessage("Filter failed...",2000);
 	}
-	catch(const MLException& exc){
-		meshDoc()->setBusy(false);
-		qApp->restoreOverrideCursor();
+	else {
 		QMessageBox::warning(
 				this,
 				tr("Filter Failure"),
-				"Failure of filter <font color=red>: '" + iFilter->filterName(action) + "'</font><br><br>" + exc.what());
-		meshDoc()->Log.log(GLLogStream::SYSTEM, iFilter->filterName(action) + " failed: " + exc.what());
+				"Failure of filter <font color=red>: '" + iFilter->filterName(action) + "'</font><br><br>" + res.errorMessage);
+		md->Log.log(GLLogStream::SYSTEM, iFilter->filterName(action) + " failed: " + res.errorMessage);
 		MainWindow::globalStatusBar()->showMessage("Filter failed...",2000);
 	}
 
 	qb->reset();
-	layerDialog->setVisible(layerDialog->isVisible() || ((newmeshcreated) && (meshDoc()->meshNumber() > 0)));
+	if (meshDoc() != nullptr)
+		layerDialog->setVisible(layerDialog->isVisible() || ((newmeshcreated) && (meshDoc()->meshNumber() > 0)));
 	updateLayerDialog();
 	updateMenus();
 	MultiViewer_Container* mvc = currentViewContainer();
@@ -1213,6 +1330,37 @@ void MainWindow::executeFilter(
 		mvc->updateAllDecoratorsForAllViewers();
 		mvc->updateAllViewers();
 	}
+	emit filterExecuted();
+}
+
+void MainWindow::updateFilterProgress(const int pos, const QString& text)
+{
+	if (filterEngine->isRunningInBackground()) {
+		// the GUI thread is free: no need to process the pending events here
+		MainWindow::globalStatusBar()->showMessage(text, 5000);
+		qb->show();
+		qb->setEnabled(true);
+		qb->setValue(pos);
+	}
+	else {
+		QCallBack(pos, qUtf8Printable(text));
+	}
+}
+
+void MainWindow::filterEngineRunningChanged(bool running)
+{
+	cancelFilterButton->setVisible(running);
+	cancelFilterButton->setEnabled(running);
+	updateMenus();
+}
+
+void MainWindow::cancelFilter()
+{
+	if (filterEngine->isRunning()) {
+		filterEngine->cancel();
+		cancelFilterButton->setEnabled(false);
+		MainWindow::globalStatusBar()->showMessage("Canceling filter...",5000);
+	}
 }
 
 // Edit Mode Management
@@ -1223,6 +1371,73 @@ void MainWindow::executeFilter(
 //
 
 
+void MainWindow::undo()
+{
+	applyHistory(true);
+}
+
+void MainWindow::redo()
+{
+	applyHistory(false);
+}
+
+/*
+restores the state of the current document before the last operation (or
+after the last undone one) and updates the rendering data of the meshes.
+*/
+void MainWindow::applyHistory(bool undo)
+{
+	MeshDocument* md = meshDoc();
+	if (md == nullptr || filterEngine->isRunning() || (GLA() != nullptr && GLA()->getCurrentEditAction() != nullptr))
+		return;
+
+	QString label = undo ? md->history().undoLabel() : md->history().redoLabel();
+	qApp->setOverrideCursor(QCursor(Qt::WaitCursor));
+	md->meshDocStateData().clear();
+	md->meshDocStateData().create(*md);
+	int restoredMask = MeshModel::MM_NONE;
+	bool ok = false;
+	try {
+		ok = undo ? md->history().undo(restoredMask) : md->history().redo(restoredMask);
+	}
+	catch (const MLException& e) {
+		md->history().clear();
+		md->Log.log(GLLogStream::WARNING, e.what());
+	}
+	if (ok) {
+		md->Log.logf(GLLogStream::SYSTEM, "%s %s", undo ? "Undo" : "Redo", qUtf8Printable(label));
+		// the restored state can contain the deleted elements left by a step of a
+		// script: compact them, otherwise the rendering data of the mesh would not
+		// be updated, and rebuild its buffers since the element indices changed
+		for (MeshModel& mm : md->meshIterator()) {
+			if (mm.hasDeletedElements()) {
+				vcg::tri::Allocator<CMeshO>::CompactEveryVector(mm.cm);
+				md->history().meshChanged(mm.id());
+				restoredMask |= MeshModel::MM_VERTNUMBER | MeshModel::MM_FACENUMBER | MeshModel::MM_FACEVERT;
+			}
+		}
+		if (md->mm() != NULL)
+			md->mm()->setMeshModified();
+	}
+	else {
+		md->Log.logf(GLLogStream::WARNING, "Unable to %s %s: the undo history has been cleared", undo ? "undo" : "redo", qUtf8Printable(label));
+	}
+
+	bool newmeshcreated = false;
+	updateSharedContextDataAfterFilterExecution(restoredMask, 0, newmeshcreated);
+	md->meshDocStateData().clear();
+	qApp->restoreOverrideCursor();
+
+	updateLayerDialog();
+	updateMenus();
+	MultiViewer_Container* mvc = currentViewContainer();
+	if (mvc)
+	{
+		mvc->updateAllDecoratorsForAllViewers();
+		mvc->updateAllViewers();
+	}
+}
+
 void MainWindow::suspendEditMode()
 {
 	// return if no window is open
@@ -1237,7 +1452,7 @@ void MainWindow::suspendEditMode()
 }
 void MainWindow::applyEditMode()
 {
-	if(!GLA()) { //prevents crash without mesh
+	if(!GLA() || filterEngine->isRunning()) { //prevents crash without mesh, or editing a mesh modified by a filter
 		QAction *action = qobject_cast<QAction *>(sender());
 		action->setChecked(false);
 		return;
@@ -2217,6 +2432,7 @@ void MainWindow::reloadAllMesh()
 				try {
 					meshlab::reloadMesh(fileName, meshList, &meshDoc()->Log, QCallBack);
 					for (MeshModel* m : meshList){
+						md->history().meshChanged(m->id());
 						computeRenderingDataOnLoading(m, true, nullptr);
 					}
 				}
@@ -2268,6 +2484,7 @@ void MainWindow::reload()
 		t.start();
 		meshlab::reloadMesh(fileName, meshList, &meshDoc()->Log, QCallBack);
 		for (MeshModel* m : meshList){
+			meshDoc()->history().meshChanged(m->id());
 			computeRenderingDataOnLoading(m, true, nullptr);
 		}
 		GLA()->Log(0, ("File reloaded in " + std::to_string(t.elapsed()) + " msec.").c_str());
@@ -2827,8 +3044,9 @@ void MainWindow::setRenderingData(int mid,const MLRenderingData& dt)
 	}
 	else
 	{
+		// the buffers are not updated while a filter is modifying the meshes
 		MultiViewer_Container* cont = currentViewContainer();
-		if (cont != NULL)
+		if (cont != NULL && !cont->meshDoc.isBusy())
 		{
 			MLSceneGLSharedDataContext* share = cont->sharedDataContext();
 			if ((share != NULL) && (GLA() != NULL))
@@ -3118,11 +3336,30 @@ void MainWindow::switchCurrentContainer(QMdiSubWindow * subwin)
 	}
 	if (_currviewcontainer != NULL)
 	{
+		updateOutdatedDocument();
 		updateLayerDialog();
 		updateMenus();
 	}
 }
 
+/*
+updates the rendering data of the current document, if some filters have
+modified it while it was not the current one. A document still used by a
+filter is updated when the filter finishes.
+*/
+void MainWindow::updateOutdatedDocument()
+{
+	MeshDocument* md = meshDoc();
+	if (md == NULL || md->isBusy() || !outdatedDocuments.contains(md))
+		return;
+	QPair<int, int> changes = outdatedDocuments.take(md);
+	bool newmeshcreated = false;
+	updateSharedContextDataAfterFilterExecution(changes.first,changes.second,newmeshcreated);
+	md->meshDocStateData().clear();
+	if (GLA())
+		GLA()->update();
+}
+
 void MainWindow::closeCurrentDocument()
 {
 	_currviewcontainer = NULL;
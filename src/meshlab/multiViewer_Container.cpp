@@ -340,6 +340,13 @@ void MultiViewer_Container::updateTrackballInViewers()
 
 void MultiViewer_Container::closeEvent( QCloseEvent *event )
 {
+	if (meshDoc.isBusy())
+	{
+		QMessageBox::information(
+			this, tr("MeshLab"), tr("A filter is running on project '%1'.\n\nCancel it before closing the project.").arg(meshDoc.docLabel()));
+		event->ignore();
+		return;
+	}
 	if (meshDoc.hasBeenModified())
 	{
 		QMessageBox::StandardButton ret=QMessageBox::question(
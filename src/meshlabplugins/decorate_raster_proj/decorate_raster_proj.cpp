@@ -326,16 +326,17 @@ void DecorateRasterProjPlugin::updateColorTexture()
 {
     glPushAttrib( GL_TEXTURE_BIT );
 
-    const int w = m_CurrentRaster->currentPlane->image.width();
-    const int h = m_CurrentRaster->currentPlane->image.height();
+    const QImage img = m_CurrentRaster->currentPlane->image();
+    const int w = img.width();
+    const int h = img.height();
 
-	 QImage tximg = QGLWidget::convertToGLFormat(m_CurrentRaster->currentPlane->image);
+	 QImage tximg = QGLWidget::convertToGLFormat(img);
     // Recover image data and convert pixels to the adequate format for transfer onto the GPU.
 	GLubyte *texData = new GLubyte [ 4*w*h ];
 	for( int y=h-1, n=0; y>=0; --y )
 	for( int x=0; x<w; ++x )
 	{
-	QRgb pixel = m_CurrentRaster->currentPlane->image.pixel(x,y);
+	QRgb pixel = img.pixel(x,y);
 	//QRgb pixel = qRgb(0, 0 , 0);
 	texData[n++] = (GLubyte) qRed  ( pixel );
 	texData[n++] = (GLubyte) qGreen( pixel );
@@ -364,8 +365,9 @@ void DecorateRasterProjPlugin::updateDepthTexture(QGLContext* glctx, MLSceneGLSh
                   GL_TRANSFORM_BIT |
                   GL_VIEWPORT_BIT  );
 
-    const int w = m_CurrentRaster->currentPlane->image.width();
-    const int h = m_CurrentRaster->currentPlane->image.height();
+    const QSize size = m_CurrentRaster->currentPlane->imageSize();
+    const int w = size.width();
+    const int h = size.height();
 
 
     // Create and initialize the OpenGL texture object used to store the shadow map.
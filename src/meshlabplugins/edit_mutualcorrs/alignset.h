@@ -34,7 +34,7 @@ class AlignSet {
 
   int wt,ht;
   CMeshO* mesh;
-  QImage* image;
+  QImage image;
   double imageRatio;
   vcg::Shot<Scalarm> shot;
   vcg::Box3<float> box;
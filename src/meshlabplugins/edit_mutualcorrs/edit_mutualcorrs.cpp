@@ -142,7 +142,7 @@ void EditMutualCorrsPlugin::decorate(MeshModel &m, GLArea *gla, QPainter *p)
 			currim = imagePoints[pindex];
 			Point2m onGL = fromImageToGL(currim);
 
-			//QImage &curImg = glArea->md()->rm()->currentPlane->image;
+			//QImage &curImg = glArea->md()->rm()->currentPlane->image();
 			//float imageRatio = float(curImg.width()) / float(curImg.height());
 			float screenRatio = float(glArea->width()) / float(glArea->height());
 			//set orthogonal view
@@ -402,13 +402,13 @@ void EditMutualCorrsPlugin::receivedShot(QString name, Shotm shot)
 	if (name == "current")
 	{
 		align.shot = shot;
-		double ratio = (double)glArea->md()->rm()->currentPlane->image.height() / (double)align.shot.Intrinsics.ViewportPx[1];
+		double ratio = (double)glArea->md()->rm()->currentPlane->imageSize().height() / (double)align.shot.Intrinsics.ViewportPx[1];
 		align.shot.Intrinsics.PixelSizeMm[0] /= ratio;
 		align.shot.Intrinsics.PixelSizeMm[1] /= ratio;
 
-		align.shot.Intrinsics.ViewportPx[0] = glArea->md()->rm()->currentPlane->image.width();
+		align.shot.Intrinsics.ViewportPx[0] = glArea->md()->rm()->currentPlane->imageSize().width();
 		align.shot.Intrinsics.CenterPx[0] = (int)(align.shot.Intrinsics.ViewportPx[0] / 2);
-		align.shot.Intrinsics.ViewportPx[1] = glArea->md()->rm()->currentPlane->image.height();
+		align.shot.Intrinsics.ViewportPx[1] = glArea->md()->rm()->currentPlane->imageSize().height();
 		align.shot.Intrinsics.CenterPx[1] = (int)(align.shot.Intrinsics.ViewportPx[1] / 2);
 	}
 
@@ -492,7 +492,7 @@ void EditMutualCorrsPlugin::applyMutual()
 {
 	Solver solver;
 	MutualInfo mutual;
-	align.image = &glArea->md()->rm()->currentPlane->image;
+	align.image = glArea->md()->rm()->currentPlane->image();
 	align.mesh = &glArea->md()->mm()->cm;
 	int rendmode = mutualcorrsDialog->ui->renderingBox->currentIndex();
 	solver.optimize_focal = mutualcorrsDialog->ui->checkFocal->isChecked();
@@ -594,9 +594,9 @@ void EditMutualCorrsPlugin::applyMutual()
 		solver.levmar(&align, align.shot);
 
 		glArea->md()->rm()->shot = Shotm::Construct(align.shot);
-		float ratio = (float)glArea->md()->rm()->currentPlane->image.height() / (float)align.shot.Intrinsics.ViewportPx[1];
-		glArea->md()->rm()->shot.Intrinsics.ViewportPx[0] = glArea->md()->rm()->currentPlane->image.width();
-		glArea->md()->rm()->shot.Intrinsics.ViewportPx[1] = glArea->md()->rm()->currentPlane->image.height();
+		float ratio = (float)glArea->md()->rm()->currentPlane->imageSize().height() / (float)align.shot.Intrinsics.ViewportPx[1];
+		glArea->md()->rm()->shot.Intrinsics.ViewportPx[0] = glArea->md()->rm()->currentPlane->imageSize().width();
+		glArea->md()->rm()->shot.Intrinsics.ViewportPx[1] = glArea->md()->rm()->currentPlane->imageSize().height();
 		glArea->md()->rm()->shot.Intrinsics.PixelSizeMm[1] /= ratio;
 		glArea->md()->rm()->shot.Intrinsics.PixelSizeMm[0] /= ratio;
 		glArea->md()->rm()->shot.Intrinsics.CenterPx[0] = (int)((float)glArea->md()->rm()->shot.Intrinsics.ViewportPx[0] / 2.0);
@@ -636,9 +636,9 @@ void EditMutualCorrsPlugin::applyMutual()
 		solver.optimize(&align, &mutual, align.shot);
 		
 		glArea->md()->rm()->shot = Shotm::Construct(align.shot);
-		float ratio = (float)glArea->md()->rm()->currentPlane->image.height() / (float)align.shot.Intrinsics.ViewportPx[1];
-		glArea->md()->rm()->shot.Intrinsics.ViewportPx[0] = glArea->md()->rm()->currentPlane->image.width();
-		glArea->md()->rm()->shot.Intrinsics.ViewportPx[1] = glArea->md()->rm()->currentPlane->image.height();
+		float ratio = (float)glArea->md()->rm()->currentPlane->imageSize().height() / (float)align.shot.Intrinsics.ViewportPx[1];
+		glArea->md()->rm()->shot.Intrinsics.ViewportPx[0] = glArea->md()->rm()->currentPlane->imageSize().width();
+		glArea->md()->rm()->shot.Intrinsics.ViewportPx[1] = glArea->md()->rm()->currentPlane->imageSize().height();
 		glArea->md()->rm()->shot.Intrinsics.PixelSizeMm[1] /= ratio;
 		glArea->md()->rm()->shot.Intrinsics.PixelSizeMm[0] /= ratio;
 		glArea->md()->rm()->shot.Intrinsics.CenterPx[0] = (int)((float)glArea->md()->rm()->shot.Intrinsics.ViewportPx[0] / 2.0);
@@ -669,8 +669,8 @@ Point3m EditMutualCorrsPlugin::fromPickedToImage(Point2m picked)
 {
 	int glWidth= glArea->size().width();
 	int glHeight = glArea->size().height();
-	int imWidth = glArea->md()->rm()->currentPlane[0].image.width();
-	int imHeight = glArea->md()->rm()->currentPlane[0].image.height();
+	int imWidth = glArea->md()->rm()->currentPlane->imageSize().width();
+	int imHeight = glArea->md()->rm()->currentPlane->imageSize().height();
 	double ratio = (double)imHeight / (double)glHeight;
 	int wGLC = (int)(glWidth / 2.0) - picked[0];
 	int imWPick = (int)(imWidth / 2.0) - (int)(wGLC*ratio);
@@ -683,8 +683,8 @@ Point2m EditMutualCorrsPlugin::fromImageToGL(Point2m picked)
 {
 	int glWidth = glArea->size().width();
 	int glHeight = glArea->size().height();
-	int imWidth = glArea->md()->rm()->currentPlane[0].image.width();
-	int imHeight = glArea->md()->rm()->currentPlane[0].image.height();
+	int imWidth = glArea->md()->rm()->currentPlane->imageSize().width();
+	int imHeight = glArea->md()->rm()->currentPlane->imageSize().height();
 	
 	double ratio = (double)glHeight / (double)imHeight;
 
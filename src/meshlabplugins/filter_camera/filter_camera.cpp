@@ -575,9 +575,10 @@ std::map<std::string, QVariant> FilterCameraPlugin::applyFilter(const QAction *f
 		}
 		Shotm shotGot=par.getShotf("Shot");
 		currentRaster->shot = shotGot;
-		float ratio=(float)currentRaster->currentPlane->image.height()/(float)shotGot.Intrinsics.ViewportPx[1];
-		currentRaster->shot.Intrinsics.ViewportPx[0]=currentRaster->currentPlane->image.width();
-		currentRaster->shot.Intrinsics.ViewportPx[1]=currentRaster->currentPlane->image.height();
+		const QSize size=currentRaster->currentPlane->imageSize();
+		float ratio=(float)size.height()/(float)shotGot.Intrinsics.ViewportPx[1];
+		currentRaster->shot.Intrinsics.ViewportPx[0]=size.width();
+		currentRaster->shot.Intrinsics.ViewportPx[1]=size.height();
 		currentRaster->shot.Intrinsics.PixelSizeMm[1]/=ratio;
 		currentRaster->shot.Intrinsics.PixelSizeMm[0]/=ratio;
 		currentRaster->shot.Intrinsics.CenterPx[0]=(int)((float)currentRaster->shot.Intrinsics.ViewportPx[0]/2.0);
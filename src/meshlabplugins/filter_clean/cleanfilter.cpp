@@ -22,6 +22,8 @@
  ****************************************************************************/
 
 #include "cleanfilter.h"
+#include "parallel_ball_pivoting.h"
+#include "vertex_weld.h"
 
 #include <QCoreApplication>
 #include <vcg/complex/algorithms/clean.h>
@@ -33,7 +35,7 @@
 using namespace std;
 using namespace vcg;
 
-int SnapVertexBorder(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb);
+int SnapVertexBorder(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb, int snapBit);
 
 CleanFilter::CleanFilter()
 {
@@ -262,6 +264,22 @@ int CleanFilter::postCondition(const QAction* action) const
 	return MeshModel::MM_ALL;
 }
 
+bool CleanFilter::supportsDeletedElements(const QAction* action) const
+{
+	// these filters only delete elements and skip the already deleted ones,
+	// so they can be chained in a script without compacting the mesh
+	switch (ID(action)) {
+	case FP_REMOVE_WRT_Q:
+	case FP_REMOVE_ISOLATED_DIAMETER:
+	case FP_REMOVE_ISOLATED_COMPLEXITY:
+	case FP_REMOVE_DUPLICATE_FACE:
+	case FP_REMOVE_UNREFERENCED_VERTEX:
+	case FP_REMOVE_DUPLICATED_VERTEX:
+	case FP_REMOVE_FACE_ZERO_AREA: return true;
+	default: return false;
+	}
+}
+
 RichParameterList CleanFilter::initParameterList(const QAction* action, const MeshDocument& md)
 {
 	RichParameterList  parlst;
@@ -295,6 +313,15 @@ RichParameterList CleanFilter::initParameterList(const QAction* action, const Me
 			"if true all the initial faces of the mesh are deleted and the whole surface is "
 			"rebuilt from scratch. Otherwise the current faces are used as a starting point. "
 			"Useful if you run the algorithm multiple times with an increasing ball radius."));
+		parlst.addParam(RichBool(
+			"Parallel",
+			false,
+			"Parallel reconstruction",
+			"If true the point cloud is split in spatial cells that are reconstructed "
+			"concurrently, each one with a halo of the neighbouring points; the surfaces of the "
+			"cells are then merged and the seams between them are closed by a final pass. "
+			"Much faster on large point clouds, the result can differ slightly along the "
+			"borders of the cells."));
 		break;
 	case FP_REMOVE_ISOLATED_DIAMETER:
 		parlst.addParam(RichPercentage(
@@ -431,10 +458,15 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 			m.cm.face.resize(0);
 		}
 		m.updateDataMask(MeshModel::MM_VERTFACETOPO);
-		int                       startingFn = m.cm.fn;
-		tri::BallPivoting<CMeshO> pivot(m.cm, Radius, Clustering, CreaseThr);
-		// the main processing
-		pivot.BuildMesh(cb);
+		int startingFn = m.cm.fn;
+		if (par.getBool("Parallel")) {
+			ParallelBallPivoting(m.cm, Radius, Clustering, CreaseThr, cb);
+		}
+		else {
+			tri::BallPivoting<CMeshO> pivot(m.cm, Radius, Clustering, CreaseThr);
+			// the main processing
+			pivot.BuildMesh(cb);
+		}
 		m.clearDataMask(MeshModel::MM_FACEFACETOPO);
 		log("Reconstructed surface. Added %i faces", m.cm.fn - startingFn);
 	} break;
@@ -530,8 +562,12 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 
 	case FP_MERGE_CLOSE_VERTEX: {
 		Scalarm threshold = par.getAbsPerc("Threshold");
-		int     total     = tri::Clean<CMeshO>::MergeCloseVertex(m.cm, threshold);
+		int     total     = WeldVertices(m.cm, threshold, cb);
 		log("Successfully merged %d vertices", total);
+		if (total != 0)
+			m.updateBoxAndNormals();
+		m.clearDataMask(MeshModel::MM_FACEFACETOPO);
+		m.clearDataMask(MeshModel::MM_VERTFACETOPO);
 	} break;
 
 	case FP_REMOVE_DUPLICATE_FACE: {
@@ -584,7 +620,7 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 	} break;
 
 	case FP_REMOVE_DUPLICATED_VERTEX: {
-		int delvert = tri::Clean<CMeshO>::RemoveDuplicateVertex(m.cm);
+		int delvert = WeldVertices(m.cm, 0, cb);
 		log("Removed %d duplicated vertices", delvert);
 		if (delvert != 0)
 			m.updateBoxAndNormals();
@@ -593,9 +629,17 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 	} break;
 
 	case FP_SNAP_MISMATCHED_BORDER: {
-		Scalarm threshold = par.getFloat("EdgeDistRatio");
-		int     total     = SnapVertexBorder(m.cm, threshold, cb);
+		Scalarm   threshold = par.getFloat("EdgeDistRatio");
+		const int snapBit   = CVertexO::NewBitFlag();
+		int       total     = SnapVertexBorder(m.cm, threshold, cb, snapBit);
 		log("Successfully Split %d faces to snap", total);
+		if (total != 0 && par.getBool("UnifyVertices")) {
+			// only the snapped vertices, marked by SnapVertexBorder, are welded
+			int delvert = WeldVertices(m.cm, 0, cb, snapBit);
+			log("Welded %d snapped vertices", delvert);
+		}
+		tri::UpdateFlags<CMeshO>::VertexClear(m.cm, snapBit);
+		CVertexO::DeleteBitFlag(snapBit);
 		m.clearDataMask(MeshModel::MM_FACEFACETOPO);
 		m.clearDataMask(MeshModel::MM_VERTFACETOPO);
 	} break;
@@ -605,82 +649,110 @@ std::map<std::string, QVariant> CleanFilter::applyFilter(
 	return std::map<std::string, QVariant>();
 }
 
-int SnapVertexBorder(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb)
+// the snapped vertices and the vertices created by the splits are marked with snapBit
+int SnapVertexBorder(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb, int snapBit)
 {
 	tri::Allocator<CMeshO>::CompactEveryVector(m);
+	tri::UpdateFlags<CMeshO>::VertexClear(m, snapBit);
 
 	tri::UpdateTopology<CMeshO>::FaceFace(m);
 	tri::UpdateFlags<CMeshO>::FaceBorderFromFF(m);
 	tri::UpdateFlags<CMeshO>::VertexBorderFromFaceBorder(m);
 	tri::UpdateNormal<CMeshO>::PerVertexNormalizedPerFaceNormalized(m);
-	typedef GridStaticPtr<CMeshO::FaceType, CMeshO::ScalarType> MetroMeshFaceGrid;
-	MetroMeshFaceGrid                                           unifGridFace;
-	typedef tri::FaceTmark<CMeshO>                              MarkerFace;
-	MarkerFace                                                  markerFunctor(&m);
-	vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType>     PDistFunct;
 	tri::UpdateFlags<CMeshO>::FaceClearV(m);
-	unifGridFace.Set(m.face.begin(), m.face.end());
 
-	int                         faceFound;
-	int                         K = 20;
-	Point3m                     startPt;
-	float                       maxDist = m.bbox.Diag() / 20;
+	// a border vertex can only be snapped on a face closer than threshold times the length of
+	// one of its border edges: each face with a border edge is hashed with its box enlarged by
+	// that distance, so that the candidates of a vertex are the faces in its cell
+	const Scalarm          maxDist = m.bbox.Diag() / 20;
+	std::vector<int>       borderFaces;
+	std::vector<Scalarm>   reach;
+	Scalarm                avgSize = 0;
+	for (size_t fi = 0; fi < m.face.size(); ++fi) {
+		const CFaceO& f       = m.face[fi];
+		Scalarm       maxEdge = 0;
+		for (int j = 0; j < 3; ++j)
+			if (IsBorder(f, j))
+				maxEdge = std::max(maxEdge, Distance(f.cP0(j), f.cP1(j)));
+		if (maxEdge > 0) {
+			borderFaces.push_back(int(fi));
+			reach.push_back(std::min(threshold * maxEdge, maxDist));
+			Box3m b;
+			f.GetBBox(b);
+			avgSize += b.Diag() + 2 * reach.back();
+		}
+	}
+	std::vector<int> borderVerts;
+	for (size_t vi = 0; vi < m.vert.size(); ++vi)
+		if (m.vert[vi].IsB())
+			borderVerts.push_back(int(vi));
+	if (borderFaces.empty() || borderVerts.empty())
+		return 0;
+	avgSize /= borderFaces.size();
+
+	cb(0, "Hashing border faces");
+	SpatialHash hash;
+	hash.build(borderFaces.size(), avgSize > 0 ? avgSize : 1, m.bbox.min, [&](size_t i) {
+		Box3m b;
+		m.face[borderFaces[i]].GetBBox(b);
+		b.Offset(reach[i]);
+		return b;
+	});
+
+	// the closest border edge of each border vertex
+	cb(30, "Snapping vertices");
+	std::vector<CMeshO::FacePointer> bestFaces(borderVerts.size(), nullptr);
+	std::vector<int>                 bestEdges(borderVerts.size(), -1);
+	std::vector<Scalarm>             bestDists(borderVerts.size());
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int k = 0; k < int(borderVerts.size()); ++k) {
+		vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType> PDistFunct;
+		const Point3m startPt  = m.vert[borderVerts[k]].cP();
+		Scalarm       bestDist = std::numeric_limits<Scalarm>::max();
+		hash.forEachInCell(startPt, [&](uint32_t i) {
+			const float         epsilonSmall = float(1e-5);
+			const float         epsilonBig   = float(1e-2);
+			CMeshO::FacePointer fp           = &m.face[borderFaces[i]];
+			Scalarm             dist         = maxDist;
+			Point3m             closest, u;
+			if (!PDistFunct(*fp, startPt, dist, closest))
+				return;
+			InterpolationParameters(*fp, fp->cN(), closest, u);
+			for (int j = 0; j < 3; ++j) {
+				if (IsBorder(*fp, j) && u[(j + 0) % 3] > epsilonBig &&
+					u[(j + 1) % 3] > epsilonBig && u[(j + 2) % 3] < epsilonSmall &&
+					dist < bestDist) {
+					bestDist     = dist;
+					bestFaces[k] = fp;
+					bestEdges[k] = j;
+				}
+			}
+		});
+		bestDists[k] = bestDist;
+	}
+
+	// a face is split at most once, the first vertex in index order wins
 	vector<Point3m>             splitVertVec;
 	vector<CMeshO::FacePointer> splitFaceVec;
 	vector<int>                 splitEdgeVec;
-	for (CMeshO::VertexIterator vi = m.vert.begin(); vi != m.vert.end(); ++vi)
-		if ((*vi).IsB()) {
-			cb((int(tri::Index(m, *vi)) * 100) / m.vn, "Snapping vertices");
-			vector<CMeshO::FacePointer> faceVec;
-			vector<float>               distVec;
-			vector<Point3m>             pointVec;
-			Point3m                     u;
-			startPt   = (*vi).P();
-			faceFound = unifGridFace.GetKClosest(
-				PDistFunct, markerFunctor, K, startPt, maxDist, faceVec, distVec, pointVec);
-
-			CMeshO::FacePointer bestFace = 0;
-			float               localThr, bestDist = std::numeric_limits<float>::max();
-			Point3m             bestPoint;
-			int                 bestEdge;
-			//        qDebug("Found %i face for vertex %i",faceFound,vi-m.vert.begin());
-			for (int i = 0; i < faceFound; ++i) {
-				const float         epsilonSmall = float(1e-5);
-				const float         epsilonBig   = float(1e-2);
-				CMeshO::FacePointer fp           = faceVec[i];
-				InterpolationParameters(*fp, fp->cN(), pointVec[i], u);
-				//          qDebug(" face %i face for vertex %5.3f %5.3f %5.3f  dist %5.3f  (%c %c
-				//          %c)",fp-&*m.face.begin(),u[0],u[1],u[2],distVec[i],IsBorder(*fp,0)?'b':'
-				//          ',IsBorder(*fp,1)?'b':' ',IsBorder(*fp,2)?'b':' ');
-				for (int j = 0; j < 3; ++j) {
-					if (IsBorder(*fp, j) && !fp->IsV()) {
-						if (u[(j + 0) % 3] > epsilonBig && u[(j + 1) % 3] > epsilonBig &&
-							u[(j + 2) % 3] < epsilonSmall) {
-							if (distVec[i] < bestDist) {
-								bestDist = distVec[i];
-								// bestPoint=pointVec[i];
-								bestPoint = (*vi).cP();
-								bestFace  = fp;
-								bestEdge  = j;
-							}
-						}
-					}
-				}
-			} // end for each faceFound
-
-			if (bestFace) {
-				localThr = threshold * Distance(bestFace->P0(bestEdge), bestFace->P1(bestEdge));
-				if (bestDist < localThr && !bestFace->IsV()) {
-					bestFace->SetV();
-					(*vi).C() = Color4b::Blue;
-					// bestFace->C()=Color4b::LightBlue;
-					(*vi).SetS();
-					splitVertVec.push_back(bestPoint);
-					splitEdgeVec.push_back(bestEdge);
-					splitFaceVec.push_back(bestFace);
-				}
+	for (size_t k = 0; k < borderVerts.size(); ++k) {
+		CMeshO::FacePointer bestFace = bestFaces[k];
+		if (bestFace) {
+			int     bestEdge = bestEdges[k];
+			Scalarm localThr =
+				threshold * Distance(bestFace->P0(bestEdge), bestFace->P1(bestEdge));
+			if (bestDists[k] < localThr && !bestFace->IsV()) {
+				CVertexO& v = m.vert[borderVerts[k]];
+				bestFace->SetV();
+				v.C() = Color4b::Blue;
+				v.SetS();
+				v.SetUserBit(snapBit);
+				splitVertVec.push_back(v.cP());
+				splitEdgeVec.push_back(bestEdge);
+				splitFaceVec.push_back(bestFace);
 			}
-		} // end for all border vertices
+		}
+	}
 	tri::Allocator<CMeshO>::PointerUpdater<CMeshO::FacePointer> pu;
 	CMeshO::VertexIterator firstVert = tri::Allocator<CMeshO>::AddVertices(m, splitVertVec.size());
 	CMeshO::FaceIterator   firstface = tri::Allocator<CMeshO>::AddFaces(m, splitVertVec.size(), pu);
@@ -696,6 +768,7 @@ int SnapVertexBorder(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb)
 
 	for (size_t i = 0; i < splitVertVec.size(); ++i) {
 		firstVert->P()           = splitVertVec[i];
+		firstVert->SetUserBit(snapBit);
 		int                 eInd = splitEdgeVec[i];
 		CMeshO::FacePointer fp   = splitFaceVec[i];
 		pu.Update(fp);
@@ -64,6 +64,7 @@ public:
 	int               getRequirements(const QAction*);
 	int               postCondition(const QAction*) const;
 	int               getPreConditions(const QAction*) const { return MeshModel::MM_NONE; }
+	bool              supportsDeletedElements(const QAction*) const;
 	RichParameterList initParameterList(const QAction*, const MeshDocument& /*m*/);
 	std::map<std::string, QVariant> applyFilter(
 		const QAction* action,
@@ -72,6 +73,7 @@ public:
 		unsigned int&     postConditionMask,
 		vcg::CallBackPos* cb);
 	FilterArity filterArity(const QAction*) const { return SINGLE_MESH; }
+	bool              supportsBackgroundExecution(const QAction*) const { return true; }
 };
 
 #endif
@@ -0,0 +1,314 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "parallel_ball_pivoting.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
+#include <memory>
+
+#include <common/mlexception.h>
+#include <vcg/complex/algorithms/clean.h>
+#include <vcg/complex/algorithms/create/ball_pivoting.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+
+namespace {
+
+// Every BallPivoting reserves a per vertex user bit for its whole life, and
+// vcg can release these bits only in reverse order of allocation. The cells
+// are therefore pivoted in waves of at most MAX_PIVOT_THREADS instances, that
+// are destroyed in reverse order of construction at the end of each wave.
+const int MAX_PIVOT_THREADS = 8;
+
+// minimum side of a cell, in halo widths, below which the halo would cost
+// more than the parallelism gives back
+const Scalarm MIN_CELL_SIDE = 8;
+
+class PivotGrid
+{
+public:
+	PivotGrid(const Box3m& bb, int cellsWanted, Scalarm halo) : bb(bb), halo(halo)
+	{
+		const Scalarm eps  = std::max(bb.Diag() * Scalarm(1e-3), halo);
+		Point3m       dim  = bb.Dim();
+		for (int d = 0; d < 3; ++d)
+			dim[d] = std::max(dim[d], eps);
+		const Scalarm side = std::max(
+			std::cbrt(dim[0] * dim[1] * dim[2] / cellsWanted), halo * MIN_CELL_SIDE);
+		for (int d = 0; d < 3; ++d) {
+			gs[d]   = std::max(1, int(dim[d] / side));
+			cell[d] = dim[d] / gs[d];
+		}
+	}
+
+	int size() const { return gs[0] * gs[1] * gs[2]; }
+
+	/// the cell owning the point p
+	int cellOf(const Point3m& p) const
+	{
+		int c[3];
+		for (int d = 0; d < 3; ++d)
+			c[d] = coord(p[d], d);
+		return (c[2] * gs[1] + c[1]) * gs[0] + c[0];
+	}
+
+	/// the range of cells whose halo contains the point p
+	void haloRange(const Point3m& p, int lo[3], int hi[3]) const
+	{
+		for (int d = 0; d < 3; ++d) {
+			lo[d] = coord(p[d] - halo, d);
+			hi[d] = coord(p[d] + halo, d);
+		}
+	}
+
+	int index(int x, int y, int z) const { return (z * gs[1] + y) * gs[0] + x; }
+
+private:
+	int coord(Scalarm v, int d) const
+	{
+		return std::min(gs[d] - 1, std::max(0, int((v - bb.min[d]) / cell[d])));
+	}
+
+	Box3m   bb;
+	Scalarm halo;
+	int     gs[3];
+	Scalarm cell[3];
+};
+
+struct PivotCell
+{
+	std::vector<int> verts;  // sorted indices of the core and halo vertices
+	std::vector<int> faces;  // initial faces having all the vertices in the cell
+	std::vector<std::array<int, 3>> result; // new faces owned by the cell
+
+	CMeshO                                     sub;
+	std::unique_ptr<tri::BallPivoting<CMeshO>> pivot;
+};
+
+void buildCellMesh(const CMeshO& m, PivotCell& c)
+{
+	CMeshO& sub = c.sub;
+	sub.vert.EnableVFAdjacency();
+	sub.vert.EnableMark();
+	sub.face.EnableVFAdjacency();
+
+	tri::Allocator<CMeshO>::AddVertices(sub, c.verts.size());
+	for (size_t i = 0; i < c.verts.size(); ++i) {
+		sub.vert[i].P() = m.vert[c.verts[i]].P();
+		sub.vert[i].N() = m.vert[c.verts[i]].N();
+	}
+	if (!c.faces.empty()) {
+		tri::Allocator<CMeshO>::AddFaces(sub, c.faces.size());
+		for (size_t k = 0; k < c.faces.size(); ++k) {
+			const CFaceO& f = m.face[c.faces[k]];
+			for (int j = 0; j < 3; ++j) {
+				int vi = tri::Index(m, f.cV(j));
+				int li = std::lower_bound(c.verts.begin(), c.verts.end(), vi) - c.verts.begin();
+				sub.face[k].V(j) = &sub.vert[li];
+			}
+		}
+		tri::UpdateTopology<CMeshO>::VertexFace(sub);
+	}
+}
+
+void collectCellFaces(const PivotGrid& grid, int cellIndex, PivotCell& c)
+{
+	const CMeshO& sub = c.sub;
+	for (size_t k = c.faces.size(); k < sub.face.size(); ++k) {
+		const CFaceO& f = sub.face[k];
+		if (f.IsD() || grid.cellOf(Barycenter(f)) != cellIndex)
+			continue;
+		std::array<int, 3> t;
+		for (int j = 0; j < 3; ++j)
+			t[j] = c.verts[tri::Index(sub, f.cV(j))];
+		c.result.push_back(t);
+	}
+}
+
+bool progress(vcg::CallBackPos* cb, int pos, const char* str)
+{
+	return cb == nullptr || cb(pos, str);
+}
+
+} // namespace
+
+void ParallelBallPivoting(
+	CMeshO&           m,
+	Scalarm           radius,
+	Scalarm           clustering,
+	Scalarm           creaseThr,
+	vcg::CallBackPos* cb)
+{
+	int threads = 1;
+#ifdef _OPENMP
+	threads = std::min(omp_get_max_threads(), MAX_PIVOT_THREADS);
+#endif
+	tri::UpdateBounding<CMeshO>::Box(m);
+	const Box3m bb = m.bbox;
+
+	// the same guess done by BallPivoting, but on the whole cloud, so that
+	// all the cells pivot the same ball
+	if (radius <= 0 && m.vn > 0)
+		radius = std::sqrt((bb.Diag() * bb.Diag()) / m.vn);
+
+	const Scalarm   halo = radius * 4;
+	const PivotGrid grid(bb, threads * 4, halo);
+	const int       cellNum = grid.size();
+
+	std::atomic<bool> canceled(false);
+	if (threads > 1 && cellNum > 1 && !bb.IsNull()) {
+		progress(cb, 0, "Partitioning the point cloud");
+		std::vector<PivotCell> cells(cellNum);
+		int                    lo[3], hi[3];
+		for (size_t vi = 0; vi < m.vert.size(); ++vi) {
+			grid.haloRange(m.vert[vi].cP(), lo, hi);
+			for (int z = lo[2]; z <= hi[2]; ++z)
+				for (int y = lo[1]; y <= hi[1]; ++y)
+					for (int x = lo[0]; x <= hi[0]; ++x)
+						cells[grid.index(x, y, z)].verts.push_back(vi);
+		}
+		for (size_t fi = 0; fi < m.face.size(); ++fi) {
+			const CFaceO& f = m.face[fi];
+			if (f.IsD())
+				continue;
+			// the cells whose halo contains all the three vertices
+			int flo[3] = {0, 0, 0};
+			int fhi[3] = {
+				std::numeric_limits<int>::max(),
+				std::numeric_limits<int>::max(),
+				std::numeric_limits<int>::max()};
+			for (int j = 0; j < 3; ++j) {
+				grid.haloRange(f.cP(j), lo, hi);
+				for (int d = 0; d < 3; ++d) {
+					flo[d] = std::max(flo[d], lo[d]);
+					fhi[d] = std::min(fhi[d], hi[d]);
+				}
+			}
+			for (int z = flo[2]; z <= fhi[2]; ++z)
+				for (int y = flo[1]; y <= fhi[1]; ++y)
+					for (int x = flo[0]; x <= fhi[0]; ++x)
+						cells[grid.index(x, y, z)].faces.push_back(fi);
+		}
+
+		// biggest cells first, so that the cells of a wave take a similar time;
+		// a cell with less than 4 vertices cannot pivot any ball, and its
+		// vertices are left to the serial pass
+		std::vector<int> order;
+		for (int i = 0; i < cellNum; ++i)
+			if (cells[i].verts.size() >= 4)
+				order.push_back(i);
+		std::sort(order.begin(), order.end(), [&](int a, int b) {
+			return cells[a].verts.size() > cells[b].verts.size();
+		});
+
+		std::atomic<int> done(0);
+		for (size_t w = 0; w < order.size() && !canceled; w += threads) {
+			const int        waveSize = std::min<int>(threads, order.size() - w);
+			std::vector<int> built;
+#pragma omp parallel for schedule(dynamic, 1) num_threads(waveSize)
+			for (int k = 0; k < waveSize; ++k) {
+				if (canceled)
+					continue;
+				PivotCell& c = cells[order[w + k]];
+				buildCellMesh(m, c);
+				if (canceled)
+					continue;
+#pragma omp critical(ball_pivoting_user_bit)
+				{
+					c.pivot.reset(
+						new tri::BallPivoting<CMeshO>(c.sub, radius, clustering, creaseThr));
+					built.push_back(order[w + k]);
+				}
+				c.pivot->BuildMesh();
+				if (canceled)
+					continue;
+				collectCellFaces(grid, order[w + k], c);
+				++done;
+				// only the calling thread may report the progress; a Cancel is
+				// seen by the other threads of the wave at their next check
+#ifdef _OPENMP
+				if (omp_get_thread_num() == 0)
+#endif
+				{
+					if (!progress(cb, 90 * done / int(order.size()), "Pivoting the cells"))
+						canceled = true;
+				}
+			}
+			for (auto it = built.rbegin(); it != built.rend(); ++it) {
+				cells[*it].pivot.reset();
+				cells[*it].sub.Clear();
+			}
+			if (!canceled && !progress(cb, 90 * done / int(order.size()), "Pivoting the cells"))
+				canceled = true;
+		}
+		// last chance to stop: from here on m is modified
+		if (canceled || !progress(cb, 90, "Merging the cells"))
+			throw MLException("Ball pivoting reconstruction canceled");
+
+		// merge the faces of all the cells
+		size_t newFaces = 0;
+		for (const PivotCell& c : cells)
+			newFaces += c.result.size();
+		if (newFaces > 0) {
+			auto fi = tri::Allocator<CMeshO>::AddFaces(m, newFaces);
+			for (PivotCell& c : cells) {
+				for (const std::array<int, 3>& t : c.result) {
+					for (int j = 0; j < 3; ++j)
+						fi->V(j) = &m.vert[t[j]];
+					++fi;
+				}
+				c.result.clear();
+			}
+		}
+
+		// two cells could have built different triangles across their border:
+		// remove the duplicated and the overlapping ones before stitching
+		progress(cb, 90, "Stitching the cells");
+		const bool hadFF = m.face.IsFFAdjacencyEnabled();
+		if (!hadFF)
+			m.face.EnableFFAdjacency();
+		tri::Clean<CMeshO>::RemoveDuplicateFace(m);
+		tri::UpdateTopology<CMeshO>::FaceFace(m);
+		tri::Clean<CMeshO>::RemoveNonManifoldFace(m);
+		if (!hadFF)
+			m.face.DisableFFAdjacency();
+		tri::Allocator<CMeshO>::CompactFaceVector(m);
+		tri::UpdateTopology<CMeshO>::VertexFace(m);
+		progress(cb, 0, "Pivoting the ball");
+	}
+	else if (!progress(cb, 0, "Pivoting the ball")) {
+		throw MLException("Ball pivoting reconstruction canceled");
+	}
+
+	// serial pass: on a partitioned cloud it only has to close the seams
+	// between the cells, starting from the border of the merged surface
+	tri::BallPivoting<CMeshO> pivot(m, radius, clustering, creaseThr);
+	pivot.BuildMesh(cb);
+}
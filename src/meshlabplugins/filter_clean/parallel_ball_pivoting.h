@@ -0,0 +1,59 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef PARALLEL_BALL_PIVOTING_H
+#define PARALLEL_BALL_PIVOTING_H
+
+#include <common/ml_document/cmesh.h>
+
+/*
+Parallel ball pivoting.
+
+The bounding box of the point cloud is split in a grid of cells. Every cell
+is reconstructed independently, on a copy of its points plus a halo of
+neighbouring points wide enough to pivot the ball across the cell border.
+A triangle belongs to the cell containing its barycenter, so the triangles
+created in the halo are discarded and each part of the surface is kept once.
+The triangles of all the cells are then merged, the faces that overlap along
+the borders of the cells are removed and a last serial ball pivoting pass,
+starting from the merged surface, closes the seams.
+*/
+
+/**
+ * @brief Reconstructs the surface of the point cloud m with the ball
+ * pivoting algorithm, using all the available threads. The parameters are
+ * the ones of vcg::tri::BallPivoting; the existing faces of m are kept and
+ * used as a starting point. The vertices of m must be compact and m must
+ * have the per vertex VF adjacency and mark enabled. Throws an MLException
+ * if the callback asks to stop before the faces of the cells are merged
+ * into m; in that case the mesh is not modified. The last serial pass is not
+ * interruptible.
+ */
+void ParallelBallPivoting(
+	CMeshO&           m,
+	Scalarm           radius,
+	Scalarm           clustering,
+	Scalarm           creaseThr,
+	vcg::CallBackPos* cb);
+
+#endif // PARALLEL_BALL_PIVOTING_H
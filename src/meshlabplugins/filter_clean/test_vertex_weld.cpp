@@ -0,0 +1,116 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include <common/utilities/test_check.h>
+
+#include "vertex_weld.h"
+
+using namespace vcg;
+using meshlab::test::check;
+
+/*
+Welds the selected vertices only: two selected coincident vertices are merged,
+while the faces made of unselected vertices, including an unselected duplicate
+of another vertex, must be left untouched.
+*/
+static void testSelectedOnly()
+{
+	CMeshO m;
+	const Point3m pos[] = {
+		Point3m(0, 0, 0), Point3m(1, 0, 0), Point3m(0, 1, 0), Point3m(1, 1, 0), // unselected quad
+		Point3m(0, 0, 0),                                                     // unselected duplicate of 0
+		Point3m(5, 0, 0), Point3m(5, 0, 0),                                   // selected duplicates
+		Point3m(6, 0, 0), Point3m(5, 1, 0), Point3m(6, 1, 0)};
+	tri::Allocator<CMeshO>::AddVertices(m, 10);
+	for (int i = 0; i < 10; ++i)
+		m.vert[i].P() = pos[i];
+	m.vert[5].SetS();
+	m.vert[6].SetS();
+
+	const int tris[][3] = {{0, 1, 2}, {1, 3, 2}, {4, 3, 1}, {5, 7, 8}, {6, 9, 8}};
+	tri::Allocator<CMeshO>::AddFaces(m, 5);
+	for (int f = 0; f < 5; ++f)
+		for (int j = 0; j < 3; ++j)
+			m.face[f].V(j) = &m.vert[tris[f][j]];
+
+	const int deleted = WeldVertices(m, 0, nullptr, CVertexO::SELECTED);
+
+	check(deleted == 1, "one selected vertex welded");
+	check(m.vert[6].IsD() && !m.vert[5].IsD(), "the lowest selected index is kept");
+	check(!m.vert[4].IsD(), "unselected duplicate kept");
+	for (int f = 0; f < 3; ++f)
+		for (int j = 0; j < 3; ++j)
+			check(m.face[f].V(j) == &m.vert[tris[f][j]], "unselected faces unchanged");
+	check(m.face[4].V(0) == &m.vert[5], "face of the welded vertex remapped");
+	check(m.face[3].V(0) == &m.vert[5], "face of the kept vertex unchanged");
+	check(m.fn == 5, "no face deleted");
+}
+
+/*
+Welds a chain of vertices 0.6 apart with threshold 1: as tri::Clean::
+MergeCloseVertex, the first vertex takes only its neighbour, and the chain is
+not collapsed into a single vertex.
+*/
+static void testChain()
+{
+	CMeshO m;
+	tri::Allocator<CMeshO>::AddVertices(m, 4);
+	for (int i = 0; i < 4; ++i)
+		m.vert[i].P() = Point3m(Scalarm(0.6) * i, 0, 0);
+
+	const int deleted = WeldVertices(m, 1);
+
+	check(deleted == 2, "chain welded in pairs");
+	check(!m.vert[0].IsD() && m.vert[1].IsD(), "first pair welded into 0");
+	check(!m.vert[2].IsD() && m.vert[3].IsD(), "second pair welded into 2");
+}
+
+/*
+Two chains like the one of testChain, far apart and with interleaved indices:
+each connected component is clustered on its own, in index order.
+*/
+static void testInterleavedChains()
+{
+	CMeshO m;
+	tri::Allocator<CMeshO>::AddVertices(m, 8);
+	for (int i = 0; i < 4; ++i) {
+		m.vert[2 * i].P()     = Point3m(Scalarm(0.6) * i, 0, 0);
+		m.vert[2 * i + 1].P() = Point3m(Scalarm(0.6) * i, 100, 0);
+	}
+
+	const int deleted = WeldVertices(m, 1);
+
+	check(deleted == 4, "both chains welded in pairs");
+	for (int c = 0; c < 2; ++c) {
+		check(!m.vert[c].IsD() && m.vert[c + 2].IsD(), "first pair of each chain welded");
+		check(!m.vert[c + 4].IsD() && m.vert[c + 6].IsD(), "second pair of each chain welded");
+	}
+}
+
+int main()
+{
+	testSelectedOnly();
+	testChain();
+	testInterleavedChains();
+	return meshlab::test::testResult("vertex_weld");
+}
@@ -0,0 +1,322 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "vertex_weld.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <vcg/complex/algorithms/clean.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace vcg;
+
+namespace {
+
+/// Lock-free union-find. The root of a class is always its smallest element,
+/// so the classes and their representatives do not depend on the order of
+/// the unions.
+class UnionFind
+{
+public:
+	UnionFind(size_t n) : parent(new std::atomic<uint32_t>[n])
+	{
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long) n; ++i)
+			parent[i].store(uint32_t(i), std::memory_order_relaxed);
+	}
+
+	uint32_t find(uint32_t i)
+	{
+		for (;;) {
+			uint32_t p = parent[i].load(std::memory_order_relaxed);
+			if (p == i)
+				return i;
+			uint32_t gp = parent[p].load(std::memory_order_relaxed);
+			// path halving, harmless if another thread got here first
+			parent[i].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+			i = gp;
+		}
+	}
+
+	void unite(uint32_t a, uint32_t b)
+	{
+		for (;;) {
+			a = find(a);
+			b = find(b);
+			if (a == b)
+				return;
+			if (a > b)
+				std::swap(a, b);
+			// only a root can be linked, retry if b stopped being one
+			uint32_t expected = b;
+			if (parent[b].compare_exchange_strong(expected, a))
+				return;
+		}
+	}
+
+private:
+	std::unique_ptr<std::atomic<uint32_t>[]> parent;
+};
+
+bool progress(vcg::CallBackPos* cb, int pos, const char* str)
+{
+	return cb == nullptr || cb(pos, str);
+}
+
+} // namespace
+
+void SpatialHash::sortAndIndex()
+{
+	const size_t n = entries.size();
+
+	// LSD radix sort of the keys, 8 bits at a time; each thread counts and
+	// scatters a contiguous range of the entries, so every pass is stable
+	const int BITS    = 8;
+	const int BUCKETS = 1 << BITS;
+	int       maxThreads = 1;
+#ifdef _OPENMP
+	maxThreads = omp_get_max_threads();
+#endif
+	std::vector<Entry>  tmp(n);
+	std::vector<size_t> count(size_t(maxThreads) * BUCKETS);
+	for (int shift = 0; shift < 64; shift += BITS) {
+		bool skip = false;
+#pragma omp parallel num_threads(maxThreads)
+		{
+			int t = 0, nt = 1;
+#ifdef _OPENMP
+			t  = omp_get_thread_num();
+			nt = omp_get_num_threads();
+#endif
+			const size_t begin = n * t / nt;
+			const size_t end   = n * (t + 1) / nt;
+			size_t*      c     = &count[size_t(t) * BUCKETS];
+			std::fill(c, c + BUCKETS, 0);
+			for (size_t i = begin; i < end; ++i)
+				++c[(entries[i].key >> shift) & (BUCKETS - 1)];
+#pragma omp barrier
+#pragma omp single
+			{
+				size_t sum = 0;
+				for (int b = 0; b < BUCKETS; ++b) {
+					const size_t bucketStart = sum;
+					for (int tt = 0; tt < nt; ++tt) {
+						const size_t v               = count[size_t(tt) * BUCKETS + b];
+						count[size_t(tt) * BUCKETS + b] = sum;
+						sum += v;
+					}
+					// all the keys have the same digit: nothing to move
+					if (sum - bucketStart == n)
+						skip = true;
+				}
+			}
+			if (!skip)
+				for (size_t i = begin; i < end; ++i)
+					tmp[c[(entries[i].key >> shift) & (BUCKETS - 1)]++] = entries[i];
+		}
+		if (!skip)
+			entries.swap(tmp);
+	}
+	tmp.clear();
+	tmp.shrink_to_fit();
+
+	// runs of equal keys
+	runStart.clear();
+	for (size_t i = 0; i < n; ++i)
+		if (i == 0 || entries[i].key != entries[i - 1].key)
+			runStart.push_back(i);
+	const size_t runs = runStart.size();
+	runStart.push_back(n);
+
+	// open addressing table from the keys to their runs, at most half full
+	tableSize = 1;
+	while (tableSize < runs * 2)
+		tableSize <<= 1;
+	table.reset(new std::atomic<uint64_t>[tableSize]);
+	tableRun.assign(tableSize, 0);
+#pragma omp parallel for schedule(static)
+	for (long long s = 0; s < (long long) tableSize; ++s)
+		table[s].store(EMPTY, std::memory_order_relaxed);
+#pragma omp parallel for schedule(static)
+	for (long long r = 0; r < (long long) runs; ++r) {
+		const uint64_t key = entries[runStart[r]].key;
+		for (size_t s = key & (tableSize - 1);; s = (s + 1) & (tableSize - 1)) {
+			uint64_t expected = EMPTY;
+			if (table[s].compare_exchange_strong(expected, key, std::memory_order_relaxed)) {
+				tableRun[s] = uint32_t(r);
+				break;
+			}
+		}
+	}
+}
+
+int WeldVertices(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb, int onlyFlags)
+{
+	std::vector<uint32_t> live;
+	live.reserve(m.vn);
+	Box3m bb;
+	for (size_t i = 0; i < m.vert.size(); ++i)
+		if (!m.vert[i].IsD() && (onlyFlags == 0 || (m.vert[i].Flags() & onlyFlags) != 0)) {
+			live.push_back(uint32_t(i));
+			bb.Add(m.vert[i].cP());
+		}
+	if (live.size() < 2)
+		return 0;
+
+	// exact duplicates always fall in the same cell: any cell size works,
+	// use one giving about a vertex per cell
+	const bool exact    = threshold <= 0;
+	Scalarm    cellSize = exact ? bb.Diag() / std::cbrt(Scalarm(live.size())) : threshold;
+	if (!(cellSize > 0))
+		cellSize = 1;
+
+	progress(cb, 0, "Hashing vertices");
+	SpatialHash hash;
+	hash.build(live.size(), cellSize, bb.min, [&](size_t i) {
+		return Box3m(m.vert[live[i]].cP(), m.vert[live[i]].cP());
+	});
+
+	// cls[i] is the index in live of the representative of the i-th vertex
+	progress(cb, 40, "Finding close vertices");
+	std::vector<uint32_t> cls(live.size());
+	if (exact) {
+		// equal positions are a transitive relation: the classes are the
+		// connected components, found in parallel
+		UnionFind uf(live.size());
+#pragma omp parallel for schedule(dynamic, 4096)
+		for (long long i = 0; i < (long long) live.size(); ++i) {
+			const Point3m& p = m.vert[live[i]].cP();
+			hash.forEachInCell(p, [&](uint32_t j) {
+				if (j < i && m.vert[live[j]].cP() == p)
+					uf.unite(uint32_t(i), j);
+			});
+		}
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long) live.size(); ++i)
+			cls[i] = uf.find(uint32_t(i));
+	}
+	else {
+		// same clustering of tri::Clean::ClusterVertex: in index order, each
+		// vertex not yet clustered takes all the free vertices nearer than
+		// threshold; the chains of close vertices are not followed.
+		// A vertex is only ever taken by a vertex nearer than threshold, so
+		// the connected components of the "nearer than threshold" graph are
+		// clustered independently: they are found in parallel, and then each
+		// one is clustered in index order by a single thread.
+		const Scalarm sqThr = threshold * threshold;
+		const Point3m off(threshold, threshold, threshold);
+		UnionFind     uf(live.size());
+#pragma omp parallel for schedule(dynamic, 4096)
+		for (long long i = 0; i < (long long) live.size(); ++i) {
+			const Point3m& p = m.vert[live[i]].cP();
+			hash.forEachInBox(Box3m(p - off, p + off), [&](uint32_t j) {
+				if (j < i && SquaredDistance(m.vert[live[j]].cP(), p) < sqThr)
+					uf.unite(uint32_t(i), j);
+			});
+		}
+
+		// the vertices of each component, in index order; the component of
+		// a vertex is named after its smallest vertex
+		std::vector<uint32_t> compStart(live.size() + 1, 0);
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < (long long) live.size(); ++i)
+			cls[i] = uf.find(uint32_t(i));
+		for (size_t i = 0; i < live.size(); ++i)
+			++compStart[cls[i] + 1];
+		for (size_t i = 0; i < live.size(); ++i)
+			compStart[i + 1] += compStart[i];
+		std::vector<uint32_t> compVert(live.size());
+		std::vector<uint32_t> fill(compStart.begin(), compStart.end() - 1);
+		for (size_t i = 0; i < live.size(); ++i)
+			compVert[fill[cls[i]]++] = uint32_t(i);
+		fill.clear();
+		fill.shrink_to_fit();
+
+		// a thread writes only the entries of its own component, and reads
+		// only those of the vertices nearer than threshold, that belong to it
+		const uint32_t FREE = ~uint32_t(0);
+#pragma omp parallel for schedule(dynamic, 64)
+		for (long long c = 0; c < (long long) live.size(); ++c) {
+			const uint32_t first = compStart[c];
+			const uint32_t last  = compStart[c + 1];
+			if (last - first < 2)
+				continue;
+			for (uint32_t k = first; k < last; ++k)
+				cls[compVert[k]] = FREE;
+			for (uint32_t k = first; k < last; ++k) {
+				const uint32_t i = compVert[k];
+				if (cls[i] != FREE)
+					continue;
+				cls[i]           = i;
+				const Point3m& p = m.vert[live[i]].cP();
+				hash.forEachInBox(Box3m(p - off, p + off), [&](uint32_t j) {
+					if (SquaredDistance(m.vert[live[j]].cP(), p) < sqThr && cls[j] == FREE)
+						cls[j] = i;
+				});
+			}
+		}
+	}
+
+	// every vertex points to the representative of its class, the vertices
+	// that are not welded (deleted or without onlyFlags) point to themselves
+	progress(cb, 80, "Merging vertices");
+	std::vector<uint32_t> rep(m.vert.size());
+	std::iota(rep.begin(), rep.end(), 0);
+	int                   deleted = 0;
+#pragma omp parallel for schedule(static) reduction(+ : deleted)
+	for (long long i = 0; i < (long long) live.size(); ++i) {
+		const uint32_t r = live[cls[i]];
+		rep[live[i]]     = r;
+		if (r != live[i]) {
+			m.vert[live[i]].SetD();
+			++deleted;
+		}
+	}
+	if (deleted == 0)
+		return 0;
+	m.vn -= deleted;
+
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long) m.face.size(); ++i) {
+		CFaceO& f = m.face[i];
+		if (!f.IsD())
+			for (int j = 0; j < 3; ++j)
+				f.V(j) = &m.vert[rep[tri::Index(m, f.V(j))]];
+	}
+	for (CEdgeO& e : m.edge)
+		if (!e.IsD())
+			for (int j = 0; j < 2; ++j)
+				e.V(j) = &m.vert[rep[tri::Index(m, e.V(j))]];
+
+	// same cleanup done by tri::Clean::RemoveDuplicateVertex
+	tri::Clean<CMeshO>::RemoveDegenerateFace(m);
+	if (m.en > 0) {
+		tri::Clean<CMeshO>::RemoveDegenerateEdge(m);
+		tri::Clean<CMeshO>::RemoveDuplicateEdge(m);
+	}
+	return deleted;
+}
@@ -0,0 +1,191 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef VERTEX_WELD_H
+#define VERTEX_WELD_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+Welding engine shared by the cleaning filters.
+
+SpatialHash stores a set of items in a uniform grid whose cells are hashed to
+64 bit keys. The (key, item) pairs are generated in parallel and radix sorted,
+so that the items of a cell are contiguous; an open addressing table then
+maps each key to its run of items. Two cells can collide on the same key: the
+queries return a superset of the items and the callers must check them.
+
+WeldVertices uses it to find the coincident vertices, merged in parallel with
+a lock-free union-find so that the result does not depend on the number of
+threads, and the vertices closer than a threshold, clustered like
+tri::Clean::ClusterVertex does; this clustering is serial inside each
+connected component of the vertices closer than threshold, the components are
+clustered in parallel.
+*/
+
+class SpatialHash
+{
+public:
+	/**
+	 * @brief Builds the hash of n items, inserting the item i in all the cells
+	 * overlapped by box(i). The grid has cubic cells of side cellSize, aligned
+	 * to origin.
+	 */
+	template<class BoxFunctor>
+	void build(size_t n, Scalarm cellSize, const Point3m& origin, BoxFunctor box);
+
+	/// calls f(item) for all the items inserted in the cell containing p
+	template<class Functor>
+	void forEachInCell(const Point3m& p, Functor f) const
+	{
+		int64_t c[3];
+		cellCoord(p, c);
+		visitCell(cellKey(c[0], c[1], c[2]), f);
+	}
+
+	/// calls f(item) for all the items inserted in the cells overlapped by b;
+	/// an item can be visited more than once
+	template<class Functor>
+	void forEachInBox(const Box3m& b, Functor f) const
+	{
+		int64_t lo[3], hi[3];
+		cellCoord(b.min, lo);
+		cellCoord(b.max, hi);
+		for (int64_t z = lo[2]; z <= hi[2]; ++z)
+			for (int64_t y = lo[1]; y <= hi[1]; ++y)
+				for (int64_t x = lo[0]; x <= hi[0]; ++x)
+					visitCell(cellKey(x, y, z), f);
+	}
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint32_t item;
+	};
+
+	static const uint64_t EMPTY = ~uint64_t(0);
+
+	void cellCoord(const Point3m& p, int64_t c[3]) const
+	{
+		for (int d = 0; d < 3; ++d)
+			c[d] = int64_t(std::floor((p[d] - origin[d]) / cellSize));
+	}
+
+	static uint64_t cellKey(int64_t x, int64_t y, int64_t z)
+	{
+		uint64_t h = uint64_t(x) * 0x9E3779B97F4A7C15ull;
+		h ^= uint64_t(y) * 0xC2B2AE3D27D4EB4Full;
+		h ^= uint64_t(z) * 0x165667B19E3779F9ull;
+		h ^= h >> 31;
+		h *= 0xBF58476D1CE4E5B9ull;
+		h ^= h >> 29;
+		return h == EMPTY ? 0 : h;
+	}
+
+	template<class Functor>
+	void visitCell(uint64_t key, Functor& f) const
+	{
+		if (tableSize == 0)
+			return;
+		for (size_t s = key & (tableSize - 1);; s = (s + 1) & (tableSize - 1)) {
+			const uint64_t k = table[s].load(std::memory_order_relaxed);
+			if (k == EMPTY)
+				return;
+			if (k == key) {
+				for (size_t i = runStart[tableRun[s]]; i < runStart[tableRun[s] + 1]; ++i)
+					f(entries[i].item);
+				return;
+			}
+		}
+	}
+
+	void sortAndIndex();
+
+	Scalarm cellSize = 1;
+	Point3m origin;
+
+	std::vector<Entry>  entries;  // sorted by key
+	std::vector<size_t> runStart; // entries of the i-th key: [runStart[i], runStart[i+1])
+
+	size_t                                 tableSize = 0;
+	std::unique_ptr<std::atomic<uint64_t>[]> table;
+	std::vector<uint32_t>                  tableRun;
+};
+
+template<class BoxFunctor>
+void SpatialHash::build(size_t n, Scalarm cellSize, const Point3m& origin, BoxFunctor box)
+{
+	this->cellSize = cellSize;
+	this->origin   = origin;
+
+	// number of cells of each item, then their (key, item) pairs
+	std::vector<size_t> offset(n + 1, 0);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long) n; ++i) {
+		const Box3m b = box(size_t(i));
+		int64_t     lo[3], hi[3];
+		cellCoord(b.min, lo);
+		cellCoord(b.max, hi);
+		offset[i + 1] = size_t((hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1));
+	}
+	for (size_t i = 0; i < n; ++i)
+		offset[i + 1] += offset[i];
+
+	entries.resize(offset[n]);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < (long long) n; ++i) {
+		const Box3m b = box(size_t(i));
+		int64_t     lo[3], hi[3];
+		cellCoord(b.min, lo);
+		cellCoord(b.max, hi);
+		size_t e = offset[i];
+		for (int64_t z = lo[2]; z <= hi[2]; ++z)
+			for (int64_t y = lo[1]; y <= hi[1]; ++y)
+				for (int64_t x = lo[0]; x <= hi[0]; ++x)
+					entries[e++] = Entry {cellKey(x, y, z), uint32_t(i)};
+	}
+	sortAndIndex();
+}
+
+/**
+ * @brief Merges the vertices with the same position if threshold is zero,
+ * else the vertices closer than threshold with the clustering of
+ * tri::Clean::MergeCloseVertex: in index order, each vertex not yet merged
+ * takes all the other free vertices closer than threshold, so that a chain of
+ * close vertices is not collapsed into a single one. Each group of vertices
+ * is replaced by the one with the lowest index, the faces and edges that
+ * become degenerate are deleted. Deleted vertices are skipped, and if
+ * onlyFlags is not zero also the vertices that have none of these flags
+ * (e.g. CVertexO::SELECTED or a user bit). Returns the number of deleted
+ * vertices.
+ */
+int WeldVertices(CMeshO& m, Scalarm threshold, vcg::CallBackPos* cb = nullptr, int onlyFlags = 0);
+
+#endif // VERTEX_WELD_H
@@ -347,6 +347,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 				"Viewport %i %i",
 				raster->shot.Intrinsics.ViewportPx[0],
 				raster->shot.Intrinsics.ViewportPx[1]);
+			const QImage rasterImg = raster->currentPlane->image();
 			for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
 				if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
 					Point2m pp = raster->shot.Project((*vi).P());
@@ -371,7 +372,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 							}
 
 							if (!use_depth || (depth <= (pdepth + eta))) {
-								QRgb pcolor = raster->currentPlane->image.pixel(
+								QRgb pcolor = rasterImg.pixel(
 									pp[0], raster->shot.Intrinsics.ViewportPx[1] - pp[1]);
 								(*vi).C() =
 									vcg::Color4b(qRed(pcolor), qGreen(pcolor), qBlue(pcolor), 255);
@@ -482,6 +483,9 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 					//  do_project = false;
 
 					if (do_project) {
+						// the image is decoded in background while the depth is rendered
+						raster.currentPlane->Prefetch();
+
 						// making context current
 						glContext->makeCurrent();
 
@@ -536,6 +540,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 							// silhouette_buff->dumppfm(dumpFileName);
 						}
 
+						const QImage rasterImg = raster.currentPlane->image();
 						for (vi = model->cm.vert.begin(); vi != model->cm.vert.end(); ++vi) {
 							if (!(*vi).IsD() && (!onselection || (*vi).IsS())) {
 								// pp is the projected point in image space
@@ -558,7 +563,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 
 										if (depth <= (pdepth + eta)) {
 											// determine color
-											QRgb pcolor = raster.currentPlane->image.pixel(
+											QRgb pcolor = rasterImg.pixel(
 												pp[0],
 												raster.shot.Intrinsics.ViewportPx[1] - pp[1]);
 											// determine weight
@@ -816,6 +821,9 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 					//  do_project = false;
 
 					if (do_project) {
+						// the image is decoded in background while the depth is rendered
+						raster.currentPlane->Prefetch();
+
 						// making context current
 						glContext->makeCurrent();
 
@@ -868,6 +876,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 							// silhouette_buff->dumpbmp(dumpFileName);
 						}
 
+						const QImage rasterImg = raster.currentPlane->image();
 						for (size_t texcount = 0; texcount < texels.size(); texcount++) {
 							Point2m pp = raster.shot.Project(texels[texcount].meshpoint);
 							// pray is the vector from the point-to-be-colored to the camera center
@@ -888,7 +897,7 @@ std::map<std::string, QVariant> FilterColorProjectionPlugin::applyFilter(
 
 									if (depth <= (pdepth + eta)) {
 										// determine color
-										QRgb pcolor = raster.currentPlane->image.pixel(
+										QRgb pcolor = rasterImg.pixel(
 											pp[0], raster.shot.Intrinsics.ViewportPx[1] - pp[1]);
 										// determine weight
 										pweight = 1.0;
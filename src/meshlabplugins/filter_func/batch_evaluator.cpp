@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "batch_evaluator.h"
+
+#include <cmath>
+#include <random>
+
+#include "string_conversion.h"
+
+// the generator is per thread, since the expressions can be evaluated in parallel
+static thread_local std::default_random_engine rndEngine(std::random_device {}());
+//Function to generate a random double number in [0..1) interval
+double ML_Rnd() { return std::generate_canonical<double, 24>(rndEngine); }
+//Function to generate a random integer number in [0..a) interval
+double ML_RandInt(const double a) { return std::floor(a*ML_Rnd()); }
+
+//Add rnd() and randint() custom functions to a mu::Parser
+void setCustomFunctions(mu::Parser& p)
+{
+	p.DefineFun("rnd", ML_Rnd);
+	p.DefineFun("randInt", ML_RandInt);
+}
+
+BatchEvaluator::BatchEvaluator(
+	const std::vector<std::string>&                   variableNames,
+	const std::vector<std::pair<std::string, double>>& constants,
+	const std::vector<std::string>&                   expressions,
+	const std::vector<std::string>&                   errorLabels) :
+		columns(variableNames.size() * BATCH_SIZE, 0),
+		parsers(expressions.size()),
+		results(expressions.size(), std::vector<double>(BATCH_SIZE, 0)),
+		labels(errorLabels)
+{
+	labels.resize(expressions.size());
+	for (unsigned int i = 0; i < parsers.size(); ++i) {
+		mu::Parser& p = parsers[i];
+		try {
+			// in bulk mode, the value of a variable for the k-th element is read at var_ptr + k
+			for (unsigned int j = 0; j < variableNames.size(); ++j)
+				p.DefineVar(conversion::fromStringToWString(variableNames[j]), column(j));
+			for (const auto& c : constants)
+				p.DefineConst(conversion::fromStringToWString(c.first), c.second);
+			setCustomFunctions(p);
+			p.SetExpr(conversion::fromStringToWString(expressions[i]));
+		}
+		catch (mu::Parser::exception_type& e) {
+			throw MLException(
+				QString::fromStdString(labels[i] + conversion::fromWStringToString(e.GetMsg())));
+		}
+	}
+}
+
+/**
+ * @brief Evaluates all the expressions on the first n elements of the batch.
+ * The values of the i-th expression are then available in result(i).
+ * Throws an MLException containing the errors of all the expressions that
+ * failed to compile or to evaluate.
+ */
+void BatchEvaluator::evaluate(int n)
+{
+	std::string errorMsg;
+	for (unsigned int i = 0; i < parsers.size(); ++i) {
+		try {
+			parsers[i].Eval(results[i].data(), n);
+		}
+		catch (mu::Parser::exception_type& e) {
+			if (labels[i].empty()) {
+				throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
+			}
+			errorMsg += labels[i] + conversion::fromWStringToString(e.GetMsg()) + "\n";
+		}
+	}
+	if (!errorMsg.empty())
+		throw MLException(QString::fromStdString(errorMsg));
+}
@@ -0,0 +1,144 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef FILTER_FUNC_BATCH_EVALUATOR_H
+#define FILTER_FUNC_BATCH_EVALUATOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <common/mlexception.h>
+
+#include "muParser.h"
+
+/**
+ * @brief The BatchEvaluator class evaluates a set of muparser expressions on
+ * batches of elements.
+ *
+ * The values of the variables are stored as a structure of arrays: each
+ * variable has a column of BATCH_SIZE values, and the i-th element of the batch
+ * is stored in the i-th position of all the columns. The columns are bound to
+ * the parsers once, in the constructor; the expressions are compiled to
+ * bytecode at their first evaluation and then evaluated using the muparser
+ * bulk mode.
+ *
+ * A BatchEvaluator must be used by a single thread: to evaluate the
+ * expressions in parallel, use one BatchEvaluator for each thread.
+ */
+class BatchEvaluator
+{
+public:
+	static const int BATCH_SIZE = 1024;
+
+	BatchEvaluator(
+		const std::vector<std::string>&                   variableNames,
+		const std::vector<std::pair<std::string, double>>& constants,
+		const std::vector<std::string>&                   expressions,
+		const std::vector<std::string>&                   errorLabels = std::vector<std::string>());
+
+	double*       column(int variable) { return &columns[variable * BATCH_SIZE]; }
+	const double* result(int expression) const { return results[expression].data(); }
+	int           expressionNumber() const { return (int) parsers.size(); }
+
+	void evaluate(int n);
+
+private:
+	std::vector<double>              columns;
+	std::vector<mu::Parser>          parsers;
+	std::vector<std::vector<double>> results;
+	std::vector<std::string>         labels;
+};
+
+void setCustomFunctions(mu::Parser& p);
+
+/**
+ * @brief Evaluates the given expressions on n elements.
+ *
+ * The elements are split in batches of BatchEvaluator::BATCH_SIZE elements that
+ * are processed in parallel; each thread compiles the expressions once in its
+ * own BatchEvaluator.
+ * load(be, i, k) must set the variables of the k-th element in the i-th row of
+ * the batch, and store(k, values) receives the values of all the expressions
+ * computed for the k-th element; k is an int64_t, since n can exceed the int
+ * range (e.g. the voxels of a large isosurface grid).
+ * Throws an MLException if some expression cannot be evaluated.
+ */
+template <typename Loader, typename Writer>
+void evaluateInBatches(
+	int64_t                                           n,
+	const std::vector<std::string>&                   variableNames,
+	const std::vector<std::pair<std::string, double>>& constants,
+	const std::vector<std::string>&                   expressions,
+	const std::vector<std::string>&                   errorLabels,
+	Loader                                            load,
+	Writer                                            store)
+{
+	const int64_t     batchSize   = BatchEvaluator::BATCH_SIZE;
+	const int64_t     batchNumber = (n + batchSize - 1) / batchSize;
+	std::atomic<bool> failed(false);
+	std::string       errorMsg;
+
+#pragma omp parallel
+	{
+		std::unique_ptr<BatchEvaluator> be;
+		std::vector<double>             values(expressions.size());
+
+#pragma omp for schedule(dynamic)
+		for (int64_t b = 0; b < batchNumber; ++b) {
+			if (failed)
+				continue;
+			const int64_t first = b * batchSize;
+			const int     size  = int(std::min(batchSize, n - first));
+			try {
+				if (!be)
+					be.reset(new BatchEvaluator(variableNames, constants, expressions, errorLabels));
+				for (int i = 0; i < size; ++i)
+					load(*be, i, first + i);
+				be->evaluate(size);
+			}
+			catch (MLException& e) {
+#pragma omp critical(batch_evaluator_error)
+				{
+					if (!failed)
+						errorMsg = e.what();
+					failed = true;
+				}
+				continue;
+			}
+			for (int i = 0; i < size; ++i) {
+				for (unsigned int j = 0; j < values.size(); ++j)
+					values[j] = be->result(j)[i];
+				store(first + i, values.data());
+			}
+		}
+	}
+	if (failed)
+		throw MLException(QString::fromStdString(errorMsg));
+}
+
+#endif // FILTER_FUNC_BATCH_EVALUATOR_H
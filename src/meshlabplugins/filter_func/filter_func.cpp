@@ -22,33 +22,19 @@
  ****************************************************************************/
 
 #include "filter_func.h"
-#include <random>
 #include <vcg/complex/algorithms/create/platonic.h>
 #include <vcg/complex/algorithms/create/marching_cubes.h>
 #include <vcg/complex/algorithms/create/mc_trivial_walker.h>
 
 #include "muParser.h"
+#include "batch_evaluator.h"
 #include "string_conversion.h"
 
-#include <random>
+#include <QElapsedTimer>
 
 using namespace mu;
 using namespace vcg;
 
-std::random_device randomDev;
-std::default_random_engine rndEngine(randomDev());
-//Function to generate a random double number in [0..1) interval
-double ML_Rnd() { return std::generate_canonical<double, 24>(rndEngine); }
-//Function to generate a random integer number in [0..a) interval
-double ML_RandInt(const double a) { return std::floor(a*ML_Rnd()); }
-
-//Add rnd() and randint() custom functions to a mu::Parser
-void setCustomFunctions(mu::Parser& p)
-{
-	p.DefineFun("rnd", ML_Rnd);
-	p.DefineFun("randInt", ML_RandInt);
-}
-
 // Constructor
 FilterFunctionPlugin::FilterFunctionPlugin()
 {
@@ -712,6 +698,90 @@ RichParameterList FilterFunctionPlugin::initParameterList(const QAction* action,
 	return parlst;
 }
 
+// columns of the per-vertex variables, in the same order of vertexVariableNames
+enum {
+	VV_X, VV_Y, VV_Z, VV_NX, VV_NY, VV_NZ, VV_R, VV_G, VV_B, VV_A, VV_Q, VV_VI, VV_VTU, VV_VTV, VV_TI, VV_VSEL,
+	VV_NUM
+};
+static const char* vertexVariableNames[VV_NUM] = {
+	"x", "y", "z", "nx", "ny", "nz", "r", "g", "b", "a", "q", "vi", "vtu", "vtv", "ti", "vsel"};
+
+// columns of the per-face variables, in the same order of faceVariableNames
+enum {
+	FV_X0, FV_Y0, FV_Z0, FV_X1, FV_Y1, FV_Z1, FV_X2, FV_Y2, FV_Z2,
+	FV_NX0, FV_NY0, FV_NZ0, FV_NX1, FV_NY1, FV_NZ1, FV_NX2, FV_NY2, FV_NZ2,
+	FV_R0, FV_G0, FV_B0, FV_A0, FV_R1, FV_G1, FV_B1, FV_A1, FV_R2, FV_G2, FV_B2, FV_A2,
+	FV_Q0, FV_Q1, FV_Q2,
+	FV_FR, FV_FG, FV_FB, FV_FA, FV_FNX, FV_FNY, FV_FNZ, FV_FQ,
+	FV_FI, FV_VI0, FV_VI1, FV_VI2,
+	FV_WTU0, FV_WTV0, FV_WTU1, FV_WTV1, FV_WTU2, FV_WTV2, FV_TI,
+	FV_VSEL0, FV_VSEL1, FV_VSEL2, FV_FSEL,
+	FV_NUM
+};
+static const char* faceVariableNames[FV_NUM] = {
+	"x0", "y0", "z0", "x1", "y1", "z1", "x2", "y2", "z2",
+	"nx0", "ny0", "nz0", "nx1", "ny1", "nz1", "nx2", "ny2", "nz2",
+	"r0", "g0", "b0", "a0", "r1", "g1", "b1", "a1", "r2", "g2", "b2", "a2",
+	"q0", "q1", "q2",
+	"fr", "fg", "fb", "fa", "fnx", "fny", "fnz", "fq",
+	"fi", "vi0", "vi1", "vi2",
+	"wtu0", "wtv0", "wtu1", "wtv1", "wtu2", "wtv2", "ti",
+	"vsel0", "vsel1", "vsel2", "fsel"};
+
+// evaluate the expressions on all the (selected) vertices of the mesh, and give the
+// values computed for each vertex to the store function, called concurrently on different vertices
+template <typename Writer>
+void FilterFunctionPlugin::evaluatePerVertex(
+	CMeshO&                         m,
+	const std::vector<std::string>& expressions,
+	const std::vector<std::string>& errorLabels,
+	bool                            onSelected,
+	Writer                          store)
+{
+	std::vector<int> elems;
+	elems.reserve(m.vn);
+	for (unsigned int i = 0; i < m.vert.size(); ++i)
+		if (!m.vert[i].IsD() && (!onSelected || m.vert[i].IsS()))
+			elems.push_back(i);
+
+	std::vector<std::string> names = setPerVertexVariables(m);
+	evaluateInBatches(
+		(int64_t) elems.size(),
+		names,
+		bboxConstants,
+		expressions,
+		errorLabels,
+		[&](BatchEvaluator& be, int i, int64_t k) { setAttributes(m.vert[elems[k]], m, be, i); },
+		[&](int64_t k, const double* values) { store(m.vert[elems[k]], values); });
+}
+
+// evaluate the expressions on all the (selected) faces of the mesh, and give the
+// values computed for each face to the store function, called concurrently on different faces
+template <typename Writer>
+void FilterFunctionPlugin::evaluatePerFace(
+	CMeshO&                         m,
+	const std::vector<std::string>& expressions,
+	const std::vector<std::string>& errorLabels,
+	bool                            onSelected,
+	Writer                          store)
+{
+	std::vector<int> elems;
+	elems.reserve(m.fn);
+	for (unsigned int i = 0; i < m.face.size(); ++i)
+		if (!m.face[i].IsD() && (!onSelected || m.face[i].IsS()))
+			elems.push_back(i);
+
+	std::vector<std::string> names = setPerFaceVariables(m);
+	evaluateInBatches(
+		(int64_t) elems.size(),
+		names,
+		bboxConstants,
+		expressions,
+		errorLabels,
+		[&](BatchEvaluator& be, int i, int64_t k) { setAttributes(m.face[elems[k]], m, be, i); },
+		[&](int64_t k, const double* values) { store(m.face[elems[k]], values); });
+}
+
 // The Real Core Function doing the actual mesh processing.
 std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 	const QAction*           filter,
@@ -720,134 +790,87 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 	unsigned int& /*postConditionMask*/,
 	vcg::CallBackPos* cb)
 {
-	errorMsg = "";
 	if (this->getClass(filter) == FilterPlugin::MeshCreation)
 		md.addNewMesh("", this->filterName(ID(filter)));
 	MeshModel& m = *(md.mm());
 	Q_UNUSED(cb);
 
-	//Set values to parser variables related to BBox
+	//Set values to parser constants related to BBox
 	const auto &bbox = m.cm.bbox;
-	xmin = bbox.min.X();
-	ymin = bbox.min.Y();
-	zmin = bbox.min.Z();
-	xmax = bbox.max.X();
-	ymax = bbox.max.Y();
-	zmax = bbox.max.Z();
-	xdim = bbox.DimX();
-	ydim = bbox.DimY();
-	zdim = bbox.DimZ();
-	bbdiag = bbox.Diag();
 	auto bbCenter = bbox.Center();
-	xmid = bbCenter.X();
-	ymid = bbCenter.Y();
-	zmid = bbCenter.Z();
+	bboxConstants = {
+		{"xmin", bbox.min.X()},
+		{"ymin", bbox.min.Y()},
+		{"zmin", bbox.min.Z()},
+		{"xmax", bbox.max.X()},
+		{"ymax", bbox.max.Y()},
+		{"zmax", bbox.max.Z()},
+		{"xdim", bbox.DimX()},
+		{"ydim", bbox.DimY()},
+		{"zdim", bbox.DimZ()},
+		{"bbdiag", bbox.Diag()},
+		{"xmid", bbCenter.X()},
+		{"ymid", bbCenter.Y()},
+		{"zmid", bbCenter.Z()}};
 
 	switch (ID(filter)) {
 	case FF_VERT_SELECTION: {
-		std::string expr  = par.getString("condSelect").toStdString();
-		auto        wexpr = conversion::fromStringToWString(expr);
-
-		// muparser initialization and explicitly define parser variables
-		Parser p;
+		std::string expr = par.getString("condSelect").toStdString();
 
-		setPerVertexVariables(p, m.cm);
-		setCustomFunctions(p);
-
-		// set expression inserted by user as string (required by muparser)
-		p.SetExpr(wexpr);
-
-		int    numvert = 0;
-		time_t start   = clock();
+		QElapsedTimer timer;
+		timer.start();
 
 		// every parser variables is related to vertex coord and attributes.
-		CMeshO::VertexIterator vi;
-		for (vi = m.cm.vert.begin(); vi != m.cm.vert.end(); ++vi)
-			if (!(*vi).IsD()) {
-				setAttributes(vi, m.cm);
-
-				bool selected = false;
-
-				// use parser to evaluate boolean function specified above
-				// in case of fail, error dialog contains details of parser's error
-				try {
-					selected = p.Eval();
-				}
-				catch (Parser::exception_type& e) {
-					throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-				}
-
-				// set vertex as selected or clear selection
-				if (selected) {
-					(*vi).SetS();
-					numvert++;
-				}
-				else
-					(*vi).ClearS();
-			}
+		// the boolean function is evaluated with the parser,
+		// in case of fail, error dialog contains details of parser's error
+		evaluatePerVertex(m.cm, {expr}, {}, false, [](CMeshO::VertexType& v, const double* val) {
+			// set vertex as selected or clear selection
+			if (val[0] != 0)
+				v.SetS();
+			else
+				v.ClearS();
+		});
+		int numvert = tri::UpdateSelection<CMeshO>::VertexCount(m.cm);
 
 		// if succeeded log stream contains number of vertices and time elapsed
-		log("selected %d vertices in %.2f sec.",
-			numvert,
-			(clock() - start) / (float) CLOCKS_PER_SEC);
+		log("selected %d vertices in %.2f sec.", numvert, timer.elapsed() / 1000.0f);
 	} break;
 
 	case FF_FACE_SELECTION: {
-		QString select = par.getString("condSelect");
+		std::string expr = par.getString("condSelect").toStdString();
 
-		// muparser initialization and explicitly define parser variables
-		Parser p;
-		setPerFaceVariables(p, m.cm);
-		setCustomFunctions(p);
-		
-		// set expression inserted by user as string (required by muparser)
-		p.SetExpr(conversion::fromStringToWString(select.toStdString()));
-
-		int    numface = 0;
-		time_t start   = clock();
+		QElapsedTimer timer;
+		timer.start();
 
 		// every parser variables is related to face attributes.
-		CMeshO::FaceIterator fi;
-		for (fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi)
-			if (!(*fi).IsD()) {
-				setAttributes(fi, m.cm);
-
-				bool selected = false;
-
-				// use parser to evaluate boolean function specified above
-				// in case of fail, error dialog contains details of parser's error
-				try {
-					selected = p.Eval();
-				}
-				catch (Parser::exception_type& e) {
-					throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-				}
-
-				// set face as selected or clear selection
-				if (selected) {
-					(*fi).SetS();
-					numface++;
-				}
-				else
-					(*fi).ClearS();
-			}
+		evaluatePerFace(m.cm, {expr}, {}, false, [](CMeshO::FaceType& f, const double* val) {
+			// set face as selected or clear selection
+			if (val[0] != 0)
+				f.SetS();
+			else
+				f.ClearS();
+		});
+		int numface = tri::UpdateSelection<CMeshO>::FaceCount(m.cm);
 
 		// if succeeded log stream contains number of vertices and time elapsed
-		log("selected %d faces in %.2f sec.", numface, (clock() - start) / (float) CLOCKS_PER_SEC);
+		log("selected %d faces in %.2f sec.", numface, timer.elapsed() / 1000.0f);
 
 	} break;
 
 	case FF_GEOM_FUNC:
 	case FF_VERT_COLOR:
 	case FF_VERT_NORMAL: {
-		std::string func_x, func_y, func_z, func_a;
 		// FF_VERT_COLOR : x = r, y = g, z = b
 		// FF_VERT_NORMAL : x = r, y = g, z = b
-		func_x = par.getString("x").toStdString();
-		func_y = par.getString("y").toStdString();
-		func_z = par.getString("z").toStdString();
-		if (ID(filter) == FF_VERT_COLOR)
-			func_a = par.getString("a").toStdString();
+		std::vector<std::string> funcs = {
+			par.getString("x").toStdString(),
+			par.getString("y").toStdString(),
+			par.getString("z").toStdString()};
+		std::vector<std::string> labels = {"1st func : ", "2nd func : ", "3rd func : "};
+		if (ID(filter) == FF_VERT_COLOR) {
+			funcs.push_back(par.getString("a").toStdString());
+			labels.push_back("4th func : ");
+		}
 
 		bool onSelected = par.getBool("onselected");
 
@@ -864,77 +887,23 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 			tri::UpdateSelection<CMeshO>::VertexFromFaceLoose(m.cm);
 		}
 
-		// muparser initialization and explicitly define parser variables
-		// function for x,y and z must use different parser and variables
-		Parser p1, p2, p3, p4;
-		setPerVertexVariables(p1, m.cm);
-		setPerVertexVariables(p2, m.cm);
-		setPerVertexVariables(p3, m.cm);
-		setPerVertexVariables(p4, m.cm);
-
-		setCustomFunctions(p1);
-		setCustomFunctions(p2);
-		setCustomFunctions(p3);
-		setCustomFunctions(p4);
-
-		p1.SetExpr(conversion::fromStringToWString(func_x));
-		p2.SetExpr(conversion::fromStringToWString(func_y));
-		p3.SetExpr(conversion::fromStringToWString(func_z));
-		p4.SetExpr(conversion::fromStringToWString(func_a));
-
-		double  newx = 0, newy = 0, newz = 0, newa = 255;
-		QString errorMsg = "";
-
-		time_t start = clock();
+		if (ID(filter) == FF_VERT_COLOR)
+			m.updateDataMask(MeshModel::MM_VERTCOLOR);
 
-		// every parser variables is related to vertex coord and attributes.
-		CMeshO::VertexIterator vi;
-		for (vi = m.cm.vert.begin(); vi != m.cm.vert.end(); ++vi)
-			if (!(*vi).IsD())
-				if ((!onSelected) || ((*vi).IsS())) {
-					setAttributes(vi, m.cm);
-
-					// every function is evaluated by different parser.
-					// errorMessage dialog contains errors for func x, func y and func z
-					try {
-						newx = p1.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("1st func : ", e);
-					}
-					try {
-						newy = p2.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("2nd func : ", e);
-					}
-					try {
-						newz = p3.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("3rd func : ", e);
-					}
-					if (ID(filter) == FF_VERT_COLOR) {
-						try {
-							newa = p4.Eval();
-						}
-						catch (Parser::exception_type& e) {
-							showParserError("4th func : ", e);
-						}
-					}
-					if (errorMsg != "")
-						throw MLException(errorMsg);
-
-					if (ID(filter) == FF_GEOM_FUNC) // set new vertex coord for this iteration
-						(*vi).P() = Point3m(newx, newy, newz);
-					if (ID(filter) == FF_VERT_NORMAL) // set new color for this iteration
-						(*vi).N() = Point3m(newx, newy, newz);
-					if (ID(filter) == FF_VERT_COLOR) // set new color for this iteration
-					{
-						(*vi).C() = Color4b(newx, newy, newz, newa);
-						m.updateDataMask(MeshModel::MM_VERTCOLOR);
-					}
-				}
+		QElapsedTimer timer;
+		timer.start();
+
+		// every function is evaluated by a different parser;
+		// errorMessage dialog contains errors for func x, func y and func z
+		const int filterId = ID(filter);
+		evaluatePerVertex(m.cm, funcs, labels, onSelected, [filterId](CMeshO::VertexType& v, const double* val) {
+			if (filterId == FF_GEOM_FUNC) // set new vertex coord for this iteration
+				v.P() = Point3m(val[0], val[1], val[2]);
+			if (filterId == FF_VERT_NORMAL) // set new normal for this iteration
+				v.N() = Point3m(val[0], val[1], val[2]);
+			if (filterId == FF_VERT_COLOR) // set new color for this iteration
+				v.C() = Color4b(val[0], val[1], val[2], val[3]);
+		});
 
 		if (ID(filter) == FF_GEOM_FUNC) {
 			// update bounding box, normalize normals
@@ -944,9 +913,7 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		}
 
 		// if succeeded log stream contains number of vertices processed and time elapsed
-		log("%d vertices processed in %.2f sec.",
-			m.cm.vn,
-			(clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d vertices processed in %.2f sec.", m.cm.vn, timer.elapsed() / 1000.0f);
 	} break;
 
 	case FF_VERT_QUALITY: {
@@ -968,33 +935,12 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 
 		m.updateDataMask(MeshModel::MM_VERTQUALITY);
 
-		// muparser initialization and define custom variables
-		Parser p;
-		setPerVertexVariables(p, m.cm);
-
-		//Add rnd() and randInt() internal functions
-		setCustomFunctions(p);
-
-		// set expression to calc with parser
-		p.SetExpr(conversion::fromStringToWString(func_q));
-
 		// every parser variables is related to vertex coord and attributes.
-		time_t                 start = clock();
-		CMeshO::VertexIterator vi;
-		for (vi = m.cm.vert.begin(); vi != m.cm.vert.end(); ++vi)
-			if (!(*vi).IsD())
-				if ((!onSelected) || ((*vi).IsS())) {
-					setAttributes(vi, m.cm);
-
-					// use parser to evaluate function specified above
-					// in case of fail, errorMessage dialog contains details of parser's error
-					try {
-						(*vi).Q() = p.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-					}
-				}
+		QElapsedTimer timer;
+		timer.start();
+		evaluatePerVertex(m.cm, {func_q}, {}, onSelected, [](CMeshO::VertexType& v, const double* val) {
+			v.Q() = val[0];
+		});
 
 		// normalize quality with values in [0..1]
 		if (par.getBool("normalize"))
@@ -1006,9 +952,7 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 			m.updateDataMask(MeshModel::MM_VERTCOLOR);
 		}
 		// if succeeded log stream contains number of vertices and time elapsed
-		log("%d vertices processed in %.2f sec.",
-			m.cm.vn,
-			(clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d vertices processed in %.2f sec.", m.cm.vn, timer.elapsed() / 1000.0f);
 	} break;
 	case FF_VERT_TEXTURE_FUNC: {
 		std::string func_u     = par.getString("u").toStdString();
@@ -1030,53 +974,25 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 
 		m.updateDataMask(MeshModel::MM_VERTTEXCOORD);
 
-		// muparser initialization and define custom variables
-		Parser pu, pv;
-		setPerVertexVariables(pu, m.cm);
-		setPerVertexVariables(pv, m.cm);
-		setCustomFunctions(pu);
-		setCustomFunctions(pv);
-
-		// set expression to calc with parser
-#ifdef _UNICODE
-		pu.SetExpr(conversion::fromStringToWString(func_u));
-		pv.SetExpr(conversion::fromStringToWString(func_v));
-#else
-		pu.SetExpr(func_u);
-		pv.SetExpr(func_v);
-#endif
-
 		// every parser variables is related to vertex coord and attributes.
-		time_t                 start = clock();
-		CMeshO::VertexIterator vi;
-		for (vi = m.cm.vert.begin(); vi != m.cm.vert.end(); ++vi)
-			if (!(*vi).IsD())
-				if ((!onSelected) || ((*vi).IsS())) {
-					setAttributes(vi, m.cm);
-
-					// use parser to evaluate function specified above
-					// in case of fail, errorMessage dialog contains details of parser's error
-					try {
-						(*vi).T().U() = pu.Eval();
-						(*vi).T().V() = pv.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-					}
-				}
-
-		log("%d vertices processed in %.2f sec.",
-			m.cm.vn,
-			(clock() - start) / (float) CLOCKS_PER_SEC);
+		QElapsedTimer timer;
+		timer.start();
+		evaluatePerVertex(m.cm, {func_u, func_v}, {}, onSelected, [](CMeshO::VertexType& v, const double* val) {
+			v.T().U() = val[0];
+			v.T().V() = val[1];
+		});
+
+		log("%d vertices processed in %.2f sec.", m.cm.vn, timer.elapsed() / 1000.0f);
 	} break;
 	case FF_WEDGE_TEXTURE_FUNC: {
-		std::string func_u0    = par.getString("u0").toStdString();
-		std::string func_v0    = par.getString("v0").toStdString();
-		std::string func_u1    = par.getString("u1").toStdString();
-		std::string func_v1    = par.getString("v1").toStdString();
-		std::string func_u2    = par.getString("u2").toStdString();
-		std::string func_v2    = par.getString("v2").toStdString();
-		bool        onSelected = par.getBool("onselected");
+		std::vector<std::string> funcs = {
+			par.getString("u0").toStdString(),
+			par.getString("v0").toStdString(),
+			par.getString("u1").toStdString(),
+			par.getString("v1").toStdString(),
+			par.getString("u2").toStdString(),
+			par.getString("v2").toStdString()};
+		bool onSelected = par.getBool("onselected");
 
 		if (onSelected && m.cm.sfn == 0) // if no selection, fail
 		{
@@ -1086,57 +1002,25 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 
 		m.updateDataMask(MeshModel::MM_VERTTEXCOORD);
 
-		// muparser initialization and define custom variables
-		Parser pu0, pv0, pu1, pv1, pu2, pv2;
-		setPerFaceVariables(pu0, m.cm);
-		setPerFaceVariables(pv0, m.cm);
-		setPerFaceVariables(pu1, m.cm);
-		setPerFaceVariables(pv1, m.cm);
-		setPerFaceVariables(pu2, m.cm);
-		setPerFaceVariables(pv2, m.cm);
-		setCustomFunctions(pu0);
-		setCustomFunctions(pv0);
-		setCustomFunctions(pu1);
-		setCustomFunctions(pv1);
-		setCustomFunctions(pu2);
-		setCustomFunctions(pv2);
-
-		// set expression to calc with parser
-		pu0.SetExpr(conversion::fromStringToWString(func_u0));
-		pv0.SetExpr(conversion::fromStringToWString(func_v0));
-		pu1.SetExpr(conversion::fromStringToWString(func_u1));
-		pv1.SetExpr(conversion::fromStringToWString(func_v1));
-		pu2.SetExpr(conversion::fromStringToWString(func_u2));
-		pv2.SetExpr(conversion::fromStringToWString(func_v2));
-
 		// every parser variables is related to vertex coord and attributes.
-		time_t start = clock();
-		for (CMeshO::FaceIterator fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi)
-			if (!(*fi).IsD())
-				if ((!onSelected) || ((*fi).IsS())) {
-					setAttributes(fi, m.cm);
-
-					// use parser to evaluate function specified above
-					// in case of fail, errorMessage dialog contains details of parser's error
-					try {
-						(*fi).WT(0).U() = pu0.Eval();
-						(*fi).WT(0).V() = pv0.Eval();
-						(*fi).WT(1).U() = pu1.Eval();
-						(*fi).WT(1).V() = pv1.Eval();
-						(*fi).WT(2).U() = pu2.Eval();
-						(*fi).WT(2).V() = pv2.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-					}
-				}
-
-		log("%d faces processed in %.2f sec.", m.cm.fn, (clock() - start) / (float) CLOCKS_PER_SEC);
+		QElapsedTimer timer;
+		timer.start();
+		evaluatePerFace(m.cm, funcs, {}, onSelected, [](CMeshO::FaceType& f, const double* val) {
+			f.WT(0).U() = val[0];
+			f.WT(0).V() = val[1];
+			f.WT(1).U() = val[2];
+			f.WT(1).V() = val[3];
+			f.WT(2).U() = val[4];
+			f.WT(2).V() = val[5];
+		});
+
+		log("%d faces processed in %.2f sec.", m.cm.fn, timer.elapsed() / 1000.0f);
 	} break;
 		case FF_FACE_NORMAL: {
-		std::string func_nx     = par.getString("x").toStdString();
-		std::string func_ny     = par.getString("y").toStdString();
-		std::string func_nz     = par.getString("z").toStdString();
+		std::vector<std::string> funcs = {
+			par.getString("x").toStdString(),
+			par.getString("y").toStdString(),
+			par.getString("z").toStdString()};
 		bool        onSelected = par.getBool("onselected");
 		if (onSelected && m.cm.sfn == 0) // if no selection, fail
 		{
@@ -1144,70 +1028,30 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 			throw MLException("Cannot apply only on selection: there is no selection");
 		}
 		m.updateDataMask(MeshModel::MM_FACENORMAL);
-		Parser p_nx, p_ny, p_nz;
-		
-		setPerFaceVariables(p_nx, m.cm);
-		setPerFaceVariables(p_ny, m.cm);
-		setPerFaceVariables(p_nz, m.cm);
-		setCustomFunctions(p_nx);
-		setCustomFunctions(p_ny);
-		setCustomFunctions(p_nz);
-			
-		p_nx.SetExpr(conversion::fromStringToWString(func_nx));
-		p_ny.SetExpr(conversion::fromStringToWString(func_ny));
-		p_nz.SetExpr(conversion::fromStringToWString(func_nz));
-		
-		
-		double nx = 0, ny = 0, nz = 0;
-		errorMsg = "";
-		
-		time_t start = clock();
+
+		QElapsedTimer timer;
+		timer.start();
 		
 		// every parser variables is related to face attributes.
-		for (CMeshO::FaceIterator  fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi)
-			if (!(*fi).IsD())
-				if ((!onSelected) || ((*fi).IsS())) {
-					setAttributes(fi, m.cm);
-					
-					// evaluate functions to generate new color
-					// in case of fail, error dialog contains details of parser's error
-					try {
-						nx = p_nx.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func nx: ", e);
-					}
-					try {
-						ny = p_ny.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func ny: ", e);
-					}
-					try {
-						nz = p_nz.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func nz: ", e);
-					}					
-					
-					if (errorMsg != "")
-						throw MLException(errorMsg);
-					
-					// set new color for this iteration
-					(*fi).N() = Point3m(nx,ny,nz);
-				}
+		// in case of fail, error dialog contains details of parser's error
+		evaluatePerFace(m.cm, funcs, {"func nx: ", "func ny: ", "func nz: "}, onSelected,
+			[](CMeshO::FaceType& f, const double* val) {
+				// set new normal for this iteration
+				f.N() = Point3m(val[0], val[1], val[2]);
+			});
 		
 		// if succeeded log stream contains number of vertices processed and time elapsed
-		log("%d faces processed in %.2f sec.", m.cm.fn, (clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d faces processed in %.2f sec.", m.cm.fn, timer.elapsed() / 1000.0f);
 		
 		
 	} break;
 	case FF_FACE_COLOR: {
-		std::string func_r     = par.getString("r").toStdString();
-		std::string func_g     = par.getString("g").toStdString();
-		std::string func_b     = par.getString("b").toStdString();
-		std::string func_a     = par.getString("a").toStdString();
-		bool        onSelected = par.getBool("onselected");
+		std::vector<std::string> funcs = {
+			par.getString("r").toStdString(),
+			par.getString("g").toStdString(),
+			par.getString("b").toStdString(),
+			par.getString("a").toStdString()};
+		bool onSelected = par.getBool("onselected");
 
 		if (onSelected && m.cm.sfn == 0) // if no selection, fail
 		{
@@ -1217,73 +1061,19 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 
 		m.updateDataMask(MeshModel::MM_FACECOLOR);
 
-		// muparser initialization and explicitly define parser variables
-		// every function must uses own parser and variables
-		Parser p1, p2, p3, p4;
-
-		setPerFaceVariables(p1, m.cm);
-		setPerFaceVariables(p2, m.cm);
-		setPerFaceVariables(p3, m.cm);
-		setPerFaceVariables(p4, m.cm);
-		setCustomFunctions(p1);
-		setCustomFunctions(p2);
-		setCustomFunctions(p3);
-		setCustomFunctions(p4);
-
-		p1.SetExpr(conversion::fromStringToWString(func_r));
-		p2.SetExpr(conversion::fromStringToWString(func_g));
-		p3.SetExpr(conversion::fromStringToWString(func_b));
-		p4.SetExpr(conversion::fromStringToWString(func_a));
-
-		// RGB is related to every face
-		CMeshO::FaceIterator fi;
-		double               newr = 0, newg = 0, newb = 0, newa = 255;
-		errorMsg = "";
-
-		time_t start = clock();
+		QElapsedTimer timer;
+		timer.start();
 
 		// every parser variables is related to face attributes.
-		for (fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi)
-			if (!(*fi).IsD())
-				if ((!onSelected) || ((*fi).IsS())) {
-					setAttributes(fi, m.cm);
-
-					// evaluate functions to generate new color
-					// in case of fail, error dialog contains details of parser's error
-					try {
-						newr = p1.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func r: ", e);
-					}
-					try {
-						newg = p2.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func g: ", e);
-					}
-					try {
-						newb = p3.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func b: ", e);
-					}
-					try {
-						newa = p4.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func a: ", e);
-					}
-
-					if (errorMsg != "")
-						throw MLException(errorMsg);
-
-					// set new color for this iteration
-					(*fi).C() = Color4b(newr, newg, newb, newa);
-				}
+		// in case of fail, error dialog contains details of parser's error
+		evaluatePerFace(m.cm, funcs, {"func r: ", "func g: ", "func b: ", "func a: "}, onSelected,
+			[](CMeshO::FaceType& f, const double* val) {
+				// set new color for this iteration
+				f.C() = Color4b(val[0], val[1], val[2], val[3]);
+			});
 
 		// if succeeded log stream contains number of vertices processed and time elapsed
-		log("%d faces processed in %.2f sec.", m.cm.fn, (clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d faces processed in %.2f sec.", m.cm.fn, timer.elapsed() / 1000.0f);
 
 	} break;
 
@@ -1299,35 +1089,13 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 
 		m.updateDataMask(MeshModel::MM_FACEQUALITY);
 
-		// muparser initialization and define custom variables
-		Parser pf;
-		setPerFaceVariables(pf, m.cm);
-		setCustomFunctions(pf);
-
-		// set expression to calc with parser
-		pf.SetExpr(conversion::fromStringToWString(func_q));
-
-		time_t start = clock();
-		errorMsg     = "";
+		QElapsedTimer timer;
+		timer.start();
 
 		// every parser variables is related to face attributes.
-		CMeshO::FaceIterator fi;
-		for (fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi)
-			if (!(*fi).IsD())
-				if ((!onSelected) || ((*fi).IsS())) {
-					setAttributes(fi, m.cm);
-
-					// evaluate functions to generate new quality
-					// in case of fail, error dialog contains details of parser's error
-					try {
-						(*fi).Q() = pf.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						showParserError("func q: ", e);
-					}
-					if (errorMsg != "")
-						throw MLException(errorMsg);
-				}
+		evaluatePerFace(m.cm, {func_q}, {"func q: "}, onSelected, [](CMeshO::FaceType& f, const double* val) {
+			f.Q() = val[0];
+		});
 
 		// normalize quality with values in [0..1]
 		if (par.getBool("normalize"))
@@ -1340,7 +1108,7 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		}
 
 		// if succeeded log stream contains number of faces processed and time elapsed
-		log("%d faces processed in %.2f sec.", m.cm.fn, (clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d faces processed in %.2f sec.", m.cm.fn, timer.elapsed() / 1000.0f);
 
 	} break;
 
@@ -1360,40 +1128,16 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		else
 			h = tri::Allocator<CMeshO>::AddPerVertexAttribute<Scalarm>(m.cm, name);
 
-		Parser p;
-		setPerVertexVariables(p, m.cm);
-		setCustomFunctions(p);
-
-		p.SetExpr(conversion::fromStringToWString(expr));
-
-		time_t start = clock();
+		QElapsedTimer timer;
+		timer.start();
 
 		// perform calculation of attribute's value with function specified by user
-		CMeshO::VertexIterator vi;
-		for (vi = m.cm.vert.begin(); vi != m.cm.vert.end(); ++vi)
-			if (!(*vi).IsD()) {
-				setAttributes(vi, m.cm);
-
-				// add new user-defined attribute
-				try {
-					h[vi] = p.Eval();
-				}
-				catch (Parser::exception_type& e) {
-					throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-				}
-			}
-
-		// add string, double and handler to vector.
-		// vectors keep tracks of new attributes and let muparser use explicit variables
-		// it's possible to use custom attributes in other filters
-		v_attrNames.push_back(name);
-		v_attrValue.push_back(0);
-		v_handlers.push_back(h);
+		evaluatePerVertex(m.cm, {expr}, {}, false, [&h](CMeshO::VertexType& v, const double* val) {
+			h[v] = val[0];
+		});
 
 		// if succeeded log stream contains number of vertices processed and time elapsed
-		log("%d vertices processed in %.2f sec.",
-			m.cm.vn,
-			(clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d vertices processed in %.2f sec.", m.cm.vn, timer.elapsed() / 1000.0f);
 
 	} break;
 
@@ -1413,38 +1157,26 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		}
 		else
 			h = tri::Allocator<CMeshO>::AddPerFaceAttribute<Scalarm>(m.cm, name);
-		Parser p;
-		setPerFaceVariables(p, m.cm);
-		setCustomFunctions(p);		
-		p.SetExpr(conversion::fromStringToWString(expr));
 
-		time_t start = clock();
+		QElapsedTimer timer;
+		timer.start();
 
 		// every parser variables is related to face attributes.
-		CMeshO::FaceIterator fi;
-		for (fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi)
-			if (!(*fi).IsD()) {
-				setAttributes(fi, m.cm);
-
-				// add new user-defined attribute
-				try {
-					h[fi] = p.Eval();
-				}
-				catch (Parser::exception_type& e) {
-					throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-				}
-			}
+		evaluatePerFace(m.cm, {expr}, {}, false, [&h](CMeshO::FaceType& f, const double* val) {
+			h[f] = val[0];
+		});
 
 		// if succeeded log stream contains number of vertices processed and time elapsed
-		log("%d faces processed in %.2f sec.", m.cm.fn, (clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d faces processed in %.2f sec.", m.cm.fn, timer.elapsed() / 1000.0f);
 
 	} break;
 
 	case FF_DEF_VERT_POINT_ATTRIB: {
 		std::string name = par.getString("name").toStdString();
-		std::string x_expr = par.getString("x_expr").toStdString();
-		std::string y_expr = par.getString("y_expr").toStdString();
-		std::string z_expr = par.getString("z_expr").toStdString();
+		std::vector<std::string> funcs = {
+			par.getString("x_expr").toStdString(),
+			par.getString("y_expr").toStdString(),
+			par.getString("z_expr").toStdString()};
 		checkAttributeName(name);
 
 		// add per-vertex attribute with type float and name specified by user
@@ -1458,56 +1190,25 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		else
 			h = tri::Allocator<CMeshO>::AddPerVertexAttribute<Point3m>(m.cm, name);
 
-		Parser p_x, p_y, p_z;
-		setPerVertexVariables(p_x, m.cm);
-		setPerVertexVariables(p_y, m.cm);
-		setPerVertexVariables(p_z, m.cm);
-		setCustomFunctions(p_x);
-		setCustomFunctions(p_y);
-		setCustomFunctions(p_z);
-
-		p_x.SetExpr(conversion::fromStringToWString(x_expr));
-		p_y.SetExpr(conversion::fromStringToWString(y_expr));
-		p_z.SetExpr(conversion::fromStringToWString(z_expr));
-
-		time_t start = clock();
+		QElapsedTimer timer;
+		timer.start();
 
 		// perform calculation of attribute's value with function specified by user
-		CMeshO::VertexIterator vi;
-		for (vi = m.cm.vert.begin(); vi != m.cm.vert.end(); ++vi)
-			if (!(*vi).IsD()) {
-				setAttributes(vi, m.cm);
-
-				try {
-					h[vi][0] = p_x.Eval();
-					h[vi][1] = p_y.Eval();
-					h[vi][2] = p_z.Eval();
-				}
-				catch (Parser::exception_type& e) {
-					throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-				}
-			}
-
-		// add string, double and handler to vector.
-		// vectors keep tracks of new attributes and let muparser use explicit variables
-		// it's possible to use custom attributes in other filters
-
-		//v_attrNames.push_back(name);
-		//v_attrValue.push_back(0);
-		//v_handlers.push_back(h);
+		evaluatePerVertex(m.cm, funcs, {}, false, [&h](CMeshO::VertexType& v, const double* val) {
+			h[v] = Point3m(val[0], val[1], val[2]);
+		});
 
 		// if succeeded log stream contains number of vertices processed and time elapsed
-		log("%d vertices processed in %.2f sec.",
-			m.cm.vn,
-			(clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d vertices processed in %.2f sec.", m.cm.vn, timer.elapsed() / 1000.0f);
 
 	} break;
 
 	case FF_DEF_FACE_POINT_ATTRIB: {
 		std::string name = par.getString("name").toStdString();
-		std::string x_expr = par.getString("x_expr").toStdString();
-		std::string y_expr = par.getString("y_expr").toStdString();
-		std::string z_expr = par.getString("z_expr").toStdString();
+		std::vector<std::string> funcs = {
+			par.getString("x_expr").toStdString(),
+			par.getString("y_expr").toStdString(),
+			par.getString("z_expr").toStdString()};
 		checkAttributeName(name);
 
 		// add per-face attribute with type float and name specified by user
@@ -1521,38 +1222,17 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		}
 		else
 			h = tri::Allocator<CMeshO>::AddPerFaceAttribute<Point3m>(m.cm, name);
-		Parser p_x, p_y, p_z;
-		setPerFaceVariables(p_x, m.cm);
-		setPerFaceVariables(p_y, m.cm);
-		setPerFaceVariables(p_z, m.cm);
-		setCustomFunctions(p_x);
-		setCustomFunctions(p_y);
-		setCustomFunctions(p_z);
-		p_x.SetExpr(conversion::fromStringToWString(x_expr));
-		p_y.SetExpr(conversion::fromStringToWString(y_expr));
-		p_z.SetExpr(conversion::fromStringToWString(z_expr));
-
-		time_t start = clock();
+
+		QElapsedTimer timer;
+		timer.start();
 
 		// every parser variables is related to face attributes.
-		CMeshO::FaceIterator fi;
-		for (fi = m.cm.face.begin(); fi != m.cm.face.end(); ++fi)
-			if (!(*fi).IsD()) {
-				setAttributes(fi, m.cm);
-
-				// add new user-defined attribute
-				try {
-					h[fi][0] = p_x.Eval();
-					h[fi][1] = p_y.Eval();
-					h[fi][2] = p_z.Eval();
-				}
-				catch (Parser::exception_type& e) {
-					throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-				}
-			}
+		evaluatePerFace(m.cm, funcs, {}, false, [&h](CMeshO::FaceType& f, const double* val) {
+			h[f] = Point3m(val[0], val[1], val[2]);
+		});
 
 		// if succeeded log stream contains number of vertices processed and time elapsed
-		log("%d faces processed in %.2f sec.", m.cm.fn, (clock() - start) / (float) CLOCKS_PER_SEC);
+		log("%d faces processed in %.2f sec.", m.cm.fn, timer.elapsed() / 1000.0f);
 
 	} break;
 
@@ -1607,30 +1287,28 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 		double  step     = par.getFloat("voxelSize");
 		Point3i siz      = Point3i::Construct((RangeBBox.max - RangeBBox.min) * (1.0 / step));
 
-		Parser p;
-		double x, y, z;
-		setCustomFunctions(p);
-		
-		p.DefineVar(conversion::fromStringToWString("x"), &x);
-		p.DefineVar(conversion::fromStringToWString("y"), &y);
-		p.DefineVar(conversion::fromStringToWString("z"), &z);
 		std::string expr = par.getString("expr").toStdString();
-		p.SetExpr(conversion::fromStringToWString(expr));
 		log("Filling a Volume of %i %i %i", siz[0], siz[1], siz[2]);
 		volume.Init(siz, RangeBBox);
-		for (double i = 0; i < siz[0]; i++)
-			for (double j = 0; j < siz[1]; j++)
-				for (double k = 0; k < siz[2]; k++) {
-					x = RangeBBox.min[0] + step * i;
-					y = RangeBBox.min[1] + step * j;
-					z = RangeBBox.min[2] + step * k;
-					try {
-						volume.Val(i, j, k) = p.Eval();
-					}
-					catch (Parser::exception_type& e) {
-						throw MLException(conversion::fromWStringToString(e.GetMsg()).c_str());
-					}
-				}
+
+		// the voxels are evaluated in batches, along the z rows of the volume;
+		// their number can exceed the int range
+		const int64_t slice = int64_t(siz[1]) * siz[2];
+		const int64_t n     = siz[0] * slice;
+		evaluateInBatches(
+			n,
+			{"x", "y", "z"},
+			{},
+			{expr},
+			{},
+			[&](BatchEvaluator& be, int i, int64_t v) {
+				be.column(0)[i] = RangeBBox.min[0] + step * int(v / slice);
+				be.column(1)[i] = RangeBBox.min[1] + step * int((v / siz[2]) % siz[1]);
+				be.column(2)[i] = RangeBBox.min[2] + step * int(v % siz[2]);
+			},
+			[&](int64_t v, const double* values) {
+				volume.Val(int(v / slice), int((v / siz[2]) % siz[1]), int(v % siz[2])) = values[0];
+			});
 
 		// MARCHING CUBES
 		log("[MARCHING CUBES] Building mesh...");
@@ -1681,390 +1359,198 @@ std::map<std::string, QVariant> FilterFunctionPlugin::applyFilter(
 	return std::map<std::string, QVariant>();
 }
 
-// display parsing error in dialog
-void FilterFunctionPlugin::showParserError(const QString& s, Parser::exception_type& e)
+// set per-vertex attributes associated to parser variables, in the i-th row of the batch
+void FilterFunctionPlugin::setAttributes(const CMeshO::VertexType& v, CMeshO& m, BatchEvaluator& be, int i)
 {
-	errorMsg += s;
-	errorMsg += conversion::fromWStringToString(e.GetMsg()).c_str();
-	errorMsg += "\n";
-}
+	be.column(VV_X)[i] = v.P()[0]; // coord x
+	be.column(VV_Y)[i] = v.P()[1]; // coord y
+	be.column(VV_Z)[i] = v.P()[2]; // coord z
 
-// set per-vertex attributes associated to parser variables
-void FilterFunctionPlugin::setAttributes(CMeshO::VertexIterator& vi, CMeshO& m)
-{
-	x = (*vi).P()[0]; // coord x
-	y = (*vi).P()[1]; // coord y
-	z = (*vi).P()[2]; // coord z
-
-	nx = (*vi).N()[0]; // normal coord x
-	ny = (*vi).N()[1]; // normal coord y
-	nz = (*vi).N()[2]; // normal coord z
+	be.column(VV_NX)[i] = v.N()[0]; // normal coord x
+	be.column(VV_NY)[i] = v.N()[1]; // normal coord y
+	be.column(VV_NZ)[i] = v.N()[2]; // normal coord z
 
-	r = (*vi).C()[0]; // color R
-	g = (*vi).C()[1]; // color G
-	b = (*vi).C()[2]; // color B
-	a = (*vi).C()[3]; // color ALPHA
+	be.column(VV_R)[i] = v.C()[0]; // color R
+	be.column(VV_G)[i] = v.C()[1]; // color G
+	be.column(VV_B)[i] = v.C()[2]; // color B
+	be.column(VV_A)[i] = v.C()[3]; // color ALPHA
 
-	q = (*vi).Q(); // quality
+	be.column(VV_Q)[i] = v.Q(); // quality
 
-	vsel = ((*vi).IsS()) ? 1.0 : 0.0; // selection
+	be.column(VV_VSEL)[i] = (v.IsS()) ? 1.0 : 0.0; // selection
 
-	v = vi - m.vert.begin(); // zero based index of current vertex
+	be.column(VV_VI)[i] = &v - &m.vert[0]; // zero based index of current vertex
 
 	if (tri::HasPerVertexTexCoord(m)) {
-		vtu = (*vi).T().U();
-		vtv = (*vi).T().V();
-		ti  = (*vi).T().N();
+		be.column(VV_VTU)[i] = v.T().U();
+		be.column(VV_VTV)[i] = v.T().V();
+		be.column(VV_TI)[i]  = v.T().N();
 	}
 	else {
-		vtu = vtv = ti = 0;
+		be.column(VV_VTU)[i] = be.column(VV_VTV)[i] = be.column(VV_TI)[i] = 0;
 	}
 
 	// if user-defined attributes exist (vector is not empty)
 	//  set variables to explicit value obtained through attribute's handler
-	for (int i = 0; i < (int) v_attrValue.size(); i++)
-		v_attrValue[i] = v_handlers[i][vi];
-
-	for (int i = 0; i < (int) v3_handlers.size(); i++) {
-		v3_attrValue[i * 3 + 0] = v3_handlers[i][vi].X();
-		v3_attrValue[i * 3 + 1] = v3_handlers[i][vi].Y();
-		v3_attrValue[i * 3 + 2] = v3_handlers[i][vi].Z();
+	int c = VV_NUM;
+	for (auto& h : v_handlers)
+		be.column(c++)[i] = h[v];
+
+	for (auto& h : v3_handlers) {
+		be.column(c++)[i] = h[v].X();
+		be.column(c++)[i] = h[v].Y();
+		be.column(c++)[i] = h[v].Z();
 	}
 }
 
-// set per-face attributes associated to parser variables
-void FilterFunctionPlugin::setAttributes(CMeshO::FaceIterator& fi, CMeshO& m)
+// set per-face attributes associated to parser variables, in the i-th row of the batch
+void FilterFunctionPlugin::setAttributes(const CMeshO::FaceType& f, CMeshO& m, BatchEvaluator& be, int i)
 {
-	// set attributes for First vertex
-	// coords, normal coords, quality
-	x0 = (*fi).V(0)->P()[0];
-	y0 = (*fi).V(0)->P()[1];
-	z0 = (*fi).V(0)->P()[2];
-
-	nx0 = (*fi).V(0)->N()[0];
-	ny0 = (*fi).V(0)->N()[1];
-	nz0 = (*fi).V(0)->N()[2];
-
-	r0 = (*fi).V(0)->C()[0];
-	g0 = (*fi).V(0)->C()[1];
-	b0 = (*fi).V(0)->C()[2];
-	a0 = (*fi).V(0)->C()[3];
-
-	q0 = (*fi).V(0)->Q();
-
-	// set attributes for Second vertex
-	// coords, normal coords, quality
-	x1 = (*fi).V(1)->P()[0];
-	y1 = (*fi).V(1)->P()[1];
-	z1 = (*fi).V(1)->P()[2];
-
-	nx1 = (*fi).V(1)->N()[0];
-	ny1 = (*fi).V(1)->N()[1];
-	nz1 = (*fi).V(1)->N()[2];
-
-	r1 = (*fi).V(1)->C()[0];
-	g1 = (*fi).V(1)->C()[1];
-	b1 = (*fi).V(1)->C()[2];
-	a1 = (*fi).V(1)->C()[3];
-
-	q1 = (*fi).V(1)->Q();
-
-	// set attributes for Third vertex
-	// coords, normal coords, quality
-	x2 = (*fi).V(2)->P()[0];
-	y2 = (*fi).V(2)->P()[1];
-	z2 = (*fi).V(2)->P()[2];
-
-	nx2 = (*fi).V(2)->N()[0];
-	ny2 = (*fi).V(2)->N()[1];
-	nz2 = (*fi).V(2)->N()[2];
-
-	r2 = (*fi).V(2)->C()[0];
-	g2 = (*fi).V(2)->C()[1];
-	b2 = (*fi).V(2)->C()[2];
-	a2 = (*fi).V(2)->C()[3];
-
-	q2 = (*fi).V(2)->Q();
+	// set attributes for the three vertices
+	// coords, normal coords, color, quality
+	for (int k = 0; k < 3; ++k) {
+		be.column(FV_X0 + 3 * k)[i] = f.V(k)->P()[0];
+		be.column(FV_Y0 + 3 * k)[i] = f.V(k)->P()[1];
+		be.column(FV_Z0 + 3 * k)[i] = f.V(k)->P()[2];
+
+		be.column(FV_NX0 + 3 * k)[i] = f.V(k)->N()[0];
+		be.column(FV_NY0 + 3 * k)[i] = f.V(k)->N()[1];
+		be.column(FV_NZ0 + 3 * k)[i] = f.V(k)->N()[2];
+
+		be.column(FV_R0 + 4 * k)[i] = f.V(k)->C()[0];
+		be.column(FV_G0 + 4 * k)[i] = f.V(k)->C()[1];
+		be.column(FV_B0 + 4 * k)[i] = f.V(k)->C()[2];
+		be.column(FV_A0 + 4 * k)[i] = f.V(k)->C()[3];
+
+		be.column(FV_Q0 + k)[i] = f.V(k)->Q();
+	}
 
 	if (HasPerFaceQuality(m))
-		fq = (*fi).Q();
+		be.column(FV_FQ)[i] = f.Q();
 	else
-		fq = 0;
+		be.column(FV_FQ)[i] = 0;
 
 	// set face color attributes
 	if (HasPerFaceColor(m)) {
-		fr = (*fi).C()[0];
-		fg = (*fi).C()[1];
-		fb = (*fi).C()[2];
-		fa = (*fi).C()[3];
+		be.column(FV_FR)[i] = f.C()[0];
+		be.column(FV_FG)[i] = f.C()[1];
+		be.column(FV_FB)[i] = f.C()[2];
+		be.column(FV_FA)[i] = f.C()[3];
 	}
 	else {
-		fr = fg = fb = fa = 255;
+		be.column(FV_FR)[i] = be.column(FV_FG)[i] = be.column(FV_FB)[i] = be.column(FV_FA)[i] = 255;
 	}
 
 	// face normal
-	fnx = (*fi).N()[0];
-	fny = (*fi).N()[1];
-	fnz = (*fi).N()[2];
+	be.column(FV_FNX)[i] = f.N()[0];
+	be.column(FV_FNY)[i] = f.N()[1];
+	be.column(FV_FNZ)[i] = f.N()[2];
 
 	// zero based index of face
-	f = fi - m.face.begin();
+	be.column(FV_FI)[i] = &f - &m.face[0];
 
 	// zero based index of its vertices
-	v0i = ((*fi).V(0) - &m.vert[0]);
-	v1i = ((*fi).V(1) - &m.vert[0]);
-	v2i = ((*fi).V(2) - &m.vert[0]);
+	be.column(FV_VI0)[i] = (f.V(0) - &m.vert[0]);
+	be.column(FV_VI1)[i] = (f.V(1) - &m.vert[0]);
+	be.column(FV_VI2)[i] = (f.V(2) - &m.vert[0]);
 
 	if (tri::HasPerWedgeTexCoord(m)) {
-		wtu0 = (*fi).WT(0).U();
-		wtv0 = (*fi).WT(0).V();
-		wtu1 = (*fi).WT(1).U();
-		wtv1 = (*fi).WT(1).V();
-		wtu2 = (*fi).WT(2).U();
-		wtv2 = (*fi).WT(2).V();
-		ti   = (*fi).WT(0).N();
+		be.column(FV_WTU0)[i] = f.WT(0).U();
+		be.column(FV_WTV0)[i] = f.WT(0).V();
+		be.column(FV_WTU1)[i] = f.WT(1).U();
+		be.column(FV_WTV1)[i] = f.WT(1).V();
+		be.column(FV_WTU2)[i] = f.WT(2).U();
+		be.column(FV_WTV2)[i] = f.WT(2).V();
+		be.column(FV_TI)[i]   = f.WT(0).N();
 	}
 	else {
-		wtu0 = wtv0 = wtu1 = wtv1 = wtu2 = wtv2 = ti = 0;
+		for (int c = FV_WTU0; c <= FV_TI; ++c)
+			be.column(c)[i] = 0;
 	}
 
 	// selection
-	vsel0 = ((*fi).V(0)->IsS()) ? 1.0 : 0.0;
-	vsel1 = ((*fi).V(1)->IsS()) ? 1.0 : 0.0;
-	vsel2 = ((*fi).V(2)->IsS()) ? 1.0 : 0.0;
-	fsel  = ((*fi).IsS()) ? 1.0 : 0.0;
+	be.column(FV_VSEL0)[i] = (f.V(0)->IsS()) ? 1.0 : 0.0;
+	be.column(FV_VSEL1)[i] = (f.V(1)->IsS()) ? 1.0 : 0.0;
+	be.column(FV_VSEL2)[i] = (f.V(2)->IsS()) ? 1.0 : 0.0;
+	be.column(FV_FSEL)[i]  = (f.IsS()) ? 1.0 : 0.0;
 
 	// if user-defined attributes exist (vector is not empty)
 	//  set variables to explicit value obtained through attribute's handler
-	for (int i = 0; i < (int) f_attrValue.size(); i++)
-		f_attrValue[i] = f_handlers[i][fi];
-	
-	for (int i = 0; i < (int) f3_handlers.size(); i++) {
-		f3_attrValue[i * 3 + 0] = f3_handlers[i][fi].X();
-		f3_attrValue[i * 3 + 1] = f3_handlers[i][fi].Y();
-		f3_attrValue[i * 3 + 2] = f3_handlers[i][fi].Z();
+	int c = FV_NUM;
+	for (auto& h : f_handlers)
+		be.column(c++)[i] = h[f];
+
+	for (auto& h : f3_handlers) {
+		be.column(c++)[i] = h[f].X();
+		be.column(c++)[i] = h[f].Y();
+		be.column(c++)[i] = h[f].Z();
 	}
-	
 }
 
- // Generate a random double in [0.0, 1.0] interval
-double FilterFunctionPlugin::random()
-{
-	std::random_device rd;  // Seed for the random number engine
-    std::mt19937 gen(rd()); // Mersenne Twister engine
-    std::uniform_real_distribution<double> dis(0.0, 1.0);
-    return dis(gen);  // Generate a random double in [0.0, 1.0]
-}
-
-// Function explicitly define parser variables to perform per-vertex filter action
+// Function returning the names of the parser variables of the per-vertex filter actions,
+// in the same order of the columns filled by setAttributes:
 // x, y, z for vertex coord, nx, ny, nz for normal coord, r, g ,b for color
-// and q for quality
-void FilterFunctionPlugin::setPerVertexVariables(Parser& p, CMeshO& m)
+// and then the user-defined attributes
+std::vector<std::string> FilterFunctionPlugin::setPerVertexVariables(CMeshO& m)
 {
-	p.DefineVar(conversion::fromStringToWString("x"), &x);
-	p.DefineVar(conversion::fromStringToWString("y"), &y);
-	p.DefineVar(conversion::fromStringToWString("z"), &z);
-	p.DefineVar(conversion::fromStringToWString("nx"), &nx);
-	p.DefineVar(conversion::fromStringToWString("ny"), &ny);
-	p.DefineVar(conversion::fromStringToWString("nz"), &nz);
-	p.DefineVar(conversion::fromStringToWString("r"), &r);
-	p.DefineVar(conversion::fromStringToWString("g"), &g);
-	p.DefineVar(conversion::fromStringToWString("b"), &b);
-	p.DefineVar(conversion::fromStringToWString("a"), &a);
-	p.DefineVar(conversion::fromStringToWString("q"), &q);
-	p.DefineVar(conversion::fromStringToWString("vi"), &v);
-	p.DefineVar(conversion::fromStringToWString("vtu"), &vtu);
-	p.DefineVar(conversion::fromStringToWString("vtv"), &vtv);
-	p.DefineVar(conversion::fromStringToWString("ti"), &ti);
-	p.DefineVar(conversion::fromStringToWString("vsel"), &vsel);
-
-    //Add tokens related to mesh bounding box
-	p.DefineVar(conversion::fromStringToWString("xmin"), &xmin);
-	p.DefineVar(conversion::fromStringToWString("ymin"), &ymin);
-	p.DefineVar(conversion::fromStringToWString("zmin"), &zmin);
-	p.DefineVar(conversion::fromStringToWString("xmax"), &xmax);
-	p.DefineVar(conversion::fromStringToWString("ymax"), &ymax);
-	p.DefineVar(conversion::fromStringToWString("zmax"), &zmax);
-	p.DefineVar(conversion::fromStringToWString("bbdiag"), &bbdiag);
-	p.DefineVar(conversion::fromStringToWString("xdim"), &xdim);
-	p.DefineVar(conversion::fromStringToWString("ydim"), &ydim);
-	p.DefineVar(conversion::fromStringToWString("zdim"), &zdim);
-	p.DefineVar(conversion::fromStringToWString("xmid"), &xmid);
-	p.DefineVar(conversion::fromStringToWString("ymid"), &ymid);
-	p.DefineVar(conversion::fromStringToWString("zmid"), &zmid);
-
-	//Add function rnd() 
-	p.DefineFun("rnd", random);
+	std::vector<std::string> names(vertexVariableNames, vertexVariableNames + VV_NUM);
 
 	// define var for user-defined attributes (if any exists)
 	// if vector is empty, code won't be executed
 	v_handlers.clear();
 	v_attrNames.clear();
-	v_attrValue.clear();
 	std::vector<std::string> AllVertexAttribName;
 	tri::Allocator<CMeshO>::GetAllPerVertexAttribute<Scalarm>(m, AllVertexAttribName);
-	v_attrValue.reserve(AllVertexAttribName.size());
 	for (int i = 0; i < (int) AllVertexAttribName.size(); i++) {
 		CMeshO::PerVertexAttributeHandle<Scalarm> hh =
 			tri::Allocator<CMeshO>::GetPerVertexAttribute<Scalarm>(m, AllVertexAttribName[i]);
 		v_handlers.push_back(hh);
 		v_attrNames.push_back(AllVertexAttribName[i]);
-		v_attrValue.push_back(0);
-		p.DefineVar(conversion::fromStringToWString(v_attrNames.back()), &v_attrValue.back());
 		qDebug("Adding custom per vertex float variable %s", v_attrNames.back().c_str());
 	}
 	AllVertexAttribName.clear();
 	v3_handlers.clear();
 	v3_attrNames.clear();
-	v3_attrValue.clear();
 	tri::Allocator<CMeshO>::GetAllPerVertexAttribute<Point3m>(m, AllVertexAttribName);
-	v3_attrValue.reserve(AllVertexAttribName.size());
 	for (int i = 0; i < (int) AllVertexAttribName.size(); i++) {
 		CMeshO::PerVertexAttributeHandle<Point3m> hh3 =
 			tri::Allocator<CMeshO>::GetPerVertexAttribute<Point3m>(m, AllVertexAttribName[i]);
 
 		v3_handlers.push_back(hh3);
 
-		v3_attrValue.push_back(0);
 		v3_attrNames.push_back(AllVertexAttribName[i] + "_x");
-		p.DefineVar(conversion::fromStringToWString(v3_attrNames.back()), &v3_attrValue.back());
-
-		v3_attrValue.push_back(0);
 		v3_attrNames.push_back(AllVertexAttribName[i] + "_y");
-		p.DefineVar(conversion::fromStringToWString(v3_attrNames.back()), &v3_attrValue.back());
-
-		v3_attrValue.push_back(0);
 		v3_attrNames.push_back(AllVertexAttribName[i] + "_z");
-		p.DefineVar(conversion::fromStringToWString(v3_attrNames.back()), &v3_attrValue.back());
 		qDebug("Adding custom per vertex Point3f variable %s", v3_attrNames.back().c_str());
 	}
+	names.insert(names.end(), v_attrNames.begin(), v_attrNames.end());
+	names.insert(names.end(), v3_attrNames.begin(), v3_attrNames.end());
+	return names;
 }
 
-// Function explicitly define parser variables to perform Per-Face filter action
-void FilterFunctionPlugin::setPerFaceVariables(Parser& p, CMeshO& m)
+// Function returning the names of the parser variables of the per-face filter actions,
+// in the same order of the columns filled by setAttributes
+std::vector<std::string> FilterFunctionPlugin::setPerFaceVariables(CMeshO& m)
 {
-	// coord of the three vertices within a face
-	p.DefineVar(conversion::fromStringToWString("x0"), &x0);
-	p.DefineVar(conversion::fromStringToWString("y0"), &y0);
-	p.DefineVar(conversion::fromStringToWString("z0"), &z0);
-	p.DefineVar(conversion::fromStringToWString("x1"), &x1);
-	p.DefineVar(conversion::fromStringToWString("y1"), &y1);
-	p.DefineVar(conversion::fromStringToWString("z1"), &z1);
-	p.DefineVar(conversion::fromStringToWString("x2"), &x2);
-	p.DefineVar(conversion::fromStringToWString("y2"), &y2);
-	p.DefineVar(conversion::fromStringToWString("z2"), &z2);
-
-	// attributes of the vertices
-	// normals:
-	p.DefineVar(conversion::fromStringToWString("nx0"), &nx0);
-	p.DefineVar(conversion::fromStringToWString("ny0"), &ny0);
-	p.DefineVar(conversion::fromStringToWString("nz0"), &nz0);
-
-	p.DefineVar(conversion::fromStringToWString("nx1"), &nx1);
-	p.DefineVar(conversion::fromStringToWString("ny1"), &ny1);
-	p.DefineVar(conversion::fromStringToWString("nz1"), &nz1);
-
-	p.DefineVar(conversion::fromStringToWString("nx2"), &nx2);
-	p.DefineVar(conversion::fromStringToWString("ny2"), &ny2);
-	p.DefineVar(conversion::fromStringToWString("nz2"), &nz2);
-
-	// colors:
-	p.DefineVar(conversion::fromStringToWString("r0"), &r0);
-	p.DefineVar(conversion::fromStringToWString("g0"), &g0);
-	p.DefineVar(conversion::fromStringToWString("b0"), &b0);
-	p.DefineVar(conversion::fromStringToWString("a0"), &a0);
-
-	p.DefineVar(conversion::fromStringToWString("r1"), &r1);
-	p.DefineVar(conversion::fromStringToWString("g1"), &g1);
-	p.DefineVar(conversion::fromStringToWString("b1"), &b1);
-	p.DefineVar(conversion::fromStringToWString("a1"), &a1);
-
-	p.DefineVar(conversion::fromStringToWString("r2"), &r2);
-	p.DefineVar(conversion::fromStringToWString("g2"), &g2);
-	p.DefineVar(conversion::fromStringToWString("b2"), &b2);
-	p.DefineVar(conversion::fromStringToWString("a2"), &a2);
-
-	// quality
-	p.DefineVar(conversion::fromStringToWString("q0"), &q0);
-	p.DefineVar(conversion::fromStringToWString("q1"), &q1);
-	p.DefineVar(conversion::fromStringToWString("q2"), &q2);
-
-	// face color
-	p.DefineVar(conversion::fromStringToWString("fr"), &fr);
-	p.DefineVar(conversion::fromStringToWString("fg"), &fg);
-	p.DefineVar(conversion::fromStringToWString("fb"), &fb);
-	p.DefineVar(conversion::fromStringToWString("fa"), &fa);
-
-	// face normal
-	p.DefineVar(conversion::fromStringToWString("fnx"), &fnx);
-	p.DefineVar(conversion::fromStringToWString("fny"), &fny);
-	p.DefineVar(conversion::fromStringToWString("fnz"), &fnz);
-
-	// face quality
-	p.DefineVar(conversion::fromStringToWString("fq"), &fq);
-
-	// index
-	p.DefineVar(conversion::fromStringToWString("fi"), &f);
-	p.DefineVar(conversion::fromStringToWString("vi0"), &v0i);
-	p.DefineVar(conversion::fromStringToWString("vi1"), &v1i);
-	p.DefineVar(conversion::fromStringToWString("vi2"), &v2i);
-
-	// texture
-	p.DefineVar(conversion::fromStringToWString("wtu0"), &wtu0);
-	p.DefineVar(conversion::fromStringToWString("wtv0"), &wtv0);
-	p.DefineVar(conversion::fromStringToWString("wtu1"), &wtu1);
-	p.DefineVar(conversion::fromStringToWString("wtv1"), &wtv1);
-	p.DefineVar(conversion::fromStringToWString("wtu2"), &wtu2);
-	p.DefineVar(conversion::fromStringToWString("wtv2"), &wtv2);
-	p.DefineVar(conversion::fromStringToWString("ti"), &ti);
-
-	// selection
-	p.DefineVar(conversion::fromStringToWString("vsel0"), &vsel0);
-	p.DefineVar(conversion::fromStringToWString("vsel1"), &vsel1);
-	p.DefineVar(conversion::fromStringToWString("vsel2"), &vsel2);
-	p.DefineVar(conversion::fromStringToWString("fsel"), &fsel);
-
-    //Add tokens related to mesh bounding box
-	p.DefineVar(conversion::fromStringToWString("xmin"), &xmin);
-	p.DefineVar(conversion::fromStringToWString("ymin"), &ymin);
-	p.DefineVar(conversion::fromStringToWString("zmin"), &zmin);
-	p.DefineVar(conversion::fromStringToWString("xmax"), &xmax);
-	p.DefineVar(conversion::fromStringToWString("ymax"), &ymax);
-	p.DefineVar(conversion::fromStringToWString("zmax"), &zmax);
-	p.DefineVar(conversion::fromStringToWString("bbdiag"), &bbdiag);
-	p.DefineVar(conversion::fromStringToWString("xdim"), &xdim);
-	p.DefineVar(conversion::fromStringToWString("ydim"), &ydim);
-	p.DefineVar(conversion::fromStringToWString("zdim"), &zdim);
-	p.DefineVar(conversion::fromStringToWString("xmid"), &xmid);
-	p.DefineVar(conversion::fromStringToWString("ymid"), &ymid);
-	p.DefineVar(conversion::fromStringToWString("zmid"), &zmid);
-
-	//Add function rnd() 
-	p.DefineFun("rnd", random);
+	std::vector<std::string> names(faceVariableNames, faceVariableNames + FV_NUM);
 
 	// define var for user-defined attributes (if any exists)
 	// if vector is empty, code won't be executed
 	f_handlers.clear();
 	f_attrNames.clear();
-	f_attrValue.clear();
 	std::vector<std::string> AllFaceAttribName;
 	tri::Allocator<CMeshO>::GetAllPerFaceAttribute<Scalarm>(m, AllFaceAttribName);
-	f_attrValue.reserve(AllFaceAttribName.size());
 	qDebug("Searching for Scalar Face Attributes (%lu)",AllFaceAttribName.size());
 	for (int i = 0; i < (int) AllFaceAttribName.size(); i++) {
 		CMeshO::PerFaceAttributeHandle<Scalarm> hh =
 			tri::Allocator<CMeshO>::GetPerFaceAttribute<Scalarm>(m, AllFaceAttribName[i]);
 		f_handlers.push_back(hh);
 		f_attrNames.push_back(AllFaceAttribName[i]);
-		f_attrValue.push_back(0);
-		p.DefineVar(conversion::fromStringToWString(f_attrNames.back()), &f_attrValue.back());
 	}
 	AllFaceAttribName.clear();
 	f3_handlers.clear();
 	f3_attrNames.clear();
-	f3_attrValue.clear();
 	tri::Allocator<CMeshO>::GetAllPerFaceAttribute<Point3m>(m, AllFaceAttribName);
-	f3_attrValue.reserve(AllFaceAttribName.size());
 	qDebug("Searching for Point3 Face Attributes (%lu)",AllFaceAttribName.size());
 	for (int i = 0; i < (int) AllFaceAttribName.size(); i++) {
 		CMeshO::PerFaceAttributeHandle<Point3m> hh3 =
@@ -2072,19 +1558,14 @@ void FilterFunctionPlugin::setPerFaceVariables(Parser& p, CMeshO& m)
 		
 		f3_handlers.push_back(hh3);
 		
-		f3_attrValue.push_back(0);
 		f3_attrNames.push_back(AllFaceAttribName[i] + "_x");
-		p.DefineVar(conversion::fromStringToWString(f3_attrNames.back()), &f3_attrValue.back());
-		
-		f3_attrValue.push_back(0);
 		f3_attrNames.push_back(AllFaceAttribName[i] + "_y");
-		p.DefineVar(conversion::fromStringToWString(f3_attrNames.back()), &f3_attrValue.back());
-		
-		f3_attrValue.push_back(0);
 		f3_attrNames.push_back(AllFaceAttribName[i] + "_z");
-		p.DefineVar(conversion::fromStringToWString(f3_attrNames.back()), &f3_attrValue.back());
 		qDebug("Adding custom per face Point3f variable %s", f3_attrNames.back().c_str());
 	}
+	names.insert(names.end(), f_attrNames.begin(), f_attrNames.end());
+	names.insert(names.end(), f3_attrNames.begin(), f3_attrNames.end());
+	return names;
 }
 
 void FilterFunctionPlugin::checkAttributeName(const std::string &name) const
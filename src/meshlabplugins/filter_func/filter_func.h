@@ -29,6 +29,7 @@
 #include <common/plugins/interfaces/filter_plugin.h>
 
 #include "filter_refine.h"
+#include "batch_evaluator.h"
 
 class FilterFunctionPlugin : public QObject, public FilterPlugin
 {
@@ -37,37 +38,20 @@ class FilterFunctionPlugin : public QObject, public FilterPlugin
 	Q_INTERFACES(FilterPlugin)
 
 protected:
-	// These variables are used to store the actual values that can be used in side functions
-	double x, y, z, nx, ny, nz, r, g, b, a, q, vtu, vtv, vsel;
-	double x0, y0, z0, x1, y1, z1, x2, y2, z2, nx0, ny0, nz0, nx1, ny1, nz1, nx2, ny2, nz2, r0, g0,
-		b0, a0, r1, g1, b1, a1, r2, g2, b2, a2, q0, q1, q2, wtu0, wtv0, wtu1, wtv1, wtu2, wtv2,
-		vsel0, vsel1, vsel2;
-	double                   fr, fg, fb, fa, fnx, fny, fnz, fq, fsel;
-	double                   v, f, v0i, v1i, v2i, ti;
-
-	//Bounding Box of the mesh
-	double xmin, ymin, zmin, xmax, ymax, zmax, xdim, ydim, zdim, bbdiag, xmid, ymid, zmid;
+	// The values of the per-element variables are stored in the columns of a BatchEvaluator;
+	// the bounding box of the mesh is given to the parsers as constants
+	std::vector<std::pair<std::string, double>> bboxConstants;
 
 	std::vector<std::string> v_attrNames;  // names of the <float> per vertex attributes
-	std::vector<double>      v_attrValue;  // values of the <Scalarm> per vertex attributes
 	std::vector<std::string> v3_attrNames; // names of the <Point3f> per vertex attributes There are
 										   // 3x (one foreach coord _x, _y, _z)
-	std::vector<double> v3_attrValue; // values of the <Point3m> per vertex attributes. There are 3x
-									  // (one foreach coord _x, _y, _z)
 	std::vector<std::string>   f_attrNames;  // names  of the <Scalarm> per face attributes
-	std::vector<double>        f_attrValue;  // values of the <Scalarm> per face attributes
 	std::vector<std::string>   f3_attrNames; // names  of the <Point3m> per face attributes
-	std::vector<double>        f3_attrValue; // values of the <Point3m> per face attributes
 	
 	std::vector<CMeshO::PerVertexAttributeHandle<Scalarm>> v_handlers;
 	std::vector<CMeshO::PerVertexAttributeHandle<Point3m>> v3_handlers;
 	std::vector<CMeshO::PerFaceAttributeHandle<Scalarm>>   f_handlers;
 	std::vector<CMeshO::PerFaceAttributeHandle<Point3m>> f3_handlers;
-	
-	QString                                                errorMsg;
-
-	// Generate a random double in [0.0, 1.0] interval
-	static double random();
 
 public:
 	enum {
@@ -110,13 +94,28 @@ public:
 		unsigned int&            postConditionMask,
 		vcg::CallBackPos*        cb);
 	FilterArity filterArity(const QAction* filter) const;
+	bool supportsBackgroundExecution(const QAction*) const { return true; }
 
-	void showParserError(const QString& s, mu::Parser::exception_type& e);
-	void setAttributes(CMeshO::VertexIterator& vi, CMeshO& m);
-	void setAttributes(CMeshO::FaceIterator& fi, CMeshO& m);
-	void setPerVertexVariables(mu::Parser& p, CMeshO& m);
-	void setPerFaceVariables(mu::Parser& p, CMeshO& m);
+	void setAttributes(const CMeshO::VertexType& v, CMeshO& m, BatchEvaluator& be, int i);
+	void setAttributes(const CMeshO::FaceType& f, CMeshO& m, BatchEvaluator& be, int i);
+	std::vector<std::string> setPerVertexVariables(CMeshO& m);
+	std::vector<std::string> setPerFaceVariables(CMeshO& m);
 	void checkAttributeName(const std::string& name) const;
+
+	template <typename Writer>
+	void evaluatePerVertex(
+		CMeshO&                         m,
+		const std::vector<std::string>& expressions,
+		const std::vector<std::string>& errorLabels,
+		bool                            onSelected,
+		Writer                          store);
+	template <typename Writer>
+	void evaluatePerFace(
+		CMeshO&                         m,
+		const std::vector<std::string>& expressions,
+		const std::vector<std::string>& errorLabels,
+		bool                            onSelected,
+		Writer                          store);
 };
 
 #endif
@@ -35,17 +35,41 @@
 #include <Qt>
 
 #include "filter_geodesic.h"
+#include "heat_geodesic_solver.h"
+
+#include <common/mlexception.h>
 
 using namespace std;
 using namespace vcg;
 
+/**
+ * @brief Solves the heat method for the given source sets, with the solver
+ * cached in the mesh; the cache is dropped if the solver fails.
+ */
+static bool heatGeodesicDistances(
+		CMeshO& m,
+		Scalarm timeStepMultiplier,
+		const std::vector<std::vector<int>>& sources,
+		Eigen::MatrixXd& distances,
+		vcg::CallBackPos* cb)
+{
+	std::shared_ptr<HeatGeodesicSolver> solver = HeatGeodesicSolver::cached(m, timeStepMultiplier, cb);
+	cb(80, "Computing Geodesic Distance...");
+	if (solver->solve(sources, distances))
+		return true;
+	// the cache is most likely useless after a failure
+	HeatGeodesicSolver::clearCache(m);
+	return false;
+}
+
 FilterGeodesic::FilterGeodesic()
 {
 	typeList = {
 		FP_QUALITY_BORDER_GEODESIC,
 		FP_QUALITY_POINT_GEODESIC,
         FP_QUALITY_SELECTED_GEODESIC,
-        FP_QUALITY_SELECTED_GEODESIC_HEAT
+        FP_QUALITY_SELECTED_GEODESIC_HEAT,
+        FP_GEODESIC_HEAT_BATCH
 	};
 
 	for(ActionIDType tt : types())
@@ -70,6 +94,8 @@ QString FilterGeodesic::filterName(ActionIDType filter) const
 		return QString("Colorize by geodesic distance from the selected points");
     case FP_QUALITY_SELECTED_GEODESIC_HEAT:
         return QString("Colorize by approximated geodesic distance from the selected points");
+    case FP_GEODESIC_HEAT_BATCH:
+        return QString("Compute approximated geodesic distances from many sources");
 	default: assert(0); return QString();
 	}
 }
@@ -84,6 +110,8 @@ QString FilterGeodesic::pythonFilterName(ActionIDType f) const
 		return QString("compute_scalar_by_geodesic_distance_from_selection_per_vertex");
     case FP_QUALITY_SELECTED_GEODESIC_HEAT:
         return QString("compute_scalar_by_heat_geodesic_distance_from_selection_per_vertex");
+    case FP_GEODESIC_HEAT_BATCH:
+        return QString("compute_scalar_by_heat_geodesic_distance_batch_per_vertex");
 	default: assert(0); return QString();
 	}
 }
@@ -95,7 +123,10 @@ QString FilterGeodesic::filterInfo(ActionIDType filterId) const
     case FP_QUALITY_BORDER_GEODESIC        : return tr("Store in the quality field the geodesic distance from borders and color the mesh accordingly.");
     case FP_QUALITY_POINT_GEODESIC         : return tr("Store in the quality field the geodesic distance from a given point on the mesh surface and color the mesh accordingly.");
     case FP_QUALITY_SELECTED_GEODESIC      : return tr("Store in the quality field the geodesic distance from the selected points on the mesh surface and color the mesh accordingly.");
-    case FP_QUALITY_SELECTED_GEODESIC_HEAT : return tr("Store in the quality field the approximated geodesic distance, computed via heat method (Crane et al.), from the selected points on the mesh surface and color the mesh accordingly. As this implementation does not use intrinsic triangulation it is very sensitive to trinagulation. First run takes longer as factorization has to be build. ");
+    case FP_QUALITY_SELECTED_GEODESIC_HEAT : return tr("Store in the quality field the approximated geodesic distance, computed via heat method (Crane et al.), from the selected points on the mesh surface and color the mesh accordingly. As this implementation does not use intrinsic triangulation it is very sensitive to trinagulation. First run takes longer as factorization has to be build; the factorization is kept until the mesh or the Euler step change. ");
+    case FP_GEODESIC_HEAT_BATCH         : return tr("Compute, via heat method (Crane et al.), the approximated geodesic distance from many source sets at once, and store each distance field in a per vertex scalar attribute named <i>prefix</i><i>id</i>. "
+                                                    "The sources are either each selected vertex (the id is the index of the vertex) or the groups of vertices having the same value in a per vertex label attribute (the id is the label; vertices with negative labels are not sources). "
+                                                    "The factorizations are computed once and shared with the other heat geodesic filter, and the source sets are solved together in blocks.");
 	default                             : assert(0);
 	}
 	return QString("error!");
@@ -109,6 +140,7 @@ FilterGeodesic::FilterClass FilterGeodesic::getClass(const QAction *a) const
     case FP_QUALITY_SELECTED_GEODESIC      :
     case FP_QUALITY_POINT_GEODESIC         :
     case FP_QUALITY_SELECTED_GEODESIC_HEAT : return FilterGeodesic::FilterClass(FilterPlugin::VertexColoring + FilterPlugin::Quality);
+    case FP_GEODESIC_HEAT_BATCH            : return FilterPlugin::Quality;
 	default                          : assert(0);
 	}
 	return FilterPlugin::Generic;
@@ -121,13 +153,14 @@ int FilterGeodesic::getRequirements(const QAction *action)
     case FP_QUALITY_BORDER_GEODESIC          :
     case FP_QUALITY_SELECTED_GEODESIC        :
     case FP_QUALITY_POINT_GEODESIC           : return MeshModel::MM_VERTFACETOPO;
-    case FP_QUALITY_SELECTED_GEODESIC_HEAT   : return MeshModel::MM_VERTFACETOPO + MeshModel::MM_FACEFACETOPO;
+    case FP_QUALITY_SELECTED_GEODESIC_HEAT   :
+    case FP_GEODESIC_HEAT_BATCH              : return MeshModel::MM_NONE;
 	default: assert(0);
 	}
 	return 0;
 }
 
-std::map<std::string, QVariant> FilterGeodesic::applyFilter(const QAction *filter, const RichParameterList & par, MeshDocument &md, unsigned int& /*postConditionMask*/, vcg::CallBackPos *cb)
+std::map<std::string, QVariant> FilterGeodesic::applyFilter(const QAction *filter, const RichParameterList & par, MeshDocument &md, unsigned int& postConditionMask, vcg::CallBackPos *cb)
 {
 	MeshModel &m=*(md.mm());
 	CMeshO::VertexIterator vi;
@@ -247,56 +280,88 @@ std::map<std::string, QVariant> FilterGeodesic::applyFilter(const QAction *filte
         break;
     case FP_QUALITY_SELECTED_GEODESIC_HEAT:
     {
-        m.updateDataMask(MeshModel::MM_FACEFACETOPO);
-        m.updateDataMask(MeshModel::MM_VERTFACETOPO);
-        m.updateDataMask(MeshModel::MM_FACEQUALITY);
-        m.updateDataMask(MeshModel::MM_FACENORMAL);
         m.updateDataMask(MeshModel::MM_VERTQUALITY);
         m.updateDataMask(MeshModel::MM_VERTCOLOR);
 
-        std::vector<CMeshO::VertexPointer> seedVec;
-        ForEachVertex(m.cm, [&seedVec] (CMeshO::VertexType & v) {
-            if (v.IsS()) seedVec.push_back(&v);
-        });
+        // the solver works on vertex and face indices
+        if (m.cm.vn != int(m.cm.vert.size()) || m.cm.fn != int(m.cm.face.size())) {
+            tri::Allocator<CMeshO>::CompactEveryVector(m.cm);
+            postConditionMask = MeshModel::MM_ALL;
+        }
 
-        float param_m = par.getFloat("m");
-
-        if (seedVec.size() > 0){
-            // cache factorizations to reduce runtime on successive computations
-            std::pair<float, tri::GeodesicHeat<CMeshO>::GeodesicHeatCache> cache;
-            if (!vcg::tri::HasPerMeshAttribute(m.cm, "GeodesicHeatCache")){
-                cb(20, "Building Cache: Computing Factorizations...");
-                cache = std::make_pair(param_m, tri::GeodesicHeat<CMeshO>::BuildCache(m.cm, param_m));
-                // save cache for next compute
-                auto GeodesicHeatCacheHandle = tri::Allocator<CMeshO>::GetPerMeshAttribute<std::pair<float, tri::GeodesicHeat<CMeshO>::GeodesicHeatCache>>(m.cm, std::string("GeodesicHeatCache"));
-                GeodesicHeatCacheHandle() = cache;
-            }
-            else {
-                cb(10, "Recovering Cache...");
-                // recover cache
-                auto GeodesicHeatCacheHandle = vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<std::pair<float, tri::GeodesicHeat<CMeshO>::GeodesicHeatCache>>(m.cm, std::string("GeodesicHeatCache"));
-                // if m has changed rebuild everything
-                if (std::get<0>(GeodesicHeatCacheHandle()) != param_m){
-                    cb(20, "Parameter Changed: Rebuilding Factorizations...");
-                    GeodesicHeatCacheHandle() = std::make_pair(param_m, tri::GeodesicHeat<CMeshO>::BuildCache(m.cm, param_m));
-                }
-                cache = GeodesicHeatCacheHandle();
-            }
-            cb(80, "Computing Geodesic Distance...");
+        std::vector<std::vector<int>> sources(1);
+        ForEachVertex(m.cm, [&] (CMeshO::VertexType & v) {
+            if (v.IsS()) sources[0].push_back(tri::Index(m.cm, v));
+        });
 
-            if (tri::GeodesicHeat<CMeshO>::ComputeFromCache(m.cm, seedVec, std::get<1>(cache))){
+        if (sources[0].size() > 0){
+            // the factorizations are cached in the mesh, and built again only
+            // when the mesh or the time step have changed
+            cb(10, "Recovering Cache...");
+            Eigen::MatrixXd distances;
+            if (heatGeodesicDistances(m.cm, par.getFloat("m"), sources, distances, cb)){
+                for (size_t i = 0; i < m.cm.vert.size(); ++i)
+                    m.cm.vert[i].Q() = distances(i, 0);
                 tri::UpdateColor<CMeshO>::PerVertexQualityRamp(m.cm);
             }
-            else{
+            else
                 log("Warning: heat method has failed. The mesh is most likely badly conditioned (e.g. angles ~ 0deg) or has disconnected components");
-                // delete cache as its most likely useless after failure
-                auto GeodesicHeatCacheHandle = vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<std::pair<float, tri::GeodesicHeat<CMeshO>::GeodesicHeatCache>>(m.cm, std::string("GeodesicHeatCache"));
-                tri::Allocator<CMeshO>::DeletePerMeshAttribute<std::pair<float, tri::GeodesicHeat<CMeshO>::GeodesicHeatCache>>(m.cm, GeodesicHeatCacheHandle);
-            }
         }
         else
             log("Warning: no vertices are selected! aborting geodesic computation.");
     }
+    break;
+    case FP_GEODESIC_HEAT_BATCH:
+    {
+        // the solver works on vertex and face indices
+        if (m.cm.vn != int(m.cm.vert.size()) || m.cm.fn != int(m.cm.face.size())) {
+            tri::Allocator<CMeshO>::CompactEveryVector(m.cm);
+            postConditionMask = MeshModel::MM_ALL;
+        }
+
+        // a source set for each selected vertex, or for each label value
+        std::vector<std::vector<int>> sources;
+        std::vector<int>              ids;
+        if (par.getEnum("sources") == 0) {
+            ForEachVertex(m.cm, [&] (CMeshO::VertexType & v) {
+                if (v.IsS()) {
+                    ids.push_back(tri::Index(m.cm, v));
+                    sources.push_back(std::vector<int>(1, ids.back()));
+                }
+            });
+        }
+        else {
+            std::string labelName = par.getString("labelAttribute").toStdString();
+            auto label = tri::Allocator<CMeshO>::FindPerVertexAttribute<Scalarm>(m.cm, labelName);
+            if (!tri::Allocator<CMeshO>::IsValidHandle(m.cm, label))
+                throw MLException("Mesh has no per vertex scalar attribute named " + QString::fromStdString(labelName));
+            std::map<int, std::vector<int>> groups;
+            for (size_t i = 0; i < m.cm.vert.size(); ++i)
+                if (label[i] >= 0)
+                    groups[int(label[i])].push_back(int(i));
+            for (auto& g : groups) {
+                ids.push_back(g.first);
+                sources.push_back(std::move(g.second));
+            }
+        }
+        if (sources.empty()) {
+            log("Warning: no source vertices! aborting geodesic computation.");
+            break;
+        }
+
+        Eigen::MatrixXd distances;
+        if (!heatGeodesicDistances(m.cm, par.getFloat("m"), sources, distances, cb))
+            throw MLException("Heat method has failed. The mesh is most likely badly conditioned (e.g. angles ~ 0deg) or has disconnected components");
+
+        std::string prefix = par.getString("prefix").toStdString();
+        for (size_t c = 0; c < sources.size(); ++c) {
+            std::string name = prefix + std::to_string(ids[c]);
+            auto h = tri::Allocator<CMeshO>::GetPerVertexAttribute<Scalarm>(m.cm, name);
+            for (size_t i = 0; i < m.cm.vert.size(); ++i)
+                h[i] = distances(i, c);
+        }
+        log("Computed %i geodesic fields in the attributes %s<id>", int(sources.size()), prefix.c_str());
+    }
     break;
 	default:
 		wrongActionCalled(filter);
@@ -320,6 +385,12 @@ RichParameterList FilterGeodesic::initParameterList(const QAction *action, const
     case FP_QUALITY_SELECTED_GEODESIC_HEAT :
         parlst.addParam(RichFloat("m", 1.0, tr("Euler Step"), tr("Multiplier used in backward Euler timestep. Changing this value will reset the cache.")));
         break;
+    case FP_GEODESIC_HEAT_BATCH :
+        parlst.addParam(RichFloat("m", 1.0, tr("Euler Step"), tr("Multiplier used in backward Euler timestep. Changing this value will reset the cache.")));
+        parlst.addParam(RichEnum("sources", 0, QStringList() << "Each selected vertex" << "Label attribute", tr("Sources"), tr("A source set for each selected vertex, or for each non negative value of the label attribute.")));
+        parlst.addParam(RichString("labelAttribute", "label", tr("Label Attribute"), tr("Per vertex scalar attribute grouping the vertices in source sets, used with the <i>Label attribute</i> sources.")));
+        parlst.addParam(RichString("prefix", "geodesic_", tr("Attribute Prefix"), tr("The distances from the source set <i>id</i> are stored in the per vertex attribute <i>prefix</i><i>id</i>.")));
+        break;
 	default: break; // do not add any parameter for the other filters
 	}
 	return parlst;
@@ -332,7 +403,8 @@ int FilterGeodesic::postCondition(const QAction * filter) const
     case FP_QUALITY_BORDER_GEODESIC        :
     case FP_QUALITY_SELECTED_GEODESIC      :
     case FP_QUALITY_POINT_GEODESIC         : return MeshModel::MM_VERTCOLOR + MeshModel::MM_VERTQUALITY;
-    case FP_QUALITY_SELECTED_GEODESIC_HEAT : return MeshModel::MM_VERTCOLOR + MeshModel::MM_VERTQUALITY + MeshModel::MM_FACEQUALITY;
+    case FP_QUALITY_SELECTED_GEODESIC_HEAT : return MeshModel::MM_VERTCOLOR + MeshModel::MM_VERTQUALITY;
+    case FP_GEODESIC_HEAT_BATCH            : return MeshModel::MM_NONE;
     default                                : return MeshModel::MM_ALL;
 	}
 }
@@ -26,7 +26,6 @@
 #include <QObject>
 #include <common/plugins/interfaces/filter_plugin.h>
 #include <vcg/complex/algorithms/geodesic.h>
-#include <vcg/complex/algorithms/geodesic_heat.h>
 
 
 class FilterGeodesic : public QObject, public FilterPlugin
@@ -44,7 +43,8 @@ class FilterGeodesic : public QObject, public FilterPlugin
 		FP_QUALITY_BORDER_GEODESIC,
 		        FP_QUALITY_POINT_GEODESIC,
                 FP_QUALITY_SELECTED_GEODESIC,
-                FP_QUALITY_SELECTED_GEODESIC_HEAT
+                FP_QUALITY_SELECTED_GEODESIC_HEAT,
+                FP_GEODESIC_HEAT_BATCH
 
 	} ;
 	
@@ -63,6 +63,7 @@ class FilterGeodesic : public QObject, public FilterPlugin
 	RichParameterList initParameterList(const QAction*, const MeshModel &/*m*/);
 	int postCondition(const QAction * filter) const;
 	FilterArity filterArity(const QAction*) const {return SINGLE_MESH;}
+	bool supportsBackgroundExecution(const QAction*) const {return true;}
 };
 
 
@@ -0,0 +1,247 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "heat_geodesic_solver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+const char* CACHE_ATTRIBUTE = "HeatGeodesicSolver";
+
+// right hand sides back-substituted together
+const int SOLVE_BLOCK = 32;
+
+uint64_t mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t bits(Scalarm v)
+{
+	uint64_t b = 0;
+	std::memcpy(&b, &v, sizeof(v));
+	return b;
+}
+
+/// cotangent of the angle between u and v
+double cotan(const Eigen::Vector3d& u, const Eigen::Vector3d& v)
+{
+	const double s = u.cross(v).norm();
+	return s > 0 ? u.dot(v) / s : 0;
+}
+
+/// integrated divergence of the normalized, reversed gradient of each column of u
+void heatDivergence(
+	const std::vector<Eigen::Vector3d>& points,
+	const std::vector<Eigen::Vector3i>& faces,
+	const Eigen::MatrixXd&              u,
+	Eigen::MatrixXd&                    div)
+{
+	div = Eigen::MatrixXd::Zero(u.rows(), u.cols());
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int c = 0; c < int(u.cols()); ++c) {
+		for (const Eigen::Vector3i& f : faces) {
+			const Eigen::Vector3d p[3] = {points[f[0]], points[f[1]], points[f[2]]};
+			Eigen::Vector3d       n    = (p[1] - p[0]).cross(p[2] - p[0]);
+			const double          area2 = n.norm();
+			if (area2 == 0)
+				continue;
+			n /= area2;
+
+			Eigen::Vector3d grad = Eigen::Vector3d::Zero();
+			for (int i = 0; i < 3; ++i)
+				grad += u(f[i], c) * n.cross(p[(i + 2) % 3] - p[(i + 1) % 3]);
+			const double len = grad.norm();
+			if (len == 0)
+				continue;
+			const Eigen::Vector3d x = -grad / len;
+
+			for (int i = 0; i < 3; ++i) {
+				const int             j = (i + 1) % 3, k = (i + 2) % 3;
+				const Eigen::Vector3d e1 = p[j] - p[i], e2 = p[k] - p[i];
+				const double          cotK = cotan(p[i] - p[k], p[j] - p[k]);
+				const double          cotJ = cotan(p[i] - p[j], p[k] - p[j]);
+				div(f[i], c) += 0.5 * (cotK * e1.dot(x) + cotJ * e2.dot(x));
+			}
+		}
+	}
+}
+
+} // namespace
+
+HeatGeodesicSolver::Signature HeatGeodesicSolver::Signature::of(const CMeshO& m)
+{
+	Signature s;
+	s.vn = m.vert.size();
+	s.fn = m.face.size();
+
+	// order dependent hash, reduced with a xor of the hashes of the elements
+	uint64_t h = 0;
+#pragma omp parallel for schedule(static) reduction(^ : h)
+	for (long long i = 0; i < (long long) m.vert.size(); ++i) {
+		const CVertexO& v = m.vert[i];
+		uint64_t        x = mix(uint64_t(i) + 1);
+		if (v.IsD())
+			x = mix(x ^ 0xD);
+		else
+			for (int d = 0; d < 3; ++d)
+				x = mix(x ^ bits(v.cP()[d]));
+		h ^= x;
+	}
+#pragma omp parallel for schedule(static) reduction(^ : h)
+	for (long long i = 0; i < (long long) m.face.size(); ++i) {
+		const CFaceO& f = m.face[i];
+		uint64_t      x = mix(~uint64_t(i));
+		if (f.IsD())
+			x = mix(x ^ 0xD);
+		else
+			for (int j = 0; j < 3; ++j)
+				x = mix(x ^ uint64_t(vcg::tri::Index(m, f.cV(j))));
+		h ^= x;
+	}
+	s.hash = h;
+	return s;
+}
+
+HeatGeodesicSolver::HeatGeodesicSolver(
+	const CMeshO&    m,
+	Scalarm          timeStepMultiplier,
+	const Signature& signature) :
+		signature(signature), timeStepMultiplier(timeStepMultiplier)
+{
+	vcg::tri::RequireCompactness(m);
+
+	points.resize(m.vert.size());
+	for (size_t i = 0; i < m.vert.size(); ++i)
+		points[i] = Eigen::Vector3d(m.vert[i].cP()[0], m.vert[i].cP()[1], m.vert[i].cP()[2]);
+	faces.resize(m.face.size());
+	for (size_t i = 0; i < m.face.size(); ++i)
+		for (int j = 0; j < 3; ++j)
+			faces[i][j] = int(vcg::tri::Index(m, m.face[i].cV(j)));
+
+	// cotangent laplacian (negative semidefinite) and lumped mass matrix
+	std::vector<Eigen::Triplet<double>> lt, mt;
+	lt.reserve(faces.size() * 12);
+	mt.reserve(faces.size() * 3);
+	double edgeSum = 0;
+	for (const Eigen::Vector3i& f : faces) {
+		const Eigen::Vector3d p[3] = {points[f[0]], points[f[1]], points[f[2]]};
+		const double          area = (p[1] - p[0]).cross(p[2] - p[0]).norm() / 2;
+		for (int i = 0; i < 3; ++i) {
+			const int    j = (i + 1) % 3, k = (i + 2) % 3;
+			const double w = 0.5 * cotan(p[j] - p[i], p[k] - p[i]);
+			lt.emplace_back(f[j], f[k], w);
+			lt.emplace_back(f[k], f[j], w);
+			lt.emplace_back(f[j], f[j], -w);
+			lt.emplace_back(f[k], f[k], -w);
+			mt.emplace_back(f[i], f[i], area / 3);
+			edgeSum += (p[j] - p[i]).norm();
+		}
+	}
+	const int    vn = int(points.size());
+	SparseMatrix L(vn, vn), M(vn, vn);
+	L.setFromTriplets(lt.begin(), lt.end());
+	M.setFromTriplets(mt.begin(), mt.end());
+
+	const double h = faces.empty() ? 1 : edgeSum / (3 * faces.size());
+	const double t = timeStepMultiplier * h * h;
+
+	// the poisson problem is defined up to a constant on each connected
+	// component: a tiny mass term makes it positive definite
+	SparseMatrix heat    = M - t * L;
+	SparseMatrix poisson = -L + (1e-8 / (h * h)) * M;
+	heatSolver.compute(heat);
+	poissonSolver.compute(poisson);
+	valid = heatSolver.info() == Eigen::Success && poissonSolver.info() == Eigen::Success;
+}
+
+bool HeatGeodesicSolver::solve(
+	const std::vector<std::vector<int>>& sources,
+	Eigen::MatrixXd&                     distances) const
+{
+	if (!valid)
+		return false;
+	const int vn = int(points.size());
+	distances.resize(vn, sources.size());
+	for (size_t b = 0; b < sources.size(); b += SOLVE_BLOCK) {
+		const int       nb = int(std::min<size_t>(SOLVE_BLOCK, sources.size() - b));
+		Eigen::MatrixXd u0 = Eigen::MatrixXd::Zero(vn, nb);
+		for (int c = 0; c < nb; ++c)
+			for (int vi : sources[b + c])
+				u0(vi, c) = 1;
+
+		Eigen::MatrixXd u = heatSolver.solve(u0);
+		if (heatSolver.info() != Eigen::Success)
+			return false;
+		Eigen::MatrixXd div;
+		heatDivergence(points, faces, u, div);
+		Eigen::MatrixXd phi = poissonSolver.solve(-div);
+		if (poissonSolver.info() != Eigen::Success || !phi.allFinite())
+			return false;
+
+		// distances are defined up to a constant: zero them on the sources
+		for (int c = 0; c < nb; ++c) {
+			double origin = std::numeric_limits<double>::max();
+			for (int vi : sources[b + c])
+				origin = std::min(origin, phi(vi, c));
+			distances.col(b + c) = phi.col(c).array() - origin;
+		}
+	}
+	return true;
+}
+
+std::shared_ptr<HeatGeodesicSolver>
+HeatGeodesicSolver::cached(CMeshO& m, Scalarm timeStepMultiplier, vcg::CallBackPos* cb)
+{
+	auto handle = vcg::tri::Allocator<CMeshO>::GetPerMeshAttribute<
+		std::shared_ptr<HeatGeodesicSolver>>(m, std::string(CACHE_ATTRIBUTE));
+	std::shared_ptr<HeatGeodesicSolver>& solver = handle();
+	const Signature signature = Signature::of(m);
+	if (!solver || solver->timeStepMultiplier != timeStepMultiplier ||
+		!(solver->signature == signature)) {
+		if (cb != nullptr)
+			cb(20, "Building Cache: Computing Factorizations...");
+		solver = std::make_shared<HeatGeodesicSolver>(m, timeStepMultiplier, signature);
+	}
+	return solver;
+}
+
+void HeatGeodesicSolver::clearCache(CMeshO& m)
+{
+	auto handle = vcg::tri::Allocator<CMeshO>::FindPerMeshAttribute<
+		std::shared_ptr<HeatGeodesicSolver>>(m, std::string(CACHE_ATTRIBUTE));
+	if (vcg::tri::Allocator<CMeshO>::IsValidHandle(m, handle))
+		vcg::tri::Allocator<CMeshO>::DeletePerMeshAttribute(m, handle);
+}
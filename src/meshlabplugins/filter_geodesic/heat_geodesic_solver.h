@@ -0,0 +1,106 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef HEAT_GEODESIC_SOLVER_H
+#define HEAT_GEODESIC_SOLVER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Sparse>
+#include <common/ml_document/cmesh.h>
+
+/*
+Geodesic distances with the heat method (Crane et al., "Geodesics in Heat").
+
+The two factorizations (heat flow and Poisson) depend only on the mesh and
+on the time step, so a solver is built once and then used for any number of
+source sets; many source sets are solved together, back-substituting a
+block of right hand sides at a time.
+
+The solvers are cached as a per mesh attribute. CMeshO has no modification
+counter that the vcg algorithms would keep up to date, so the cache is keyed
+on a signature of the geometry and of the topology of the mesh, recomputed in
+parallel at each lookup: its cost is linear, negligible with respect to a
+factorization.
+*/
+class HeatGeodesicSolver
+{
+public:
+	/// hash of the vertex positions and of the faces of a mesh
+	struct Signature
+	{
+		size_t   vn = 0, fn = 0;
+		uint64_t hash = 0;
+
+		static Signature of(const CMeshO& m);
+		bool operator==(const Signature& o) const
+		{
+			return vn == o.vn && fn == o.fn && hash == o.hash;
+		}
+	};
+
+	/**
+	 * @brief Factorizes the operators of the mesh m, that must be compact.
+	 * The time step of the heat flow is timeStepMultiplier times the squared
+	 * average edge length. signature is Signature::of(m).
+	 */
+	HeatGeodesicSolver(const CMeshO& m, Scalarm timeStepMultiplier, const Signature& signature);
+
+	/// false if one of the factorizations failed (badly conditioned mesh)
+	bool isValid() const { return valid; }
+
+	/**
+	 * @brief Computes the geodesic distance of all the vertices from each one
+	 * of the source sets (non empty lists of vertex indices). distances has a
+	 * column for each source set, zero on its sources. Returns false if the heat method failed.
+	 */
+	bool solve(const std::vector<std::vector<int>>& sources, Eigen::MatrixXd& distances) const;
+
+	/**
+	 * @brief Returns the solver of m cached in the mesh, building it again if
+	 * the mesh or the time step have changed since it was built. cb is
+	 * notified only when the factorizations are computed.
+	 */
+	static std::shared_ptr<HeatGeodesicSolver>
+	cached(CMeshO& m, Scalarm timeStepMultiplier, vcg::CallBackPos* cb = nullptr);
+
+	/// drops the solver cached in m, if any
+	static void clearCache(CMeshO& m);
+
+private:
+	typedef Eigen::SparseMatrix<double>          SparseMatrix;
+	typedef Eigen::SimplicialLDLT<SparseMatrix> Solver;
+
+	Signature signature;
+	Scalarm   timeStepMultiplier;
+	bool      valid = false;
+
+	std::vector<Eigen::Vector3i> faces;
+	std::vector<Eigen::Vector3d> points;
+	Solver                       heatSolver;
+	Solver                       poissonSolver;
+};
+
+#endif // HEAT_GEODESIC_SOLVER_H
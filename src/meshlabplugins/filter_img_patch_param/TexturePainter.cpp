@@ -213,7 +213,7 @@ void TexturePainter::paint( RasterPatchMap &patches )
     // TEXTURE PAINTING.
     for( RasterPatchMap::iterator rp=patches.begin(); rp!=patches.end(); ++rp )
     {
-        QImage &rmImg = rp.key()->currentPlane->image;
+        const QImage rmImg = rp.key()->currentPlane->image();
 
 
         // Loads the raster into the GPU as a texture image.
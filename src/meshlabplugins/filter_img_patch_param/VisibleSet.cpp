@@ -70,9 +70,14 @@ VisibleSet::VisibleSet(glw::Context &ctx,
 		visibility.setRaster( rm );
 		visibility.checkVisibility();
 
+		// fetched once for all the faces: each access goes through the RasterPager
+		QImage rmImg;
+		if( m_WeightMask & W_IMG_ALPHA )
+			rmImg = rm->currentPlane->image();
+
 		for( int f=0; f<mesh.fn; ++f ){
 			if( visibility.isFaceVisible(f) ) {
-				float w = getWeight( rm, mesh.face[f] );
+				float w = getWeight( rm, rmImg, mesh.face[f] );
 				if( w >= 0.0f )
 					m_FaceVis[f].add( w, rm );
 			}
@@ -84,6 +89,15 @@ VisibleSet::VisibleSet(glw::Context &ctx,
 
 
 float VisibleSet::getWeight( const RasterModel *rm, CFaceO &f )
+{
+    QImage rmImg;
+    if( m_WeightMask & W_IMG_ALPHA )
+        rmImg = rm->currentPlane->image();
+    return getWeight( rm, rmImg, f );
+}
+
+
+float VisibleSet::getWeight( const RasterModel *rm, const QImage &rmImg, CFaceO &f )
 {
     Point3m centroid = (f.V(0)->P() +
                              f.V(1)->P() +
@@ -114,11 +128,11 @@ float VisibleSet::getWeight( const RasterModel *rm, CFaceO &f )
           Point2m ppoint = rm->shot.Project( f.V(i)->P() );
           if(ppoint[0] < 0 ||
              ppoint[1] < 0 ||
-             ppoint[0] >= rm->currentPlane->image.width() ||
-             ppoint[1] >= rm->currentPlane->image.height())
+             ppoint[0] >= rmImg.width() ||
+             ppoint[1] >= rmImg.height())
             alpha[i] = 0;
           else
-            alpha[i] = qAlpha(rm->currentPlane->image.pixel(ppoint[0],rm->shot.Intrinsics.ViewportPx[1] - ppoint[1]));
+            alpha[i] = qAlpha(rmImg.pixel(ppoint[0],rm->shot.Intrinsics.ViewportPx[1] - ppoint[1]));
         }
 
         int minAlpha = vcg::math::Min(alpha[0],alpha[1],alpha[2]);
@@ -85,6 +85,7 @@ public:
                 int weightMask );
 
     float               getWeight( const RasterModel *rm, CFaceO &f );
+    float               getWeight( const RasterModel *rm, const QImage &rmImg, CFaceO &f );
 
     inline const FaceVisInfo&  operator[]( const int f ) const                     { return m_FaceVis[f]; }
     inline       FaceVisInfo&  operator[]( const int f )                           { return m_FaceVis[f]; }
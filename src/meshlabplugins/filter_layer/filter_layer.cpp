@@ -21,6 +21,7 @@
  *                                                                           *
  ****************************************************************************/
 
+#include <algorithm>
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
@@ -227,6 +228,122 @@ FilterLayerPlugin::initParameterList(const QAction* action, const MeshDocument&
 	return parlst;
 }
 
+namespace {
+
+// faces and vertices (indices in the source mesh) of a connected component
+struct ComponentElements
+{
+	std::vector<int> faces;
+	std::vector<int> verts;
+};
+
+/*
+ * Labels the face connected components of m (FF adjacency required) in a
+ * single flood fill, numbering them as tri::Clean::ConnectedComponents does,
+ * and buckets their faces and vertices, in the order they have in m. A non
+ * manifold vertex shared by many components belongs to all of them.
+ */
+std::vector<ComponentElements> bucketConnectedComponents(const CMeshO& m)
+{
+	std::vector<int> label(m.face.size(), -1);
+	std::vector<int> stack;
+	int              numCC = 0;
+	for (size_t i = 0; i < m.face.size(); ++i) {
+		if (m.face[i].IsD() || label[i] >= 0)
+			continue;
+		label[i] = numCC;
+		stack.push_back(i);
+		while (!stack.empty()) {
+			const CFaceO& f = m.face[stack.back()];
+			stack.pop_back();
+			for (int j = 0; j < f.VN(); ++j) {
+				if (face::IsBorder(f, j))
+					continue;
+				int k = tri::Index(m, f.cFFp(j));
+				if (label[k] < 0) {
+					label[k] = numCC;
+					stack.push_back(k);
+				}
+			}
+		}
+		++numCC;
+	}
+
+	std::vector<ComponentElements> components(numCC);
+	for (size_t i = 0; i < m.face.size(); ++i)
+		if (label[i] >= 0)
+			components[label[i]].faces.push_back(i);
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for (long long c = 0; c < (long long) components.size(); ++c) {
+		std::vector<int>& verts = components[c].verts;
+		for (int fi : components[c].faces)
+			for (int j = 0; j < m.face[fi].VN(); ++j)
+				verts.push_back(tri::Index(m, m.face[fi].cV(j)));
+		std::sort(verts.begin(), verts.end());
+		verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+	}
+	return components;
+}
+
+/*
+ * Fills the empty mesh dst (with the same components of src enabled) with a
+ * connected component of src, like an append of its selected elements would
+ * do. Only the textures actually used by the component are listed in dst,
+ * remapping the texture indices.
+ */
+void buildComponentMesh(const CMeshO& src, const ComponentElements& c, CMeshO& dst)
+{
+	tri::Allocator<CMeshO>::AddVertices(dst, c.verts.size());
+	tri::Allocator<CMeshO>::AddFaces(dst, c.faces.size());
+	for (size_t i = 0; i < c.verts.size(); ++i) {
+		dst.vert[i].ImportData(src.vert[c.verts[i]]);
+		dst.vert[i].ClearS();
+	}
+	for (size_t i = 0; i < c.faces.size(); ++i) {
+		const CFaceO& sf = src.face[c.faces[i]];
+		CFaceO&       df = dst.face[i];
+		df.ImportData(sf);
+		df.ClearS();
+		for (int j = 0; j < sf.VN(); ++j) {
+			int vi = tri::Index(src, sf.cV(j));
+			df.V(j) = &dst.vert[std::lower_bound(c.verts.begin(), c.verts.end(), vi) - c.verts.begin()];
+		}
+	}
+
+	const bool wedgeTex = tri::HasPerWedgeTexCoord(dst);
+	const bool vertTex  = tri::HasPerVertexTexCoord(dst);
+	const int  texNum   = int(src.textures.size());
+	std::vector<int> texRemap(texNum, -1);
+	auto isTexture = [&](int n) { return n >= 0 && n < texNum; };
+	if (wedgeTex)
+		for (const CFaceO& f : dst.face)
+			for (int j = 0; j < f.VN(); ++j)
+				if (isTexture(f.cWT(j).n()))
+					texRemap[f.cWT(j).n()] = 0;
+	if (vertTex)
+		for (const CVertexO& v : dst.vert)
+			if (isTexture(v.cT().n()))
+				texRemap[v.cT().n()] = 0;
+	for (int t = 0; t < texNum; ++t) {
+		if (texRemap[t] == 0) {
+			texRemap[t] = int(dst.textures.size());
+			dst.textures.push_back(src.textures[t]);
+		}
+	}
+	if (wedgeTex)
+		for (CFaceO& f : dst.face)
+			for (int j = 0; j < f.VN(); ++j)
+				if (isTexture(f.WT(j).n()))
+					f.WT(j).n() = texRemap[f.WT(j).n()];
+	if (vertTex)
+		for (CVertexO& v : dst.vert)
+			if (isTexture(v.T().n()))
+				v.T().n() = texRemap[v.T().n()];
+}
+
+} // namespace
+
 // Core Function doing the actual mesh processing.
 std::map<std::string, QVariant> FilterLayerPlugin::applyFilter(
 	const QAction*           filter,
@@ -457,38 +574,29 @@ std::map<std::string, QVariant> FilterLayerPlugin::applyFilter(
 		CMeshO&    cm           = md.mm()->cm;
 		bool removeSourceMesh = par.getBool("delete_source_mesh");
 		md.mm()->updateDataMask(MeshModel::MM_FACEFACETOPO);
-		std::vector<std::pair<int, CMeshO::FacePointer>> connectedCompVec;
-		int numCC = tri::Clean<CMeshO>::ConnectedComponents(cm, connectedCompVec);
-		log("Found %i Connected Components", numCC);
-		tri::UpdateSelection<CMeshO>::FaceClear(cm);
-		tri::UpdateSelection<CMeshO>::VertexClear(cm);
-
-		for (size_t i = 0; i < connectedCompVec.size(); ++i) {
-			// select verts and faces of ith connected component
-			connectedCompVec[i].second->SetS();
-			tri::UpdateSelection<CMeshO>::FaceConnectedFF(cm /*,true*/);
-			tri::UpdateSelection<CMeshO>::VertexFromFaceLoose(cm);
-
-			// create a new mesh from the selection
-			MeshModel* destModel = md.addNewMesh("", QString("CC %1").arg(i), true);
-			destModel->updateDataMask(currentModel);
-			tri::Append<CMeshO, CMeshO>::Mesh(destModel->cm, cm, true);
-
-			// clear selection from source mesh and from newly created mesh
-			tri::UpdateSelection<CMeshO>::FaceClear(cm);
-			tri::UpdateSelection<CMeshO>::VertexClear(cm);
-			tri::UpdateSelection<CMeshO>::FaceClear(destModel->cm);
-			tri::UpdateSelection<CMeshO>::VertexClear(destModel->cm);
-
-			// append any textures... (todo: append only the ACTUALLY USED ones)
-			for (const std::string& txt : cm.textures) {
-				destModel->addTexture(txt, md.mm()->getTexture(txt));
-			}
-
-			// init new layer
-			destModel->updateBoxAndNormals();
-			destModel->cm.Tr = currentModel->cm.Tr;
+		cb(0, "Labeling connected components...");
+		std::vector<ComponentElements> components = bucketConnectedComponents(cm);
+		log("Found %i Connected Components", int(components.size()));
+
+		// the layers are added to the document sequentially, then filled concurrently
+		std::vector<MeshModel*> destModels(components.size());
+		for (size_t i = 0; i < components.size(); ++i) {
+			destModels[i] = md.addNewMesh("", QString("CC %1").arg(i), true);
+			destModels[i]->updateDataMask(currentModel);
+			destModels[i]->cm.Tr = currentModel->cm.Tr;
+		}
+		cb(50, "Building connected component layers...");
+#pragma omp parallel for schedule(dynamic, 16)
+		for (long long i = 0; i < (long long) components.size(); ++i) {
+			buildComponentMesh(cm, components[i], destModels[i]->cm);
+			destModels[i]->updateBoxAndNormals();
+		}
 
+		// append only the textures used by each component
+		for (MeshModel* destModel : destModels) {
+			for (const std::string& txt : destModel->cm.textures) {
+				destModel->addTexture(txt, currentModel->getTexture(txt));
+			}
 		}
 		if (removeSourceMesh)
 			md.delMesh(currentModel->id());
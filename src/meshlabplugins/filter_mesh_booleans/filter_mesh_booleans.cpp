@@ -22,6 +22,7 @@
  ****************************************************************************/
 
 #include "filter_mesh_booleans.h"
+#include "nary_boolean.h"
 
 #include <common/utilities/eigen_mesh_conversions.h>
 
@@ -37,7 +38,7 @@
  */
 FilterMeshBooleans::FilterMeshBooleans()
 {
-	typeList = {MESH_INTERSECTION, MESH_UNION, MESH_DIFFERENCE, MESH_XOR};
+	typeList = {MESH_INTERSECTION, MESH_UNION, MESH_DIFFERENCE, MESH_XOR, MESH_NARY};
 
 	for (const ActionIDType& tt : typeList)
 		actionList.push_back(new QAction(filterName(tt), this));
@@ -66,6 +67,7 @@ QString FilterMeshBooleans::filterName(ActionIDType filterId) const
 	case MESH_UNION: return "Mesh Boolean: Union";
 	case MESH_DIFFERENCE: return "Mesh Boolean: Difference";
 	case MESH_XOR: return "Mesh Boolean: Symmetric Difference (XOR)";
+	case MESH_NARY: return "Mesh Boolean: Visible Layers";
 	default: assert(0); return QString();
 	}
 }
@@ -77,6 +79,7 @@ QString FilterMeshBooleans::pythonFilterName(ActionIDType f) const
 	case MESH_UNION: return "generate_boolean_union";
 	case MESH_DIFFERENCE: return "generate_boolean_difference";
 	case MESH_XOR: return "generate_boolean_xor";
+	case MESH_NARY: return "generate_boolean_visible_layers";
 	default: assert(0); return QString();
 	}
 }
@@ -101,6 +104,22 @@ QString FilterMeshBooleans::filterInfo(ActionIDType filterId) const
 	case MESH_UNION: return description.arg("union");
 	case MESH_DIFFERENCE: return description.arg("difference");
 	case MESH_XOR: return description.arg("symmetric difference (XOR)");
+	case MESH_NARY:
+		return "This filter extecutes an exact boolean union or intersection between all the "
+			   "visible meshes. <br>"
+			   "The meshes are split in their connected shells, the shells that overlap or are "
+			   "nested are grouped, and each group is passed to its own exact boolean, in "
+			   "parallel; the isolated shells that do not intersect themselves are copied "
+			   "untouched in the result. Much faster than a sequence of boolean operations between two meshes "
+			   "when there are many parts.<br>"
+			   "Note that the shells of a group are passed whole to the exact boolean, not only "
+			   "their overlapping regions: a chain of shells each overlapping the next one (e.g. "
+			   "an assembly) is a single group, and costs a single exact boolean of all its shells.<br>"
+			   "The filter uses the original code provided in the "
+			   "<a href=\"https://libigl.github.io/\">libigl library</a>.<br>"
+			   "The implementation refers to the following paper:<br>"
+			   "<i>Qingnan Zhou, Eitan Grinspun, Denis Zorin, Alec Jacobson</i>,<br>"
+			   "<b>\"Mesh Arrangements for Solid Geometry\"</b><br>";
 	default: assert(0); return "Unknown Filter";
 	}
 }
@@ -119,6 +138,7 @@ FilterMeshBooleans::FilterClass FilterMeshBooleans::getClass(const QAction* a) c
 	case MESH_UNION:
 	case MESH_DIFFERENCE:
 	case MESH_XOR:
+	case MESH_NARY:
 		return FilterPlugin::FilterClass(
 			FilterPlugin::FilterClass(FilterPlugin::Layer + FilterPlugin::Remeshing));
 	default: assert(0); return FilterPlugin::Generic;
@@ -129,9 +149,9 @@ FilterMeshBooleans::FilterClass FilterMeshBooleans::getClass(const QAction* a) c
  * @brief FilterSamplePlugin::filterArity
  * @return
  */
-FilterPlugin::FilterArity FilterMeshBooleans::filterArity(const QAction*) const
+FilterPlugin::FilterArity FilterMeshBooleans::filterArity(const QAction* a) const
 {
-	return FIXED;
+	return ID(a) == MESH_NARY ? VARIABLE : FIXED;
 }
 
 /**
@@ -224,6 +244,26 @@ FilterMeshBooleans::initParameterList(const QAction* action, const MeshDocument&
 			"created vertices, "
 			"a simple average of the neighbours is computed."));
 	} break;
+	case MESH_NARY:
+		parlst.addParam(RichEnum(
+			"operation",
+			0,
+			QStringList() << "Union" << "Intersection",
+			"Operation",
+			"The boolean operation between all the visible meshes"));
+
+		parlst.addParam(RichBool(
+			"transfer_face_color",
+			false,
+			"Transfer face color",
+			"Save the color of the birth face to the faces of resulting mesh."));
+
+		parlst.addParam(RichBool(
+			"transfer_face_quality",
+			false,
+			"Transfer face quality",
+			"Save the quality of the birth face to the faces of resulting mesh."));
+		break;
 	default: assert(0);
 	}
 	return parlst;
@@ -242,10 +282,22 @@ std::map<std::string, QVariant> FilterMeshBooleans::applyFilter(
 	const RichParameterList& par,
 	MeshDocument&            md,
 	unsigned int& /*postConditionMask*/,
-	vcg::CallBackPos*)
+	vcg::CallBackPos* cb)
 {
 	bool transfFaceQuality = par.getBool("transfer_face_quality");
 	bool transfFaceColor   = par.getBool("transfer_face_color");
+
+	if (ID(action) == MESH_NARY) {
+		naryBooleanOperation(
+			md,
+			par.getEnum("operation") == 0 ? igl::MESH_BOOLEAN_TYPE_UNION :
+											igl::MESH_BOOLEAN_TYPE_INTERSECT,
+			transfFaceQuality,
+			transfFaceColor,
+			cb);
+		return std::map<std::string, QVariant>();
+	}
+
 	bool transfVertQuality = par.getBool("transfer_vert_quality");
 	bool transfVertColor   = par.getBool("transfer_vert_color");
 
@@ -362,6 +414,55 @@ void FilterMeshBooleans::booleanOperation(
 	}
 }
 
+/**
+ * @brief Executes the boolean operation op (union or intersection) between all
+ * the visible meshes of md, and puts the result as a new mesh into md.
+ */
+void FilterMeshBooleans::naryBooleanOperation(
+	MeshDocument&     md,
+	int               op,
+	bool              transfFaceQuality,
+	bool              transfFaceColor,
+	vcg::CallBackPos* cb)
+{
+	std::vector<const MeshModel*> models;
+	std::vector<const CMeshO*>    meshes;
+	for (const MeshModel& m : md.meshIterator()) {
+		if (m.isVisible()) {
+			models.push_back(&m);
+			meshes.push_back(&m.cm);
+		}
+	}
+	if (meshes.size() < 2)
+		throw MLException("At least two visible meshes are needed.");
+
+	std::vector<BooleanBirthFace> birth;
+	CMeshO result = naryMeshBoolean(meshes, op, birth, cb);
+	if (result.fn == 0 && op == igl::MESH_BOOLEAN_TYPE_INTERSECT)
+		throw MLException("The intersection of the visible meshes is empty.");
+
+	MeshModel* mesh = md.addNewMesh(
+		"", op == igl::MESH_BOOLEAN_TYPE_UNION ? "union" : "intersection");
+	mesh->cm = result;
+
+	if (transfFaceQuality)
+		mesh->updateDataMask(MeshModel::MM_FACEQUALITY);
+	if (transfFaceColor)
+		mesh->updateDataMask(MeshModel::MM_FACECOLOR);
+	if (transfFaceQuality || transfFaceColor) {
+		for (size_t i = 0; i < birth.size(); ++i) {
+			const MeshModel& m = *models[birth[i].mesh];
+			const CFaceO&    f = m.cm.face[birth[i].face];
+			if (transfFaceQuality)
+				mesh->cm.face[i].Q() = m.hasDataMask(MeshModel::MM_FACEQUALITY) ? f.cQ() : 0;
+			if (transfFaceColor)
+				mesh->cm.face[i].C() = m.hasDataMask(MeshModel::MM_FACECOLOR) ?
+										   f.cC() :
+										   vcg::Color4b(128, 128, 128, 255);
+		}
+	}
+}
+
 /**
  * @brief Allows to transfer face attributes from m1 and m2 to res, depending on the
  * birth faces indices.
@@ -48,7 +48,7 @@ class FilterMeshBooleans : public QObject, public FilterPlugin
 
 public:
 	// enum used to give an ID to every filter implemented in the plugin
-	enum FileterIds { MESH_INTERSECTION, MESH_UNION, MESH_DIFFERENCE, MESH_XOR };
+	enum FileterIds { MESH_INTERSECTION, MESH_UNION, MESH_DIFFERENCE, MESH_XOR, MESH_NARY };
 
 	FilterMeshBooleans();
 
@@ -61,6 +61,7 @@ public:
 	QString     filterInfo(ActionIDType filter) const;
 	FilterClass getClass(const QAction* a) const;
 	FilterArity filterArity(const QAction*) const;
+	bool        supportsBackgroundExecution(const QAction*) const { return true; }
 	// int getPreConditions(const QAction *) const;
 	// int postCondition(const QAction* ) const;
 	RichParameterList               initParameterList(const QAction*, const MeshDocument& /*m*/);
@@ -83,6 +84,14 @@ private:
 		bool             transfVertQuality,
 		bool             transfVertColor);
 
+	// boolean operation between all the visible meshes
+	static void naryBooleanOperation(
+		MeshDocument&     md,
+		int               op,
+		bool              transfFaceQuality,
+		bool              transfFaceColor,
+		vcg::CallBackPos* cb);
+
 	// transfer functions
 	static void transferFaceAttributes(
 		MeshModel&             res,
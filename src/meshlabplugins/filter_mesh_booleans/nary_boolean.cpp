@@ -0,0 +1,571 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "nary_boolean.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iterator>
+#include <memory>
+#include <numeric>
+
+#include <common/mlexception.h>
+#include <common/utilities/eigen_mesh_conversions.h>
+#include <vcg/complex/algorithms/clean.h>
+
+#include <igl/copyleft/cgal/mesh_boolean.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// closed overlap test: boxes of coplanar faces are flat and must still collide
+bool boxesOverlap(const Box3m& a, const Box3m& b)
+{
+	for (int d = 0; d < 3; ++d)
+		if (a.min[d] > b.max[d] || b.min[d] > a.max[d])
+			return false;
+	return true;
+}
+
+bool boxContains(const Box3m& outer, const Box3m& inner)
+{
+	for (int d = 0; d < 3; ++d)
+		if (inner.min[d] < outer.min[d] || inner.max[d] > outer.max[d])
+			return false;
+	return true;
+}
+
+/// a connected set of faces of an input mesh
+struct Shell
+{
+	int              mesh;
+	std::vector<int> faces;
+	Box3m            box;
+};
+
+std::vector<Shell> extractShells(const CMeshO& m, int meshIndex)
+{
+	std::vector<int> parent(m.vert.size());
+	std::iota(parent.begin(), parent.end(), 0);
+	auto find = [&](int i) {
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	};
+	for (const CFaceO& f : m.face) {
+		if (f.IsD())
+			continue;
+		int r0 = find(vcg::tri::Index(m, f.cV(0)));
+		for (int j = 1; j < 3; ++j) {
+			int rj = find(vcg::tri::Index(m, f.cV(j)));
+			if (rj != r0)
+				parent[std::max(rj, r0)] = std::min(rj, r0);
+			r0 = std::min(rj, r0);
+		}
+	}
+
+	std::vector<Shell> shells;
+	std::vector<int>   shellOf(m.vert.size(), -1);
+	for (size_t fi = 0; fi < m.face.size(); ++fi) {
+		const CFaceO& f = m.face[fi];
+		if (f.IsD())
+			continue;
+		int r = find(vcg::tri::Index(m, f.cV(0)));
+		if (shellOf[r] < 0) {
+			shellOf[r] = int(shells.size());
+			shells.push_back(Shell {meshIndex, {}, Box3m()});
+		}
+		Shell& s = shells[shellOf[r]];
+		s.faces.push_back(int(fi));
+		for (int j = 0; j < 3; ++j)
+			s.box.Add(f.cP(j));
+	}
+	return shells;
+}
+
+/// bounding volume hierarchy of the triangles of a shell
+class TriangleBVH
+{
+public:
+	TriangleBVH(const CMeshO& m, const std::vector<int>& faces)
+	{
+		boxes.resize(faces.size());
+		std::vector<Point3m> centers(faces.size());
+		for (size_t i = 0; i < faces.size(); ++i) {
+			m.face[faces[i]].GetBBox(boxes[i]);
+			centers[i] = boxes[i].Center();
+		}
+		std::vector<int> order(faces.size());
+		std::iota(order.begin(), order.end(), 0);
+		if (!order.empty())
+			build(order, centers, 0, int(order.size()));
+
+		std::vector<Box3m> sorted(boxes.size());
+		faceIds.resize(faces.size());
+		for (size_t i = 0; i < order.size(); ++i) {
+			sorted[i]  = boxes[order[i]];
+			faceIds[i] = faces[order[i]];
+		}
+		boxes.swap(sorted);
+	}
+
+	/// true if a triangle box of this BVH overlaps a triangle box of other
+	bool overlaps(const TriangleBVH& other) const
+	{
+		return !nodes.empty() && !other.nodes.empty() && overlaps(0, other, 0);
+	}
+
+	/// true if two triangles of the shell intersect (touching along a shared
+	/// vertex or edge does not count); m is the mesh the BVH was built on
+	bool selfIntersects(const CMeshO& m) const
+	{
+		return !nodes.empty() && selfIntersects(m, 0);
+	}
+
+private:
+	static const int LEAF_SIZE = 8;
+
+	struct Node
+	{
+		Box3m box;
+		int   left, right; // children, -1 for the leaves
+		int   begin, end;  // range of the triangles
+	};
+
+	int build(std::vector<int>& order, const std::vector<Point3m>& centers, int begin, int end)
+	{
+		const int n = int(nodes.size());
+		nodes.push_back(Node {Box3m(), -1, -1, begin, end});
+		Box3m box;
+		for (int i = begin; i < end; ++i)
+			box.Add(boxes[order[i]]);
+		nodes[n].box = box;
+		if (end - begin > LEAF_SIZE) {
+			const int axis = box.MaxDim();
+			const int mid  = (begin + end) / 2;
+			std::nth_element(
+				order.begin() + begin, order.begin() + mid, order.begin() + end, [&](int a, int b) {
+					return centers[a][axis] < centers[b][axis];
+				});
+			const int left  = build(order, centers, begin, mid);
+			const int right = build(order, centers, mid, end);
+			nodes[n].left   = left;
+			nodes[n].right  = right;
+		}
+		return n;
+	}
+
+	bool overlaps(int a, const TriangleBVH& other, int b) const
+	{
+		const Node& na = nodes[a];
+		const Node& nb = other.nodes[b];
+		if (!boxesOverlap(na.box, nb.box))
+			return false;
+		const bool leafA = na.left < 0, leafB = nb.left < 0;
+		if (leafA && leafB) {
+			for (int i = na.begin; i < na.end; ++i)
+				for (int j = nb.begin; j < nb.end; ++j)
+					if (boxesOverlap(boxes[i], other.boxes[j]))
+						return true;
+			return false;
+		}
+		// descend the biggest node
+		if (leafB || (!leafA && na.box.Volume() > nb.box.Volume()))
+			return overlaps(na.left, other, b) || overlaps(na.right, other, b);
+		return overlaps(a, other, nb.left) || overlaps(a, other, nb.right);
+	}
+
+	bool selfIntersects(const CMeshO& m, int a) const
+	{
+		const Node& na = nodes[a];
+		if (na.left < 0) {
+			for (int i = na.begin; i < na.end; ++i)
+				for (int j = i + 1; j < na.end; ++j)
+					if (trianglesIntersect(m, i, j))
+						return true;
+			return false;
+		}
+		return selfIntersects(m, na.left) || selfIntersects(m, na.right) ||
+			   intersects(m, na.left, na.right);
+	}
+
+	/// true if a triangle of node a intersects a triangle of node b
+	bool intersects(const CMeshO& m, int a, int b) const
+	{
+		const Node& na = nodes[a];
+		const Node& nb = nodes[b];
+		if (!boxesOverlap(na.box, nb.box))
+			return false;
+		const bool leafA = na.left < 0, leafB = nb.left < 0;
+		if (leafA && leafB) {
+			for (int i = na.begin; i < na.end; ++i)
+				for (int j = nb.begin; j < nb.end; ++j)
+					if (trianglesIntersect(m, i, j))
+						return true;
+			return false;
+		}
+		if (leafB || (!leafA && na.box.Volume() > nb.box.Volume()))
+			return intersects(m, na.left, b) || intersects(m, na.right, b);
+		return intersects(m, a, nb.left) || intersects(m, a, nb.right);
+	}
+
+	bool trianglesIntersect(const CMeshO& m, int i, int j) const
+	{
+		if (!boxesOverlap(boxes[i], boxes[j]))
+			return false;
+		// the test only reads the faces
+		CFaceO* f0 = const_cast<CFaceO*>(&m.face[faceIds[i]]);
+		CFaceO* f1 = const_cast<CFaceO*>(&m.face[faceIds[j]]);
+		return vcg::tri::Clean<CMeshO>::TestFaceFaceIntersection(f0, f1);
+	}
+
+	std::vector<Node>  nodes;
+	std::vector<Box3m> boxes;
+	std::vector<int>   faceIds; // the face of each box
+};
+
+/// generalized winding number of the shell around p, about 1 inside and 0 outside
+Scalarm windingNumber(const CMeshO& m, const Shell& s, const Point3m& p)
+{
+	Scalarm w = 0;
+	for (int fi : s.faces) {
+		const CFaceO& f  = m.face[fi];
+		Point3m       a  = f.cP(0) - p, b = f.cP(1) - p, c = f.cP(2) - p;
+		Scalarm       la = a.Norm(), lb = b.Norm(), lc = c.Norm();
+		Scalarm       num = a.dot(b ^ c);
+		Scalarm den = la * lb * lc + a.dot(b) * lc + b.dot(c) * la + c.dot(a) * lb;
+		w += 2 * std::atan2(num, den);
+	}
+	return w / (4 * M_PI);
+}
+
+bool nested(const CMeshO& mIn, const Shell& in, const CMeshO& mOut, const Shell& out)
+{
+	return boxContains(out.box, in.box) &&
+		   std::abs(windingNumber(mOut, out, mIn.face[in.faces[0]].cP(0))) > 0.5;
+}
+
+/// a piece of the result
+struct Piece
+{
+	EigenMatrixX3m                V;
+	Eigen::MatrixX3i              F;
+	std::vector<BooleanBirthFace> birth;
+};
+
+/// the vertices and faces of some shells of the same mesh, as indexed matrices
+void shellMatrices(
+	const CMeshO&                  m,
+	const std::vector<const Shell*>& shells,
+	EigenMatrixX3m&                V,
+	Eigen::MatrixX3i&              F,
+	std::vector<BooleanBirthFace>& birth)
+{
+	std::vector<int> verts;
+	size_t           fn = 0;
+	for (const Shell* s : shells) {
+		for (int fi : s->faces)
+			for (int j = 0; j < 3; ++j)
+				verts.push_back(vcg::tri::Index(m, m.face[fi].cV(j)));
+		fn += s->faces.size();
+	}
+	std::sort(verts.begin(), verts.end());
+	verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+
+	V.resize(verts.size(), 3);
+	for (size_t i = 0; i < verts.size(); ++i)
+		for (int d = 0; d < 3; ++d)
+			V(i, d) = m.vert[verts[i]].cP()[d];
+
+	F.resize(fn, 3);
+	size_t k = 0;
+	for (const Shell* s : shells) {
+		for (int fi : s->faces) {
+			for (int j = 0; j < 3; ++j) {
+				int vi  = vcg::tri::Index(m, m.face[fi].cV(j));
+				F(k, j) = int(std::lower_bound(verts.begin(), verts.end(), vi) - verts.begin());
+			}
+			birth.push_back(BooleanBirthFace {s->mesh, fi});
+			++k;
+		}
+	}
+}
+
+/// exact boolean of the given groups of shells, one group per operand
+Piece exactBoolean(
+	const std::vector<const CMeshO*>&              meshes,
+	const std::vector<std::vector<const Shell*>>& operands,
+	int                                           op)
+{
+	std::vector<EigenMatrixX3m>   Vlist(operands.size());
+	std::vector<Eigen::MatrixX3i> Flist(operands.size());
+	std::vector<BooleanBirthFace> inBirth;
+	for (size_t i = 0; i < operands.size(); ++i)
+		shellMatrices(*meshes[operands[i][0]->mesh], operands[i], Vlist[i], Flist[i], inBirth);
+
+	Piece           p;
+	Eigen::VectorXi J;
+	if (!igl::copyleft::cgal::mesh_boolean(Vlist, Flist, (igl::MeshBooleanType) op, p.V, p.F, J)) {
+		throw MLException(
+			"Mesh inputs must induce a piecewise constant winding number field.<br>"
+			"Make sure that all the input meshes are watertight (closed).");
+	}
+	p.birth.resize(J.size());
+	for (Eigen::Index i = 0; i < J.size(); ++i)
+		p.birth[i] = inBirth[J[i]];
+	return p;
+}
+
+bool progress(vcg::CallBackPos* cb, int pos, const char* str)
+{
+	return cb == nullptr || cb(pos, str);
+}
+
+/// reports the progress, throwing if the user has canceled the filter
+void checkProgress(vcg::CallBackPos* cb, int pos, const char* str)
+{
+	if (!progress(cb, pos, str))
+		throw MLException("Boolean operation canceled");
+}
+
+int threadNum()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+std::vector<Piece> naryUnion(
+	const std::vector<const CMeshO*>& meshes,
+	const std::vector<Shell>&         shells,
+	vcg::CallBackPos*                 cb)
+{
+	const int n = int(shells.size());
+
+	checkProgress(cb, 10, "Building the BVH of the shells");
+	std::vector<std::unique_ptr<TriangleBVH>> bvh(n);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < n; ++i)
+		bvh[i].reset(new TriangleBVH(*meshes[shells[i].mesh], shells[i].faces));
+
+	// candidate pairs by sweep and prune of the shell boxes along x
+	checkProgress(cb, 20, "Finding the overlapping shells");
+	std::vector<int> byX(n);
+	std::iota(byX.begin(), byX.end(), 0);
+	std::sort(byX.begin(), byX.end(), [&](int a, int b) {
+		return shells[a].box.min[0] < shells[b].box.min[0];
+	});
+	std::vector<std::pair<int, int>> candidates;
+	for (int i = 0; i < n; ++i)
+		for (int j = i + 1; j < n && shells[byX[j]].box.min[0] <= shells[byX[i]].box.max[0]; ++j)
+			if (boxesOverlap(shells[byX[i]].box, shells[byX[j]].box))
+				candidates.emplace_back(byX[i], byX[j]);
+
+	std::vector<char> interact(candidates.size(), 0);
+#pragma omp parallel for schedule(dynamic, 16)
+	for (int k = 0; k < int(candidates.size()); ++k) {
+		const Shell&  a  = shells[candidates[k].first];
+		const Shell&  b  = shells[candidates[k].second];
+		const CMeshO& ma = *meshes[a.mesh];
+		const CMeshO& mb = *meshes[b.mesh];
+		interact[k] = bvh[candidates[k].first]->overlaps(*bvh[candidates[k].second]) ||
+					  nested(ma, a, mb, b) || nested(mb, b, ma, a);
+	}
+
+	// groups of interacting shells
+	std::vector<int> parent(n);
+	std::iota(parent.begin(), parent.end(), 0);
+	auto find = [&](int i) {
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	};
+	for (size_t k = 0; k < candidates.size(); ++k)
+		if (interact[k]) {
+			int a = find(candidates[k].first), b = find(candidates[k].second);
+			parent[std::max(a, b)] = std::min(a, b);
+		}
+	std::vector<std::vector<int>> groups(n);
+	for (int i = 0; i < n; ++i)
+		groups[find(i)].push_back(i);
+	groups.erase(
+		std::remove_if(
+			groups.begin(), groups.end(), [](const std::vector<int>& g) { return g.empty(); }),
+		groups.end());
+
+	// an isolated shell is already its own union, unless it intersects itself
+	std::vector<char> passThrough(groups.size(), 0);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int g = 0; g < int(groups.size()); ++g) {
+		if (groups[g].size() == 1) {
+			const int s    = groups[g][0];
+			passThrough[g] = !bvh[s]->selfIntersects(*meshes[shells[s].mesh]);
+		}
+	}
+	bvh.clear();
+
+	// the biggest groups first, to balance the threads
+	std::vector<size_t> groupFaces(groups.size(), 0);
+	for (size_t g = 0; g < groups.size(); ++g)
+		for (int s : groups[g])
+			groupFaces[g] += shells[s].faces.size();
+	std::vector<int> order(groups.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return groupFaces[a] > groupFaces[b];
+	});
+
+	checkProgress(cb, 30, "Merging the shells");
+	std::vector<Piece> pieces(groups.size());
+	QString            error;
+	int                done = 0;
+	std::atomic<bool>  canceled(false);
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int k = 0; k < int(order.size()); ++k) {
+		if (canceled)
+			continue;
+		const std::vector<int>& g = groups[order[k]];
+		try {
+			if (passThrough[order[k]]) {
+				// non-overlapping geometry is copied untouched in the result
+				std::vector<const Shell*> shell = {&shells[g[0]]};
+				shellMatrices(
+					*meshes[shells[g[0]].mesh], shell, pieces[k].V, pieces[k].F, pieces[k].birth);
+			}
+			else {
+				// one operand for each mesh, made of all its shells in the
+				// group: the inside of a mesh is defined by all its shells
+				// together (e.g. a cavity is an inverted shell nested in another one)
+				std::vector<std::vector<const Shell*>> operands;
+				std::vector<int>                       operandOf(meshes.size(), -1);
+				for (int s : g) {
+					int& o = operandOf[shells[s].mesh];
+					if (o < 0) {
+						o = int(operands.size());
+						operands.emplace_back();
+					}
+					operands[o].push_back(&shells[s]);
+				}
+				// also a group of shells of a single mesh is resolved, since
+				// its shells can overlap
+				pieces[k] = exactBoolean(meshes, operands, igl::MESH_BOOLEAN_TYPE_UNION);
+			}
+		}
+		catch (const std::exception& e) {
+#pragma omp critical(nary_boolean_error)
+			error = e.what();
+		}
+		int d;
+#pragma omp atomic capture
+		d = ++done;
+		// only the calling thread reports the progress
+		if (threadNum() == 0 && !progress(cb, 30 + 60 * d / int(order.size()), "Merging the shells"))
+			canceled = true;
+	}
+	if (canceled)
+		throw MLException("Boolean operation canceled");
+	if (!error.isEmpty())
+		throw MLException(error);
+	return pieces;
+}
+
+std::vector<Piece> naryIntersection(
+	const std::vector<const CMeshO*>& meshes,
+	const std::vector<Shell>&         shells,
+	vcg::CallBackPos*                 cb)
+{
+	// the intersection lies in the common box of the meshes
+	std::vector<Box3m> meshBox(meshes.size());
+	for (const Shell& s : shells)
+		meshBox[s.mesh].Add(s.box);
+	Box3m common = meshBox[0];
+	for (const Box3m& b : meshBox) {
+		if (b.IsNull() || !boxesOverlap(common, b))
+			return {};
+		common.Intersect(b);
+	}
+
+	// a shell not overlapping the common box can neither cross it nor
+	// contain a part of it, so it does not change the result
+	std::vector<std::vector<const Shell*>> operands(meshes.size());
+	for (const Shell& s : shells)
+		if (boxesOverlap(s.box, common))
+			operands[s.mesh].push_back(&s);
+	for (const std::vector<const Shell*>& o : operands)
+		if (o.empty())
+			return {};
+
+	checkProgress(cb, 30, "Computing the intersection");
+	return {exactBoolean(meshes, operands, igl::MESH_BOOLEAN_TYPE_INTERSECT)};
+}
+
+} // namespace
+
+CMeshO naryMeshBoolean(
+	const std::vector<const CMeshO*>& meshes,
+	int                               op,
+	std::vector<BooleanBirthFace>&    birth,
+	vcg::CallBackPos*                 cb)
+{
+	checkProgress(cb, 0, "Splitting the meshes in shells");
+	std::vector<std::vector<Shell>> meshShells(meshes.size());
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < int(meshes.size()); ++i)
+		meshShells[i] = extractShells(*meshes[i], i);
+	std::vector<Shell> shells;
+	for (std::vector<Shell>& ms : meshShells)
+		std::move(ms.begin(), ms.end(), std::back_inserter(shells));
+
+	std::vector<Piece> pieces;
+	switch (op) {
+	case igl::MESH_BOOLEAN_TYPE_UNION: pieces = naryUnion(meshes, shells, cb); break;
+	case igl::MESH_BOOLEAN_TYPE_INTERSECT: pieces = naryIntersection(meshes, shells, cb); break;
+	default: throw MLException("Only union and intersection are supported on more than two meshes");
+	}
+
+	checkProgress(cb, 95, "Building the result");
+	Eigen::Index vn = 0, fn = 0;
+	for (const Piece& p : pieces) {
+		vn += p.V.rows();
+		fn += p.F.rows();
+	}
+	EigenMatrixX3m   V(vn, 3);
+	Eigen::MatrixX3i F(fn, 3);
+	birth.clear();
+	birth.reserve(fn);
+	Eigen::Index vo = 0, fo = 0;
+	for (const Piece& p : pieces) {
+		V.middleRows(vo, p.V.rows()) = p.V;
+		F.middleRows(fo, p.F.rows()) = (p.F.array() + int(vo)).matrix();
+		birth.insert(birth.end(), p.birth.begin(), p.birth.end());
+		vo += p.V.rows();
+		fo += p.F.rows();
+	}
+	return meshlab::meshFromMatrices(V, F);
+}
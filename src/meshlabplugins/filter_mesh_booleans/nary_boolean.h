@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef MESHLAB_NARY_BOOLEAN_H
+#define MESHLAB_NARY_BOOLEAN_H
+
+#include <common/ml_document/cmesh.h>
+
+#include <utility>
+#include <vector>
+
+/*
+N-ary mesh booleans.
+
+The meshes are split in their connected shells, and the shells are culled
+with their bounding boxes and a BVH of their triangles before calling the
+exact (and expensive) libigl/CGAL kernel:
+- union: two shells interact if some of their triangles overlap or if one is
+  nested in the other. Each group of interacting shells is merged by its own
+  exact boolean, with an operand for each mesh made of all its shells in the
+  group, and the groups run in parallel. The shells are passed whole to the
+  exact kernel, not clipped to their overlapping regions: a chain of shells
+  each overlapping the next one is a single (large) group. A group of shells
+  of a single mesh
+  is resolved too, as the exact union of the whole meshes would do; only a
+  shell that interacts with no other shell and does not intersect itself is
+  copied untouched in the result.
+- intersection: the result is contained in the intersection of the bounding
+  boxes of the meshes, so the shells not overlapping it are discarded before
+  the exact boolean.
+*/
+
+/// the face of an input mesh a face of the result comes from
+struct BooleanBirthFace
+{
+	int mesh; // index in the input vector
+	int face; // index in the face vector of the mesh
+};
+
+/**
+ * @brief Computes the union or the intersection (igl::MESH_BOOLEAN_TYPE_UNION
+ * or igl::MESH_BOOLEAN_TYPE_INTERSECT) of all the given meshes. For each
+ * face of the result, birth contains the input face it comes from. Throws an
+ * MLException if the exact kernel fails or if cb returns false.
+ */
+CMeshO naryMeshBoolean(
+	const std::vector<const CMeshO*>& meshes,
+	int                               op,
+	std::vector<BooleanBirthFace>&    birth,
+	vcg::CallBackPos*                 cb);
+
+#endif // MESHLAB_NARY_BOOLEAN_H
@@ -39,6 +39,8 @@
 #include <wrap/gl/glu_tessellator_cap.h>
 #include "quadric_simp.h"
 
+#include <QRegularExpression>
+
 using namespace std;
 using namespace vcg;
 using namespace vcg::tri;
@@ -74,6 +76,7 @@ ExtraMeshFilterPlugin::ExtraMeshFilterPlugin(void)
 		FP_CLUSTERING,
 		FP_QUADRIC_SIMPLIFICATION,
 		FP_QUADRIC_TEXCOORD_SIMPLIFICATION,
+		FP_QUADRIC_LOD_CHAIN,
 		FP_EXPLICIT_ISOTROPIC_REMESHING,
 		FP_MIDPOINT,
 		FP_REORIENT,
@@ -150,6 +153,7 @@ ExtraMeshFilterPlugin::FilterClass ExtraMeshFilterPlugin::getClass(const QAction
 	case FP_MIDPOINT                         :
 	case FP_QUADRIC_SIMPLIFICATION           :
 	case FP_QUADRIC_TEXCOORD_SIMPLIFICATION  :
+	case FP_QUADRIC_LOD_CHAIN                :
 	case FP_EXPLICIT_ISOTROPIC_REMESHING     :
 	case FP_CLUSTERING                       :
 	case FP_CLOSE_HOLES                      :
@@ -204,6 +208,7 @@ int ExtraMeshFilterPlugin::getPreConditions(const QAction *filter) const
 	case FP_MIDPOINT                         :
 	case FP_REFINE_CATMULL                   :
 	case FP_QUADRIC_SIMPLIFICATION           :
+	case FP_QUADRIC_LOD_CHAIN                :
 	case FP_EXPLICIT_ISOTROPIC_REMESHING     :
 	case FP_REORIENT                         :
 	case FP_INVERT_FACES                     :
@@ -260,6 +265,7 @@ QString ExtraMeshFilterPlugin::pythonFilterName(ActionIDType f) const
 	case FP_QUADRIC_SIMPLIFICATION: return tr("meshing_decimation_quadric_edge_collapse");
 	case FP_QUADRIC_TEXCOORD_SIMPLIFICATION:
 		return tr("meshing_decimation_quadric_edge_collapse_with_texture");
+	case FP_QUADRIC_LOD_CHAIN: return tr("meshing_decimation_quadric_edge_collapse_lod_chain");
 	case FP_EXPLICIT_ISOTROPIC_REMESHING: return tr("meshing_isotropic_explicit_remeshing");
 	case FP_CLUSTERING: return tr("meshing_decimation_clustering");
 	case FP_REORIENT: return tr("meshing_re_orient_faces_coherently");
@@ -306,6 +312,7 @@ QString ExtraMeshFilterPlugin::filterName(ActionIDType filter) const
 	case FP_QUADRIC_SIMPLIFICATION: return tr("Simplification: Quadric Edge Collapse Decimation");
 	case FP_QUADRIC_TEXCOORD_SIMPLIFICATION:
 		return tr("Simplification: Quadric Edge Collapse Decimation (with texture)");
+	case FP_QUADRIC_LOD_CHAIN: return tr("Simplification: Quadric Edge Collapse LOD Chain");
 	case FP_EXPLICIT_ISOTROPIC_REMESHING: return tr("Remeshing: Isotropic Explicit Remeshing");
 	case FP_CLUSTERING: return tr("Simplification: Clustering Decimation");
 	case FP_REORIENT: return tr("Re-Orient all faces coherently");
@@ -374,6 +381,9 @@ QString ExtraMeshFilterPlugin::filterInfo(ActionIDType filterID) const
 							       "<i>M. Garland and P. Heckbert.</i> <br>"
 			                                        "<b>Surface Simplification Using Quadric Error Metrics</b> (<a href='http://mgarland.org/papers/quadrics.pdf'>pdf</a>)<br>"
 			                                        "In Proceedings of SIGGRAPH 97.<br/><br/>");
+	case FP_QUADRIC_LOD_CHAIN                  : return tr("Build a chain of levels of detail of the current mesh with the quadric based edge-collapse simplification. "
+							       "The simplification is run only once, down to the smallest level: each time one of the target sizes is reached a copy of the mesh is added as a new layer, "
+							       "so a whole chain costs about as much as a single simplification. The current mesh is not modified.");
 	case FP_QUADRIC_TEXCOORD_SIMPLIFICATION    : return tr("Simplify a textured mesh using a Quadric based Edge Collapse Strategy preserving UV parametrization. "
 							       "Inspired in the QSLIM surface simplification algorithm "
 							       "by Michael Garland, which turned into the industry standard method for mesh simplification."
@@ -475,6 +485,20 @@ RichParameterList ExtraMeshFilterPlugin::initParameterList(const QAction * actio
 		parlst.addParam(RichBool ("QualityWeight",lastq_QualityWeight,"Weighted Simplification","Use the Per-Vertex quality as a weighting factor for the simplification. The weight is used as a error amplification value, so a vertex with a high quality value will not be simplified and a portion of the mesh with low quality values will be aggressively simplified."));
 		parlst.addParam(RichBool ("AutoClean",true,"Post-simplification cleaning","After the simplification an additional set of steps is performed to clean the mesh (unreferenced vertices, bad faces, etc)"));
 		parlst.addParam(RichBool ("Selected",m.cm.sfn>0,"Simplify only selected faces","The simplification is applied only to the selected set of faces.\n Take care of the target number of faces!"));
+		parlst.addParam(RichBool ("Parallel",false,"Parallel simplification","The mesh is split in spatial blocks that are simplified concurrently, keeping their shared borders fixed; the borders are simplified at the end. Much faster on large meshes, with a quality close to the standard simplification."));
+		break;
+
+	case FP_QUADRIC_LOD_CHAIN:
+		parlst.addParam(RichString("Targets", "0.5 0.1 0.01 0.001", "Target sizes", "The sizes of the levels of detail, separated by spaces or commas. Values not greater than 1 are fractions of the number of faces of the mesh, larger values are numbers of faces."));
+		parlst.addParam(RichBool ("PreserveTexCoord",m.cm.face.IsWedgeTexCoordEnabled(),"Preserve texture coordinates","Use the texture preserving simplification (the mesh must have consistent per wedge texture coordinates)."));
+		parlst.addParam(RichFloat("QualityThr",lastq_QualityThr,"Quality threshold","Quality threshold for penalizing bad shaped faces.<br>The value is in the range [0..1]\n 0 accept any kind of face (no penalties),\n 0.5  penalize faces with quality < 0.5, proportionally to their shape\n"));
+		parlst.addParam(RichBool ("PreserveBoundary",lastq_PreserveBoundary,"Preserve Boundary of the mesh","The simplification process tries to do not affect mesh boundaries during simplification"));
+		parlst.addParam(RichFloat("BoundaryWeight",lastq_BoundaryWeight,"Boundary Preserving Weight","The importance of the boundary during simplification. Default (1.0) means that the boundary has the same importance of the rest. Values greater than 1.0 raise boundary importance and has the effect of removing less vertices on the border. Admitted range of values (0,+inf). "));
+		parlst.addParam(RichBool ("PreserveNormal",lastq_PreserveNormal,"Preserve Normal","Try to avoid face flipping effects and try to preserve the original orientation of the surface"));
+		parlst.addParam(RichBool ("PreserveTopology",lastq_PreserveTopology,"Preserve Topology","Avoid all the collapses that should cause a topology change in the mesh (like closing holes, squeezing handles, etc). If checked the genus of the mesh should stay unchanged. Ignored when preserving texture coordinates."));
+		parlst.addParam(RichBool ("OptimalPlacement",lastq_OptimalPlacement,"Optimal position of simplified vertices","Each collapsed vertex is placed in the position minimizing the quadric error.\n It can fail (creating bad spikes) in case of very flat areas. \nIf disabled edges are collapsed onto one of the two original vertices and the final mesh is composed by a subset of the original vertices. "));
+		parlst.addParam(RichBool ("PlanarQuadric",lastq_PlanarQuadric,"Planar Simplification","Add additional simplification constraints that improves the quality of the simplification of the planar portion of the mesh, as a side effect, more triangles will be preserved in flat areas (allowing better shaped triangles)."));
+		parlst.addParam(RichBool ("AutoClean",true,"Post-simplification cleaning","After the simplification an additional set of steps is performed to clean each level (unreferenced vertices, bad faces, etc)"));
 		break;
 
 	case FP_QUADRIC_TEXCOORD_SIMPLIFICATION:
@@ -1000,7 +1024,10 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 		pp.QualityQuadricWeight=lastq_PlanarWeight = par.getFloat("PlanarWeight");
 		lastq_Selected = par.getBool("Selected");
 
-		QuadricSimplification(m.cm,TargetFaceNum,lastq_Selected,pp,  cb);
+		if(par.getBool("Parallel"))
+			ParallelQuadricSimplification(m.cm,TargetFaceNum,lastq_Selected,pp,  cb);
+		else
+			QuadricSimplification(m.cm,TargetFaceNum,lastq_Selected,pp,  cb);
 
 		if(par.getBool("AutoClean"))
 		{
@@ -1022,6 +1049,89 @@ std::map<std::string, QVariant> ExtraMeshFilterPlugin::applyFilter(
 
 	} break;
 
+	case FP_QUADRIC_LOD_CHAIN:
+	{
+		// the targets, as decreasing numbers of faces smaller than the current one
+		std::vector<int> targets;
+		for (const QString& t : par.getString("Targets").split(QRegularExpression("[\\s,;]+"), Qt::SkipEmptyParts)) {
+			bool ok;
+			double v = t.toDouble(&ok);
+			if (!ok || v <= 0)
+				throw MLException("Invalid target size: " + t);
+			int faces = (v <= 1) ? int(m.cm.fn * v) : int(v);
+			if (faces > 0 && faces < m.cm.fn)
+				targets.push_back(faces);
+		}
+		std::sort(targets.begin(), targets.end(), std::greater<int>());
+		targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+		if (targets.empty())
+			throw MLException("No target size is smaller than the current mesh.");
+
+		bool texCoord = par.getBool("PreserveTexCoord");
+		if (texCoord && !tri::HasPerWedgeTexCoord(m.cm)) {
+			log("The mesh has no per wedge texture coordinates: Preserve texture coordinates is ignored");
+			texCoord = false;
+		}
+		m.updateDataMask(MeshModel::MM_VERTFACETOPO | MeshModel::MM_VERTMARK);
+		if (texCoord && !tri::Clean<CMeshO>::HasConsistentPerWedgeTexCoord(m.cm)) {
+			throw MLException(
+				"Mesh has some inconsistent tex coordinates (some faces without texture)");
+		}
+
+		// the chain is extracted from a working copy, the current mesh is not touched
+		CMeshO work = m.cm;
+		tri::UpdateTopology<CMeshO>::VertexFace(work);
+		tri::UpdateFlags<CMeshO>::FaceBorderFromVF(work);
+
+		const QString baseName = QFileInfo(m.shortName()).baseName();
+		const bool autoClean = par.getBool("AutoClean");
+		auto levelReached = [&](int level) {
+			MeshModel* lod = md.addNewMesh(work, QString("%1_lod%2").arg(baseName).arg(level), false);
+			for (const std::string& tex: m.cm.textures) {
+				lod->addTexture(tex, m.getTexture(tex));
+			}
+			lod->clearDataMask(MeshModel::MM_VERTFACETOPO | MeshModel::MM_VERTMARK);
+			if (autoClean) {
+				tri::Clean<CMeshO>::RemoveFaceOutOfRangeArea(lod->cm,0);
+				tri::Clean<CMeshO>::RemoveDuplicateVertex(lod->cm);
+				tri::Clean<CMeshO>::RemoveUnreferencedVertex(lod->cm);
+			}
+			tri::Allocator<CMeshO>::CompactEveryVector(lod->cm);
+			lod->updateBoxAndNormals();
+			tri::UpdateNormal<CMeshO>::NormalizePerFace(lod->cm);
+			tri::UpdateNormal<CMeshO>::PerVertexFromCurrentFaceNormal(lod->cm);
+			tri::UpdateNormal<CMeshO>::NormalizePerVertex(lod->cm);
+			log("LOD %d: %d faces", level, lod->cm.fn);
+		};
+
+		lastq_QualityThr = par.getFloat("QualityThr");
+		lastq_PreserveBoundary = par.getBool("PreserveBoundary");
+		lastq_PreserveNormal = par.getBool("PreserveNormal");
+		lastq_OptimalPlacement = par.getBool("OptimalPlacement");
+		lastq_PlanarQuadric = par.getBool("PlanarQuadric");
+		if (texCoord) {
+			tri::TriEdgeCollapseQuadricTexParameter pp;
+			pp.QualityThr = lastq_QualityThr;
+			pp.OptimalPlacement = lastq_OptimalPlacement;
+			pp.PreserveBoundary = lastq_PreserveBoundary;
+			pp.BoundaryWeight = pp.BoundaryWeight * par.getFloat("BoundaryWeight");
+			pp.QualityQuadric = lastq_PlanarQuadric;
+			pp.NormalCheck = lastq_PreserveNormal;
+			QuadricTexSimplificationChain(work, targets, pp, levelReached, cb);
+		}
+		else {
+			tri::TriEdgeCollapseQuadricParameter pp;
+			pp.QualityThr = lastq_QualityThr;
+			pp.PreserveBoundary = lastq_PreserveBoundary;
+			pp.BoundaryQuadricWeight = pp.BoundaryQuadricWeight * par.getFloat("BoundaryWeight");
+			pp.PreserveTopology = lastq_PreserveTopology = par.getBool("PreserveTopology");
+			pp.NormalCheck = lastq_PreserveNormal;
+			pp.OptimalPlacement = lastq_OptimalPlacement;
+			pp.QualityQuadric = lastq_PlanarQuadric;
+			QuadricSimplificationChain(work, targets, pp, levelReached, cb);
+		}
+	} break;
+
 	case FP_QUADRIC_TEXCOORD_SIMPLIFICATION:
 	{
 		m.updateDataMask(MeshModel::MM_VERTFACETOPO | MeshModel::MM_VERTMARK);
@@ -1988,6 +2098,7 @@ int ExtraMeshFilterPlugin::postCondition(const QAction * filter) const
 
 	case FP_SLICE_WITH_A_PLANE :
 	case FP_PERIMETER_POLYLINE :
+	case FP_QUADRIC_LOD_CHAIN :
 	case FP_CYLINDER_UNWRAP : return MeshModel::MM_NONE; // they create a new layer
 
 	default                  : return MeshModel::MM_ALL;
@@ -45,6 +45,7 @@ public:
 		FP_CLUSTERING,
 		FP_QUADRIC_SIMPLIFICATION,
 		FP_QUADRIC_TEXCOORD_SIMPLIFICATION,
+		FP_QUADRIC_LOD_CHAIN,
 		FP_EXPLICIT_ISOTROPIC_REMESHING,
 		FP_NORMAL_EXTRAPOLATION,
 		FP_NORMAL_SMOOTH_POINTCLOUD,
@@ -101,6 +102,7 @@ public:
 	int getPreConditions(const QAction *filter) const;
 	int getRequirements(const QAction* filter);
 	FilterArity filterArity(const QAction *) const {return SINGLE_MESH;}
+	bool supportsBackgroundExecution(const QAction *) const {return true;}
 protected:
 
 	float lastq_QualityThr;
@@ -22,6 +22,12 @@
 #include "meshfilter.h"
 #include "quadric_simp.h"
 
+#include <unordered_map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace vcg;
 using namespace std;
 
@@ -144,3 +150,353 @@ void QuadricTexSimplification(CMeshO &m,int  TargetFaceNum, bool Selected, tri::
   tri::QuadricTexHelper<CMeshO>::TDp()=nullptr;
 
 }
+
+/*
+ * Parallel simplification.
+ *
+ * The faces are partitioned in a grid of spatial blocks (a few blocks for
+ * each thread, to balance the load). Each block is copied in a small mesh,
+ * with the vertices shared with other blocks locked (not writable), and
+ * simplified by its own decimation session, with its own quadrics. The result
+ * is written back in place: the collapses only move and delete the vertices of
+ * the block and change the faces of the block. A final serial pass unlocks
+ * the seams between the blocks and their neighborhood, and simplifies them to
+ * reach the requested number of faces.
+ */
+namespace {
+
+const int MAX_BLOCK_THREADS = 16;
+
+// runs the decimation session of a block with the collapse instance of slot
+template <int N>
+void decimateBlock(int slot, CMeshO &m, int TargetFaceNum, tri::TriEdgeCollapseQuadricParameter &pp)
+{
+  if (slot != N) {
+    decimateBlock<N + 1>(slot, m, TargetFaceNum, pp);
+    return;
+  }
+  math::Quadric<double> QZero;
+  QZero.SetZero();
+  tri::QuadricTemp TD(m.vert,QZero);
+  tri::QHelper::TDp()=&TD;
+
+  vcg::LocalOptimization<CMeshO> DeciSession(m,&pp);
+  DeciSession.Init<tri::BlockTriEdgeCollapse<N> >();
+  DeciSession.SetTargetSimplices(TargetFaceNum);
+  while( DeciSession.DoOptimization() && m.fn>TargetFaceNum )
+    ;
+  DeciSession.Finalize<tri::BlockTriEdgeCollapse<N> >();
+
+  tri::QHelper::TDp()=nullptr;
+}
+
+template <>
+void decimateBlock<MAX_BLOCK_THREADS>(int, CMeshO &, int, tri::TriEdgeCollapseQuadricParameter &)
+{
+  assert(0);
+}
+
+const int SEAM = -2;
+
+void simplifyBlock(
+    CMeshO &m,
+    const std::vector<int> &faces,
+    const std::vector<int> &vertBlock,
+    int block,
+    int faceToDel,
+    tri::TriEdgeCollapseQuadricParameter pp,
+    int slot)
+{
+  CMeshO sub;
+  sub.vert.EnableVFAdjacency();
+  sub.vert.EnableMark();
+  sub.face.EnableVFAdjacency();
+
+  std::unordered_map<size_t, int> local;
+  local.reserve(faces.size());
+  std::vector<size_t> vertOrig;
+  for (int f : faces)
+    for (int j = 0; j < 3; ++j)
+    {
+      size_t vi = tri::Index(m, m.face[f].V(j));
+      if (local.emplace(vi, (int) vertOrig.size()).second)
+        vertOrig.push_back(vi);
+    }
+
+  tri::Allocator<CMeshO>::AddVertices(sub, vertOrig.size());
+  for (size_t i = 0; i < vertOrig.size(); ++i)
+  {
+    const CVertexO &v = m.vert[vertOrig[i]];
+    sub.vert[i].P() = v.P();
+    sub.vert[i].Q() = v.Q();
+    sub.vert[i].Flags() = v.Flags();
+    if (vertBlock[vertOrig[i]] != block)
+      sub.vert[i].ClearW();
+  }
+
+  tri::Allocator<CMeshO>::AddFaces(sub, faces.size());
+  for (size_t k = 0; k < faces.size(); ++k)
+  {
+    const CFaceO &f = m.face[faces[k]];
+    for (int j = 0; j < 3; ++j)
+      sub.face[k].V(j) = &sub.vert[local[tri::Index(m, f.V(j))]];
+    sub.face[k].Flags() = f.Flags();
+  }
+  tri::UpdateTopology<CMeshO>::VertexFace(sub);
+
+  decimateBlock<0>(slot, sub, sub.fn - faceToDel, pp);
+
+  // only the unlocked vertices can be moved or deleted
+  for (size_t i = 0; i < vertOrig.size(); ++i)
+  {
+    if (sub.vert[i].IsD())
+      m.vert[vertOrig[i]].SetD();
+    else if (vertBlock[vertOrig[i]] == block)
+      m.vert[vertOrig[i]].P() = sub.vert[i].P();
+  }
+  for (size_t k = 0; k < faces.size(); ++k)
+  {
+    CFaceO &f = m.face[faces[k]];
+    if (sub.face[k].IsD())
+      f.SetD();
+    else
+      for (int j = 0; j < 3; ++j)
+        f.V(j) = &m.vert[vertOrig[tri::Index(sub, sub.face[k].V(j))]];
+  }
+}
+
+} // namespace
+
+void ParallelQuadricSimplification(CMeshO &m,int  TargetFaceNum, bool Selected, tri::TriEdgeCollapseQuadricParameter &pp, CallBackPos *cb)
+{
+  int threads = 1;
+#ifdef _OPENMP
+  threads = std::min(omp_get_max_threads(), MAX_BLOCK_THREADS);
+#endif
+  Box3m bb;
+  for (auto vi = m.vert.begin(); vi != m.vert.end(); ++vi)
+    if (!(*vi).IsD()) bb.Add((*vi).P());
+
+  if (threads < 2 || bb.IsNull() || bb.Diag() == 0)
+  {
+    QuadricSimplification(m, TargetFaceNum, Selected, pp, cb);
+    return;
+  }
+
+  if(Selected) // simplify only inside selected faces
+  {
+    // select only the vertices having ALL incident faces selected
+    tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(m);
+
+    // Mark not writable un-selected vertices
+    for(auto vi=m.vert.begin();vi!=m.vert.end();++vi) if(!(*vi).IsD())
+    {
+      if(!(*vi).IsS()) (*vi).ClearW();
+      else (*vi).SetW();
+    }
+  }
+
+  if(pp.PreserveBoundary && !Selected)
+  {
+    pp.FastPreserveBoundary=true;
+    pp.PreserveBoundary = false;
+  }
+
+  if(pp.NormalCheck) pp.NormalThrRad = M_PI/4.0;
+
+  const int faceToDel = Selected ? m.sfn - TargetFaceNum : m.fn - TargetFaceNum;
+  const int finalFaceNum = m.fn - faceToDel;
+
+  std::vector<bool> writable(m.vert.size());
+  for (size_t i = 0; i < m.vert.size(); ++i)
+    writable[i] = m.vert[i].IsW();
+
+  // grid of blocks with roughly cubic cells
+  cb(1,"Partitioning the mesh");
+  const int blocksWanted = threads * 4;
+  const Scalarm eps = bb.Diag() * 1e-3;
+  Point3m dim = bb.Dim();
+  for (int d = 0; d < 3; ++d) dim[d] = std::max(dim[d], eps);
+  const Scalarm side = std::cbrt(dim[0] * dim[1] * dim[2] / blocksWanted);
+  int gs[3];
+  for (int d = 0; d < 3; ++d) gs[d] = std::max(1, int(std::round(dim[d] / side)));
+  const int blockNum = gs[0] * gs[1] * gs[2];
+
+  std::vector<std::vector<int> > blockFaces(blockNum);
+  std::vector<int> removable(blockNum, 0);
+  std::vector<int> vertBlock(m.vert.size(), -1);
+  for (size_t fi = 0; fi < m.face.size(); ++fi)
+  {
+    const CFaceO &f = m.face[fi];
+    if (f.IsD()) continue;
+    const Point3m c = Barycenter(f);
+    int b = 0;
+    for (int d = 0; d < 3; ++d)
+      b = b * gs[d] + std::min(std::max(int((c[d] - bb.min[d]) / dim[d] * gs[d]), 0), gs[d] - 1);
+    blockFaces[b].push_back(int(fi));
+    if (!Selected || f.IsS()) removable[b]++;
+    for (int j = 0; j < 3; ++j)
+    {
+      int &vb = vertBlock[tri::Index(m, f.cV(j))];
+      if (vb == -1) vb = b;
+      else if (vb != b) vb = SEAM;
+    }
+  }
+  long long totalRemovable = 0;
+  for (int b = 0; b < blockNum; ++b) totalRemovable += removable[b];
+
+  if (faceToDel > 0 && totalRemovable > 0)
+  {
+    cb(5,"Simplifying blocks");
+#pragma omp parallel num_threads(threads)
+    {
+      int slot = 0;
+#ifdef _OPENMP
+      slot = omp_get_thread_num();
+#endif
+#pragma omp for schedule(dynamic)
+      for (int b = 0; b < blockNum; ++b)
+      {
+        if (blockFaces[b].empty()) continue;
+        const int blockToDel = int((long long) faceToDel * removable[b] / totalRemovable);
+        if (blockToDel > 0)
+          simplifyBlock(m, blockFaces[b], vertBlock, b, blockToDel, pp, slot);
+      }
+    }
+
+    m.vn = 0;
+    for (auto vi = m.vert.begin(); vi != m.vert.end(); ++vi) if (!(*vi).IsD()) m.vn++;
+    m.fn = 0;
+    for (auto fi = m.face.begin(); fi != m.face.end(); ++fi) if (!(*fi).IsD()) m.fn++;
+    tri::UpdateTopology<CMeshO>::VertexFace(m);
+    tri::UpdateFlags<CMeshO>::FaceBorderFromVF(m);
+
+    // unlock the seams and their two ring
+    std::vector<bool> unlock(m.vert.size(), false);
+    for (size_t i = 0; i < m.vert.size(); ++i)
+      unlock[i] = !m.vert[i].IsD() && vertBlock[i] == SEAM;
+    for (int ring = 0; ring < 2; ++ring)
+    {
+      std::vector<bool> grown = unlock;
+      for (auto fi = m.face.begin(); fi != m.face.end(); ++fi) if (!(*fi).IsD())
+      {
+        const size_t i0 = tri::Index(m, (*fi).V(0)), i1 = tri::Index(m, (*fi).V(1)), i2 = tri::Index(m, (*fi).V(2));
+        if (unlock[i0] || unlock[i1] || unlock[i2])
+          grown[i0] = grown[i1] = grown[i2] = true;
+      }
+      unlock.swap(grown);
+    }
+    for (size_t i = 0; i < m.vert.size(); ++i) if (!m.vert[i].IsD())
+    {
+      if (unlock[i] && writable[i]) m.vert[i].SetW();
+      else m.vert[i].ClearW();
+    }
+
+    if (m.fn > finalFaceNum)
+    {
+      cb(50,"Simplifying seams");
+      math::Quadric<double> QZero;
+      QZero.SetZero();
+      tri::QuadricTemp TD(m.vert,QZero);
+      tri::QHelper::TDp()=&TD;
+
+      vcg::LocalOptimization<CMeshO> DeciSession(m,&pp);
+      DeciSession.Init<tri::MyTriEdgeCollapse >();
+      DeciSession.SetTargetSimplices(finalFaceNum);
+      DeciSession.SetTimeBudget(0.1f);
+      const int seamToDel = m.fn - finalFaceNum;
+      while( DeciSession.DoOptimization() && m.fn>finalFaceNum )
+      {
+        cb(100-50*(m.fn-finalFaceNum)/(seamToDel), "Simplifying seams...");
+      };
+      DeciSession.Finalize<tri::MyTriEdgeCollapse >();
+      tri::QHelper::TDp()=nullptr;
+    }
+  }
+
+  // restore the writable flags
+  for (size_t i = 0; i < m.vert.size(); ++i) if (!m.vert[i].IsD())
+  {
+    if (writable[i]) m.vert[i].SetW();
+    else m.vert[i].ClearW();
+  }
+
+  if(Selected) // Clear Writable flags
+  {
+    for(auto vi=m.vert.begin();vi!=m.vert.end();++vi)
+    {
+      if (!(*vi).IsD()) (*vi).SetW();
+      if ((*vi).IsS()) (*vi).ClearS();
+    }
+  }
+}
+
+namespace {
+
+// runs an already initialized session through all the targets
+template <class COLLAPSE>
+void runChain(CMeshO &m, vcg::LocalOptimization<CMeshO> &DeciSession, const std::vector<int> &TargetFaceNums, const std::function<void(int)> &levelReached, CallBackPos *cb)
+{
+  DeciSession.SetTimeBudget(0.1f);
+  const int startFn = m.fn;
+  const int faceToDel = std::max(1, startFn - TargetFaceNums.back());
+  for (size_t i = 0; i < TargetFaceNums.size(); ++i)
+  {
+    DeciSession.SetTargetSimplices(TargetFaceNums[i]);
+    while( DeciSession.DoOptimization() && m.fn>TargetFaceNums[i] )
+    {
+      cb(100*(startFn-m.fn)/faceToDel, "Simplifying...");
+    };
+    levelReached(int(i));
+  }
+  DeciSession.Finalize<COLLAPSE>();
+}
+
+} // namespace
+
+void QuadricSimplificationChain(CMeshO &m, const std::vector<int> &TargetFaceNums, tri::TriEdgeCollapseQuadricParameter &pp, const std::function<void(int)> &levelReached, CallBackPos *cb)
+{
+  if (TargetFaceNums.empty()) return;
+  math::Quadric<double> QZero;
+  QZero.SetZero();
+  tri::QuadricTemp TD(m.vert,QZero);
+  tri::QHelper::TDp()=&TD;
+
+  if(pp.PreserveBoundary)
+  {
+    pp.FastPreserveBoundary=true;
+    pp.PreserveBoundary = false;
+  }
+
+  if(pp.NormalCheck) pp.NormalThrRad = M_PI/4.0;
+
+  vcg::LocalOptimization<CMeshO> DeciSession(m,&pp);
+  cb(1,"Initializing simplification");
+  DeciSession.Init<tri::MyTriEdgeCollapse >();
+  runChain<tri::MyTriEdgeCollapse>(m, DeciSession, TargetFaceNums, levelReached, cb);
+
+  tri::QHelper::TDp()=nullptr;
+}
+
+void QuadricTexSimplificationChain(CMeshO &m, const std::vector<int> &TargetFaceNums, tri::TriEdgeCollapseQuadricTexParameter &pp, const std::function<void(int)> &levelReached, CallBackPos *cb)
+{
+  if (TargetFaceNums.empty()) return;
+  tri::UpdateNormal<CMeshO>::PerFace(m);
+  math::Quadric<double> QZero;
+  QZero.SetZero();
+  tri::QuadricTexHelper<CMeshO>::QuadricTemp TD3(m.vert,QZero);
+  tri::QuadricTexHelper<CMeshO>::TDp3()=&TD3;
+
+  std::vector<std::pair<vcg::TexCoord2<float>,Quadric5<double> > > qv;
+
+  tri::QuadricTexHelper<CMeshO>::Quadric5Temp TD(m.vert,qv);
+  tri::QuadricTexHelper<CMeshO>::TDp()=&TD;
+
+  vcg::LocalOptimization<CMeshO> DeciSession(m,&pp);
+  cb(1,"Initializing simplification");
+  DeciSession.Init<tri::MyTriEdgeCollapseQTex>();
+  runChain<tri::MyTriEdgeCollapseQTex>(m, DeciSession, TargetFaceNums, levelReached, cb);
+
+  tri::QuadricTexHelper<CMeshO>::TDp3()=nullptr;
+  tri::QuadricTexHelper<CMeshO>::TDp()=nullptr;
+}
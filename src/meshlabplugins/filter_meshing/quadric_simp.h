@@ -19,6 +19,9 @@
  * for more details.                                                         *
  *                                                                           *
  ****************************************************************************/
+#include <functional>
+#include <vector>
+
 #include <vcg/container/simple_temporary_data.h>
 #include <vcg/complex/algorithms/local_optimization.h>
 #include <vcg/complex/algorithms/local_optimization/tri_edge_collapse_quadric.h>
@@ -40,7 +43,8 @@ public:
   static CVertexO::ScalarType W(CVertexO * /*v*/) {return 1.0;}
   static CVertexO::ScalarType W(CVertexO & /*v*/) {return 1.0;}
   static void Merge(CVertexO & /*v_dest*/, CVertexO const & /*v_del*/){}
-  static QuadricTemp* &TDp() {static QuadricTemp *td; return td;}
+  // thread local, so that concurrent simplifications have their own quadrics
+  static QuadricTemp* &TDp() {static thread_local QuadricTemp *td; return td;}
   static QuadricTemp &TD() {return *TDp();}
 };
 
@@ -52,6 +56,16 @@ public:
   inline MyTriEdgeCollapse(  const VertexPair &p, int i, BaseParameterClass *pp) :TECQ(p,i,pp){}
 };
 
+// Collapse used by the parallel simplification. TriEdgeCollapse keeps a static
+// GlobalMark for each collapse type: every thread uses its own instance N, so
+// that the blocks simplified concurrently do not share it.
+template <int N>
+class BlockTriEdgeCollapse: public vcg::tri::TriEdgeCollapseQuadric< CMeshO, VertexPair, BlockTriEdgeCollapse<N>, QHelper > {
+public:
+  typedef  vcg::tri::TriEdgeCollapseQuadric< CMeshO, VertexPair, BlockTriEdgeCollapse<N>, QHelper> TECQ;
+  inline BlockTriEdgeCollapse(  const VertexPair &p, int i, BaseParameterClass *pp) :TECQ(p,i,pp){}
+};
+
 class MyTriEdgeCollapseQTex: public TriEdgeCollapseQuadricTex< CMeshO, VertexPair, MyTriEdgeCollapseQTex, QuadricTexHelper<CMeshO> > {
 public:
             typedef  TriEdgeCollapseQuadricTex< CMeshO,  VertexPair, MyTriEdgeCollapseQTex, QuadricTexHelper<CMeshO> > TECQ;
@@ -62,4 +76,11 @@ public:
 } // end namespace vcg
 void QuadricSimplification   (CMeshO &m,int  TargetFaceNum,    bool Selected, vcg::tri::TriEdgeCollapseQuadricParameter &pp,    vcg::CallBackPos *cb);
 void QuadricTexSimplification(CMeshO &m,int  TargetFaceNum,    bool Selected, vcg::tri::TriEdgeCollapseQuadricTexParameter &pp, vcg::CallBackPos *cb);
+void ParallelQuadricSimplification(CMeshO &m,int  TargetFaceNum, bool Selected, vcg::tri::TriEdgeCollapseQuadricParameter &pp,    vcg::CallBackPos *cb);
+
+// Simplify the mesh through the given decreasing face targets with a single
+// decimation session: levelReached(i) is called as soon as the target i is
+// reached, while the mesh still contains the deleted elements.
+void QuadricSimplificationChain   (CMeshO &m, const std::vector<int> &TargetFaceNums, vcg::tri::TriEdgeCollapseQuadricParameter &pp,    const std::function<void(int)> &levelReached, vcg::CallBackPos *cb);
+void QuadricTexSimplificationChain(CMeshO &m, const std::vector<int> &TargetFaceNums, vcg::tri::TriEdgeCollapseQuadricTexParameter &pp, const std::function<void(int)> &levelReached, vcg::CallBackPos *cb);
 
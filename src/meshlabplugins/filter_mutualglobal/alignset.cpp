@@ -347,7 +347,7 @@ bool AlignSet::ProjectedMultiImageChanged()
 /////// Image 1
 	//arcImages[0]->save("im0.jpg");
 
-	QImage tmp = QGLWidget::convertToGLFormat(*arcImages[0]);
+	QImage tmp = QGLWidget::convertToGLFormat(arcImages[0]);
 	tmp=tmp.scaled(wt,ht);
 
 	//tmp.save("temp.jpg");
@@ -379,7 +379,7 @@ bool AlignSet::ProjectedMultiImageChanged()
 
 /////// Image 2
 
-	tmp = QGLWidget::convertToGLFormat(*arcImages[1]);
+	tmp = QGLWidget::convertToGLFormat(arcImages[1]);
 	tmp=tmp.scaled(wt,ht);
 		
 	//tmp.save("temp2.jpg");
@@ -411,7 +411,7 @@ bool AlignSet::ProjectedMultiImageChanged()
 
 /////// Image 3
 
-	tmp = QGLWidget::convertToGLFormat(*arcImages[2]);
+	tmp = QGLWidget::convertToGLFormat(arcImages[2]);
 	tmp=tmp.scaled(wt,ht);
 		
 	//tmp.save("temp3.jpg");
@@ -858,9 +858,9 @@ bool AlignSet::RenderMultiShadowMap(void)
 
 //resample image IF too big.
 void AlignSet::resize(int max_side) {
-  int w = image->width();
-  int h = image->height();
-  if(image->isNull()) {
+  int w = image.width();
+  int h = image.height();
+  if(image.isNull()) {
     w =  1024;
     h = 768;
   }
@@ -883,12 +883,12 @@ void AlignSet::resize(int max_side) {
   render = new unsigned char[w*h];
 
 
-  if(image->isNull()) return;
+  if(image.isNull()) return;
   //resize image and store values into render
   QImage im;
-  if(w != image->width() || h != image->height())
-    im = image->scaled(w, h, Qt::IgnoreAspectRatio); //Qt::KeepAspectRatio);
-  else im = *image;
+  if(w != image.width() || h != image.height())
+    im = image.scaled(w, h, Qt::IgnoreAspectRatio); //Qt::KeepAspectRatio);
+  else im = image;
   //im.save("image.jpg");
   assert(w == im.width());
   assert(h == im.height());
@@ -31,19 +31,19 @@ class AlignSet {
 
   int wt,ht;
   CMeshO* mesh;
-  QImage* image;
+  QImage image;
   double imageRatio;
   vcg::Shot<Scalarm> shot;
   vcg::Box3<float> box;
   vcg::Shot<Scalarm> shotPro;
-  QImage* imagePro;
+  QImage imagePro;
   vcg::Matrix44<float> shadPro;
   QList<PointCorrespondence*> *correspList; //List that includes corresponces involving the model
   double error; //alignment error in px
   QImage rend;
   QImage comb;
   //Node* node;
-  std::vector<QImage*> arcImages;
+  std::vector<QImage> arcImages;
   std::vector<vcg::Shot<Scalarm>*> arcShots;
   std::vector<float> arcMI;
   std::vector<vcg::Matrix44<float>> prjMats;
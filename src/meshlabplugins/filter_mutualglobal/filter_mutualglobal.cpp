@@ -38,6 +38,8 @@
 
 #include <vcg/complex/algorithms/point_sampling.h>
 
+#include <algorithm>
+
 #include <QElapsedTimer>
 
 // Constructor usually performs only two simple tasks of filling the two lists
@@ -46,6 +48,15 @@
 
 AlignSet alignset;
 
+// all the images are scaled to at most 800 pixels by the alignment: the low
+// resolution copy kept by the RasterPager is enough, if it is not smaller
+static QImage alignmentImage(RasterPlane* plane)
+{
+	QImage img = plane->lowResolutionImage();
+	if (std::max(img.width(), img.height()) < 800)
+		img = plane->image();
+	return img;
+}
 
 
 FilterMutualGlobal::FilterMutualGlobal()
@@ -245,6 +256,10 @@ std::map<std::string, QVariant> FilterMutualGlobal::applyFilter(
 			}
 
 			this->glContext->doneCurrent();
+			// the images kept by the alignset would not be released by the RasterPager
+			alignset.image=QImage();
+			alignset.imagePro=QImage();
+			alignset.arcImages.clear();
 			log("Done!");
 			break;
 
@@ -440,12 +455,13 @@ bool FilterMutualGlobal::preAlignment(MeshDocument &md, const RichParameterList
 		unsigned int r = 0;
 		for (RasterModel& rm : md.rasterIterator()) {
 			if(rm.isVisible()) {
-				alignset.image=&rm.currentPlane->image;
+				alignset.image=alignmentImage(rm.currentPlane);
+				QSize imageSize=rm.currentPlane->imageSize();
 				alignset.shot=rm.shot;
 
 				alignset.resize(800);
 
-				alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*alignset.image->width()/alignset.image->height());
+				alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*imageSize.width()/imageSize.height());
 				alignset.shot.Intrinsics.CenterPx[0]=(int)(alignset.shot.Intrinsics.ViewportPx[0]/2);
 
 				if (solver.fine_alignment)
@@ -456,9 +472,9 @@ bool FilterMutualGlobal::preAlignment(MeshDocument &md, const RichParameterList
 				}
 
 				rm.shot=alignset.shot;
-				float ratio= (float) rm.currentPlane->image.height()/(float)alignset.shot.Intrinsics.ViewportPx[1];
-				rm.shot.Intrinsics.ViewportPx[0]=rm.currentPlane->image.width();
-				rm.shot.Intrinsics.ViewportPx[1]=rm.currentPlane->image.height();
+				float ratio= (float) imageSize.height()/(float)alignset.shot.Intrinsics.ViewportPx[1];
+				rm.shot.Intrinsics.ViewportPx[0]=imageSize.width();
+				rm.shot.Intrinsics.ViewportPx[1]=imageSize.height();
 				rm.shot.Intrinsics.PixelSizeMm[1]/=ratio;
 				rm.shot.Intrinsics.PixelSizeMm[0]/=ratio;
 				rm.shot.Intrinsics.CenterPx[0]=(int)((float)rm.shot.Intrinsics.ViewportPx[0]/2.0);
@@ -546,7 +562,8 @@ std::vector<AlignPair> FilterMutualGlobal::CalcPairs(MeshDocument &md, bool glob
 	for (RasterModel& rm : md.rasterIterator()) {
 		if(rm.isVisible()) {
 			AlignPair pair;
-			alignset.image=&rm.currentPlane->image;
+			alignset.image=alignmentImage(rm.currentPlane);
+			QSize imageSize=rm.currentPlane->imageSize();
 			alignset.shot=rm.shot;
 
 			//this->initGL();
@@ -554,7 +571,7 @@ std::vector<AlignPair> FilterMutualGlobal::CalcPairs(MeshDocument &md, bool glob
 
 			//alignset.shot=par.getShotf("Shot");
 
-			alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*alignset.image->width()/alignset.image->height());
+			alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*imageSize.width()/imageSize.height());
 			alignset.shot.Intrinsics.CenterPx[0]=(int)(alignset.shot.Intrinsics.ViewportPx[0]/2);
 
 			alignset.mode=AlignSet::COMBINE;
@@ -568,8 +585,8 @@ std::vector<AlignPair> FilterMutualGlobal::CalcPairs(MeshDocument &md, bool glob
 				if (pm.id()!=rm.id()) {
 					alignset.mode=AlignSet::PROJIMG;
 					alignset.shotPro=pm.shot;
-					alignset.imagePro=&pm.currentPlane->image;
-					alignset.ProjectedImageChanged(*alignset.imagePro);
+					alignset.imagePro=alignmentImage(pm.currentPlane);
+					alignset.ProjectedImageChanged(alignset.imagePro);
 					float countTot=0.0;
 					float countCol=0.0;
 					alignset.RenderShadowMap();
@@ -620,8 +637,8 @@ std::vector<AlignPair> FilterMutualGlobal::CalcPairs(MeshDocument &md, bool glob
 					int p=weightList[i].projId;
 					alignset.mode=AlignSet::PROJIMG;
 					alignset.shotPro=rm.shot;
-					alignset.imagePro=&rm.currentPlane->image;
-					alignset.ProjectedImageChanged(*alignset.imagePro);
+					alignset.imagePro=alignmentImage(rm.currentPlane);
+					alignset.ProjectedImageChanged(alignset.imagePro);
 					float countTot=0.0;
 					float countCol=0.0;
 					float countCov=0.0;
@@ -853,7 +870,12 @@ bool FilterMutualGlobal::AlignNode(MeshDocument &md, Node node)
 
 	auto it= md.rasterBegin(); std::advance(it, node.id);
 	RasterModel& rm = *it;
-	alignset.image=&rm.currentPlane->image;
+	// the arcs of the previously aligned node
+	alignset.arcImages.clear();
+	alignset.arcShots.clear();
+	alignset.arcMI.clear();
+	alignset.image=alignmentImage(rm.currentPlane);
+	QSize imageSize=rm.currentPlane->imageSize();
 	alignset.shot=rm.shot;
 
 	alignset.mesh=&md.mm()->cm;
@@ -861,7 +883,7 @@ bool FilterMutualGlobal::AlignNode(MeshDocument &md, Node node)
 	for (unsigned int l=0; l<node.arcs.size(); l++) {
 		auto lit = md.rasterBegin(); std::advance(lit, node.arcs[l].projId);
 		RasterModel& lrm  =*lit;
-		alignset.arcImages.push_back(&lrm.currentPlane->image);
+		alignset.arcImages.push_back(alignmentImage(lrm.currentPlane));
 		alignset.arcShots.push_back(&lrm.shot);
 		alignset.arcMI.push_back(node.arcs[l].mutual);
 	}
@@ -871,17 +893,17 @@ bool FilterMutualGlobal::AlignNode(MeshDocument &md, Node node)
 	else if(alignset.arcImages.size()==1) {
 		auto lit = md.rasterBegin(); std::advance(lit, node.arcs[0].projId);
 		RasterModel& lrm  =*lit;
-		alignset.arcImages.push_back(&lrm.currentPlane->image);
+		alignset.arcImages.push_back(alignmentImage(lrm.currentPlane));
 		alignset.arcShots.push_back(&lrm.shot);
 		alignset.arcMI.push_back(node.arcs[0].mutual);
-		alignset.arcImages.push_back(&lrm.currentPlane->image);
+		alignset.arcImages.push_back(alignmentImage(lrm.currentPlane));
 		alignset.arcShots.push_back(&lrm.shot);
 		alignset.arcMI.push_back(node.arcs[0].mutual);
 	}
 	else if(alignset.arcImages.size()==2) {
 		auto lit = md.rasterBegin(); std::advance(lit, node.arcs[0].projId);
 		RasterModel& lrm  =*lit;
-		alignset.arcImages.push_back(&lrm.currentPlane->image);
+		alignset.arcImages.push_back(alignmentImage(lrm.currentPlane));
 		alignset.arcShots.push_back(&lrm.shot);
 		alignset.arcMI.push_back(node.arcs[0].mutual);
 	}
@@ -935,7 +957,7 @@ bool FilterMutualGlobal::AlignNode(MeshDocument &md, Node node)
 
 	//alignset.shot=par.getShotf("Shot");
 
-	alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*alignset.image->width()/alignset.image->height());
+	alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*imageSize.width()/imageSize.height());
 	alignset.shot.Intrinsics.CenterPx[0]=(int)(alignset.shot.Intrinsics.ViewportPx[0]/2);
 
 	int iter;
@@ -949,9 +971,9 @@ bool FilterMutualGlobal::AlignNode(MeshDocument &md, Node node)
 
 	//md.rasterList[node.id]->shot=alignset.shot;
 	rm.shot=alignset.shot;
-	float ratio=(float)rm.currentPlane->image.height()/(float)alignset.shot.Intrinsics.ViewportPx[1];
-	rm.shot.Intrinsics.ViewportPx[0]=rm.currentPlane->image.width();
-	rm.shot.Intrinsics.ViewportPx[1]=rm.currentPlane->image.height();
+	float ratio=(float)imageSize.height()/(float)alignset.shot.Intrinsics.ViewportPx[1];
+	rm.shot.Intrinsics.ViewportPx[0]=imageSize.width();
+	rm.shot.Intrinsics.ViewportPx[1]=imageSize.height();
 	rm.shot.Intrinsics.PixelSizeMm[1]/=ratio;
 	rm.shot.Intrinsics.PixelSizeMm[0]/=ratio;
 	rm.shot.Intrinsics.CenterPx[0]=(int)((float)rm.shot.Intrinsics.ViewportPx[0]/2.0);
@@ -1026,7 +1048,8 @@ bool FilterMutualGlobal::UpdateGraph(MeshDocument &md, SubGraph graph, int n)
 				RasterModel& rm = *it;
 				//this->glContext->makeCurrent();
 
-				alignset.image=&rm.currentPlane->image;
+				alignset.image=alignmentImage(rm.currentPlane);
+				QSize imageSize=rm.currentPlane->imageSize();
 				alignset.shot=rm.shot;
 
 				//this->initGL();
@@ -1034,7 +1057,7 @@ bool FilterMutualGlobal::UpdateGraph(MeshDocument &md, SubGraph graph, int n)
 
 				//alignset.shot=par.getShotf("Shot");
 
-				alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*alignset.image->width()/alignset.image->height());
+				alignset.shot.Intrinsics.ViewportPx[0]=int((double)alignset.shot.Intrinsics.ViewportPx[1]*imageSize.width()/imageSize.height());
 				alignset.shot.Intrinsics.CenterPx[0]=(int)(alignset.shot.Intrinsics.ViewportPx[0]/2);
 
 				/*alignset.mode=AlignSet::COMBINE;
@@ -1043,8 +1066,8 @@ bool FilterMutualGlobal::UpdateGraph(MeshDocument &md, SubGraph graph, int n)
 
 				alignset.mode=AlignSet::PROJIMG;
 				alignset.shotPro=rm.shot;
-				alignset.imagePro=&rm.currentPlane->image;
-				alignset.ProjectedImageChanged(*alignset.imagePro);
+				alignset.imagePro=alignmentImage(rm.currentPlane);
+				alignset.ProjectedImageChanged(alignset.imagePro);
 				alignset.RenderShadowMap();
 				alignset.renderScene(alignset.shot, 1, true);
 				graph.nodes[h].arcs[l].mutual=mutual.info(alignset.wt,alignset.ht,alignset.target,alignset.render);
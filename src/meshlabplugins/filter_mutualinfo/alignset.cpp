@@ -76,9 +76,9 @@ void AlignSet::initializeGL() {
 
 //resample image IF too big.
 void AlignSet::resize(int max_side) {
-    int w = image->width();
-    int h = image->height();
-    if(image->isNull()) {
+    int w = image.width();
+    int h = image.height();
+    if(image.isNull()) {
         w =  1024;
         h = 768;
     }
@@ -101,12 +101,12 @@ void AlignSet::resize(int max_side) {
     render = new unsigned char[w*h];
 
 
-    if(image->isNull()) return;
+    if(image.isNull()) return;
     //resize image and store values into render
     QImage im;
-    if(w != image->width() || h != image->height())
-        im = image->scaled(w, h, Qt::IgnoreAspectRatio); //Qt::KeepAspectRatio);
-    else im = *image;
+    if(w != image.width() || h != image.height())
+        im = image.scaled(w, h, Qt::IgnoreAspectRatio); //Qt::KeepAspectRatio);
+    else im = image;
     //im.save("image.jpg");
     assert(w == im.width());
     assert(h == im.height());
@@ -29,7 +29,7 @@ class AlignSet {
   int wt,ht;
   CMeshO* mesh;
   int meshid;
-  QImage* image;
+  QImage image;
   double imageRatio;
   vcg::Shot<MESHLAB_SCALAR> shot;
   vcg::Box3<float> box;
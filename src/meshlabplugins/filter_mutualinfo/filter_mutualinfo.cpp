@@ -181,7 +181,7 @@ void FilterMutualInfoPlugin::imageMutualInfoAlign(
 		throw MLException("You need a Raster Model to apply this filter!");
 	}
 	else {
-		align.image=&md.rm()->currentPlane->image;
+		align.image=md.rm()->currentPlane->image();
 	}
 
 	align.mesh=&md.mm()->cm;
@@ -221,7 +221,7 @@ void FilterMutualInfoPlugin::imageMutualInfoAlign(
 
 	align.shot = Shotm::Construct(shot);
 
-	align.shot.Intrinsics.ViewportPx[0]=int((double)align.shot.Intrinsics.ViewportPx[1]*align.image->width()/align.image->height());
+	align.shot.Intrinsics.ViewportPx[0]=int((double)align.shot.Intrinsics.ViewportPx[1]*align.image.width()/align.image.height());
 	align.shot.Intrinsics.CenterPx[0]=(int)(align.shot.Intrinsics.ViewportPx[0]/2);
 
 	///// Initialize GLContext
@@ -248,9 +248,9 @@ void FilterMutualInfoPlugin::imageMutualInfoAlign(
 			solver.iterative(&align, &mutual, align.shot);
 
 		md.rm()->shot = Shotm::Construct(align.shot);
-		float ratio=(float)md.rm()->currentPlane->image.height()/(float)align.shot.Intrinsics.ViewportPx[1];
-		md.rm()->shot.Intrinsics.ViewportPx[0]=md.rm()->currentPlane->image.width();
-		md.rm()->shot.Intrinsics.ViewportPx[1]=md.rm()->currentPlane->image.height();
+		float ratio=(float)align.image.height()/(float)align.shot.Intrinsics.ViewportPx[1];
+		md.rm()->shot.Intrinsics.ViewportPx[0]=align.image.width();
+		md.rm()->shot.Intrinsics.ViewportPx[1]=align.image.height();
 		md.rm()->shot.Intrinsics.PixelSizeMm[1]/=ratio;
 		md.rm()->shot.Intrinsics.PixelSizeMm[0]/=ratio;
 		md.rm()->shot.Intrinsics.CenterPx[0]=(int)((float)md.rm()->shot.Intrinsics.ViewportPx[0]/2.0);
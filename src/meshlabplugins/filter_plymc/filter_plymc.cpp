@@ -23,14 +23,110 @@
 
 #include "filter_plymc.h"
 #include <wrap/io_trimesh/export_vmi.h>
+#include <wrap/io_trimesh/import_vmi.h>
 #include <vcg/complex/algorithms/smooth.h>
 #include <vcg/complex/algorithms/create/plymc/plymc.h>
 #include <vcg/complex/algorithms/create/plymc/simplemeshprovider.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <QFileInfo>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace vcg;
 
+/*
+Mesh provider of a PlyMC instance that builds a single block of the volume.
+
+SimpleMeshProvider::InitBBox loads every range map to compute its bounding
+box, and each PlyMC instance would do it again. Here the boxes are computed
+once, while the range maps are preprocessed, and shared by all the blocks: a
+block loads from disk, through its own small mesh cache, only the range maps
+that overlap it. PlyMC is a template on its provider, so hiding InitBBox, bb
+and fullBB is enough.
+
+The VMI importer keeps its state in static members, so the blocks built in
+parallel must not load their range maps at the same time. Find loads a range
+map missing from the cache one thread at a time, and then does what
+PlyMC::InitMesh does for a fully preprocessed mesh (the range maps have an
+identity transformation): it computes the bounding box and moves the vertices
+in the coordinates of the volume, through the given function.
+*/
+template <class TriMeshType>
+class BlockMeshProvider : public SimpleMeshProvider<TriMeshType>
+{
+public:
+	void setRangeMaps(const std::vector<std::string>& names, const std::vector<Box3f>& boxes)
+	{
+		for (const std::string& n : names)
+			SimpleMeshProvider<TriMeshType>::AddSingleMesh(n.c_str());
+		bbv = &boxes;
+		fullBox.SetNull();
+		for (const Box3f& b : boxes)
+			fullBox.Add(b);
+	}
+
+	void setInterize(const std::function<void(Point3f&)>& f) { interize = f; }
+
+	bool InitBBox() { return true; }
+	Box3f bb(int i) { return (*bbv)[i]; }
+	Box3f fullBB() { return fullBox; }
+
+	bool Find(int i, TriMeshType*& sm)
+	{
+		if (SimpleMeshProvider<TriMeshType>::Find(i, sm))
+			return true;
+		const std::string name = SimpleMeshProvider<TriMeshType>::MeshName(i);
+		int loadMask = 0;
+		int ret;
+		sm->Clear();
+#pragma omp critical(plymc_vmi_load)
+		ret = tri::io::ImporterVMI<TriMeshType>::Open(*sm, name.c_str(), loadMask);
+		// returning false would make PlyMC::InitMesh load the file again,
+		// outside the critical section (ImporterVMI has static state)
+		if (ret != 0)
+			throw MLException("Failed to load the range map " + QString::fromStdString(name));
+		tri::UpdateBounding<TriMeshType>::Box(*sm);
+		for (auto& v : sm->vert)
+			interize(v.P());
+		return true;
+	}
+
+private:
+	const std::vector<Box3f>*         bbv = nullptr;
+	Box3f                             fullBox;
+	std::function<void(Point3f&)>     interize;
+};
+
+typedef tri::PlyMC<SMesh, BlockMeshProvider<SMesh> > BlockPlyMC;
+
+/*
+Simplifies a mesh extracted by PlyMC, as PlyMC itself does when its
+SimplificationFlag is set, keeping the vertices on the border of its subvolume.
+Not thread safe: MCSimplify keeps the state of the collapse in static members.
+*/
+static bool simplifyBlockMesh(const std::string& inName, const std::string& outName, float absoluteError)
+{
+	typedef BlockPlyMC::MCMesh MCMesh;
+	MCMesh m;
+	int mask = 0;
+	if (tri::io::ImporterPLY<MCMesh>::Open(m, inName.c_str(), mask) != 0)
+		return false;
+	m.face.EnableVFAdjacency();
+	tri::MCSimplify<MCMesh>(m, absoluteError, true);
+	tri::Allocator<MCMesh>::CompactFaceVector(m);
+	m.face.EnableFFAdjacency();
+	tri::Clean<MCMesh>::RemoveTVertexByFlip(m, 20, true);
+	tri::Clean<MCMesh>::RemoveFaceFoldByFlip(m);
+	return tri::io::ExporterPLY<MCMesh>::Save(m, outName.c_str(), mask) == 0;
+}
+
 // Constructor usually performs only two simple tasks of filling the two lists
 //  - typeList: with all the possible id of the filtering actions
 //  - actionList with the corresponding actions. If you want to add icons to your filtering actions you can do here by construction the QActions accordingly
@@ -78,7 +174,8 @@ QString PlyMCPlugin::filterInfo(ActionIDType filterId) const
 	case FP_PLYMC :  return QString( "The surface reconstrction algorithm that have been used for a long time inside the ISTI-Visual Computer Lab."
 									 "It is mostly a variant of the Curless et al. e.g. a volumetric approach with some original weighting schemes,"
 									 "a different expansion rule, and another approach to hole filling through volume dilation/relaxations.<br>"
-									 "The filter is applied to <b>ALL</b> the visible layers. In practice, all the meshes/point clouds that are currently <i>visible</i> are used to build the volumetric distance field.");
+									 "The filter is applied to <b>ALL</b> the visible layers. In practice, all the meshes/point clouds that are currently <i>visible</i> are used to build the volumetric distance field.<br>"
+									 "When the volume is split in subvolumes, they are reconstructed in parallel, loading from disk only the range maps that overlap each of them.");
 	case FP_MC_SIMPLIFY :  return QString( "A simplification/cleaning algorithm that works ONLY on meshes generated by Marching Cubes algorithm." );
 		
 	default : assert(0);
@@ -122,6 +219,7 @@ RichParameterList PlyMCPlugin::initParameterList(const QAction *action,const Mes
 		parlst.addParam(   RichBool("mergeColor",false,"Vertex Splatting","This option use a different way to build up the volume, instead of using rasterization of the triangular face it splat the vertices into the grids. It works under the assumption that you have at least one sample for each voxel of your reconstructed volume."));
 		parlst.addParam(   RichBool("simplification",false,"Post Merge simplification","After the merging an automatic simplification step is performed."));
 		parlst.addParam(    RichInt("normalSmooth",3,"PreSmooth iter" ,"How many times, before converting meshes into volume, the normal of the surface are smoothed. It is useful only to get more smooth expansion in case of noisy borders."));
+		parlst.addParam(   RichBool("joinBlocks",false,"Join SubVolumes","When the volume is split in many subvolumes, the matching meshes are joined in a single layer, welding the vertices along their seams. If not checked, each subvolume is opened in its own layer."));
 		break;
 	case FP_MC_SIMPLIFY :
 		break;
@@ -144,9 +242,9 @@ std::map<std::string, QVariant> PlyMCPlugin::applyFilter(
 	{
 		srand(time(NULL));
 
-		QDir currDir = QDir::current();
-
-		//Using tmp dir
+		//Using tmp dir: all the intermediate files are named with their absolute
+		//path, since the filter can run in background and the current directory
+		//is shared by the whole process
 		QTemporaryDir tmpdir;
 		QTemporaryFile file(tmpdir.path());
 		if (!file.open()) {
@@ -156,29 +254,29 @@ std::map<std::string, QVariant> PlyMCPlugin::applyFilter(
 				"tmp folder is not writable.<br> VCG Merging needs to save intermediate files in "
 				"the tmp folder.");
 		}
-		else {
-			QDir::setCurrent(tmpdir.path());
-		}
-		
-		tri::PlyMC<SMesh,SimpleMeshProvider<SMesh> > pmc;
-		pmc.MP.setCacheSize(64);
-		tri::PlyMC<SMesh,SimpleMeshProvider<SMesh> >::Parameter &p = pmc.p;
+		const QString tmpPath = tmpdir.path() + "/";
 		
 		int subdiv=par.getInt("subdiv");
+		const bool simplification = par.getBool("simplification");
+		const bool mergeColor = par.getBool("mergeColor");
+		printf("AutoComputing all subVolumes on a %ix%ix%i\n",subdiv,subdiv,subdiv);
 		
-		p.IDiv=Point3i(subdiv,subdiv,subdiv);
-		p.IPosS=Point3i(0,0,0);
-		p.IPosE[0]=p.IDiv[0]-1; p.IPosE[1]=p.IDiv[1]-1; p.IPosE[2]=p.IDiv[2]-1;
-		printf("AutoComputing all subVolumes on a %ix%ix%i\n",p.IDiv[0],p.IDiv[1],p.IDiv[2]);
+		auto setParameters = [&](auto& p) {
+			p.IDiv=Point3i(subdiv,subdiv,subdiv);
+			p.VoxSize=par.getAbsPerc("voxSize");
+			p.QualitySmoothVox = par.getFloat("geodesic");
+			p.SmoothNum = par.getInt("smoothNum");
+			p.WideNum = par.getInt("wideNum");
+			p.NCell=0;
+			p.FullyPreprocessedFlag=true;
+			p.MergeColor=p.VertSplatFlag=mergeColor;
+			p.SimplificationFlag = simplification;
+			p.basename = qUtf8Printable(tmpPath + "plymcout");
+		};
 		
-		p.VoxSize=par.getAbsPerc("voxSize");
-		p.QualitySmoothVox = par.getFloat("geodesic");
-		p.SmoothNum = par.getInt("smoothNum");
-		p.WideNum = par.getInt("wideNum");
-		p.NCell=0;
-		p.FullyPreprocessedFlag=true;
-		p.MergeColor=p.VertSplatFlag=par.getBool("mergeColor");
-		p.SimplificationFlag = par.getBool("simplification");
+		// range maps saved on disk, with their bounding boxes
+		std::vector<std::string> rangeMaps;
+		std::vector<Box3f> rangeBoxes;
 		for(MeshModel& mm: md.meshIterator()) {
 			if(mm.isVisible()) {
 				SMesh sm;
@@ -193,7 +291,7 @@ std::map<std::string, QVariant> PlyMCPlugin::applyFilter(
 				for(int i=0;i<par.getInt("normalSmooth");++i)
 					tri::Smooth<SMesh>::FaceNormalLaplacianVF(sm);
 				//QString mshTmpPath=QDir::tempPath()+QString("/")+QString(mm->shortName())+QString(".vmi");
-				QString mshTmpPath=QString("__TMP")+QString(mm.shortName())+QString(".vmi");
+				QString mshTmpPath=tmpPath+QString("__TMP")+QString(mm.shortName())+QString(".vmi");
 				qDebug("Saving tmp file %s",qUtf8Printable(mshTmpPath));
 				int retVal = tri::io::ExporterVMI<SMesh>::Save(sm,qUtf8Printable(mshTmpPath) );
 				if(retVal!=0) {
@@ -202,35 +300,146 @@ std::map<std::string, QVariant> PlyMCPlugin::applyFilter(
 					log("ERROR - Failed to write vmi temp file %s", qUtf8Printable(mshTmpPath));
 					throw MLException("Failed to write vmi temp file " + mshTmpPath);
 				}
-				pmc.MP.AddSingleMesh(qUtf8Printable(mshTmpPath));
+				rangeMaps.push_back(qUtf8Printable(mshTmpPath));
+				rangeBoxes.push_back(sm.bbox);
 				log("Preprocessing mesh %s",qUtf8Printable(mm.shortName()));
 			}
 		}
 		
-		if(pmc.Process(cb)==false) {
-			throw MLException(pmc.errorMessage.c_str());
+		// Each subvolume is built by its own PlyMC instance, with its own
+		// volume, marching cubes and mesh cache; the range maps are loaded
+		// on demand from the vmi files. When required, the subvolumes are
+		// simplified afterwards, one at a time (the collapse used by
+		// MCSimplify keeps its state in static members), keeping their
+		// borders so that the seams can still be joined.
+		std::vector<Point3i> blocks;
+		for(int z=0;z<subdiv;++z)
+			for(int y=0;y<subdiv;++y)
+				for(int x=0;x<subdiv;++x)
+					blocks.push_back(Point3i(x,y,z));
+		const int blockNum = int(blocks.size());
+		
+		int threads = 1;
+#ifdef _OPENMP
+		threads = std::min(omp_get_max_threads(), blockNum);
+#endif
+		const int cacheSize = std::max(4, 64 / threads);
+		
+		std::vector<std::vector<std::string>> blockMeshes(blockNum);
+		std::vector<std::string> blockErrors(blockNum);
+		std::vector<std::exception_ptr> blockExceptions(blockNum);
+		std::vector<float> blockVoxelSize(blockNum);
+		std::atomic<bool> canceled(false);
+		int done = 0;
+		if (cb != nullptr)
+			cb(0, "Merging the subvolumes");
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+		for(int b=0;b<blockNum;++b) {
+			if (canceled)
+				continue;
+			// an exception must not leave the parallel region: it is
+			// rethrown after the loop (e.g. a std::bad_alloc on a large volume)
+			try {
+				BlockPlyMC pmc;
+				pmc.MP.setCacheSize(cacheSize);
+				pmc.MP.setRangeMaps(rangeMaps, rangeBoxes);
+				pmc.MP.setInterize([&pmc](Point3f& p) { pmc.VV.Interize(p); });
+				setParameters(pmc.p);
+				pmc.p.SimplificationFlag = false;
+				pmc.p.IPosS = pmc.p.IPosE = blocks[b];
+				if(pmc.Process()==false)
+					blockErrors[b] = pmc.errorMessage;
+				else {
+					blockMeshes[b] = pmc.p.OutNameVec;
+					blockVoxelSize[b] = pmc.VV.voxel[0];
+				}
+			}
+			catch (const std::exception& e) {
+				blockErrors[b] = e.what();
+				blockExceptions[b] = std::current_exception();
+			}
+			
+			int d;
+#pragma omp atomic capture
+			d = ++done;
+#ifdef _OPENMP
+			if (omp_get_thread_num() == 0)
+#endif
+			{
+				// only the calling thread reports the progress
+				QString msg = QString("Merged subvolume %1 of %2").arg(d).arg(blockNum);
+				if (cb != nullptr && !cb(100 * d / blockNum, qUtf8Printable(msg)))
+					canceled = true;
+			}
+		}
+		
+		for(const std::string& n : rangeMaps)
+			QFile::remove(n.c_str());
+		for(const std::exception_ptr& e : blockExceptions) {
+			if (e) {
+				std::rethrow_exception(e);
+			}
+		}
+		if (canceled) {
+			throw MLException("VCG reconstruction canceled");
+		}
+		for(const std::string& e : blockErrors) {
+			if (!e.empty()) {
+				throw MLException(e.c_str());
+			}
 		}
 		
+		if (simplification) {
+			for(int b=0;b<blockNum;++b) {
+				for(std::string& name : blockMeshes[b]) {
+					std::string simpName = name.substr(0, name.size() - 4) + ".d.ply";
+					if (!simplifyBlockMesh(name, simpName, blockVoxelSize[b] / 4.0f)) {
+						throw MLException("Failed to simplify the subvolume " + QString::fromStdString(name));
+					}
+					name = simpName;
+				}
+				QString msg = QString("Simplified subvolume %1 of %2").arg(b+1).arg(blockNum);
+				if (cb != nullptr && !cb(100 * (b+1) / blockNum, qUtf8Printable(msg))) {
+					throw MLException("VCG reconstruction canceled");
+				}
+			}
+		}
 		
 		if(par.getBool("openResult")) {
-			for(size_t i=0;i<p.OutNameVec.size();++i)
-			{std::string name;
-				if(!p.SimplificationFlag) name = p.OutNameVec[i].c_str();
-				else name = p.OutNameSimpVec[i].c_str();
-				
-				MeshModel *mp=md.addNewMesh("",name.c_str(),true);  // created mesh is the current one, if multiple meshes are created last mesh is the current one
-				int loadMask=-1;
-				tri::io::ImporterPLY<CMeshO>::Open(mp->cm,name.c_str(),loadMask);
-				if(p.MergeColor) mp->updateDataMask(MeshModel::MM_VERTCOLOR);
+			std::vector<std::string> names;
+			for(const std::vector<std::string>& bm : blockMeshes)
+				names.insert(names.end(), bm.begin(), bm.end());
+			
+			if (par.getBool("joinBlocks") && names.size() > 1) {
+				MeshModel *mp=md.addNewMesh("","plymcout",true);
+				for(const std::string& name : names) {
+					CMeshO blockMesh;
+					int loadMask=-1;
+					tri::io::ImporterPLY<CMeshO>::Open(blockMesh,name.c_str(),loadMask);
+					tri::Append<CMeshO,CMeshO>::MeshAppendConst(mp->cm, blockMesh);
+				}
+				// the vertices on the seams are shared by the matching meshes
+				int welded = tri::Clean<CMeshO>::RemoveDuplicateVertex(mp->cm);
+				tri::Clean<CMeshO>::RemoveDuplicateFace(mp->cm);
+				tri::Clean<CMeshO>::RemoveUnreferencedVertex(mp->cm);
+				tri::Allocator<CMeshO>::CompactEveryVector(mp->cm);
+				log("Joined %i subvolumes, welding %i seam vertices", int(names.size()), welded);
+				if(mergeColor) mp->updateDataMask(MeshModel::MM_VERTCOLOR);
 				mp->updateDataMask(MeshModel::MM_VERTQUALITY);
 				mp->updateBoxAndNormals();
 			}
+			else {
+				for(const std::string& name : names)
+				{
+					MeshModel *mp=md.addNewMesh("",QFileInfo(QString::fromStdString(name)).fileName(),true);  // created mesh is the current one, if multiple meshes are created last mesh is the current one
+					int loadMask=-1;
+					tri::io::ImporterPLY<CMeshO>::Open(mp->cm,name.c_str(),loadMask);
+					if(mergeColor) mp->updateDataMask(MeshModel::MM_VERTCOLOR);
+					mp->updateDataMask(MeshModel::MM_VERTQUALITY);
+					mp->updateBoxAndNormals();
+				}
+			}
 		}
-		
-		for(int i=0;i<pmc.MP.size();++i)
-			QFile::remove(pmc.MP.MeshName(i).c_str());
-
-		QDir::setCurrent(currDir.path());
 	} break;
 	case FP_MC_SIMPLIFY:
 	{
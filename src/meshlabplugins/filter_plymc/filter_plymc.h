@@ -53,6 +53,7 @@ public:
 			vcg::CallBackPos * cb);
 	FilterClass getClass(const QAction* a) const;
 	FilterPlugin::FilterArity filterArity(const QAction* filter) const;
+	bool supportsBackgroundExecution(const QAction*) const { return true; }
 	int postCondition(const QAction *filter) const;
 
 };
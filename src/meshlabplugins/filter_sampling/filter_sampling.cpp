@@ -322,11 +322,58 @@ public:
 	}
 
 	float AddSample(const CMeshO::CoordType &startPt, const CMeshO::CoordType &startN)
+	{
+		bool found;
+		CMeshO::ScalarType dist = ComputeDistance(startPt, markerFunctor, found);
+		if (found)
+			AccumulateDistance(dist);
+		return dist;
+	}
+
+	/// Same as calling AddVert on all the vertices of the mesh, but the distances
+	/// are computed in parallel; the statistics are then accumulated in vertex order,
+	/// so the results are identical to the serial version.
+	void AddAllVertices(CMeshO &sampledMesh)
+	{
+		const int n = int(sampledMesh.vert.size());
+		std::vector<CMeshO::ScalarType> dist(n);
+		std::vector<char> found(n, 0);
+		// the marks of tri::FaceTmark are stored in the shared faces: the
+		// concurrent queries do not mark the faces, at the cost of testing
+		// again the faces that span many cells (the result does not change)
+		tri::EmptyTMark<CMeshO> marker;
+
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < n; ++i) {
+			CMeshO::VertexType &v = sampledMesh.vert[i];
+			if (v.IsD())
+				continue;
+			bool f;
+			dist[i] = ComputeDistance(v.cP(), marker, f);
+			found[i] = f;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			CMeshO::VertexType &v = sampledMesh.vert[i];
+			if (v.IsD())
+				continue;
+			v.Q() = dist[i];
+			if (found[i])
+				AccumulateDistance(dist[i]);
+		}
+	}
+
+private:
+	/// distance of startPt from the reference mesh; it only reads the search
+	/// structures, so it can be called concurrently using a different marker per thread.
+	template <class MarkerType>
+	CMeshO::ScalarType ComputeDistance(const CMeshO::CoordType &startPt, MarkerType &marker, bool &found)
 	{
 		// the results
 		CMeshO::CoordType closestPt;
 		CMeshO::CoordType closestNm;
 		CMeshO::ScalarType dist = dist_upper_bound;
+		found = false;
 
 		// compute distance between startPt and the mesh S2
 		CMeshO::FaceType   *nearestF = 0;
@@ -343,7 +390,7 @@ public:
 		}
 		else
 		{
-			nearestF = unifGridFace.GetClosest(PDistFunct, markerFunctor, startPt, maxDistABS, dist, closestPt);
+			nearestF = unifGridFace.GetClosest(PDistFunct, marker, startPt, maxDistABS, dist, closestPt);
 			if (nearestF == NULL) return (maxDistABS*2.0);
 
 			closestNm = nearestF->N();
@@ -355,18 +402,185 @@ public:
 			dist = -dist;
 		}
 
+		found = true;
+		return dist;
+	}
+
+	void AccumulateDistance(CMeshO::ScalarType dist)
+	{
 		if (dist > max_dist) max_dist = dist;
 		if (dist < min_dist) min_dist = dist;
 
 		mean_dist += dist;	       
 		RMS_dist += dist*dist;     
 		n_total_samples++;
-
-		return dist;
 	}
 }; 
 
 //--------------------------------------------------------------------
+// Multi-threaded version of vcg::tri::HausdorffSampler.
+// The samples generated by the sampling strategies are buffered; each block of
+// samples is then searched on the target mesh in parallel, and the distances are
+// reduced serially in the same order of generation, with the same code of
+// HausdorffSampler::AddSample, so that all the results are exactly the same of
+// the serial sampler.
+// A HausdorffSampler per thread is not used: each one would build its own grid
+// of the target mesh, and its tri::FaceTmark writes the marks in the shared faces.
+// The queries use a tri::EmptyTMark instead, that does not change their result.
+class ParallelHausdorffSampler
+{
+	typedef GridStaticPtr<CMeshO::FaceType, CMeshO::ScalarType > MetroMeshFaceGrid;
+	typedef GridStaticPtr<CMeshO::VertexType, CMeshO::ScalarType > MetroMeshVertexGrid;
+
+public:
+	static const size_t blockSize = 1 << 20;
+
+	ParallelHausdorffSampler(CMeshO* _m) : m(_m)
+	{
+		init();
+	}
+
+	CMeshO *m;              /// the mesh that is searched for the closest points
+	CMeshO *samplePtMesh;   /// if not null, the used samples are stored here
+	CMeshO *closestPtMesh;  /// if not null, the closest points of the used samples are stored here
+
+	MetroMeshVertexGrid unifGridVert;
+	MetroMeshFaceGrid   unifGridFace;
+
+	double min_dist;
+	double max_dist;
+	double mean_dist;
+	double RMS_dist;   /// from the wikipedia definition RMS DIST is sqrt(Sum(distances^2)/n), here we store Sum(distances^2)
+	Histogramf hist;
+	int n_total_samples;
+
+	bool useVertexSampling;
+	CMeshO::ScalarType dist_upper_bound;  // samples that have a distance beyond this threshold distance are not considered.
+
+	float getMeanDist() const { return mean_dist / n_total_samples; }
+	float getMinDist() const  { return min_dist; }
+	float getMaxDist() const  { return max_dist; }
+	float getRMSDist() const  { return sqrt(RMS_dist / n_total_samples); }
+
+	void init(CMeshO *_sampleMesh = nullptr, CMeshO *_closestMesh = nullptr)
+	{
+		samplePtMesh = _sampleMesh;
+		closestPtMesh = _closestMesh;
+		tri::UpdateNormal<CMeshO>::PerFaceNormalized(*m);
+		useVertexSampling = (m->fn == 0);
+		if (useVertexSampling)
+			unifGridVert.Set(m->vert.begin(), m->vert.end());
+		else
+			unifGridFace.Set(m->face.begin(), m->face.end());
+		hist.SetRange(0.0, m->bbox.Diag() / 100.0, 100);
+
+		min_dist = std::numeric_limits<double>::max();
+		max_dist = 0;
+		mean_dist = 0;
+		RMS_dist = 0;
+		n_total_samples = 0;
+		clearBuffers();
+	}
+
+	// Sampler interface: the samples are only buffered here, see flush()
+	void AddVert(CMeshO::VertexType &p)
+	{
+		addSample(p.cP(), p.cN(), &p);
+	}
+
+	void AddFace(const CMeshO::FaceType &f, CMeshO::CoordType interp)
+	{
+		CMeshO::CoordType startPt = f.cP(0)*interp[0] + f.cP(1)*interp[1] + f.cP(2)*interp[2];
+		CMeshO::CoordType startN  = f.cV(0)->cN()*interp[0] + f.cV(1)->cN()*interp[1] + f.cV(2)->cN()*interp[2];
+		addSample(startPt, startN, nullptr);
+	}
+
+	/// Computes the distances of all the buffered samples and accumulates them.
+	/// Must be called after the last sampling strategy has been run.
+	void flush()
+	{
+		const int n = int(samplePos.size());
+		if (n == 0)
+			return;
+		sampleDist.resize(n);
+		closestPos.resize(n);
+
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (int i = 0; i < n; ++i)
+			sampleDist[i] = closestPoint(samplePos[i], closestPos[i]);
+
+		// serial reduction, in the order in which the samples were generated
+		for (int i = 0; i < n; ++i) {
+			const CMeshO::ScalarType dist = sampleDist[i];
+			if (sampleVert[i] != nullptr)
+				sampleVert[i]->Q() = dist;
+			if (dist == dist_upper_bound)
+				continue;
+
+			if (dist > max_dist) max_dist = dist;
+			if (dist < min_dist) min_dist = dist;
+			mean_dist += dist;
+			RMS_dist += dist*dist;
+			n_total_samples++;
+			hist.Add((float)fabs(dist));
+
+			if (samplePtMesh) {
+				tri::Allocator<CMeshO>::AddVertices(*samplePtMesh, 1);
+				samplePtMesh->vert.back().P() = samplePos[i];
+				samplePtMesh->vert.back().Q() = dist;
+				samplePtMesh->vert.back().N() = sampleNrm[i];
+			}
+			if (closestPtMesh) {
+				tri::Allocator<CMeshO>::AddVertices(*closestPtMesh, 1);
+				closestPtMesh->vert.back().P() = closestPos[i];
+				closestPtMesh->vert.back().N() = sampleNrm[i]; // as HausdorffSampler does
+				closestPtMesh->vert.back().Q() = dist;
+			}
+		}
+		clearBuffers();
+	}
+
+private:
+	std::vector<CMeshO::CoordType> samplePos;
+	std::vector<CMeshO::CoordType> sampleNrm;
+	std::vector<CMeshO::VertexType*> sampleVert; // the sampled vertex, for vertex samples
+	std::vector<CMeshO::ScalarType> sampleDist;
+	std::vector<CMeshO::CoordType> closestPos;
+
+	void addSample(const CMeshO::CoordType &startPt, const CMeshO::CoordType &startN, CMeshO::VertexType* v)
+	{
+		samplePos.push_back(startPt);
+		sampleNrm.push_back(startN);
+		sampleVert.push_back(v);
+		if (samplePos.size() >= blockSize)
+			flush();
+	}
+
+	void clearBuffers()
+	{
+		samplePos.clear();
+		sampleNrm.clear();
+		sampleVert.clear();
+	}
+
+	// thread safe: the grids are only read, and the faces are not marked
+	CMeshO::ScalarType closestPoint(const CMeshO::CoordType& startPt, CMeshO::CoordType& closestPt)
+	{
+		CMeshO::ScalarType dist = dist_upper_bound;
+		if (useVertexSampling) {
+			CMeshO::VertexType* nearestV =
+				tri::GetClosestVertex<CMeshO, MetroMeshVertexGrid>(*m, unifGridVert, startPt, dist_upper_bound, dist);
+			if (nearestV != nullptr)
+				closestPt = nearestV->cP();
+		}
+		else {
+			vcg::face::PointDistanceBaseFunctor<CMeshO::ScalarType> PDistFunct;
+			tri::EmptyTMark<CMeshO> marker;
+			unifGridFace.GetClosest(PDistFunct, marker, startPt, dist_upper_bound, dist, closestPt);
+		}
+		return dist;
+	}
+};
 
 
 
@@ -1179,7 +1393,7 @@ std::map<std::string, QVariant> FilterDocSampling::applyFilter(
 		
 		MeshModel *samplePtMesh =0;
 		MeshModel *closestPtMesh =0;
-		vcg::tri::HausdorffSampler<CMeshO> hs(&(mm1->cm));
+		ParallelHausdorffSampler hs(&(mm1->cm));
 		if(saveSampleFlag)
 		{
 			closestPtMesh=md.addNewMesh("","Hausdorff Closest Points", false); // the new mesh is NOT the current one (byproduct of measurement)
@@ -1196,11 +1410,13 @@ std::map<std::string, QVariant> FilterDocSampling::applyFilter(
 		qDebug("Max sampling distance %f on a bbox diag of %f",distUpperBound,mm1->cm.bbox.Diag());
 		
 		if(sampleVert)
-			tri::SurfaceSampling<CMeshO,vcg::tri::HausdorffSampler<CMeshO> >::VertexUniform(mm0->cm,hs,par.getInt("SampleNum"));
+			tri::SurfaceSampling<CMeshO,ParallelHausdorffSampler>::VertexUniform(mm0->cm,hs,par.getInt("SampleNum"));
 		if(sampleEdge)
-			tri::SurfaceSampling<CMeshO,vcg::tri::HausdorffSampler<CMeshO> >::EdgeUniform(mm0->cm,hs,par.getInt("SampleNum"),sampleFauxEdge);
+			tri::SurfaceSampling<CMeshO,ParallelHausdorffSampler>::EdgeUniform(mm0->cm,hs,par.getInt("SampleNum"),sampleFauxEdge);
 		if(sampleFace)
-			tri::SurfaceSampling<CMeshO,vcg::tri::HausdorffSampler<CMeshO> >::Montecarlo(mm0->cm,hs,par.getInt("SampleNum"));
+			tri::SurfaceSampling<CMeshO,ParallelHausdorffSampler>::Montecarlo(mm0->cm,hs,par.getInt("SampleNum"));
+		// the closest point queries of the buffered samples are done here, in parallel
+		hs.flush();
 		
 		// the meshes have to return to their original position
 		if (mm0->cm.Tr != Matrix44m::Identity())
@@ -1264,7 +1480,7 @@ std::map<std::string, QVariant> FilterDocSampling::applyFilter(
 		
 		SimpleDistanceSampler ds(&(mm1->cm), useSigned, maxDistABS);
 		
-		tri::SurfaceSampling<CMeshO, SimpleDistanceSampler>::AllVertex(mm0->cm, ds);
+		ds.AddAllVertices(mm0->cm);
 		
 		// the meshes have to return to their original position
 		if (mm0->cm.Tr != Matrix44m::Identity())
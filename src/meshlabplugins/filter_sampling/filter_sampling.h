@@ -66,6 +66,7 @@ public:
 	int postCondition(const QAction* ) const;
 	FilterClass getClass(const QAction*) const;
 	FilterArity filterArity(const QAction* filter) const;
+	bool supportsBackgroundExecution(const QAction*) const { return true; }
 };
 
 #endif
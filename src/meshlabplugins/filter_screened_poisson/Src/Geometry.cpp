@@ -42,14 +42,16 @@ TriangulationTriangle::TriangulationTriangle(void){eIndex[0]=eIndex[1]=eIndex[2]
 ///////////////////////////
 // BufferedReadWriteFile //
 ///////////////////////////
-BufferedReadWriteFile::BufferedReadWriteFile( char* fileName , int bufferSize )
+BufferedReadWriteFile::BufferedReadWriteFile( char* fileName , const char* fileHeader , int bufferSize )
 {
 	_bufferIndex = 0;
 	_bufferSize = bufferSize;
 	if( fileName ) strcpy( _fileName , fileName ) , tempFile = false , _fp = fopen( _fileName , "w+b" );
 	else
 	{
-		strcpy( _fileName , "PR_XXXXXX" );
+		// the temporary file is created in the folder given by fileHeader (if
+		// any), without relying on the current directory of the process
+		snprintf( _fileName , sizeof( _fileName ) , "%sPR_XXXXXX" , fileHeader );
 #ifdef _WIN32
 		_mktemp( _fileName );
 		_fp = fopen( _fileName , "w+b" );
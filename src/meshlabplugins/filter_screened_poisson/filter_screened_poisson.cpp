@@ -26,7 +26,7 @@
 #include <Psapi.h>
 #endif
 
-#include <QDir>
+#include <QFileInfo>
 #include <QTemporaryDir>
 #include <QTemporaryFile>
 
@@ -34,10 +34,27 @@
 
 #include "filter_screened_poisson.h"
 #include "poisson_utils.h"
+#include "poisson_streams.h"
+
+static PoissonParam<Scalarm> poissonParam(const RichParameterList& params)
+{
+	PoissonParam<Scalarm> pp;
+	pp.MaxDepthVal = params.getInt("depth");
+	pp.FullDepthVal = params.getInt("fullDepth");
+	pp.CGDepthVal= params.getInt("cgDepth");
+	pp.ScaleVal = params.getFloat("scale");
+	pp.SamplesPerNodeVal = params.getFloat("samplesPerNode");
+	pp.PointWeightVal = params.getFloat("pointWeight");
+	pp.ItersVal = params.getInt("iters");
+	pp.ConfidenceFlag = params.getBool("confidence");
+	pp.DensityFlag = true;
+	pp.ThreadsVal = params.getInt("threads");
+	return pp;
+}
 
 FilterScreenedPoissonPlugin::FilterScreenedPoissonPlugin()
 {
-	typeList = {FP_SCREENED_POISSON};
+	typeList = {FP_SCREENED_POISSON, FP_SCREENED_POISSON_OUT_OF_CORE};
 
 	for (ActionIDType tt : types()){
 		actionList.push_back(new QAction(filterName(tt), this));
@@ -58,6 +75,9 @@ QString FilterScreenedPoissonPlugin::filterName(ActionIDType filter) const
 	if (filter == FP_SCREENED_POISSON) {
 		return "Surface Reconstruction: Screened Poisson";
 	}
+	else if (filter == FP_SCREENED_POISSON_OUT_OF_CORE) {
+		return "Surface Reconstruction: Screened Poisson (Out of Core)";
+	}
 	else {
 		assert(0);
 		return QString();
@@ -69,6 +89,9 @@ QString FilterScreenedPoissonPlugin::pythonFilterName(ActionIDType f) const
 	if (f == FP_SCREENED_POISSON) {
 		return "generate_surface_reconstruction_screened_poisson";
 	}
+	else if (f == FP_SCREENED_POISSON_OUT_OF_CORE) {
+		return "generate_surface_reconstruction_screened_poisson_out_of_core";
+	}
 	else {
 		assert(0);
 		return QString();
@@ -84,6 +107,14 @@ QString FilterScreenedPoissonPlugin::filterInfo(ActionIDType filter) const
 				"implementing the algorithm described in the following paper:<br>"
 				"<i>Michael Kazhdan, Hugues Hoppe</i>,<br>"
 				"<b>\"Screened Poisson surface reconstruction\"</b><br>";
+	else if (filter == FP_SCREENED_POISSON_OUT_OF_CORE)
+		return	"Screened Poisson surface reconstruction of point clouds too large to be loaded in memory.<br>"
+				"The oriented points are streamed, one block at a time, directly from PLY and E57 files on disk "
+				"and splatted in the octree as they are read, so the memory used depends on the octree and "
+				"not on the number of points. The isosurface is extracted slab by slab in temporary files, created "
+				"next to the output file, and then streamed into a binary PLY file; neither the input nor the "
+				"output are loaded as layers.<br>"
+				"The input points must have normals.";
 	else {
 		return "Error!";
 	}
@@ -91,7 +122,7 @@ QString FilterScreenedPoissonPlugin::filterInfo(ActionIDType filter) const
 
 FilterPlugin::FilterClass FilterScreenedPoissonPlugin::getClass(const QAction* a) const
 {
-	if (ID(a) == FP_SCREENED_POISSON){
+	if (ID(a) == FP_SCREENED_POISSON || ID(a) == FP_SCREENED_POISSON_OUT_OF_CORE){
 		return FilterPlugin::Remeshing;
 	}
 	else {
@@ -102,7 +133,7 @@ FilterPlugin::FilterClass FilterScreenedPoissonPlugin::getClass(const QAction* a
 
 int FilterScreenedPoissonPlugin::getRequirements(const QAction* a)
 {
-	if (ID(a) == FP_SCREENED_POISSON) {
+	if (ID(a) == FP_SCREENED_POISSON || ID(a) == FP_SCREENED_POISSON_OUT_OF_CORE) {
 		return MeshModel::MM_NONE;
 	}
 	else {
@@ -118,12 +149,12 @@ std::map<std::string, QVariant> FilterScreenedPoissonPlugin::applyFilter(
 		unsigned int& /*postConditionMask*/,
 		vcg::CallBackPos* cb)
 {
-	bool currDirChanged=false;
-	QDir currDir = QDir::current();
-
 	if (ID(filter) == FP_SCREENED_POISSON) {
-		//Using tmp dir
+		//Using tmp dir: the temporary files are named with their absolute
+		//path, since the filter can run in background and the current
+		//directory is shared by the whole process
 		QTemporaryDir tmpdir;
+		std::string tmpFileHeader;
 		QTemporaryFile file(tmpdir.path());
 		if (!file.open()) { //if a file cannot be created in the tmp folder
 			log("Warning - tmp folder is not writable.");
@@ -135,22 +166,11 @@ std::map<std::string, QVariant> FilterScreenedPoissonPlugin::applyFilter(
 			}
 		}
 		else { //if the tmp folder is writable, we will use it
-			currDirChanged=true;
-			QDir::setCurrent(tmpdir.path());
+			tmpFileHeader = QString(tmpdir.path() + "/").toStdString();
 		}
 
-		PoissonParam<Scalarm> pp;
-		pp.MaxDepthVal = params.getInt("depth");
-		pp.FullDepthVal = params.getInt("fullDepth");
-		pp.CGDepthVal= params.getInt("cgDepth");
-		pp.ScaleVal = params.getFloat("scale");
-		pp.SamplesPerNodeVal = params.getFloat("samplesPerNode");
-		pp.PointWeightVal = params.getFloat("pointWeight");
-		pp.ItersVal = params.getInt("iters");
-		pp.ConfidenceFlag = params.getBool("confidence");
-		pp.DensityFlag = true;
+		PoissonParam<Scalarm> pp = poissonParam(params);
 		pp.CleanFlag = params.getBool("preClean");
-		pp.ThreadsVal = params.getInt("threads");
 
 		bool goodNormal=true, goodColor=true;
 		if(params.getBool("visibleLayer") == false) {
@@ -193,19 +213,20 @@ std::map<std::string, QVariant> FilterScreenedPoissonPlugin::applyFilter(
 			}
 
 			MeshDocumentPointStream<Scalarm> documentStream(md);
-			_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&documentStream,bb,pm->cm,pp,cb);
+			_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&documentStream,bb,pm->cm,pp,cb,tmpFileHeader.c_str());
 		}
 		else {
 			MeshModelPointStream<Scalarm> meshStream(md.mm()->cm);
 			Box3m bb;
 			bb.Add(md.mm()->cm.Tr, md.mm()->cm.bbox);
-			_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&meshStream,bb,pm->cm,pp,cb);
+			_Execute<Scalarm,2,BOUNDARY_NEUMANN,PlyColorAndValueVertex<Scalarm> >(&meshStream,bb,pm->cm,pp,cb,tmpFileHeader.c_str());
 		}
 		pm->updateBoxAndNormals();
 		md.setVisible(pm->id(),true);
 		md.setCurrentMesh(pm->id());
-		if(currDirChanged)
-			QDir::setCurrent(currDir.path());
+	}
+	else if (ID(filter) == FP_SCREENED_POISSON_OUT_OF_CORE) {
+		reconstructOutOfCore(params, cb);
 	}
 	else {
 		wrongActionCalled(filter);
@@ -213,6 +234,51 @@ std::map<std::string, QVariant> FilterScreenedPoissonPlugin::applyFilter(
 	return std::map<std::string, QVariant>();
 }
 
+void FilterScreenedPoissonPlugin::reconstructOutOfCore(
+		const RichParameterList& params,
+		vcg::CallBackPos* cb)
+{
+	QStringList inputs;
+	if (!params.getOpenFileName("inputFile").isEmpty())
+		inputs << params.getOpenFileName("inputFile");
+	for (const QString& f : params.getString("moreInputFiles").split(';', Qt::SkipEmptyParts))
+		inputs << f.trimmed();
+	if (inputs.isEmpty())
+		throw MLException("No input file given.");
+	QString output = params.getSaveFileName("outputFile");
+	if (output.isEmpty())
+		throw MLException("No output file given.");
+	if (!output.endsWith(".ply", Qt::CaseInsensitive))
+		output += ".ply";
+	output = QFileInfo(output).absoluteFilePath();
+
+	PoissonParam<Scalarm> pp = poissonParam(params);
+	FilePointStream stream(inputs, std::max(params.getInt("blockSize"), 1024));
+	Box3m bb;
+	size_t pointCount = 0;
+	stream.scan(bb, pointCount, cb);
+	if (pointCount == 0)
+		throw MLException("The input files have no points.");
+	log("Streaming %llu points from %i files", (unsigned long long) pointCount, int(inputs.size()));
+
+	// the temporary files of the isosurface are about as large as the
+	// output: keep them next to it rather than in the system tmp folder
+	QTemporaryDir tmpdir(QFileInfo(output).absolutePath() + "/poisson_XXXXXX");
+	if (!tmpdir.isValid())
+		throw MLException("Cannot create a temporary folder next to " + output);
+	const std::string tmpFileHeader = QString(tmpdir.path() + "/").toStdString();
+	typedef PlyColorAndValueVertex<Scalarm> Vertex;
+	CoredFileMeshData<Vertex> mesh(tmpFileHeader.c_str());
+	XForm4x4<Scalarm> iXForm;
+	if (!_Reconstruct<Scalarm,2,BOUNDARY_NEUMANN,Vertex>(&stream,bb,pp,cb,mesh,iXForm))
+		throw MLException("Screened Poisson reconstruction failed.");
+	cb(90, "Writing Mesh");
+	WriteCoredMeshPly(mesh, iXForm, output, stream.hasColor(), cb);
+	log("Saved %i vertices and %i faces in %s",
+		int(mesh.inCorePoints.size()) + mesh.outOfCorePointCount(),
+		mesh.polygonCount(), qUtf8Printable(output));
+}
+
 RichParameterList FilterScreenedPoissonPlugin::initParameterList(
 		const QAction* filter,
 		const MeshModel&)
@@ -222,6 +288,13 @@ RichParameterList FilterScreenedPoissonPlugin::initParameterList(
 	if (nThreads == 0) nThreads = 8;
 	if (ID(filter) == FP_SCREENED_POISSON) {
 		parlist.addParam(RichBool("visibleLayer", false, "Merge all visible layers", "Enabling this flag means that all the visible layers will be used for providing the points."));
+	}
+	else if (ID(filter) == FP_SCREENED_POISSON_OUT_OF_CORE) {
+		parlist.addParam(RichFileOpen("inputFile", "", {"*.ply *.e57", "*.ply", "*.e57"}, "Input File", "PLY or E57 file with the oriented points to be reconstructed."));
+		parlist.addParam(RichString("moreInputFiles", "", "Additional Input Files", "Semicolon separated list of other PLY or E57 files to be merged with the input file."));
+		parlist.addParam(RichFileSave("outputFile", "", "*.ply", "Output File", "Binary PLY file where the reconstructed surface is written."));
+	}
+	if (ID(filter) == FP_SCREENED_POISSON || ID(filter) == FP_SCREENED_POISSON_OUT_OF_CORE) {
 		parlist.addParam(RichInt("depth", 8, "Reconstruction Depth", "This integer is the maximum depth of the tree that will be used for surface reconstruction. Running at depth d corresponds to solving on a voxel grid whose resolution is no larger than 2^d x 2^d x 2^d. Note that since the reconstructor adapts the octree to the sampling density, the specified reconstruction depth is only an upper bound. The default value for this parameter is 8."));
 		parlist.addParam(RichInt("fullDepth", 5, "Adaptive Octree Depth", "This integer specifies the depth beyond depth the octree will be adapted. At coarser depths, the octree will be complete, containing all 2^d x 2^d x 2^d nodes. The default value for this parameter is 5.", true));
 		parlist.addParam(RichInt("cgDepth", 0, "Conjugate Gradients Depth", "This integer is the depth up to which a conjugate-gradients solver will be used to solve the linear system. Beyond this depth Gauss-Seidel relaxation will be used. The default value for this parameter is 0.", true));
@@ -230,8 +303,11 @@ RichParameterList FilterScreenedPoissonPlugin::initParameterList(
 		parlist.addParam(RichFloat("pointWeight", 4, "Interpolation Weight", "This floating point value specifies the importants that interpolation of the point samples is given in the formulation of the screened Poisson equation. The results of the original (unscreened) Poisson Reconstruction can be obtained by setting this value to 0. The default value for this parameter is 4."));
 		parlist.addParam(RichInt("iters", 8, "Gauss-Seidel Relaxations", "This integer value specifies the number of Gauss-Seidel relaxations to be performed at each level of the hierarchy. The default value for this parameter is 8.", true));
 		parlist.addParam(RichBool("confidence", false, "Confidence Flag", "Enabling this flag tells the reconstructor to use the quality as confidence information; this is done by scaling the unit normals with the quality values. When the flag is not enabled, all normals are normalized to have unit-length prior to reconstruction."));
-		parlist.addParam(RichBool("preClean", false, "Pre-Clean", "Enabling this flag force a cleaning pre-pass on the data removing all unreferenced vertices or vertices with null normals."));
+		if (ID(filter) == FP_SCREENED_POISSON)
+			parlist.addParam(RichBool("preClean", false, "Pre-Clean", "Enabling this flag force a cleaning pre-pass on the data removing all unreferenced vertices or vertices with null normals."));
 		parlist.addParam(RichInt("threads", nThreads, "Number Threads", "Maximum number of threads that the reconstruction algorithm can use."));
+		if (ID(filter) == FP_SCREENED_POISSON_OUT_OF_CORE)
+			parlist.addParam(RichInt("blockSize", int(FilePointStream::DEFAULT_BLOCK_SIZE), "Points per Block", "Number of points read from the files at a time.", true));
 	}
 	return parlist;
 }
@@ -241,14 +317,19 @@ int FilterScreenedPoissonPlugin::postCondition(const QAction* filter) const
 	if (ID(filter) == FP_SCREENED_POISSON){
 		return MeshModel::MM_VERTNUMBER + MeshModel::MM_FACENUMBER;
 	}
+	else if (ID(filter) == FP_SCREENED_POISSON_OUT_OF_CORE){
+		return MeshModel::MM_NONE;
+	}
 	else {
 		return MeshModel::MM_ALL;
 	}
 }
 
 
-FilterPlugin::FilterArity FilterScreenedPoissonPlugin::filterArity(const QAction*) const
+FilterPlugin::FilterArity FilterScreenedPoissonPlugin::filterArity(const QAction* a) const
 {
+	if (ID(a) == FP_SCREENED_POISSON_OUT_OF_CORE)
+		return NONE;
 	return VARIABLE;
 }
 
@@ -34,7 +34,8 @@ class FilterScreenedPoissonPlugin : public QObject, public FilterPlugin
 public:
 
 	enum {
-		FP_SCREENED_POISSON
+		FP_SCREENED_POISSON,
+		FP_SCREENED_POISSON_OUT_OF_CORE
 	};
 
 	FilterScreenedPoissonPlugin();
@@ -58,7 +59,10 @@ public:
 	RichParameterList initParameterList(const QAction* a, const MeshModel&);
 	int postCondition(const QAction* filter) const;
 	FilterArity filterArity(const QAction*) const;
+	bool supportsBackgroundExecution(const QAction*) const { return true; }
 
+private:
+	void reconstructOutOfCore(const RichParameterList& params, vcg::CallBackPos* cb);
 };
 
 
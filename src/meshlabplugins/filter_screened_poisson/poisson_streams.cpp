@@ -0,0 +1,626 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "poisson_streams.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <common/mlexception.h>
+
+#ifdef MESHLAB_POISSON_E57
+#include <E57SimpleReader.h>
+#endif
+
+namespace {
+
+enum PlyScalar { P_NONE, P_INT8, P_UINT8, P_INT16, P_UINT16, P_INT32, P_UINT32, P_FLOAT32, P_FLOAT64 };
+
+// the vertex properties used by the reconstruction
+enum PlyField { F_X, F_Y, F_Z, F_NX, F_NY, F_NZ, F_RED, F_GREEN, F_BLUE, F_COUNT };
+
+PlyScalar scalarType(const QByteArray& name)
+{
+	if (name == "char" || name == "int8") return P_INT8;
+	if (name == "uchar" || name == "uint8") return P_UINT8;
+	if (name == "short" || name == "int16") return P_INT16;
+	if (name == "ushort" || name == "uint16") return P_UINT16;
+	if (name == "int" || name == "int32") return P_INT32;
+	if (name == "uint" || name == "uint32") return P_UINT32;
+	if (name == "float" || name == "float32") return P_FLOAT32;
+	if (name == "double" || name == "float64") return P_FLOAT64;
+	return P_NONE;
+}
+
+size_t scalarSize(PlyScalar t)
+{
+	switch (t) {
+	case P_INT8:
+	case P_UINT8: return 1;
+	case P_INT16:
+	case P_UINT16: return 2;
+	case P_INT32:
+	case P_UINT32:
+	case P_FLOAT32: return 4;
+	case P_FLOAT64: return 8;
+	default: return 0;
+	}
+}
+
+template <typename T>
+T load(const char* p)
+{
+	T v;
+	std::memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+double readScalar(const char* p, PlyScalar t, bool swap)
+{
+	char b[8];
+	if (swap) {
+		std::reverse_copy(p, p + scalarSize(t), b);
+		p = b;
+	}
+	switch (t) {
+	case P_INT8: return load<qint8>(p);
+	case P_UINT8: return load<quint8>(p);
+	case P_INT16: return load<qint16>(p);
+	case P_UINT16: return load<quint16>(p);
+	case P_INT32: return load<qint32>(p);
+	case P_UINT32: return load<quint32>(p);
+	case P_FLOAT32: return load<float>(p);
+	case P_FLOAT64: return load<double>(p);
+	default: return 0;
+	}
+}
+
+int vertexField(const QByteArray& name)
+{
+	if (name == "x") return F_X;
+	if (name == "y") return F_Y;
+	if (name == "z") return F_Z;
+	if (name == "nx") return F_NX;
+	if (name == "ny") return F_NY;
+	if (name == "nz") return F_NZ;
+	if (name == "red" || name == "diffuse_red") return F_RED;
+	if (name == "green" || name == "diffuse_green") return F_GREEN;
+	if (name == "blue" || name == "diffuse_blue") return F_BLUE;
+	return -1;
+}
+
+/*
+Reads the vertices of a PLY file (ascii or binary) as oriented points. The
+elements before the vertices are skipped; in binary files they must not have
+list properties, as their size would be unknown.
+*/
+class PlySampleReader : public SampleFileReader
+{
+public:
+	PlySampleReader(const QString& fileName, size_t blockSize) :
+			file(fileName), blockSize(blockSize)
+	{
+		if (!file.open(QIODevice::ReadOnly))
+			throw MLException("Cannot open " + fileName);
+		fail = "Unsupported PLY file " + fileName + ": ";
+
+		struct Element
+		{
+			QByteArray name;
+			long long  count      = 0;
+			size_t     recordSize = 0;
+			bool       hasList    = false;
+		};
+		std::vector<Element> elements;
+		bool                 formatFound = false;
+		for (bool first = true;; first = false) {
+			if (file.atEnd())
+				throw MLException(fail + "missing end_header");
+			QByteArray        line   = file.readLine().trimmed();
+			QList<QByteArray> tokens = line.simplified().split(' ');
+			if (first) {
+				if (line != "ply")
+					throw MLException(fileName + " is not a PLY file");
+			}
+			else if (tokens[0] == "format" && tokens.size() >= 2) {
+				ascii       = tokens[1] == "ascii";
+				swap        = (tokens[1] == "binary_big_endian") == (Q_BYTE_ORDER == Q_LITTLE_ENDIAN);
+				formatFound = ascii || tokens[1].startsWith("binary_");
+			}
+			else if (tokens[0] == "element" && tokens.size() >= 3) {
+				elements.emplace_back();
+				elements.back().name  = tokens[1];
+				elements.back().count = tokens[2].toLongLong();
+			}
+			else if (tokens[0] == "property" && !elements.empty()) {
+				Element& e = elements.back();
+				if (tokens.size() >= 5 && tokens[1] == "list") {
+					e.hasList = true;
+				}
+				else if (tokens.size() >= 3) {
+					PlyScalar t = scalarType(tokens[1]);
+					if (t == P_NONE)
+						throw MLException(fail + "unknown type " + QString(tokens[1]));
+					if (e.name == "vertex") {
+						Property p;
+						p.type   = t;
+						p.offset = e.recordSize;
+						p.field  = vertexField(tokens[2]);
+						props.push_back(p);
+					}
+					e.recordSize += scalarSize(t);
+				}
+			}
+			else if (tokens[0] == "end_header") {
+				break;
+			}
+		}
+		if (!formatFound)
+			throw MLException(fail + "unknown format");
+
+		// the elements before the vertices are skipped
+		bool found = false;
+		for (const Element& e : elements) {
+			if (e.name == "vertex") {
+				if (e.hasList)
+					throw MLException(fail + "list properties in the vertex element");
+				vertexCount = e.count;
+				recordSize  = e.recordSize;
+				found       = true;
+				break;
+			}
+			if (ascii) {
+				for (long long i = 0; i < e.count; ++i)
+					file.readLine();
+			}
+			else {
+				if (e.hasList)
+					throw MLException(fail + "list properties before the vertex element");
+				file.seek(file.pos() + e.count * qint64(e.recordSize));
+			}
+		}
+		if (!found)
+			throw MLException(fail + "no vertex element");
+
+		bool has[F_COUNT] = {};
+		for (const Property& p : props)
+			if (p.field >= 0)
+				has[p.field] = true;
+		if (!(has[F_X] && has[F_Y] && has[F_Z]))
+			throw MLException(fail + "missing vertex coordinates");
+		if (!(has[F_NX] && has[F_NY] && has[F_NZ]))
+			throw MLException(fileName + " has no per vertex normals");
+		color = has[F_RED] && has[F_GREEN] && has[F_BLUE];
+		vertexStart = file.pos();
+	}
+
+	void rewind()
+	{
+		file.seek(vertexStart);
+		read = 0;
+	}
+
+	bool readBlock(std::vector<FileSample>& block)
+	{
+		const long long n = std::min<long long>(blockSize, vertexCount - read);
+		block.clear();
+		if (n <= 0)
+			return false;
+		block.resize(n);
+		if (ascii) {
+			for (long long i = 0; i < n; ++i) {
+				QByteArray line = file.readLine();
+				if (line.isEmpty())
+					throw MLException("Unexpected end of file " + file.fileName());
+				double      v[F_COUNT] = {};
+				const char* s          = line.constData();
+				for (const Property& p : props) {
+					char* e = nullptr;
+					double x = std::strtod(s, &e);
+					s = e;
+					if (p.field >= 0)
+						v[p.field] = x;
+				}
+				decode(v, props, block[i]);
+			}
+		}
+		else {
+			QByteArray data = file.read(n * qint64(recordSize));
+			if (data.size() != n * qint64(recordSize))
+				throw MLException("Unexpected end of file " + file.fileName());
+			const char* base = data.constData();
+#pragma omp parallel for schedule(static)
+			for (long long i = 0; i < n; ++i) {
+				double      v[F_COUNT] = {};
+				const char* rec        = base + i * recordSize;
+				for (const Property& p : props)
+					if (p.field >= 0)
+						v[p.field] = readScalar(rec + p.offset, p.type, swap);
+				decode(v, props, block[i]);
+			}
+		}
+		read += n;
+		return true;
+	}
+
+	bool hasColor() const { return color; }
+
+private:
+	struct Property
+	{
+		PlyScalar type   = P_NONE;
+		size_t    offset = 0;
+		int       field  = -1;
+	};
+
+	/// colors stored as floating point values are in the 0..1 range
+	static void decode(const double* v, const std::vector<Property>& props, FileSample& s)
+	{
+		for (int i = 0; i < 3; ++i) {
+			s.point.p[i] = Scalarm(v[F_X + i]);
+			s.point.n[i] = Scalarm(v[F_NX + i]);
+		}
+		for (const Property& p : props)
+			if (p.field >= F_RED && p.field <= F_BLUE)
+				s.color[p.field - F_RED] = Scalarm(
+					(p.type == P_FLOAT32 || p.type == P_FLOAT64) ? v[p.field] * 255 : v[p.field]);
+	}
+
+	QFile                 file;
+	size_t                blockSize;
+	QString               fail;
+	bool                  ascii = false, swap = false, color = false;
+	std::vector<Property> props;
+	long long             vertexCount = 0, read = 0;
+	size_t                recordSize  = 0;
+	qint64                vertexStart = 0;
+};
+
+#ifdef MESHLAB_POISSON_E57
+/*
+Reads all the scans of an E57 file, in their pose, one block at a time. Only
+scans with cartesian coordinates and normals are supported.
+*/
+class E57SampleReader : public SampleFileReader
+{
+public:
+	E57SampleReader(const QString& fileName, size_t blockSize) :
+			reader(QFile::encodeName(fileName).toStdString()), blockSize(blockSize)
+	{
+		if (!reader.IsOpen())
+			throw MLException("Cannot open " + fileName);
+		scanCount = reader.GetData3DCount();
+		color     = scanCount > 0;
+		for (int64_t i = 0; i < scanCount; ++i) {
+			e57::Data3D header;
+			if (!reader.ReadData3D(i, header))
+				throw MLException("Error while reading the scans of " + fileName);
+			const e57::PointStandardizedFieldsAvailable& f = header.pointFields;
+			if (!(f.cartesianXField && f.cartesianYField && f.cartesianZField))
+				throw MLException(fileName + ": only scans with cartesian coordinates are supported");
+			if (!(f.normalX && f.normalY && f.normalZ))
+				throw MLException(fileName + " has no per point normals");
+			color &= f.colorRedField && f.colorGreenField && f.colorBlueField;
+		}
+		x.resize(blockSize);
+		y.resize(blockSize);
+		z.resize(blockSize);
+		invalid.resize(blockSize);
+		nx.resize(blockSize);
+		ny.resize(blockSize);
+		nz.resize(blockSize);
+		red.resize(blockSize);
+		green.resize(blockSize);
+		blue.resize(blockSize);
+	}
+
+	~E57SampleReader()
+	{
+		closeScan();
+		reader.Close();
+	}
+
+	void rewind()
+	{
+		closeScan();
+		curScan = -1;
+	}
+
+	bool readBlock(std::vector<FileSample>& block)
+	{
+		block.clear();
+		try {
+			size_t n = 0;
+			while (n == 0) {
+				if (!data) {
+					if (curScan + 1 >= scanCount)
+						return false;
+					openScan(++curScan);
+				}
+				n = data->read();
+				if (n == 0)
+					closeScan();
+			}
+			for (size_t i = 0; i < n; ++i) {
+				if (hasInvalid && invalid[i] != 0)
+					continue;
+				FileSample s;
+				Point3m    p = tr * Point3m(x[i], y[i], z[i]);
+				Point3m    nn = rot * Point3m(nx[i], ny[i], nz[i]);
+				for (int j = 0; j < 3; ++j) {
+					s.point.p[j] = p[j];
+					s.point.n[j] = nn[j];
+				}
+				if (color)
+					s.color = Point3D<Scalarm>(red[i], green[i], blue[i]);
+				block.push_back(s);
+			}
+		}
+		catch (const e57::E57Exception& e) {
+			throw MLException(
+				QString("E57 Exception: %1.\nError Code: %2")
+					.arg(QString::fromStdString(e.context()))
+					.arg(e.errorCode()));
+		}
+		return true;
+	}
+
+	bool hasColor() const { return color; }
+
+private:
+	void openScan(int64_t i)
+	{
+		e57::Data3D header;
+		reader.ReadData3D(i, header);
+		e57::Data3DPointsData_t<Scalarm> buffers;
+		buffers.cartesianX = x.data();
+		buffers.cartesianY = y.data();
+		buffers.cartesianZ = z.data();
+		hasInvalid         = header.pointFields.cartesianInvalidStateField;
+		if (hasInvalid)
+			buffers.cartesianInvalidState = invalid.data();
+		buffers.normalX = nx.data();
+		buffers.normalY = ny.data();
+		buffers.normalZ = nz.data();
+		if (color) {
+			buffers.colorRed   = red.data();
+			buffers.colorGreen = green.data();
+			buffers.colorBlue  = blue.data();
+		}
+		data.reset(new e57::CompressedVectorReader(
+			reader.SetUpData3DPointsData(i, blockSize, buffers)));
+
+		// same pose used by the E57 importer
+		vcg::Quaternion<Scalarm> q(
+			header.pose.rotation.w,
+			header.pose.rotation.x,
+			header.pose.rotation.y,
+			header.pose.rotation.z);
+		q.ToMatrix(rot);
+		tr = rot;
+		tr.ElementAt(0, 3) = header.pose.translation.x;
+		tr.ElementAt(1, 3) = header.pose.translation.y;
+		tr.ElementAt(2, 3) = header.pose.translation.z;
+	}
+
+	void closeScan()
+	{
+		if (data)
+			data->close();
+		data.reset();
+	}
+
+	e57::Reader                                 reader;
+	size_t                                      blockSize;
+	int64_t                                     scanCount = 0, curScan = -1;
+	bool                                        color = false, hasInvalid = false;
+	std::unique_ptr<e57::CompressedVectorReader> data;
+	Matrix44m                                   tr, rot;
+
+	std::vector<Scalarm> x, y, z;
+	std::vector<int8_t>  invalid;
+	std::vector<float>   nx, ny, nz;
+	std::vector<uint8_t> red, green, blue;
+};
+#endif
+
+template <typename T>
+void put(QByteArray& buf, T v)
+{
+	v = qToLittleEndian(v);
+	buf.append((const char*) &v, sizeof(T));
+}
+
+void put(QByteArray& buf, float v)
+{
+	quint32 b;
+	std::memcpy(&b, &v, sizeof(b));
+	put(buf, b);
+}
+
+void put(QByteArray& buf, double v)
+{
+	quint64 b;
+	std::memcpy(&b, &v, sizeof(b));
+	put(buf, b);
+}
+
+void flush(QFile& file, QByteArray& buf)
+{
+	if (file.write(buf) != buf.size())
+		throw MLException("Error while writing " + file.fileName());
+	buf.clear();
+}
+
+} // namespace
+
+FilePointStream::FilePointStream(const QStringList& fileNames, size_t blockSize) :
+		blockSize(blockSize)
+{
+	for (const QString& fileName : fileNames) {
+		const QString ext = QFileInfo(fileName).suffix().toLower();
+		if (ext == "ply") {
+			readers.emplace_back(new PlySampleReader(fileName, blockSize));
+		}
+		else if (ext == "e57") {
+#ifdef MESHLAB_POISSON_E57
+			readers.emplace_back(new E57SampleReader(fileName, blockSize));
+#else
+			throw MLException("MeshLab has been built without E57 support: cannot read " + fileName);
+#endif
+		}
+		else {
+			throw MLException("Unsupported point file " + fileName + ": only PLY and E57 files can be streamed");
+		}
+	}
+	reset();
+}
+
+FilePointStream::~FilePointStream()
+{
+}
+
+void FilePointStream::reset()
+{
+	for (auto& r : readers)
+		r->rewind();
+	curReader = 0;
+	block.clear();
+	curSample = 0;
+}
+
+bool FilePointStream::nextBlock()
+{
+	curSample = 0;
+	while (curReader < readers.size()) {
+		if (!readers[curReader]->readBlock(block))
+			++curReader;
+		else if (!block.empty())
+			return true;
+	}
+	return false;
+}
+
+bool FilePointStream::nextPoint(OrientedPoint3D<Scalarm>& p, Point3D<Scalarm>& d)
+{
+	if (curSample >= block.size() && !nextBlock())
+		return false;
+	p = block[curSample].point;
+	d = block[curSample].color;
+	++curSample;
+	return true;
+}
+
+void FilePointStream::scan(Box3m& bb, size_t& pointCount, vcg::CallBackPos* cb)
+{
+	bb.SetNull();
+	pointCount = 0;
+	reset();
+	while (nextBlock()) {
+		for (const FileSample& s : block)
+			bb.Add(Point3m(s.point.p[0], s.point.p[1], s.point.p[2]));
+		pointCount += block.size();
+		cb(int(100 * curReader / readers.size()), "Scanning input files");
+	}
+	reset();
+}
+
+bool FilePointStream::hasColor() const
+{
+	for (const auto& r : readers)
+		if (!r->hasColor())
+			return false;
+	return !readers.empty();
+}
+
+void WriteCoredMeshPly(
+	CoredFileMeshData<PlyColorAndValueVertex<Scalarm>>& mesh,
+	const XForm4x4<Scalarm>&                            iXForm,
+	const QString&                                      fileName,
+	bool                                                color,
+	vcg::CallBackPos*                                   cb)
+{
+	typedef PlyColorAndValueVertex<Scalarm> Vertex;
+	const int  BLOCK        = 1 << 16;
+	const long long inCore  = (long long) mesh.inCorePoints.size();
+	const long long vn      = inCore + mesh.outOfCorePointCount();
+	const long long fn      = mesh.polygonCount();
+	const char* scalar      = sizeof(Scalarm) == sizeof(double) ? "double" : "float";
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		throw MLException("Cannot open " + fileName + " for writing");
+
+	QByteArray buf;
+	buf += "ply\nformat binary_little_endian 1.0\ncomment Screened Poisson reconstruction\n";
+	buf += "element vertex " + QByteArray::number(vn) + "\n";
+	for (const char* c : {"x", "y", "z"})
+		buf += QByteArray("property ") + scalar + " " + c + "\n";
+	if (color)
+		buf += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+	buf += QByteArray("property ") + scalar + " quality\n";
+	buf += "element face " + QByteArray::number(fn) + "\n";
+	buf += "property list uchar int vertex_indices\nend_header\n";
+
+	mesh.resetIterator();
+	auto putVertex = [&](const Vertex& v) {
+		Point3D<Scalarm> p = iXForm * v.point;
+		for (int i = 0; i < 3; ++i)
+			put(buf, p[i]);
+		if (color)
+			buf.append((const char*) v.color, 3);
+		put(buf, v.value);
+	};
+	long long written = 0;
+	for (const Vertex& v : mesh.inCorePoints) {
+		putVertex(v);
+		if (++written % BLOCK == 0)
+			flush(file, buf);
+	}
+	for (long long i = 0; i < vn - inCore; ++i) {
+		Vertex v;
+		mesh.nextOutOfCorePoint(v);
+		putVertex(v);
+		if (++written % BLOCK == 0) {
+			flush(file, buf);
+			cb(90 + int(5 * written / vn), "Writing vertices");
+		}
+	}
+
+	std::vector<CoredVertexIndex> polygon;
+	for (long long f = 0; mesh.nextPolygon(polygon); ++f) {
+		buf.append(char(polygon.size()));
+		for (const CoredVertexIndex& i : polygon)
+			put(buf, qint32(i.inCore ? i.idx : i.idx + inCore));
+		if ((f + 1) % BLOCK == 0) {
+			flush(file, buf);
+			cb(95 + int(5 * f / std::max(fn, 1ll)), "Writing faces");
+		}
+	}
+	flush(file, buf);
+}
@@ -0,0 +1,120 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+#ifndef POISSON_STREAMS_H
+#define POISSON_STREAMS_H
+
+#include <memory>
+#include <vector>
+
+#include <QStringList>
+
+#include "Src/Geometry.h"
+#include "Src/PointStream.h"
+
+#include <common/ml_document/cmesh.h>
+
+/*
+Out of core input and output of the screened poisson reconstruction.
+
+The reconstructor reads its samples from a point stream and splats them in the
+octree as they arrive, so its memory depends on the number of octree nodes and
+not on the number of input points. FilePointStream feeds it directly from the
+files on disk, one block of points at a time, without ever loading the input
+in a mesh.
+
+The isosurface is extracted slab by slab in the temporary files of a
+CoredFileMeshData; WriteCoredMeshPly streams them into a binary PLY file,
+again one block at a time, without building the output mesh in memory.
+*/
+
+/// an oriented point, with its color (0..255 range), as read from a file
+struct FileSample
+{
+	OrientedPoint3D<Scalarm> point;
+	Point3D<Scalarm>         color;
+};
+
+/// reads the samples of a file, one block at a time
+class SampleFileReader
+{
+public:
+	virtual ~SampleFileReader() {}
+
+	/// restarts from the first sample
+	virtual void rewind() = 0;
+
+	/// reads the next block of samples; returns false at the end of the file
+	virtual bool readBlock(std::vector<FileSample>& block) = 0;
+
+	/// true if the file has per point colors
+	virtual bool hasColor() const = 0;
+};
+
+/**
+ * @brief Oriented point stream reading the vertices of PLY files and the
+ * scans of E57 files (when MeshLab is built with E57 support). The points
+ * must have normals. Throws an MLException if a file cannot be read.
+ */
+class FilePointStream : public OrientedPointStreamWithData<Scalarm, Point3D<Scalarm>>
+{
+public:
+	static const size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+
+	FilePointStream(const QStringList& fileNames, size_t blockSize = DEFAULT_BLOCK_SIZE);
+	~FilePointStream();
+
+	void reset();
+	bool nextPoint(OrientedPoint3D<Scalarm>& p, Point3D<Scalarm>& d);
+
+	/**
+	 * @brief Reads all the files once, computing the bounding box and the
+	 * number of points; then rewinds the stream.
+	 */
+	void scan(Box3m& bb, size_t& pointCount, vcg::CallBackPos* cb);
+
+	/// true if all the files have per point colors
+	bool hasColor() const;
+
+private:
+	bool nextBlock();
+
+	std::vector<std::unique_ptr<SampleFileReader>> readers;
+	size_t                                          blockSize;
+	size_t                                          curReader = 0;
+	std::vector<FileSample>                         block;
+	size_t                                          curSample = 0;
+};
+
+/**
+ * @brief Writes the isosurface extracted by the reconstructor in a binary PLY
+ * file, transforming the vertices with iXForm. Vertex colors are written only
+ * if color is true. Throws an MLException if the file cannot be written.
+ */
+void WriteCoredMeshPly(
+	CoredFileMeshData<PlyColorAndValueVertex<Scalarm>>& mesh,
+	const XForm4x4<Scalarm>&                            iXForm,
+	const QString&                                      fileName,
+	bool                                                color,
+	vcg::CallBackPos*                                   cb);
+
+#endif // POISSON_STREAMS_H
@@ -301,12 +301,16 @@ XForm4x4<Real> GetPointStreamScale(vcg::Box3<Real> &bb, float expFact)
 	return sXForm * tXForm;
 }
 
+// Runs the reconstruction, leaving the isosurface in mesh (mostly in its
+// temporary files) in the unit cube coordinates; iXForm maps it back.
 template< class Real , int Degree , BoundaryType BType , class Vertex >
-int _Execute(
+int _Reconstruct(
 		OrientedPointStream< Real > *pointStream,
-		Box3m bb, CMeshO &pm,
+		Box3m bb,
 		PoissonParam<Real> &pp,
-		vcg::CallBackPos* cb)
+		vcg::CallBackPos* cb,
+		CoredFileMeshData< Vertex > &mesh,
+		XForm4x4< Real > &iXForm)
 {
 	typedef typename Octree< Real >::template DensityEstimator< WEIGHT_DEGREE > DensityEstimator;
 	typedef typename Octree< Real >::template InterpolationInfo< false > InterpolationInfo;
@@ -316,7 +320,7 @@ int _Execute(
 	std::vector< char* > comments;
 
 	XForm4x4< Real > xForm = GetPointStreamScale(bb,pp.ScaleVal);
-	XForm4x4< Real > iXForm = xForm.inverse();
+	iXForm = xForm.inverse();
 	DumpOutput2( comments , "Running Screened Poisson Reconstruction (Version 9.0)\n" );
 	double startTime = Time();
 
@@ -451,8 +455,6 @@ int _Execute(
 		}
 	}
 
-	CoredFileMeshData< Vertex > mesh;
-
 	{
 		profiler.start();
 		double valueSum = 0 , weightSum = 0;
@@ -487,6 +489,25 @@ int _Execute(
 
 	//        FreePointer( solution );
 
+	delete samples;
+	if( density ) delete density , density = NULL;
+	DumpOutput2( comments , "#          Total Solve: %9.1f (s), %9.1f (MB)\n" , Time()-startTime , tree.maxMemoryUsage() );
+	return 1;
+}
+
+template< class Real , int Degree , BoundaryType BType , class Vertex >
+int _Execute(
+		OrientedPointStream< Real > *pointStream,
+		Box3m bb, CMeshO &pm,
+		PoissonParam<Real> &pp,
+		vcg::CallBackPos* cb,
+		const char* tmpFileHeader)
+{
+	CoredFileMeshData< Vertex > mesh( tmpFileHeader );
+	XForm4x4< Real > iXForm;
+	if( !_Reconstruct< Real , Degree , BType , Vertex >( pointStream , bb , pp , cb , mesh , iXForm ) )
+		return false;
+
 	cb(90,"Creating Mesh");
 	mesh.resetIterator();
 	//int vm = mesh.outOfCorePointCount()+mesh.inCorePoints.size();
@@ -525,10 +546,6 @@ int _Execute(
 
 	//if( colorData ) delete colorData , colorData = NULL;
 
-
-	if( density ) delete density , density = NULL;
-	DumpOutput2( comments , "#          Total Solve: %9.1f (s), %9.1f (MB)\n" , Time()-startTime , tree.maxMemoryUsage() );
-
 	return 1;
 }
 
@@ -29,6 +29,7 @@
 #include "filter_texture.h"
 #include "pushpull.h"
 #include "rastering.h"
+#include "texture_baker.h"
 #include <vcg/complex/algorithms/update/texture.h>
 #include<wrap/io_trimesh/export_ply.h>
 #include <vcg/complex/algorithms/parametrization/voronoi_atlas.h>
@@ -113,7 +114,8 @@ QString FilterTexturePlugin::filterInfo(ActionIDType filterId) const
 	case FP_PLANAR_MAPPING : return QString("Builds a trivial flat-plane parametrization.");
 	case FP_SET_TEXTURE : return QString("Set a texture associated with current mesh parametrization.<br>" "If the texture provided exists, then it will be simply associated to the current mesh; else the filter will fail with no further actions.");
 	case FP_COLOR_TO_TEXTURE : return QString("Fills the specified texture using per-vertex color data of the mesh.");
-	case FP_TRANSFER_TO_TEXTURE : return QString("Transfer texture color, vertex color or normal from one mesh the texture of another mesh. This may be useful to restore detail lost in simplification, or resample a texture in a different parametrization.");
+	case FP_TRANSFER_TO_TEXTURE : return QString("Transfer texture color, vertex color or normal from one mesh the texture of another mesh. This may be useful to restore detail lost in simplification, or resample a texture in a different parametrization.<br>"
+										  "It can also bake a normal map, with the normals of the source in the tangent space of the target, or a displacement map, with the signed distance of the source along the normals of the target (mid gray is no displacement, black and white are the negative and positive Max Dist Search).");
 	case FP_TEX_TO_VCOLOR_TRANSFER : return QString("Generates Vertex Color values picking color from a texture (same mesh or another mesh).");
 	default : assert(0);
 	}
@@ -259,8 +261,8 @@ RichParameterList FilterTexturePlugin::initParameterList(const QAction *action,
 								  "The mesh that contains the source data that we want to transfer"));
 		parlst.addParam(RichMesh ("targetMesh",trg->id(),&md, "Target Mesh",
 								  "The mesh whose texture will be filled according to source mesh data"));
-		parlst.addParam(RichEnum("AttributeEnum", 0, QStringList("Vertex Color")  << "Vertex Normal" << "Vertex Quality"<< "Texture Color", "Color Data Source",
-								 "Choose what attribute has to be transferred onto the target texture. You can choose between Per vertex attributes (color,normal,quality) or to transfer color information from source mesh texture"));
+		parlst.addParam(RichEnum("AttributeEnum", 0, QStringList("Vertex Color")  << "Vertex Normal" << "Vertex Quality"<< "Texture Color" << "Normal Map (tangent space)" << "Displacement Map", "Color Data Source",
+								 "Choose what attribute has to be transferred onto the target texture. You can choose between Per vertex attributes (color,normal,quality), to transfer color information from source mesh texture, or to bake a normal or displacement map of the source surface"));
 		parlst.addParam(RichPercentage("upperBound", md.mm()->cm.bbox.Diag()/50.0, 0.0f, md.mm()->cm.bbox.Diag(),
 									tr("Max Dist Search"), tr("Sample points for which we do not find anything within this distance are rejected and not considered for recovering data")));
 		parlst.addParam(RichString("textName", trgFileName, "Texture file", "The texture file to be created"));
@@ -765,9 +767,8 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 		tri::UpdateFlags<CMeshO>::FaceBorderFromFF(m.cm);
 
 		// Rasterizing triangles
-		RasterSampler rs(trgImgs);
-		rs.InitCallback(cb, m.cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO,RasterSampler>::Texture(m.cm,rs,textW,textH,true);
+		TextureBaker baker(m.cm, trgImgs);
+		baker.bakeVertexColor(cb, 0, 80);
 
 		// Undo topology changes
 		tri::UpdateTopology<CMeshO>::FaceFace(m.cm);
@@ -777,13 +778,7 @@ std::map<std::string, QVariant> FilterTexturePlugin::applyFilter(
 		{
 			// Revert alpha values for border edge pixels to 255
 			cb(81, "Cleaning up texture ...");
-			for (int y = 0; y<textH; ++y)
-				for (int x = 0; x<textW; ++x)
-				{
-					QRgb px = trgImgs[texInd].pixel(x, y);
-					if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-						trgImgs[texInd].setPixel(x, y, px | 0xff000000);
-				}
+			TextureBaker::closeBorderTexels(trgImgs[texInd], pp);
 
 			// PullPush
 			if (pp)
@@ -900,17 +895,18 @@ void FilterTexturePlugin::transferToTexture(
 {
 	MeshModel *srcMesh = md.getMesh(par.getMeshId("sourceMesh"));
 	MeshModel *trgMesh = md.getMesh(par.getMeshId("targetMesh"));
-	bool vertexSampling=false;
-	bool textureSampling=false;
-	int  vertexMode= -1;
+	TextureBaker::Attribute attribute = TextureBaker::VERTEX_COLOR;
 	switch (par.getEnum("AttributeEnum"))
 	{
-		case 0: vertexSampling= true; vertexMode=0; break;  // Color
-		case 1: vertexSampling= true; vertexMode=1; break;  // Normal
-		case 2: vertexSampling= true; vertexMode=2; break;  // Quality
-		case 3: textureSampling = true; break;
+		case 0: attribute = TextureBaker::VERTEX_COLOR; break;
+		case 1: attribute = TextureBaker::VERTEX_NORMAL; break;
+		case 2: attribute = TextureBaker::VERTEX_QUALITY; break;
+		case 3: attribute = TextureBaker::TEXTURE_COLOR; break;
+		case 4: attribute = TextureBaker::NORMAL_MAP; break;
+		case 5: attribute = TextureBaker::DISPLACEMENT_MAP; break;
 		default: assert(0);
 	}
+	const bool textureSampling = attribute == TextureBaker::TEXTURE_COLOR;
 	Scalarm upperbound = par.getAbsPerc("upperBound"); // maximum distance to stop search
 	QString textName = par.getString("textName");
 	int textW = par.getInt("textW");
@@ -925,16 +921,17 @@ void FilterTexturePlugin::transferToTexture(
 	CheckError(textW <= 0, "Texture Width has an incorrect value");
 	CheckError(textH <= 0, "Texture Height has an incorrect value");
 
-	if (vertexSampling) {
-		if (vertexMode == 0) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTCOLOR), "Source mesh doesn't have Per-Vertex Color"); }
-		if (vertexMode == 1) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTNORMAL), "Source mesh doesn't have Per-Vertex Normal"); }
-		if (vertexMode == 2) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTQUALITY), "Source mesh doesn't have Per-Vertex Quality"); }
-	}
-	else {
+	if (attribute == TextureBaker::VERTEX_COLOR) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTCOLOR), "Source mesh doesn't have Per-Vertex Color"); }
+	if (attribute == TextureBaker::VERTEX_NORMAL) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTNORMAL), "Source mesh doesn't have Per-Vertex Normal"); }
+	if (attribute == TextureBaker::VERTEX_QUALITY) { CheckError(!srcMesh->hasDataMask(MeshModel::MM_VERTQUALITY), "Source mesh doesn't have Per-Vertex Quality"); }
+	if (textureSampling) {
 		CheckError(srcMesh->cm.fn == 0, "Source mesh needs to have faces");
 		CheckError(!srcMesh->hasDataMask(MeshModel::MM_WEDGTEXCOORD), "Source mesh does not have Per-Wedge Texture Coordinates");
 		CheckError(srcMesh->cm.textures.empty(), "Source mesh does not have any associated texture");
 	}
+	if (attribute == TextureBaker::NORMAL_MAP || attribute == TextureBaker::DISPLACEMENT_MAP) {
+		CheckError(srcMesh->cm.fn == 0, "Source mesh needs to have faces");
+	}
 
 	if (overwrite) {
 		CheckError(trgMesh->cm.textures.empty(), "Mesh has no associated texture to overwrite");
@@ -981,6 +978,7 @@ void FilterTexturePlugin::transferToTexture(
 		for (srcTexInd = 0; srcTexInd < numSrcTex; srcTexInd++)
 		{
 			srcTextureFileNames[srcTexInd] = srcMesh->cm.textures[srcTexInd].c_str();
+			srcImgs[srcTexInd] = srcMesh->getTexture(srcMesh->cm.textures[srcTexInd]);
 		}
 	}
 
@@ -1019,20 +1017,9 @@ void FilterTexturePlugin::transferToTexture(
 	}
 
 	// Rasterizing faces
-	srcMesh->updateDataMask(MeshModel::MM_FACEMARK);
 	tri::UpdateNormal<CMeshO>::PerFaceNormalized(srcMesh->cm);
-	if (vertexSampling)
-	{
-		TransferColorSampler sampler(srcMesh->cm, trgImgs, upperbound, vertexMode); // color sampling
-		sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
-	}
-	else
-	{
-		TransferColorSampler sampler(srcMesh->cm, trgImgs, &srcImgs, upperbound); // texture sampling
-		sampler.InitCallback(cb, trgMesh->cm.fn, 0, 80);
-		tri::SurfaceSampling<CMeshO, TransferColorSampler>::Texture(trgMesh->cm, sampler, textW, textH, false);
-	}
+	TextureBaker baker(trgMesh->cm, trgImgs);
+	baker.bakeTransfer(srcMesh->cm, attribute, upperbound, srcImgs, cb, 0, 80);
 
 	// the meshes have to return to their original position
 	// only if source different from target (if single mesh, it does not matter)
@@ -1052,13 +1039,7 @@ void FilterTexturePlugin::transferToTexture(
 	{
 		// Revert alpha values for border edge pixels to 255
 		cb(81, "Cleaning up texture ...");
-		for (int y = 0; y<textH; ++y)
-			for (int x = 0; x<textW; ++x)
-			{
-				QRgb px = trgImgs[trgTexInd].pixel(x, y);
-				if (qAlpha(px) < 255 && (!pp || qAlpha(px) > 0))
-					trgImgs[trgTexInd].setPixel(x, y, px | 0xff000000);
-			}
+		TextureBaker::closeBorderTexels(trgImgs[trgTexInd], pp);
 
 		// PullPush
 		if (pp)
@@ -0,0 +1,453 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#include "texture_baker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <vcg/complex/algorithms/stat.h>
+#include <vcg/simplex/face/distance.h>
+#include <vcg/simplex/vertex/distance.h>
+#include <vcg/space/index/grid_static_ptr.h>
+#include <vcg/space/triangle3.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+typedef vcg::Point2<double> TexelPoint;
+
+/*
+ * The spatial indexes are shared by all the threads: the usual marker,
+ * writing the mark of each visited face in the mesh, is replaced by one that
+ * marks nothing (a face in many cells is just tested more than once).
+ */
+struct NoMarker
+{
+	void UnMarkAll() {}
+	template <class T>
+	bool IsMarked(T) const
+	{
+		return false;
+	}
+	template <class T>
+	void Mark(T)
+	{
+	}
+};
+
+double cross(const TexelPoint& a, const TexelPoint& b)
+{
+	return a[0] * b[1] - a[1] * b[0];
+}
+
+TexelPoint closestOnSegment(const TexelPoint& a, const TexelPoint& b, const TexelPoint& p)
+{
+	const TexelPoint d  = b - a;
+	const double     l2 = d.SquaredNorm();
+	if (l2 == 0)
+		return a;
+	const double t = std::min(1.0, std::max(0.0, ((p - a) * d) / l2));
+	return a + d * t;
+}
+
+int toByte(double v)
+{
+	return std::min(255, std::max(0, int(v)));
+}
+
+/// the uv triangle of f, in texel coordinates (texel centers on integers)
+void texelTriangle(const CFaceO& f, int width, int height, TexelPoint v[3])
+{
+	for (int i = 0; i < 3; ++i)
+		v[i] = TexelPoint(f.cWT(i).U() * width - 0.5, f.cWT(i).V() * height - 0.5);
+}
+
+/// texel bounding box, enlarged by one texel, of the uv triangle; false if not valid
+bool texelBox(const TexelPoint v[3], int width, int height, int& x0, int& y0, int& x1, int& y1)
+{
+	for (int i = 0; i < 3; ++i)
+		if (!std::isfinite(v[i][0]) || !std::isfinite(v[i][1]))
+			return false;
+	auto clampX = [&](double x) { return int(std::min<double>(std::max<double>(x, -2), width + 2)); };
+	auto clampY = [&](double y) { return int(std::min<double>(std::max<double>(y, -2), height + 2)); };
+	x0 = clampX(std::floor(std::min({v[0][0], v[1][0], v[2][0]})) - 1);
+	y0 = clampY(std::floor(std::min({v[0][1], v[1][1], v[2][1]})) - 1);
+	x1 = clampX(std::ceil(std::max({v[0][0], v[1][0], v[2][0]})) + 1);
+	y1 = clampY(std::ceil(std::max({v[0][1], v[1][1], v[2][1]})) + 1);
+	return true;
+}
+
+/// orthonormal tangent frame of the target surface at the barycentric coords b of f
+bool tangentFrame(const CFaceO& f, const Point3m& b, Point3m& t, Point3m& bt, Point3m& n)
+{
+	n = f.cV(0)->cN() * b[0] + f.cV(1)->cN() * b[1] + f.cV(2)->cN() * b[2];
+	if (n.Norm() == 0)
+		n = (f.cP(1) - f.cP(0)) ^ (f.cP(2) - f.cP(0));
+	if (n.Norm() == 0)
+		return false;
+	n.Normalize();
+
+	const Point3m dp1 = f.cP(1) - f.cP(0), dp2 = f.cP(2) - f.cP(0);
+	const Scalarm du1 = f.cWT(1).U() - f.cWT(0).U(), dv1 = f.cWT(1).V() - f.cWT(0).V();
+	const Scalarm du2 = f.cWT(2).U() - f.cWT(0).U(), dv2 = f.cWT(2).V() - f.cWT(0).V();
+	const Scalarm r   = du1 * dv2 - du2 * dv1;
+	if (r == 0)
+		return false;
+	t  = (dp1 * dv2 - dp2 * dv1) / r;
+	bt = (dp2 * du1 - dp1 * du2) / r;
+
+	t = t - n * (n * t);
+	if (t.Norm() == 0)
+		return false;
+	t.Normalize();
+	Point3m b2 = n ^ t;
+	bt         = (b2 * bt < 0) ? -b2 : b2;
+	return true;
+}
+
+} // namespace
+
+TextureBaker::TextureBaker(const CMeshO& target, std::vector<QImage>& images) :
+		target(target), images(images)
+{
+	if (images.empty())
+		return;
+	width  = images[0].width();
+	height = images[0].height();
+
+	const int tw = (width + TILE_SIZE - 1) / TILE_SIZE;
+	const int th = (height + TILE_SIZE - 1) / TILE_SIZE;
+	std::vector<std::vector<int>> bins(images.size() * tw * th);
+	for (size_t fi = 0; fi < target.face.size(); ++fi) {
+		const CFaceO& f   = target.face[fi];
+		const int     tex = f.cWT(0).N();
+		if (f.IsD() || tex < 0 || tex >= int(images.size()))
+			continue;
+		TexelPoint v[3];
+		int        x0, y0, x1, y1;
+		texelTriangle(f, width, height, v);
+		if (!texelBox(v, width, height, x0, y0, x1, y1))
+			continue;
+		x0 = std::max(x0, 0);
+		y0 = std::max(y0, 0);
+		x1 = std::min(x1, width - 1);
+		y1 = std::min(y1, height - 1);
+		for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE && y0 <= y1; ++ty)
+			for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE && x0 <= x1; ++tx)
+				bins[(tex * th + ty) * tw + tx].push_back(int(fi));
+	}
+
+	for (size_t i = 0; i < bins.size(); ++i) {
+		if (bins[i].empty())
+			continue;
+		Tile tile;
+		tile.tex   = int(i / (tw * th));
+		tile.x0    = int(i % tw) * TILE_SIZE;
+		tile.y0    = int((i / tw) % th) * TILE_SIZE;
+		tile.x1    = std::min(tile.x0 + TILE_SIZE, width);
+		tile.y1    = std::min(tile.y0 + TILE_SIZE, height);
+		tile.faces = std::move(bins[i]);
+		tiles.push_back(std::move(tile));
+	}
+}
+
+template <class Emit>
+void TextureBaker::rasterizeFace(const Tile& tile, const CFaceO& f, bool onEdgeBary, Emit& emit)
+	const
+{
+	TexelPoint v[3];
+	int        x0, y0, x1, y1;
+	texelTriangle(f, width, height, v);
+	const double de = cross(v[1] - v[0], v[2] - v[0]);
+	if (de == 0 || !texelBox(v, width, height, x0, y0, x1, y1))
+		return;
+	x0 = std::max(x0, tile.x0);
+	y0 = std::max(y0, tile.y0);
+	x1 = std::min(x1, tile.x1 - 1);
+	y1 = std::min(y1, tile.y1 - 1);
+
+	auto bary = [&](const TexelPoint& p) {
+		const double b0 = cross(v[1] - p, v[2] - p) / de;
+		const double b1 = cross(v[2] - p, v[0] - p) / de;
+		return Point3m(b0, b1, 1 - b0 - b1);
+	};
+
+	// as in SurfaceSampling::SingleFaceRaster, a border edge is considered
+	// only for the texels on its outer side: n[i] is the edge function of the
+	// edge i, whose sign depends on the orientation of the triangle
+	const TexelPoint d10 = v[1] - v[0], d02 = v[0] - v[2];
+	const bool       flipped = !(d02[1] * d10[0] - d02[0] * d10[1] >= 0);
+	auto             outerSide = [&](int i, const TexelPoint& p) {
+		const TexelPoint d = v[(i + 1) % 3] - v[i];
+		const double     n = (p[0] - v[i][0]) * d[1] - (p[1] - v[i][1]) * d[0];
+		return flipped ? n > 0 : n < 0;
+	};
+
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			const TexelPoint p(x, y);
+			const Point3m    b = bary(p);
+			if (b[0] >= 0 && b[1] >= 0 && b[2] >= 0) {
+				emit(f, b, x, y, 0);
+				continue;
+			}
+
+			// a texel outside the face is written if it is close to one of
+			// its texture space border edges
+			double     minDist = std::numeric_limits<double>::max();
+			TexelPoint closest;
+			for (int i = 0; i < 3; ++i) {
+				if (!f.IsB(i) || !outerSide(i, p))
+					continue;
+				const TexelPoint c = closestOnSegment(v[i], v[(i + 1) % 3], p);
+				const double     d = (c - p).Norm();
+				if (d < minDist && std::abs(c[0] - x) < 1 && std::abs(c[1] - y) < 1) {
+					minDist = d;
+					closest = c;
+				}
+			}
+			if (minDist != std::numeric_limits<double>::max())
+				emit(f, onEdgeBary ? bary(closest) : b, x, y, float(minDist));
+		}
+	}
+}
+
+template <class Shader>
+void TextureBaker::bake(bool onEdgeBary, Shader& shade, vcg::CallBackPos* cb, int start, int offset)
+{
+	// detach the images once, before writing them from many threads
+	std::vector<QRgb*> bits(images.size());
+	std::vector<int>   stride(images.size());
+	for (size_t i = 0; i < images.size(); ++i) {
+		bits[i]   = reinterpret_cast<QRgb*>(images[i].bits());
+		stride[i] = images[i].bytesPerLine() / int(sizeof(QRgb));
+	}
+
+	const int tileNum = int(tiles.size());
+	int       done    = 0;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int t = 0; t < tileNum; ++t) {
+		const Tile& tile = tiles[t];
+		QRgb*       img  = bits[tile.tex];
+		const int   s    = stride[tile.tex];
+
+		auto emit = [&](const CFaceO& f, const Point3m& b, int x, int y, float edgeDist) {
+			QRgb&     texel = img[(height - 1 - y) * s + x];
+			const int alpha = edgeDist == 0 ? 255 : int(254 - edgeDist * 128);
+			QRgb      c;
+			if (shade(f, b, alpha, c) && (qAlpha(c) == 255 || qAlpha(texel) < qAlpha(c)))
+				texel = c;
+		};
+		for (int fi : tile.faces)
+			rasterizeFace(tile, target.face[fi], onEdgeBary, emit);
+
+		int d;
+#pragma omp atomic capture
+		d = ++done;
+#ifdef _OPENMP
+		if (omp_get_thread_num() == 0)
+#endif
+		{
+			if (cb != nullptr)
+				cb(start + d * offset / tileNum, "Rasterizing faces ...");
+		}
+	}
+}
+
+void TextureBaker::bakeVertexColor(vcg::CallBackPos* cb, int start, int offset)
+{
+	auto shade = [](const CFaceO& f, const Point3m& b, int alpha, QRgb& c) {
+		int rgb[3];
+		for (int k = 0; k < 3; ++k)
+			rgb[k] = toByte(
+				f.cV(0)->cC()[k] * b[0] + f.cV(1)->cC()[k] * b[1] + f.cV(2)->cC()[k] * b[2]);
+		c = qRgba(rgb[0], rgb[1], rgb[2], alpha);
+		return true;
+	};
+	bake(true, shade, cb, start, offset);
+}
+
+void TextureBaker::bakeTransfer(
+	CMeshO&                    source,
+	Attribute                  attribute,
+	Scalarm                    maxDist,
+	const std::vector<QImage>& srcImgs,
+	vcg::CallBackPos*          cb,
+	int                        start,
+	int                        offset)
+{
+	typedef vcg::GridStaticPtr<CMeshO::FaceType, CMeshO::ScalarType>   FaceGrid;
+	typedef vcg::GridStaticPtr<CMeshO::VertexType, CMeshO::ScalarType> VertexGrid;
+
+	const bool pointCloud = source.fn == 0;
+	FaceGrid   faceGrid;
+	VertexGrid vertGrid;
+	if (pointCloud)
+		vertGrid.Set(source.vert.begin(), source.vert.end());
+	else
+		faceGrid.Set(source.face.begin(), source.face.end());
+
+	Scalarm minQ = 0, maxQ = 0;
+	if (attribute == VERTEX_QUALITY) {
+		std::pair<Scalarm, Scalarm> mm =
+			vcg::tri::Stat<CMeshO>::ComputePerVertexQualityMinMax(source);
+		minQ = mm.first;
+		maxQ = mm.second;
+	}
+	auto qualityShade = [&](Scalarm q) {
+		return maxQ > minQ ? toByte(255.0 * (q - minQ) / (maxQ - minQ)) : 0;
+	};
+
+	std::vector<QImage> src(srcImgs.size());
+	if (attribute == TEXTURE_COLOR)
+		for (size_t i = 0; i < srcImgs.size(); ++i)
+			src[i] = srcImgs[i].convertToFormat(QImage::Format_ARGB32);
+
+	auto shade = [&](const CFaceO& f, const Point3m& b, int alpha, QRgb& c) {
+		const Point3m p = f.cP(0) * b[0] + f.cP(1) * b[1] + f.cP(2) * b[2];
+		// same gate of the previous sequential transfer
+		if (!source.bbox.IsInEx(p))
+			return false;
+
+		NoMarker marker;
+		Scalarm  dist = maxDist;
+		Point3m  closest;
+		if (pointCloud) {
+			vcg::vertex::PointDistanceFunctor<Scalarm> distFunct;
+			const CVertexO* v = vertGrid.GetClosest(distFunct, marker, p, maxDist, dist, closest);
+			if (v == nullptr || dist == maxDist)
+				return false;
+			switch (attribute) {
+			case VERTEX_COLOR: c = qRgba(v->cC()[0], v->cC()[1], v->cC()[2], 255); break;
+			case VERTEX_NORMAL:
+				c = qRgba(
+					toByte(v->cN()[0] * 128.0 + 128),
+					toByte(v->cN()[1] * 128.0 + 128),
+					toByte(v->cN()[2] * 128.0 + 128),
+					255);
+				break;
+			case VERTEX_QUALITY: {
+				const int q = qualityShade(v->cQ());
+				c           = qRgba(q, q, q, 255);
+			} break;
+			default: return false;
+			}
+			return true;
+		}
+
+		vcg::face::PointDistanceBaseFunctor<Scalarm> distFunct;
+		const CFaceO* nf = faceGrid.GetClosest(distFunct, marker, p, maxDist, dist, closest);
+		if (nf == nullptr || dist == maxDist)
+			return false;
+
+		// barycentric coords of the closest point, clamped inside the face
+		Point3m ip;
+		if (!vcg::InterpolationParameters(*nf, nf->cN(), closest, ip)) {
+			for (int k = 0; k < 3; ++k)
+				ip[k] = std::max<Scalarm>(ip[k], 0);
+			const Scalarm sum = ip[0] + ip[1] + ip[2];
+			if (sum == 0)
+				return false;
+			ip /= sum;
+		}
+
+		switch (attribute) {
+		case VERTEX_COLOR: {
+			int rgb[3];
+			for (int k = 0; k < 3; ++k)
+				rgb[k] = toByte(
+					nf->cV(0)->cC()[k] * ip[0] + nf->cV(1)->cC()[k] * ip[1] +
+					nf->cV(2)->cC()[k] * ip[2]);
+			c = qRgba(rgb[0], rgb[1], rgb[2], alpha);
+		} break;
+		case VERTEX_NORMAL: {
+			Point3m nn = nf->cV(0)->cN() * ip[0] + nf->cV(1)->cN() * ip[1] + nf->cV(2)->cN() * ip[2];
+			nn.Normalize();
+			nn = (nn + Point3m(1, 1, 1)) / 2 * 255;
+			c  = qRgba(toByte(nn[0]), toByte(nn[1]), toByte(nn[2]), alpha);
+		} break;
+		case VERTEX_QUALITY: {
+			const int q = qualityShade(
+				nf->cV(0)->cQ() * ip[0] + nf->cV(1)->cQ() * ip[1] + nf->cV(2)->cQ() * ip[2]);
+			c = qRgba(q, q, q, alpha);
+		} break;
+		case TEXTURE_COLOR: {
+			const int tex = nf->cWT(0).N();
+			if (tex < 0 || tex >= int(src.size()) || src[tex].isNull())
+				return false;
+			const int w = src[tex].width(), h = src[tex].height();
+			int x = w * (ip[0] * nf->cWT(0).U() + ip[1] * nf->cWT(1).U() + ip[2] * nf->cWT(2).U());
+			int y = h * (1.0 - (ip[0] * nf->cWT(0).V() + ip[1] * nf->cWT(1).V() +
+								ip[2] * nf->cWT(2).V()));
+			// texture repeat mode
+			x             = (x % w + w) % w;
+			y             = (y % h + h) % h;
+			const QRgb px = reinterpret_cast<const QRgb*>(src[tex].constScanLine(y))[x];
+			c             = qRgba(qRed(px), qGreen(px), qBlue(px), alpha);
+		} break;
+		case NORMAL_MAP: {
+			Point3m sn = nf->cV(0)->cN() * ip[0] + nf->cV(1)->cN() * ip[1] + nf->cV(2)->cN() * ip[2];
+			if (sn.Norm() == 0)
+				sn = nf->cN();
+			sn.Normalize();
+			Point3m t, bt, n;
+			Point3m tn(0, 0, 1);
+			if (tangentFrame(f, b, t, bt, n))
+				tn = Point3m(sn * t, sn * bt, sn * n);
+			tn = (tn + Point3m(1, 1, 1)) / 2 * 255;
+			c  = qRgba(toByte(tn[0]), toByte(tn[1]), toByte(tn[2]), alpha);
+		} break;
+		case DISPLACEMENT_MAP: {
+			Point3m n = f.cV(0)->cN() * b[0] + f.cV(1)->cN() * b[1] + f.cV(2)->cN() * b[2];
+			if (n.Norm() == 0)
+				n = (f.cP(1) - f.cP(0)) ^ (f.cP(2) - f.cP(0));
+			n.Normalize();
+			const Scalarm d = ((closest - p) * n) / maxDist;
+			const int     g = toByte(255.0 * std::min<Scalarm>(1, std::max<Scalarm>(0, 0.5 + 0.5 * d)));
+			c               = qRgba(g, g, g, alpha);
+		} break;
+		}
+		return true;
+	};
+	bake(false, shade, cb, start, offset);
+}
+
+void TextureBaker::closeBorderTexels(QImage& img, bool keepEmpty)
+{
+	uchar*    bits   = img.bits();
+	const int stride = img.bytesPerLine();
+#pragma omp parallel for schedule(static)
+	for (int y = 0; y < img.height(); ++y) {
+		QRgb* line = reinterpret_cast<QRgb*>(bits + size_t(y) * stride);
+		for (int x = 0; x < img.width(); ++x) {
+			const int a = qAlpha(line[x]);
+			if (a < 255 && (!keepEmpty || a > 0))
+				line[x] |= 0xff000000;
+		}
+	}
+}
@@ -0,0 +1,121 @@
+/****************************************************************************
+* MeshLab                                                           o o     *
+* A versatile mesh processing toolbox                             o     o   *
+*                                                                _   O  _   *
+* Copyright(C) 2005                                                \/)\/    *
+* Visual Computing Lab                                            /\/|      *
+* ISTI - Italian National Research Council                           |      *
+*                                                                    \      *
+* All rights reserved.                                                      *
+*                                                                           *
+* This program is free software; you can redistribute it and/or modify      *
+* it under the terms of the GNU General Public License as published by      *
+* the Free Software Foundation; either version 2 of the License, or         *
+* (at your option) any later version.                                       *
+*                                                                           *
+* This program is distributed in the hope that it will be useful,           *
+* but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+* GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+* for more details.                                                         *
+*                                                                           *
+****************************************************************************/
+
+#ifndef _TEXTURE_BAKER_H
+#define _TEXTURE_BAKER_H
+
+#include <vector>
+
+#include <QImage>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+Tiled baking of per texel data in the textures of a mesh.
+
+The texture space of the target mesh is split in square tiles, and each face
+is binned in the tiles touched by its uv triangle. The tiles are baked in
+parallel: a tile rasterizes, in face order, only the texels inside it, so
+every texel is written by a single thread and in the same order of a face by
+face rasterization. Texels are written directly in the scanlines of the
+images; the closest point queries of a tile, coherent in space, are done by
+the same thread against the spatial index of the source mesh, which is built
+once and then only read.
+
+As in the sampling of tri::SurfaceSampling::Texture, a texel is covered by a
+face if its center is inside the uv triangle; the texels just outside a
+texture space border edge, on its outer side (the FaceFaceFromTexCoord
+border flags must be set), are also written, with an alpha value decreasing with their distance
+from the edge, so that they can be filled by the nearest face.
+*/
+class TextureBaker
+{
+public:
+	/// data transferred from the source mesh in the target textures
+	enum Attribute {
+		VERTEX_COLOR,
+		VERTEX_NORMAL,
+		VERTEX_QUALITY,
+		TEXTURE_COLOR,
+		NORMAL_MAP,      // source normal in the tangent space of the target
+		DISPLACEMENT_MAP // signed distance of the source along the target normal
+	};
+
+	static const int TILE_SIZE = 64;
+
+	/**
+	 * @brief Prepares the baking in images (one for each texture of the
+	 * target, all of the same size, in ARGB32 format) of the faces of target.
+	 */
+	TextureBaker(const CMeshO& target, std::vector<QImage>& images);
+
+	/**
+	 * @brief Fills the texels with the interpolation of the vertex colors of
+	 * the target itself. Progress goes from start to start+offset.
+	 */
+	void bakeVertexColor(vcg::CallBackPos* cb, int start, int offset);
+
+	/**
+	 * @brief Fills the texels with the attribute of the point of source
+	 * closest to the texel, if closer than maxDist. A source without faces
+	 * is sampled at its closest vertex (only vertex attributes). srcImgs are
+	 * the textures of source, used only for TEXTURE_COLOR. The displacement
+	 * map maps [-maxDist, maxDist] to [0, 255].
+	 */
+	void bakeTransfer(
+		CMeshO&                    source,
+		Attribute                  attribute,
+		Scalarm                    maxDist,
+		const std::vector<QImage>& srcImgs,
+		vcg::CallBackPos*          cb,
+		int                        start,
+		int                        offset);
+
+	/**
+	 * @brief Makes opaque the texels partially covered by a border; if
+	 * keepEmpty is true the texels not covered at all stay transparent.
+	 */
+	static void closeBorderTexels(QImage& img, bool keepEmpty);
+
+private:
+	struct Tile
+	{
+		int              tex;
+		int              x0, y0, x1, y1; // texel range [x0,x1) x [y0,y1)
+		std::vector<int> faces;
+	};
+
+	template <class Shader>
+	void bake(bool onEdgeBary, Shader& shade, vcg::CallBackPos* cb, int start, int offset);
+
+	template <class Emit>
+	void rasterizeFace(const Tile& tile, const CFaceO& f, bool onEdgeBary, Emit& emit) const;
+
+	const CMeshO&        target;
+	std::vector<QImage>& images;
+	int                  width  = 0;
+	int                  height = 0;
+	std::vector<Tile>    tiles;
+};
+
+#endif // _TEXTURE_BAKER_H
@@ -21,6 +21,7 @@
  *                                                                           *
  ****************************************************************************/
 #include "filter_unsharp.h"
+#include "vertex_smoother.h"
 
 #include <vcg/complex/algorithms/clean.h>
 #include <vcg/complex/algorithms/crease_cut.h>
@@ -763,7 +764,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		break;
 	case FP_VERTEX_QUALITY_SMOOTHING:
 		tri::UpdateFlags<CMeshO>::FaceBorderFromNone(m.cm);
-		tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm);
+		VertexSmoother(m.cm, false).qualityLaplacian(m.cm, 1);
 		break;
 
 	case FP_LAPLACIAN_SMOOTH: {
@@ -778,8 +779,8 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		if (!boundarySmooth)
 			tri::UpdateFlags<CMeshO>::FaceClearB(m.cm);
 
-		tri::Smooth<CMeshO>::VertexCoordLaplacian(
-			m.cm, stepSmoothNum, Selected, cotangentWeight, cb);
+		VertexSmoother smoother(m.cm, Selected, cotangentWeight);
+		smoother.laplacian(m.cm, stepSmoothNum, cotangentWeight, cb);
 		log("Smoothed %d vertices", Selected ? m.cm.svn : m.cm.vn);
 		m.updateBoxAndNormals();
 	} break;
@@ -849,15 +850,14 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		// Small hack
 		tri::UpdateFlags<CMeshO>::FaceClearB(m.cm);
 		Scalarm delta = par.getAbsPerc("delta");
-		tri::Smooth<CMeshO>::VertexCoordScaleDependentLaplacian_Fujiwara(
-			m.cm, stepSmoothNum, delta);
+		VertexSmoother(m.cm, false).scaleDependentLaplacian(m.cm, stepSmoothNum, delta);
 		log("Smoothed %d vertices", cnt > 0 ? cnt : m.cm.vn);
 		m.updateBoxAndNormals();
 	} break;
 	case FP_HC_LAPLACIAN_SMOOTH: {
 		tri::UpdateFlags<CMeshO>::FaceBorderFromNone(m.cm);
 		size_t cnt = tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(m.cm);
-		tri::Smooth<CMeshO>::VertexCoordLaplacianHC(m.cm, 1, cnt > 0);
+		VertexSmoother(m.cm, cnt > 0).laplacianHC(m.cm, 1);
 		m.updateBoxAndNormals();
 	} break;
 	case FP_TWO_STEP_SMOOTH: {
@@ -887,7 +887,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		Scalarm mu            = par.getFloat("mu");
 
 		size_t cnt = tri::UpdateSelection<CMeshO>::VertexFromFaceStrict(m.cm);
-		tri::Smooth<CMeshO>::VertexCoordTaubin(m.cm, stepSmoothNum, lambda, mu, cnt > 0, cb);
+		VertexSmoother(m.cm, cnt > 0).taubin(m.cm, stepSmoothNum, lambda, mu, cb);
 		log("Smoothed %d vertices", cnt > 0 ? cnt : m.cm.vn);
 		m.updateBoxAndNormals();
 	} break;
@@ -959,7 +959,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		for (int i = 0; i < m.cm.vn; ++i)
 			geomOrig[i] = m.cm.vert[i].P();
 
-		tri::Smooth<CMeshO>::VertexCoordLaplacian(m.cm, smoothIter);
+		VertexSmoother(m.cm, false).laplacian(m.cm, smoothIter, false);
 
 		for (int i = 0; i < m.cm.vn; ++i)
 			m.cm.vert[i].P() = geomOrig[i] * alphaorig + (geomOrig[i] - m.cm.vert[i].P()) * alpha;
@@ -978,7 +978,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		for (int i = 0; i < m.cm.vn; ++i)
 			colorOrig[i].Import(m.cm.vert[i].C());
 
-		tri::Smooth<CMeshO>::VertexColorLaplacian(m.cm, smoothIter);
+		VertexSmoother(m.cm, false).colorLaplacian(m.cm, smoothIter);
 		for (int i = 0; i < m.cm.vn; ++i) {
 			Color4f colorDelta = colorOrig[i] - Color4f::Construct(m.cm.vert[i].C());
 			Color4f newCol     = colorOrig[i] * alphaorig + colorDelta * alpha; // Unsharp formula
@@ -997,7 +997,7 @@ std::map<std::string, QVariant> FilterUnsharp::applyFilter(
 		for (int i = 0; i < m.cm.vn; ++i)
 			qualityOrig[i] = m.cm.vert[i].Q();
 
-		tri::Smooth<CMeshO>::VertexQualityLaplacian(m.cm, smoothIter);
+		VertexSmoother(m.cm, false).qualityLaplacian(m.cm, smoothIter);
 		for (int i = 0; i < m.cm.vn; ++i) {
 			float qualityDelta = qualityOrig[i] - m.cm.vert[i].Q();
 			m.cm.vert[i].Q() = qualityOrig[i] * alphaorig + qualityDelta * alpha; // Unsharp formula
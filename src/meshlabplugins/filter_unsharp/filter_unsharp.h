@@ -78,6 +78,7 @@ public:
 	int               postCondition(const QAction*) const;
 	int               getPreConditions(const QAction*) const;
 	FilterArity       filterArity(const QAction* filter) const;
+	bool              supportsBackgroundExecution(const QAction*) const { return true; }
 };
 
 #endif // FILTER_UNSHARP_PLUGIN_H
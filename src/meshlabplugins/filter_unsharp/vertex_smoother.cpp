@@ -0,0 +1,408 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#include "vertex_smoother.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// a face edge seen from one of its vertices
+struct HalfEdge
+{
+	int  to;       // the other vertex of the edge
+	int  opposite; // the third vertex of the face
+	bool isBorder;
+};
+
+void prefixSum(std::vector<size_t>& v)
+{
+	for (size_t i = 1; i < v.size(); ++i)
+		v[i] += v[i - 1];
+}
+
+} // namespace
+
+void VertexSmoother::Coords::resize(size_t n)
+{
+	for (int k = 0; k < 3; ++k)
+		c[k].resize(n);
+}
+
+VertexSmoother::VertexSmoother(const CMeshO& m, bool selectedOnly, bool cotangent) :
+		vn(int(m.vert.size()))
+{
+	active.assign(vn, 0);
+	border.assign(vn, 0);
+	for (int i = 0; i < vn; ++i)
+		active[i] = !m.vert[i].IsD() && (!selectedOnly || m.vert[i].IsS());
+
+	// bucket the half edges by vertex
+	std::vector<size_t> heStart(vn + 1, 0);
+	for (const CFaceO& f : m.face) {
+		if (f.IsD())
+			continue;
+		for (int j = 0; j < 3; ++j) {
+			const int a = vcg::tri::Index(m, f.cV(j)), b = vcg::tri::Index(m, f.cV1(j));
+			++heStart[a + 1];
+			++heStart[b + 1];
+			if (f.IsB(j))
+				border[a] = border[b] = 1;
+		}
+	}
+	prefixSum(heStart);
+	std::vector<HalfEdge> he(heStart[vn]);
+	std::vector<size_t>   fill(heStart.begin(), heStart.end() - 1);
+	for (const CFaceO& f : m.face) {
+		if (f.IsD())
+			continue;
+		for (int j = 0; j < 3; ++j) {
+			const int  a = vcg::tri::Index(m, f.cV(j)), b = vcg::tri::Index(m, f.cV1(j));
+			const int  o = vcg::tri::Index(m, f.cV2(j));
+			const bool isB = f.IsB(j);
+			he[fill[a]++] = {b, o, isB};
+			he[fill[b]++] = {a, o, isB};
+		}
+	}
+
+	// sort each row by neighbour, then merge the half edges of the same edge
+	std::vector<size_t> rowCount(vn + 1, 0), oppositeCount(vn + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (long long v = 0; v < vn; ++v) {
+		auto b = he.begin() + heStart[v], e = he.begin() + heStart[v + 1];
+		std::sort(b, e, [](const HalfEdge& x, const HalfEdge& y) { return x.to < y.to; });
+		for (auto it = b; it != e; ++it) {
+			if (it == b || it->to != (it - 1)->to)
+				++rowCount[v + 1];
+			if (!it->isBorder)
+				++oppositeCount[v + 1];
+		}
+	}
+	prefixSum(rowCount);
+	prefixSum(oppositeCount);
+	rowStart = std::move(rowCount);
+
+	const size_t entries = rowStart[vn];
+	col.resize(entries);
+	innerCount.assign(entries, 0);
+	borderCount.assign(entries, 0);
+	if (cotangent) {
+		oppositeStart.resize(entries + 1);
+		opposite.resize(oppositeCount[vn]);
+		oppositeStart[entries] = oppositeCount[vn];
+		cotWeight.assign(entries, 0);
+	}
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (long long v = 0; v < vn; ++v) {
+		size_t e = rowStart[v];
+		size_t o = oppositeCount[v];
+		for (size_t k = heStart[v]; k < heStart[v + 1]; ++k) {
+			if (k > heStart[v] && he[k].to != he[k - 1].to)
+				++e;
+			if (k == heStart[v] || he[k].to != he[k - 1].to) {
+				col[e] = he[k].to;
+				if (cotangent)
+					oppositeStart[e] = o;
+			}
+			if (he[k].isBorder) {
+				borderCount[e] += 1;
+			}
+			else {
+				innerCount[e] += 1;
+				if (cotangent)
+					opposite[o++] = he[k].opposite;
+			}
+		}
+	}
+}
+
+void VertexSmoother::getCoords(const CMeshO& m, Coords& p) const
+{
+	p.resize(vn);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < vn; ++i)
+		for (int k = 0; k < 3; ++k)
+			p.c[k][i] = m.vert[i].cP()[k];
+}
+
+void VertexSmoother::setCoords(CMeshO& m, const Coords& p) const
+{
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < vn; ++i)
+		if (active[i])
+			for (int k = 0; k < 3; ++k)
+				m.vert[i].P()[k] = p.c[k][i];
+}
+
+void VertexSmoother::updateCotangentWeights(const Coords& p)
+{
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (long long i = 0; i < vn; ++i) {
+		const Point3m pi(p.c[0][i], p.c[1][i], p.c[2][i]);
+		for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+			const int     j = col[e];
+			const Point3m pj(p.c[0][j], p.c[1][j], p.c[2][j]);
+			Scalarm       w = 0;
+			for (size_t o = oppositeStart[e]; o < oppositeStart[e + 1]; ++o) {
+				const int     k = opposite[o];
+				const Point3m pk(p.c[0][k], p.c[1][k], p.c[2][k]);
+				w += std::tan(Scalarm(M_PI * 0.5) - vcg::Angle(pj - pk, pi - pk));
+			}
+			cotWeight[e] = w;
+		}
+	}
+}
+
+void VertexSmoother::laplacianStep(const Coords& p, Coords& q, bool cotangentWeight) const
+{
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < vn; ++i) {
+		Scalarm s[3] = {0, 0, 0};
+		Scalarm w    = 0;
+		if (active[i]) {
+			if (border[i]) {
+				// border vertices are averaged with themselves and their border neighbours
+				for (int k = 0; k < 3; ++k)
+					s[k] = p.c[k][i];
+				w = 1;
+				for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+					const Scalarm we = borderCount[e];
+					for (int k = 0; k < 3; ++k)
+						s[k] += we * p.c[k][col[e]];
+					w += we;
+				}
+			}
+			else {
+				for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+					const Scalarm we = cotangentWeight ? cotWeight[e] : innerCount[e];
+					for (int k = 0; k < 3; ++k)
+						s[k] += we * p.c[k][col[e]];
+					w += we;
+				}
+			}
+		}
+		for (int k = 0; k < 3; ++k)
+			q.c[k][i] = w > 0 ? (p.c[k][i] + s[k]) / (w + 1) : p.c[k][i];
+	}
+}
+
+void VertexSmoother::taubinStep(const Coords& p, Coords& q, Scalarm factor) const
+{
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < vn; ++i) {
+		Scalarm s[3] = {0, 0, 0};
+		Scalarm w    = 0;
+		if (active[i]) {
+			const std::vector<Scalarm>& count = border[i] ? borderCount : innerCount;
+			if (border[i]) {
+				for (int k = 0; k < 3; ++k)
+					s[k] = p.c[k][i];
+				w = 1;
+			}
+			for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+				for (int k = 0; k < 3; ++k)
+					s[k] += count[e] * p.c[k][col[e]];
+				w += count[e];
+			}
+		}
+		for (int k = 0; k < 3; ++k)
+			q.c[k][i] = w > 0 ? p.c[k][i] + (s[k] / w - p.c[k][i]) * factor : p.c[k][i];
+	}
+}
+
+void VertexSmoother::laplacian(CMeshO& m, int steps, bool cotangentWeight, vcg::CallBackPos* cb)
+{
+	assert(!cotangentWeight || oppositeStart.size() == col.size() + 1);
+	Coords p, q;
+	getCoords(m, p);
+	q.resize(vn);
+	for (int i = 0; i < steps; ++i) {
+		if (cb != nullptr)
+			cb(100 * i / steps, "Classic Laplacian Smoothing");
+		if (cotangentWeight)
+			updateCotangentWeights(p);
+		laplacianStep(p, q, cotangentWeight);
+		std::swap(p, q);
+	}
+	setCoords(m, p);
+}
+
+void VertexSmoother::taubin(
+	CMeshO&           m,
+	int               steps,
+	Scalarm           lambda,
+	Scalarm           mu,
+	vcg::CallBackPos* cb)
+{
+	Coords p, q;
+	getCoords(m, p);
+	q.resize(vn);
+	for (int i = 0; i < steps; ++i) {
+		if (cb != nullptr)
+			cb(100 * i / steps, "Taubin Smoothing");
+		taubinStep(p, q, lambda);
+		taubinStep(q, p, mu);
+	}
+	setCoords(m, p);
+}
+
+void VertexSmoother::laplacianHC(CMeshO& m, int steps)
+{
+	const Scalarm beta = 0.5;
+	Coords        p, avg, q;
+	getCoords(m, p);
+	avg.resize(vn);
+	q.resize(vn);
+	std::vector<Scalarm> count(vn);
+	for (int step = 0; step < steps; ++step) {
+		// average of the neighbours, border edges counting twice
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < vn; ++i) {
+			Scalarm s[3] = {0, 0, 0};
+			Scalarm w    = 0;
+			for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+				const Scalarm we = innerCount[e] + 2 * borderCount[e];
+				for (int k = 0; k < 3; ++k)
+					s[k] += we * p.c[k][col[e]];
+				w += we;
+			}
+			count[i] = w;
+			for (int k = 0; k < 3; ++k)
+				avg.c[k][i] = w > 0 ? s[k] / w : p.c[k][i];
+		}
+		// average of the displacements of the neighbours
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < vn; ++i) {
+			if (!active[i] || count[i] == 0) {
+				for (int k = 0; k < 3; ++k)
+					q.c[k][i] = p.c[k][i];
+				continue;
+			}
+			Scalarm d[3] = {0, 0, 0};
+			for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+				const Scalarm we = innerCount[e] + 2 * borderCount[e];
+				for (int k = 0; k < 3; ++k)
+					d[k] += we * (avg.c[k][col[e]] - p.c[k][col[e]]);
+			}
+			for (int k = 0; k < 3; ++k)
+				q.c[k][i] = avg.c[k][i] - (avg.c[k][i] - p.c[k][i]) * beta +
+							d[k] / count[i] * beta;
+		}
+		std::swap(p, q);
+	}
+	setCoords(m, p);
+}
+
+void VertexSmoother::scaleDependentLaplacian(CMeshO& m, int steps, Scalarm delta)
+{
+	Coords p, q;
+	getCoords(m, p);
+	q.resize(vn);
+	for (int step = 0; step < steps; ++step) {
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < vn; ++i) {
+			Scalarm s[3] = {0, 0, 0};
+			Scalarm len  = 0;
+			if (active[i]) {
+				const std::vector<Scalarm>& count = border[i] ? borderCount : innerCount;
+				for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+					if (count[e] == 0)
+						continue;
+					Scalarm d[3];
+					for (int k = 0; k < 3; ++k)
+						d[k] = p.c[k][col[e]] - p.c[k][i];
+					const Scalarm l = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+					if (l == 0)
+						continue;
+					for (int k = 0; k < 3; ++k)
+						s[k] += count[e] * d[k] / l;
+					len += count[e] * l;
+				}
+			}
+			for (int k = 0; k < 3; ++k)
+				q.c[k][i] = len > 0 ? p.c[k][i] + s[k] / len * delta : p.c[k][i];
+		}
+		std::swap(p, q);
+	}
+	setCoords(m, p);
+}
+
+void VertexSmoother::qualityLaplacian(CMeshO& m, int steps)
+{
+	std::vector<Scalarm> p(vn), q(vn);
+	for (int i = 0; i < vn; ++i)
+		p[i] = m.vert[i].cQ();
+	for (int step = 0; step < steps; ++step) {
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < vn; ++i) {
+			Scalarm s = 0, w = 0;
+			if (active[i]) {
+				const std::vector<Scalarm>& count = border[i] ? borderCount : innerCount;
+				for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+					s += count[e] * p[col[e]];
+					w += count[e];
+				}
+			}
+			q[i] = w > 0 ? s / w : p[i];
+		}
+		std::swap(p, q);
+	}
+	for (int i = 0; i < vn; ++i)
+		if (active[i])
+			m.vert[i].Q() = p[i];
+}
+
+void VertexSmoother::colorLaplacian(CMeshO& m, int steps)
+{
+	std::vector<unsigned char> p[4], q[4];
+	for (int k = 0; k < 4; ++k) {
+		p[k].resize(vn);
+		q[k].resize(vn);
+		for (int i = 0; i < vn; ++i)
+			p[k][i] = m.vert[i].cC()[k];
+	}
+	for (int step = 0; step < steps; ++step) {
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < vn; ++i) {
+			int s[4] = {0, 0, 0, 0};
+			int w    = 0;
+			if (active[i]) {
+				const std::vector<Scalarm>& count = border[i] ? borderCount : innerCount;
+				for (size_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+					const int we = int(count[e]);
+					for (int k = 0; k < 4; ++k)
+						s[k] += we * p[k][col[e]];
+					w += we;
+				}
+			}
+			for (int k = 0; k < 4; ++k)
+				q[k][i] = w > 0 ? (unsigned char) (s[k] / w) : p[k][i];
+		}
+		for (int k = 0; k < 4; ++k)
+			std::swap(p[k], q[k]);
+	}
+	for (int i = 0; i < vn; ++i)
+		if (active[i])
+			for (int k = 0; k < 4; ++k)
+				m.vert[i].C()[k] = p[k][i];
+}
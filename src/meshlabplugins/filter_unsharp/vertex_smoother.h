@@ -0,0 +1,105 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * An extendible mesh processor                                    o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+#ifndef FILTER_UNSHARP_VERTEX_SMOOTHER_H
+#define FILTER_UNSHARP_VERTEX_SMOOTHER_H
+
+#include <vector>
+
+#include <common/ml_document/cmesh.h>
+
+/*
+Per vertex smoothing kernels of the unsharp plugin.
+
+The vertex adjacency of the mesh is built once, in compressed rows, from the
+faces and from their border flags, and then used by every iteration: each
+iteration is a Jacobi step, computed in parallel over the vertices from
+plain per coordinate (or per channel) arrays and written to a second buffer.
+
+The kernels give the same results of the corresponding tri::Smooth ones:
+an edge counts once for each face it belongs to, a vertex on a border edge
+(a face edge with the border flag set) is averaged only with its neighbours
+along the border, and vertices outside the selection, when smoothing only
+the selected ones, are left untouched but still used by their neighbours.
+*/
+class VertexSmoother
+{
+public:
+	/**
+	 * @brief Builds the adjacency of the vertices of m. If selectedOnly is
+	 * true only the selected vertices are smoothed; if cotangent is true the
+	 * cotangent weights are available to laplacian().
+	 */
+	VertexSmoother(const CMeshO& m, bool selectedOnly, bool cotangent = false);
+
+	/// tri::Smooth::VertexCoordLaplacian
+	void laplacian(CMeshO& m, int steps, bool cotangentWeight, vcg::CallBackPos* cb = nullptr);
+
+	/// tri::Smooth::VertexCoordTaubin
+	void taubin(CMeshO& m, int steps, Scalarm lambda, Scalarm mu, vcg::CallBackPos* cb = nullptr);
+
+	/// tri::Smooth::VertexCoordLaplacianHC
+	void laplacianHC(CMeshO& m, int steps);
+
+	/// tri::Smooth::VertexCoordScaleDependentLaplacian_Fujiwara
+	void scaleDependentLaplacian(CMeshO& m, int steps, Scalarm delta);
+
+	/// tri::Smooth::VertexQualityLaplacian
+	void qualityLaplacian(CMeshO& m, int steps);
+
+	/// tri::Smooth::VertexColorLaplacian
+	void colorLaplacian(CMeshO& m, int steps);
+
+private:
+	/// an array for each coordinate
+	struct Coords
+	{
+		std::vector<Scalarm> c[3];
+		void                 resize(size_t n);
+	};
+
+	void getCoords(const CMeshO& m, Coords& p) const;
+	void setCoords(CMeshO& m, const Coords& p) const;
+	void updateCotangentWeights(const Coords& p);
+	void laplacianStep(const Coords& p, Coords& q, bool cotangentWeight) const;
+	void taubinStep(const Coords& p, Coords& q, Scalarm factor) const;
+
+	int vn = 0;
+
+	std::vector<char> active; // smoothed vertices
+	std::vector<char> border; // vertices on a border edge
+
+	// compressed rows of the adjacency: for each neighbour, the number of
+	// faces sharing the edge without and with the border flag
+	std::vector<size_t>  rowStart;
+	std::vector<int>     col;
+	std::vector<Scalarm> innerCount;
+	std::vector<Scalarm> borderCount;
+
+	// cotangent weights: for each entry, the list of the vertices opposite
+	// to the edge in its faces without the border flag
+	std::vector<size_t>  oppositeStart;
+	std::vector<int>     opposite;
+	std::vector<Scalarm> cotWeight;
+};
+
+#endif // FILTER_UNSHARP_VERTEX_SMOOTHER_H
@@ -22,9 +22,15 @@
 ****************************************************************************/
 
 #include "baseio.h"
+#include "binary_ply.h"
 #include "load_project.h"
+#include "parallel_obj.h"
 #include "save_project.h"
 
+#include <common/utilities/load_save.h>
+
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QTextStream>
 
 #include <wrap/io_trimesh/import_ply.h>
@@ -208,20 +214,35 @@ void BaseMeshIOPlugin::open(const QString &formatName, const QString &fileName,
 
 	if (formatName.toUpper() == tr("PLY"))
 	{
-		tri::io::ImporterPLY<CMeshO>::LoadMask(filename.c_str(), mask);
-		// small patch to allow the loading of per wedge color into faces.
-		if (mask & tri::io::Mask::IOM_WEDGCOLOR) mask |= tri::io::Mask::IOM_FACECOLOR;
-		m.enable(mask);
+		QElapsedTimer t;
+		t.start();
+		// binary files with the common layout are decoded in parallel from the mapped file
+		bool fastPath = false;
+		try {
+			fastPath = openBinaryPLY(fileName, m, mask, cb);
+		}
+		catch (const MLException& e) {
+			throw MLException(errorMsgFormat.arg(fileName, e.what()));
+		}
+		if (!fastPath) {
+			tri::io::ImporterPLY<CMeshO>::LoadMask(filename.c_str(), mask);
+			// small patch to allow the loading of per wedge color into faces.
+			if (mask & tri::io::Mask::IOM_WEDGCOLOR) mask |= tri::io::Mask::IOM_FACECOLOR;
+			m.enable(mask);
 
 
-		int result = tri::io::ImporterPLY<CMeshO>::Open(m.cm, filename.c_str(), mask, cb);
-		if (result != 0) // all the importers return 0 on success
-		{
-			if (tri::io::ImporterPLY<CMeshO>::ErrorCritical(result))
+			int result = tri::io::ImporterPLY<CMeshO>::Open(m.cm, filename.c_str(), mask, cb);
+			if (result != 0) // all the importers return 0 on success
 			{
-				throw MLException(errorMsgFormat.arg(fileName, tri::io::ImporterPLY<CMeshO>::ErrorMsg(result)));
+				if (tri::io::ImporterPLY<CMeshO>::ErrorCritical(result))
+				{
+					throw MLException(errorMsgFormat.arg(fileName, tri::io::ImporterPLY<CMeshO>::ErrorMsg(result)));
+				}
 			}
 		}
+		double mb = QFileInfo(fileName).size() / (1024.0 * 1024.0);
+		int msec = std::max<int>(t.elapsed(), 1);
+		log("Loaded %s: %.1f MB in %d msec (%.1f MB/s)", qUtf8Printable(QFileInfo(fileName).fileName()), mb, msec, mb * 1000.0 / msec);
 	}
 	else if (formatName.toUpper() == tr("STL"))
 	{
@@ -244,8 +265,15 @@ void BaseMeshIOPlugin::open(const QString &formatName, const QString &fileName,
 		}
 
 	}
+	else if (formatName.toUpper() == tr("OBJ") && openParallelOBJ(fileName, m, mask, cb))
+	{
+		// triangulated files are parsed in parallel chunks
+	}
 	else if ((formatName.toUpper() == tr("OBJ")) || (formatName.toUpper() == tr("QOBJ")))
 	{
+		// the vcg importer opens the material libraries relative to the current
+		// directory, shared by the files opened concurrently
+		meshlab::CurrentDirGuard dir(QFileInfo(fileName).absolutePath());
 		tri::io::ImporterOBJ<CMeshO>::Info oi;
 		oi.cb = cb;
 		if (!tri::io::ImporterOBJ<CMeshO>::LoadMask(filename.c_str(), oi)){
@@ -388,6 +416,12 @@ void BaseMeshIOPlugin::open(const QString &formatName, const QString &fileName,
 	if (cb != NULL)	(*cb)(99, "Done");
 }
 
+// the PLY and OBJ importers keep their state in the objects of each open
+bool BaseMeshIOPlugin::isOpenReentrant(const QString& format) const
+{
+	return format.toUpper() == tr("PLY") || format.toUpper() == tr("OBJ");
+}
+
 void BaseMeshIOPlugin::save(const QString &formatName, const QString &fileName, MeshModel &m, const int mask, const RichParameterList & par, CallBackPos *cb)
 {
 	QString errorMsgFormat = "Error encountered while exportering file %1:\n%2";
@@ -409,6 +443,7 @@ void BaseMeshIOPlugin::save(const QString &formatName, const QString &fileName,
 					vcg::ply::T_DOUBLE;
 
 		// custom attributes
+		bool customAttributes = false;
 		for (const RichParameter& pr : par) {
 			QString pname = pr.name();
 			// if pname starts with __CA_VS__, it is a PLY per-vertex scalar custom attribute
@@ -416,6 +451,7 @@ void BaseMeshIOPlugin::save(const QString &formatName, const QString &fileName,
 				std::string attributeName = pname.toStdString().substr(9);
 				if (par.getBool(pname)) {        // if it is true, add to save list
 					pi.addPerVertexScalarAttribute(attributeName, scalarPlyType);
+					customAttributes = true;
 				}
 			}
 			// if pname starts with __CA_VP__, it is a PLY per-vertex point3m custom attribute
@@ -423,6 +459,7 @@ void BaseMeshIOPlugin::save(const QString &formatName, const QString &fileName,
 				std::string attributeName = pname.toStdString().substr(9);
 				if (par.getBool(pname)) {             // if it is true, add to save list
 					pi.addPerVertexPoint3mAttribute(attributeName, scalarPlyType);
+					customAttributes = true;
 				}
 			}
 			// if pname starts with __CA_FS__, it is a PLY per-face scalar custom attribute
@@ -430,6 +467,7 @@ void BaseMeshIOPlugin::save(const QString &formatName, const QString &fileName,
 				std::string attributeName = pname.toStdString().substr(9);
 				if (par.getBool(pname)) {             // if it is true, add to save list
 					pi.addPerFaceScalarAttribute(attributeName, scalarPlyType);
+					customAttributes = true;
 				}
 			}
 			// if pname starts with __CA_FP__, it is a PLY per-face point3m custom attribute
@@ -437,15 +475,33 @@ void BaseMeshIOPlugin::save(const QString &formatName, const QString &fileName,
 				std::string attributeName = pname.toStdString().substr(9);
 				if (par.getBool(pname)) {
 					pi.addPerFacePoint3mAttribute(attributeName, scalarPlyType);
+					customAttributes = true;
 				}
 			}
 		}
 
-		int result = tri::io::ExporterPLY<CMeshO>::Save(m.cm, filename.c_str(), binaryFlag, pi, cb);
-		if (result != 0)
-		{
-			throw MLException(errorMsgFormat.arg(fileName, tri::io::ExporterPLY<CMeshO>::ErrorMsg(result)));
+		QElapsedTimer t;
+		t.start();
+		// custom attributes are written only by the vcg exporter
+		bool fastPath = false;
+		if (binaryFlag && !customAttributes) {
+			try {
+				fastPath = saveBinaryPLY(fileName, m.cm, mask, cb);
+			}
+			catch (const MLException& e) {
+				throw MLException(errorMsgFormat.arg(fileName, e.what()));
+			}
+		}
+		if (!fastPath) {
+			int result = tri::io::ExporterPLY<CMeshO>::Save(m.cm, filename.c_str(), binaryFlag, pi, cb);
+			if (result != 0)
+			{
+				throw MLException(errorMsgFormat.arg(fileName, tri::io::ExporterPLY<CMeshO>::ErrorMsg(result)));
+			}
 		}
+		double mb = QFileInfo(fileName).size() / (1024.0 * 1024.0);
+		int msec = std::max<int>(t.elapsed(), 1);
+		log("Saved %s: %.1f MB in %d msec (%.1f MB/s)", qUtf8Printable(QFileInfo(fileName).fileName()), mb, msec, mb * 1000.0 / msec);
 	}
 	else if (formatName.toUpper() == tr("STL"))
 	{
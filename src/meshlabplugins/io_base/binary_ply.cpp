@@ -0,0 +1,643 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "binary_ply.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <QFile>
+#include <QtEndian>
+
+#include <common/mlexception.h>
+#include <wrap/io_trimesh/io_mask.h>
+
+namespace {
+
+// number of elements decoded (or encoded) between two progress updates
+const long long CHUNK_SIZE = 1 << 20;
+
+enum PlyScalar { P_NONE, P_INT8, P_UINT8, P_INT16, P_UINT16, P_INT32, P_UINT32, P_FLOAT32, P_FLOAT64 };
+
+enum PlyField {
+	F_SKIP,
+	F_X, F_Y, F_Z,
+	F_NX, F_NY, F_NZ,
+	F_RED, F_GREEN, F_BLUE, F_ALPHA,
+	F_QUALITY,
+	F_FLAGS,
+	F_RADIUS,
+	F_U, F_V,
+	F_VERTEX_INDICES
+};
+
+struct PlyProperty
+{
+	PlyScalar type = P_NONE;
+	PlyScalar countType = P_NONE; // only for list properties
+	PlyField field = F_SKIP;
+	size_t offset = 0; // in the record of the element
+};
+
+struct PlyElement
+{
+	QByteArray name;
+	long long count = 0;
+	std::vector<PlyProperty> properties;
+	size_t recordSize = 0;
+	size_t offset = 0; // of the first record, from the beginning of the file
+	int mask = 0;
+};
+
+struct PlyHeader
+{
+	bool swap = false;
+	std::vector<PlyElement> elements;
+	std::vector<std::string> textures;
+};
+
+PlyScalar scalarType(const QByteArray& name)
+{
+	if (name == "char" || name == "int8") return P_INT8;
+	if (name == "uchar" || name == "uint8") return P_UINT8;
+	if (name == "short" || name == "int16") return P_INT16;
+	if (name == "ushort" || name == "uint16") return P_UINT16;
+	if (name == "int" || name == "int32") return P_INT32;
+	if (name == "uint" || name == "uint32") return P_UINT32;
+	if (name == "float" || name == "float32") return P_FLOAT32;
+	if (name == "double" || name == "float64") return P_FLOAT64;
+	return P_NONE;
+}
+
+size_t scalarSize(PlyScalar t)
+{
+	switch (t) {
+	case P_INT8:
+	case P_UINT8: return 1;
+	case P_INT16:
+	case P_UINT16: return 2;
+	case P_INT32:
+	case P_UINT32:
+	case P_FLOAT32: return 4;
+	case P_FLOAT64: return 8;
+	default: return 0;
+	}
+}
+
+bool isFloatingPoint(PlyScalar t)
+{
+	return t == P_FLOAT32 || t == P_FLOAT64;
+}
+
+template <typename T>
+T load(const uchar* p)
+{
+	T v;
+	std::memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+double readScalar(const uchar* p, PlyScalar t, bool swap)
+{
+	uchar b[8];
+	if (swap) {
+		std::reverse_copy(p, p + scalarSize(t), b);
+		p = b;
+	}
+	switch (t) {
+	case P_INT8: return load<qint8>(p);
+	case P_UINT8: return load<quint8>(p);
+	case P_INT16: return load<qint16>(p);
+	case P_UINT16: return load<quint16>(p);
+	case P_INT32: return load<qint32>(p);
+	case P_UINT32: return load<quint32>(p);
+	case P_FLOAT32: return load<float>(p);
+	case P_FLOAT64: return load<double>(p);
+	default: return 0;
+	}
+}
+
+PlyField vertexField(const QByteArray& name)
+{
+	if (name == "x") return F_X;
+	if (name == "y") return F_Y;
+	if (name == "z") return F_Z;
+	if (name == "nx") return F_NX;
+	if (name == "ny") return F_NY;
+	if (name == "nz") return F_NZ;
+	if (name == "red" || name == "diffuse_red") return F_RED;
+	if (name == "green" || name == "diffuse_green") return F_GREEN;
+	if (name == "blue" || name == "diffuse_blue") return F_BLUE;
+	if (name == "alpha") return F_ALPHA;
+	if (name == "quality") return F_QUALITY;
+	if (name == "flags") return F_FLAGS;
+	if (name == "radius") return F_RADIUS;
+	if (name == "texture_u" || name == "u" || name == "s") return F_U;
+	if (name == "texture_v" || name == "v" || name == "t") return F_V;
+	return F_SKIP;
+}
+
+PlyField faceField(const QByteArray& name)
+{
+	if (name == "nx") return F_NX;
+	if (name == "ny") return F_NY;
+	if (name == "nz") return F_NZ;
+	if (name == "red") return F_RED;
+	if (name == "green") return F_GREEN;
+	if (name == "blue") return F_BLUE;
+	if (name == "alpha") return F_ALPHA;
+	if (name == "quality") return F_QUALITY;
+	if (name == "flags") return F_FLAGS;
+	return F_SKIP;
+}
+
+int fieldMask(PlyField f, bool face)
+{
+	using namespace vcg::tri::io;
+	switch (f) {
+	case F_X:
+	case F_Y:
+	case F_Z: return Mask::IOM_VERTCOORD;
+	case F_NX:
+	case F_NY:
+	case F_NZ: return face ? Mask::IOM_FACENORMAL : Mask::IOM_VERTNORMAL;
+	case F_RED:
+	case F_GREEN:
+	case F_BLUE:
+	case F_ALPHA: return face ? Mask::IOM_FACECOLOR : Mask::IOM_VERTCOLOR;
+	case F_QUALITY: return face ? Mask::IOM_FACEQUALITY : Mask::IOM_VERTQUALITY;
+	case F_FLAGS: return face ? Mask::IOM_FACEFLAGS : Mask::IOM_VERTFLAGS;
+	case F_RADIUS: return Mask::IOM_VERTRADIUS;
+	case F_U:
+	case F_V: return Mask::IOM_VERTTEXCOORD;
+	case F_VERTEX_INDICES: return Mask::IOM_FACEINDEX;
+	default: return 0;
+	}
+}
+
+/*
+Parses the header and computes the layout of the elements. Returns false if
+the file is not a binary PLY with a layout supported by the fast path, or if
+it is shorter than the elements declared by its header (checked without
+overflowing on huge counts). The face lists are assumed to be triangles: this
+is checked before decoding.
+*/
+bool parseHeader(const uchar* data, size_t size, PlyHeader& h, size_t& headerSize)
+{
+	const bool littleEndianHost = (Q_BYTE_ORDER == Q_LITTLE_ENDIAN);
+	size_t pos = 0;
+	bool first = true;
+	bool formatFound = false;
+	while (pos < size) {
+		const uchar* end = (const uchar*) std::memchr(data + pos, '\n', size - pos);
+		if (end == nullptr)
+			return false;
+		QByteArray line = QByteArray((const char*) data + pos, int(end - data - pos)).trimmed();
+		pos = end - data + 1;
+		QList<QByteArray> tokens = line.simplified().split(' ');
+		const QByteArray& key = tokens[0];
+
+		if (first) {
+			if (line != "ply")
+				return false;
+			first = false;
+		}
+		else if (key == "format") {
+			if (tokens.size() < 2)
+				return false;
+			if (tokens[1] == "binary_little_endian")
+				h.swap = !littleEndianHost;
+			else if (tokens[1] == "binary_big_endian")
+				h.swap = littleEndianHost;
+			else
+				return false;
+			formatFound = true;
+		}
+		else if (key == "comment") {
+			if (tokens.size() > 2 && tokens[1].toLower() == "texturefile") {
+				int start = line.indexOf(tokens[1]) + tokens[1].size();
+				h.textures.push_back(line.mid(start).trimmed().toStdString());
+			}
+		}
+		else if (key == "obj_info" || key.isEmpty()) {
+		}
+		else if (key == "element") {
+			if (tokens.size() != 3)
+				return false;
+			PlyElement el;
+			el.name = tokens[1];
+			bool ok = false;
+			el.count = tokens[2].toLongLong(&ok);
+			if (!ok || el.count < 0)
+				return false;
+			h.elements.push_back(el);
+		}
+		else if (key == "property") {
+			if (h.elements.empty() || tokens.size() < 3)
+				return false;
+			PlyElement& el = h.elements.back();
+			const bool isVertex = el.name == "vertex";
+			const bool isFace = el.name == "face";
+			PlyProperty p;
+			p.offset = el.recordSize;
+			if (tokens[1] == "list") {
+				if (tokens.size() != 5 || !isFace ||
+					(tokens[4] != "vertex_indices" && tokens[4] != "vertex_index"))
+					return false;
+				p.countType = scalarType(tokens[2]);
+				p.type = scalarType(tokens[3]);
+				if (p.countType == P_NONE || p.type == P_NONE ||
+					isFloatingPoint(p.countType) || isFloatingPoint(p.type))
+					return false;
+				p.field = F_VERTEX_INDICES;
+				el.recordSize += scalarSize(p.countType) + 3 * scalarSize(p.type);
+			}
+			else {
+				p.type = scalarType(tokens[1]);
+				if (p.type == P_NONE)
+					return false;
+				if (isVertex)
+					p.field = vertexField(tokens[2]);
+				else if (isFace)
+					p.field = faceField(tokens[2]);
+				el.recordSize += scalarSize(p.type);
+			}
+			el.mask |= fieldMask(p.field, isFace);
+			el.properties.push_back(p);
+		}
+		else if (key == "end_header") {
+			headerSize = pos;
+			break;
+		}
+		else {
+			return false;
+		}
+	}
+	if (!formatFound || headerSize == 0)
+		return false;
+
+	size_t offset = headerSize;
+	bool hasVertex = false;
+	for (PlyElement& el : h.elements) {
+		if (el.name == "vertex") {
+			if (!(el.mask & vcg::tri::io::Mask::IOM_VERTCOORD))
+				return false;
+			hasVertex = true;
+		}
+		else if (el.name == "face") {
+			if (!(el.mask & vcg::tri::io::Mask::IOM_FACEINDEX))
+				return false;
+		}
+		else if (el.count > 0) {
+			// e.g. edges, tristrips or the camera element
+			return false;
+		}
+		el.offset = offset;
+		// offset <= size holds here: a count larger than the records left in
+		// the file is rejected before it can wrap the product
+		if (el.recordSize > 0 && (unsigned long long) el.count > (size - offset) / el.recordSize)
+			return false;
+		offset += el.count * el.recordSize;
+	}
+	return hasVertex;
+}
+
+const PlyElement* findElement(const PlyHeader& h, const char* name)
+{
+	for (const PlyElement& el : h.elements)
+		if (el.name == name)
+			return &el;
+	return nullptr;
+}
+
+unsigned char colorComponent(double v, PlyScalar t)
+{
+	if (isFloatingPoint(t))
+		v *= 255.0;
+	return (unsigned char) std::min(std::max(v, 0.0), 255.0);
+}
+
+void decodeVertex(const uchar* rec, const PlyElement& el, bool swap, CVertexO& v)
+{
+	if (el.mask & vcg::tri::io::Mask::IOM_VERTCOLOR)
+		v.C() = vcg::Color4b(0, 0, 0, 255);
+	for (const PlyProperty& p : el.properties) {
+		if (p.field == F_SKIP)
+			continue;
+		const double val = readScalar(rec + p.offset, p.type, swap);
+		switch (p.field) {
+		case F_X: v.P()[0] = val; break;
+		case F_Y: v.P()[1] = val; break;
+		case F_Z: v.P()[2] = val; break;
+		case F_NX: v.N()[0] = val; break;
+		case F_NY: v.N()[1] = val; break;
+		case F_NZ: v.N()[2] = val; break;
+		case F_RED: v.C()[0] = colorComponent(val, p.type); break;
+		case F_GREEN: v.C()[1] = colorComponent(val, p.type); break;
+		case F_BLUE: v.C()[2] = colorComponent(val, p.type); break;
+		case F_ALPHA: v.C()[3] = colorComponent(val, p.type); break;
+		case F_QUALITY: v.Q() = val; break;
+		case F_FLAGS: v.Flags() = int(val); break;
+		case F_RADIUS: v.R() = val; break;
+		case F_U: v.T().U() = val; v.T().N() = 0; break;
+		case F_V: v.T().V() = val; v.T().N() = 0; break;
+		default: break;
+		}
+	}
+}
+
+// the vertex indices must have been checked by validIndices
+void decodeFace(const uchar* rec, const PlyElement& el, bool swap, CMeshO& m, size_t firstVert, CFaceO& f)
+{
+	if (el.mask & vcg::tri::io::Mask::IOM_FACECOLOR)
+		f.C() = vcg::Color4b(0, 0, 0, 255);
+	for (const PlyProperty& p : el.properties) {
+		if (p.field == F_SKIP)
+			continue;
+		if (p.field == F_VERTEX_INDICES) {
+			const uchar* item = rec + p.offset + scalarSize(p.countType);
+			for (int j = 0; j < 3; ++j) {
+				long long idx = (long long) readScalar(item + j * scalarSize(p.type), p.type, swap);
+				f.V(j) = &m.vert[firstVert + idx];
+			}
+			continue;
+		}
+		const double val = readScalar(rec + p.offset, p.type, swap);
+		switch (p.field) {
+		case F_NX: f.N()[0] = val; break;
+		case F_NY: f.N()[1] = val; break;
+		case F_NZ: f.N()[2] = val; break;
+		case F_RED: f.C()[0] = colorComponent(val, p.type); break;
+		case F_GREEN: f.C()[1] = colorComponent(val, p.type); break;
+		case F_BLUE: f.C()[2] = colorComponent(val, p.type); break;
+		case F_ALPHA: f.C()[3] = colorComponent(val, p.type); break;
+		case F_QUALITY: f.Q() = val; break;
+		case F_FLAGS: f.Flags() = int(val); break;
+		default: break;
+		}
+	}
+}
+
+const PlyProperty* indexList(const PlyElement& el)
+{
+	const PlyProperty* list = nullptr;
+	for (const PlyProperty& p : el.properties)
+		if (p.field == F_VERTEX_INDICES)
+			list = &p;
+	return list;
+}
+
+// checks that all the faces are triangles, i.e. that the fixed record size is right
+bool allTriangles(const uchar* data, const PlyElement& el, bool swap)
+{
+	const PlyProperty* list = indexList(el);
+	const long long n = el.count;
+	std::atomic<bool> ok(true);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < n; ++i) {
+		const uchar* rec = data + el.offset + i * el.recordSize;
+		if (readScalar(rec + list->offset, list->countType, swap) != 3)
+			ok = false;
+	}
+	return ok;
+}
+
+// checks that all the faces refer to existing vertices, before the mesh grows
+bool validIndices(const uchar* data, const PlyElement& el, bool swap, long long vn)
+{
+	const PlyProperty* list = indexList(el);
+	const size_t itemSize = scalarSize(list->type);
+	const long long n = el.count;
+	std::atomic<bool> ok(true);
+#pragma omp parallel for schedule(static)
+	for (long long i = 0; i < n; ++i) {
+		const uchar* item = data + el.offset + i * el.recordSize + list->offset + scalarSize(list->countType);
+		for (int j = 0; j < 3; ++j) {
+			long long idx = (long long) readScalar(item + j * itemSize, list->type, swap);
+			if (idx < 0 || idx >= vn)
+				ok = false;
+		}
+	}
+	return ok;
+}
+
+template <typename T>
+void store(std::vector<char>& buf, size_t& pos, T v)
+{
+	std::memcpy(buf.data() + pos, &v, sizeof(T));
+	pos += sizeof(T);
+}
+
+void progress(vcg::CallBackPos* cb, long long done, long long total, const char* msg)
+{
+	if (cb != nullptr && total > 0)
+		cb(int(100 * done / total), msg);
+}
+
+} // namespace
+
+bool openBinaryPLY(
+		const QString& fileName,
+		MeshModel& m,
+		int& mask,
+		vcg::CallBackPos* cb)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	const size_t size = file.size();
+	// the mapping is released when the file is destroyed
+	const uchar* data = file.map(0, size);
+	if (data == nullptr)
+		return false;
+
+	PlyHeader h;
+	size_t headerSize = 0;
+	if (!parseHeader(data, size, h, headerSize))
+		return false;
+	// a truncated file (rejected by parseHeader), or one with polygons, is
+	// left to the vcg importer; the faces are all checked before the mesh grows
+	const PlyElement* vertEl = findElement(h, "vertex");
+	const PlyElement* faceEl = findElement(h, "face");
+	if (faceEl != nullptr && !allTriangles(data, *faceEl, h.swap))
+		return false;
+	if (faceEl != nullptr && !validIndices(data, *faceEl, h.swap, vertEl->count))
+		throw MLException("Bad vertex index in face");
+
+	mask = vertEl->mask | (faceEl != nullptr ? faceEl->mask : 0);
+	m.enable(mask);
+	CMeshO& cm = m.cm;
+
+	const long long vn = vertEl->count;
+	const long long fn = faceEl != nullptr ? faceEl->count : 0;
+	const long long total = vn + fn;
+	const size_t firstVert = cm.vert.size();
+	const size_t firstFace = cm.face.size();
+	vcg::tri::Allocator<CMeshO>::AddVertices(cm, vn);
+	vcg::tri::Allocator<CMeshO>::AddFaces(cm, fn);
+
+	for (long long begin = 0; begin < vn; begin += CHUNK_SIZE) {
+		const long long end = std::min(begin + CHUNK_SIZE, vn);
+#pragma omp parallel for schedule(static)
+		for (long long i = begin; i < end; ++i)
+			decodeVertex(data + vertEl->offset + i * vertEl->recordSize, *vertEl, h.swap, cm.vert[firstVert + i]);
+		progress(cb, end, total, "Loading Vertices");
+	}
+
+	for (long long begin = 0; begin < fn; begin += CHUNK_SIZE) {
+		const long long end = std::min(begin + CHUNK_SIZE, fn);
+#pragma omp parallel for schedule(static)
+		for (long long i = begin; i < end; ++i)
+			decodeFace(data + faceEl->offset + i * faceEl->recordSize, *faceEl, h.swap, cm, firstVert, cm.face[firstFace + i]);
+		progress(cb, vn + end, total, "Loading Faces");
+	}
+
+	cm.textures.insert(cm.textures.end(), h.textures.begin(), h.textures.end());
+	return true;
+}
+
+bool saveBinaryPLY(
+		const QString& fileName,
+		const CMeshO& m,
+		int mask,
+		vcg::CallBackPos* cb)
+{
+	using namespace vcg::tri::io;
+	const int supported =
+		Mask::IOM_VERTCOORD | Mask::IOM_VERTNORMAL | Mask::IOM_VERTCOLOR | Mask::IOM_VERTQUALITY |
+		Mask::IOM_VERTRADIUS | Mask::IOM_VERTTEXCOORD | Mask::IOM_FACEINDEX | Mask::IOM_FACECOLOR |
+		Mask::IOM_FACEQUALITY;
+	if ((mask & ~supported) != 0 || m.en > 0)
+		return false;
+
+	const bool vNormal = mask & Mask::IOM_VERTNORMAL;
+	const bool vColor = mask & Mask::IOM_VERTCOLOR;
+	const bool vQuality = mask & Mask::IOM_VERTQUALITY;
+	const bool vRadius = mask & Mask::IOM_VERTRADIUS;
+	const bool vTex = mask & Mask::IOM_VERTTEXCOORD;
+	const bool fColor = mask & Mask::IOM_FACECOLOR;
+	const bool fQuality = mask & Mask::IOM_FACEQUALITY;
+
+	const QByteArray scalar = sizeof(Scalarm) == sizeof(float) ? "float" : "double";
+	QByteArray header = "ply\n";
+	header += Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n";
+	header += "comment MeshLab generated\n";
+	for (const std::string& t : m.textures)
+		header += "comment TextureFile " + QByteArray::fromStdString(t) + "\n";
+	header += "element vertex " + QByteArray::number(m.vn) + "\n";
+	header += "property " + scalar + " x\nproperty " + scalar + " y\nproperty " + scalar + " z\n";
+	if (vNormal)
+		header += "property " + scalar + " nx\nproperty " + scalar + " ny\nproperty " + scalar + " nz\n";
+	if (vColor)
+		header += "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n";
+	if (vQuality)
+		header += "property " + scalar + " quality\n";
+	if (vRadius)
+		header += "property " + scalar + " radius\n";
+	if (vTex)
+		header += "property " + scalar + " texture_u\nproperty " + scalar + " texture_v\n";
+	header += "element face " + QByteArray::number(m.fn) + "\n";
+	header += "property list uchar int vertex_indices\n";
+	if (fColor)
+		header += "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n";
+	if (fQuality)
+		header += "property " + scalar + " quality\n";
+	header += "end_header\n";
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		throw MLException("Unable to open file for writing");
+	if (file.write(header) != header.size())
+		throw MLException("Error while writing the file");
+
+	const size_t vStride = sizeof(Scalarm) * (3 + (vNormal ? 3 : 0) + (vQuality ? 1 : 0) + (vRadius ? 1 : 0) + (vTex ? 2 : 0)) +
+			(vColor ? 4 : 0);
+	const size_t fStride = 1 + 3 * sizeof(qint32) + (fColor ? 4 : 0) + (fQuality ? sizeof(Scalarm) : 0);
+	const long long total = (long long) (m.vert.size() + m.face.size());
+
+	// indices of the vertices in the file, deleted vertices are skipped
+	std::vector<qint32> remap(m.vert.size(), -1);
+	qint32 k = 0;
+	for (size_t i = 0; i < m.vert.size(); ++i)
+		if (!m.vert[i].IsD())
+			remap[i] = k++;
+
+	std::vector<char> buf;
+	std::vector<size_t> live;
+	const long long vertSize = m.vert.size();
+	for (long long begin = 0; begin < vertSize; begin += CHUNK_SIZE) {
+		const long long end = std::min(begin + CHUNK_SIZE, vertSize);
+		live.clear();
+		for (long long i = begin; i < end; ++i)
+			if (!m.vert[i].IsD())
+				live.push_back(i);
+		buf.resize(live.size() * vStride);
+		const long long n = live.size();
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < n; ++i) {
+			const CVertexO& v = m.vert[live[i]];
+			size_t pos = i * vStride;
+			for (int j = 0; j < 3; ++j) store(buf, pos, (Scalarm) v.cP()[j]);
+			if (vNormal)
+				for (int j = 0; j < 3; ++j) store(buf, pos, (Scalarm) v.cN()[j]);
+			if (vColor)
+				for (int j = 0; j < 4; ++j) store(buf, pos, (quint8) v.cC()[j]);
+			if (vQuality) store(buf, pos, (Scalarm) v.cQ());
+			if (vRadius) store(buf, pos, (Scalarm) v.cR());
+			if (vTex) {
+				store(buf, pos, (Scalarm) v.cT().U());
+				store(buf, pos, (Scalarm) v.cT().V());
+			}
+		}
+		if (file.write(buf.data(), buf.size()) != (qint64) buf.size())
+			throw MLException("Error while writing the file");
+		progress(cb, end, total, "Saving Vertices");
+	}
+
+	const long long faceSize = m.face.size();
+	for (long long begin = 0; begin < faceSize; begin += CHUNK_SIZE) {
+		const long long end = std::min(begin + CHUNK_SIZE, faceSize);
+		live.clear();
+		for (long long i = begin; i < end; ++i)
+			if (!m.face[i].IsD())
+				live.push_back(i);
+		buf.resize(live.size() * fStride);
+		const long long n = live.size();
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < n; ++i) {
+			const CFaceO& f = m.face[live[i]];
+			size_t pos = i * fStride;
+			store(buf, pos, (quint8) 3);
+			for (int j = 0; j < 3; ++j)
+				store(buf, pos, remap[f.cV(j) - &m.vert[0]]);
+			if (fColor)
+				for (int j = 0; j < 4; ++j) store(buf, pos, (quint8) f.cC()[j]);
+			if (fQuality) store(buf, pos, (Scalarm) f.cQ());
+		}
+		if (file.write(buf.data(), buf.size()) != (qint64) buf.size())
+			throw MLException("Error while writing the file");
+		progress(cb, vertSize + end, total, "Saving Faces");
+	}
+	return true;
+}
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef BINARY_PLY_H
+#define BINARY_PLY_H
+
+#include <common/ml_document/mesh_model.h>
+
+/*
+Fast path for binary PLY files.
+
+The file is memory mapped and the vertex and face blocks are decoded in
+parallel chunks directly into the CMeshO containers. Only the common layout
+is handled (a vertex element with scalar properties and a face element made
+of triangles); these functions return false for anything else, and the
+caller should fall back to the vcg importer/exporter.
+*/
+
+/**
+ * @brief Loads a binary PLY file. Returns false, without touching the mesh,
+ * if the file is not supported by the fast path or is shorter than its
+ * header declares; throws an MLException, also without touching the mesh,
+ * if a face refers to a vertex that does not exist.
+ */
+bool openBinaryPLY(
+		const QString& fileName,
+		MeshModel& m,
+		int& mask,
+		vcg::CallBackPos* cb);
+
+/**
+ * @brief Saves the mesh as a binary PLY file, streaming the encoded
+ * elements to disk. Returns false, without writing anything, if the mask
+ * requires data not supported by the fast path.
+ */
+bool saveBinaryPLY(
+		const QString& fileName,
+		const CMeshO& m,
+		int mask,
+		vcg::CallBackPos* cb);
+
+#endif // BINARY_PLY_H
@@ -1,5 +1,7 @@
 #include "load_project.h"
 
+#include <algorithm>
+
 #include <QDir>
 
 #include <wrap/io_trimesh/alnParser.h>
@@ -10,6 +12,40 @@
 #include <common/ml_document/mesh_document.h>
 #include <common/utilities/load_save.h>
 
+namespace {
+
+/*
+Adds to the current raster a paged plane of the image in fileName: the image
+is not decoded here, but on the first access by the RasterPager, so that
+opening a project keeps in memory only the cameras of its rasters. Only the
+existence of the file is checked; an image that cannot be decoded is
+replaced by a dummy image when accessed. The path is made absolute, since
+the image will be decoded after the current directory has been restored.
+*/
+void addPagedPlane(
+		MeshDocument& md,
+		const QString& fileName,
+		std::vector<std::string>& unloadedImgList)
+{
+	QFileInfo fi(fileName);
+	if (!fi.isReadable())
+		unloadedImgList.push_back(fileName.toStdString());
+	md.rm()->addPlane(new RasterPlane(fi.absoluteFilePath(), RasterPlane::RGBA));
+}
+
+/// a layer of a MeshGroup of an MLP project
+struct MLPMeshEntry
+{
+	QString label;
+	bool visible;
+	int idInFile;
+	int file; // index of the file containing the layer, in the files of its MeshGroup
+	bool hasTransform;
+	Matrix44m transform;
+};
+
+} // namespace
+
 std::vector<MeshModel*> loadALN(
 		const QString& filename,
 		MeshDocument& md,
@@ -22,24 +58,21 @@ std::vector<MeshModel*> loadALN(
 		throw MLException("Unable to open ALN file");
 	}
 	QFileInfo fi(filename);
-	QString curr_path = QDir::currentPath();
-	QDir::setCurrent(fi.absolutePath());
-
-	for(const RangeMap& rm : rmv) {
-		QString relativeToProj = fi.absoluteDir().absolutePath() + "/" + rm.filename.c_str();
-		try {
-			std::list<MeshModel*> tmp =
-					meshlab::loadMeshWithStandardParameters(relativeToProj, md, cb);
-			md.mm()->cm.Tr.Import(rm.transformation);
-			meshList.insert(meshList.end(), tmp.begin(), tmp.end());
-		}
-		catch (const MLException& e){
-			for (const MeshModel* m : meshList)
-				md.delMesh(m->id());
-			throw e;
-		}
+
+	// absolute paths: the current directory must not be held while loading,
+	// since the loading threads can need it (see CurrentDirGuard)
+	QStringList files;
+	for(const RangeMap& rm : rmv)
+		files.push_back(fi.absoluteDir().absoluteFilePath(QString::fromStdString(rm.filename)));
+
+	// the files are loaded concurrently, the layers are in the order of the ALN
+	std::vector<std::list<MeshModel*>> loaded =
+		meshlab::loadMeshesWithStandardParameters(files, md, cb);
+	for(size_t i = 0; i < rmv.size(); ++i) {
+		for (MeshModel* m : loaded[i])
+			m->cm.Tr.Import(rmv[i].transformation);
+		meshList.insert(meshList.end(), loaded[i].begin(), loaded[i].end());
 	}
-	QDir::setCurrent(curr_path);
 	return meshList;
 }
 
@@ -62,9 +95,8 @@ std::vector<MeshModel*> loadOUT(
 	vcg::tri::io::ImporterOUT<CMeshO>::Open(newMesh->cm, shots, image_filenames, qUtf8Printable(filename), qUtf8Printable(imageListFile));
 	newMesh->updateDataMask(MeshModel::MM_VERTCOLOR);
 
-	QString curr_path = QDir::currentPath();
 	QFileInfo imi(imageListFile);
-	QDir::setCurrent(imi.absoluteDir().absolutePath());
+	meshlab::CurrentDirGuard dir(imi.absoluteDir().absolutePath());
 	//
 	QStringList image_filenames_q;
 	for(unsigned int i  = 0; i < image_filenames.size(); ++i)
@@ -82,15 +114,7 @@ std::vector<MeshModel*> loadOUT(
 		md.addNewRaster();
 		const QString fullpath_image_filename = image_filenames_q[int(i)];
 
-		QImage img(":/img/dummy.png");
-		try {
-			img = meshlab::loadImage(fullpath_image_filename);
-		}
-		catch(const MLException& e){
-			unloadedImgList.push_back(fullpath_image_filename.toStdString());
-		}
-
-		md.rm()->addPlane(new RasterPlane(img, fullpath_image_filename, RasterPlane::RGBA));
+		addPagedPlane(md, fullpath_image_filename, unloadedImgList);
 		int count=fullpath_image_filename.count('\\');
 		if (count==0)
 		{
@@ -101,7 +125,6 @@ std::vector<MeshModel*> loadOUT(
 			md.rm()->setLabel(fullpath_image_filename.section('\\',count,1));
 		md.rm()->shot = shots[i];
 	}
-	QDir::setCurrent(curr_path);
 
 	meshList.push_back(newMesh);
 
@@ -126,9 +149,7 @@ std::vector<MeshModel*> loadNVM(
 	vcg::tri::io::ImporterNVM<CMeshO>::Open(md.mm()->cm,shots,image_filenames, qUtf8Printable(filename));
 	md.mm()->updateDataMask(MeshModel::MM_VERTCOLOR);
 
-	QString curr_path = QDir::currentPath();
-
-	QDir::setCurrent(fi.absolutePath());
+	meshlab::CurrentDirGuard dir(fi.absolutePath());
 	QStringList image_filenames_q;
 	for(size_t i  = 0; i < image_filenames.size(); ++i)
 		image_filenames_q.push_back(QString::fromStdString(image_filenames[int(i)]));
@@ -136,19 +157,10 @@ std::vector<MeshModel*> loadNVM(
 	for(size_t i=0 ; i<shots.size() ; i++){
 		md.addNewRaster();
 		const QString fullpath_image_filename = image_filenames_q[int(i)];
-		QImage img(":/img/dummy.png");
-		try {
-			img = meshlab::loadImage(fullpath_image_filename);
-		}
-		catch(const MLException& e){
-			unloadedImgList.push_back(fullpath_image_filename.toStdString());
-		}
-
-		md.rm()->addPlane(new RasterPlane(fullpath_image_filename,RasterPlane::RGBA));
+		addPagedPlane(md, fullpath_image_filename, unloadedImgList);
 		md.rm()->setLabel(image_filenames_q[int(i)].section('/',1,2));
 		md.rm()->shot = shots[int(i)];
 	}
-	QDir::setCurrent(curr_path);
 
 	meshList.push_back(newMesh);
 
@@ -160,7 +172,7 @@ std::vector<MeshModel*> loadMLP(
 		MeshDocument& md,
 		std::vector<MLRenderingData>& rendOpt,
 		std::vector<std::string>& unloadedImgList,
-		vcg::CallBackPos*)
+		vcg::CallBackPos* cb)
 {
 	std::vector<MeshModel*> meshList;
 	unloadedImgList.clear();
@@ -183,53 +195,50 @@ std::vector<MeshModel*> loadMLP(
 
 	node = root.firstChild();
 
-	QDir tmpDir = QDir::current();
-	QDir::setCurrent(qfInfo.absoluteDir().absolutePath());
+	// the files of the project are resolved against its folder, without
+	// changing the current directory: the threads loading the meshes can need
+	// it (see CurrentDirGuard)
+	const QDir projectDir = qfInfo.absoluteDir();
 	//Devices
 	while (!node.isNull()) {
 		if (QString::compare(node.nodeName(), "MeshGroup") == 0) {
+			// the files of the group are loaded together, concurrently, and
+			// then the entries are applied to their meshes
+			QStringList files;
+			std::vector<MLPMeshEntry> entries;
 			QDomNode mesh;
-			QString filen, label;
+			QString filen;
 			mesh = node.firstChild();
 			while (!mesh.isNull()) {
 				//return true;
+				MLPMeshEntry entry;
 				filen = mesh.attributes().namedItem("filename").nodeValue();
-				label = mesh.attributes().namedItem("label").nodeValue();
-				bool visible = true;
+				entry.label = mesh.attributes().namedItem("label").nodeValue();
+				entry.visible = true;
 				if (mesh.attributes().contains("visible"))
-					visible = (mesh.attributes().namedItem("visible").nodeValue().toInt() == 1);
-				//MeshModel* mm = md.addNewMesh(filen, label);
-
-				//mm->visible = visible;
+					entry.visible = (mesh.attributes().namedItem("visible").nodeValue().toInt() == 1);
 
-				int idInFile = -1;
+				entry.idInFile = -1;
 				if (mesh.attributes().contains("idInFile")){
-					idInFile = mesh.attributes().namedItem("idInFile").nodeValue().toInt();
+					entry.idInFile = mesh.attributes().namedItem("idInFile").nodeValue().toInt();
 				}
-				if (idInFile <= 0){
+				if (entry.idInFile <= 0){
 					//load the file just if it is the first layer contained
 					//in the file (or it is the only one)
-					try {
-						auto tmp = meshlab::loadMeshWithStandardParameters(filen, md);
-						for (auto m : tmp){
-							m->setVisible(visible);
-							m->setLabel(label);
-						}
-						meshList.insert(meshList.end(), tmp.begin(), tmp.end());
-					}
-					catch(const MLException& e) {
-						for (MeshModel* mm : meshList)
-							md.delMesh(mm->id());
-						throw MLException(filen + " mesh file not found.");
-					}
+					files.push_back(projectDir.absoluteFilePath(filen));
 				}
+				// the other layers of a file follow its first one
+				entry.file = files.size() - 1;
 
+				entry.hasTransform = false;
+				entry.transform.SetIdentity();
 				QDomNode tr = mesh.firstChildElement("MLMatrix44");
 
 				if (!tr.isNull()) {
 					if (tr.childNodes().size() == 1) {
+						entry.hasTransform = true;
 						if (!binary) {
-							Scalarm* v = md.mm()->cm.Tr.V();
+							Scalarm* v = entry.transform.V();
 							const QStringList rows = tr.firstChild().nodeValue().split("\n", Qt::SkipEmptyParts);
 							unsigned int i = 0;
 							for (const QString& row: rows) {
@@ -243,10 +252,11 @@ std::vector<MeshModel*> loadMLP(
 						else {
 							QString str = tr.firstChild().nodeValue();
 							QByteArray value = QByteArray::fromBase64(str.toLocal8Bit());
-							memcpy(md.mm()->cm.Tr.V(), value.data(), sizeof(Matrix44m::ScalarType) * 16);
+							memcpy(entry.transform.V(), value.data(), sizeof(Matrix44m::ScalarType) * 16);
 						}
 					}
 				}
+				entries.push_back(entry);
 
 				QDomNode renderingOpt = mesh.firstChildElement("RenderingOption");
 				if (!renderingOpt.isNull())
@@ -285,6 +295,36 @@ std::vector<MeshModel*> loadMLP(
 
 				mesh = mesh.nextSibling();
 			}
+
+			std::vector<std::list<MeshModel*>> loaded;
+			try {
+				loaded = meshlab::loadMeshesWithStandardParameters(files, md, cb);
+			}
+			catch(const MLException&) {
+				for (MeshModel* mm : meshList)
+					md.delMesh(mm->id());
+				throw;
+			}
+			for (const MLPMeshEntry& entry : entries) {
+				if (entry.file < 0 || loaded[entry.file].empty())
+					continue;
+				const std::list<MeshModel*>& fileMeshes = loaded[entry.file];
+				if (entry.idInFile <= 0) {
+					for (MeshModel* m : fileMeshes) {
+						m->setVisible(entry.visible);
+						m->setLabel(entry.label);
+					}
+					meshList.insert(meshList.end(), fileMeshes.begin(), fileMeshes.end());
+				}
+				auto it = fileMeshes.begin();
+				std::advance(it, std::min(std::max(entry.idInFile, 0), (int) fileMeshes.size() - 1));
+				if (entry.idInFile > 0) {
+					(*it)->setVisible(entry.visible);
+					(*it)->setLabel(entry.label);
+				}
+				if (entry.hasTransform)
+					(*it)->cm.Tr = entry.transform;
+			}
 		}
 		// READ IN POINT CORRESPONDECES INCOMPLETO!!
 		else if (QString::compare(node.nodeName(), "RasterGroup") == 0)
@@ -304,16 +344,7 @@ std::vector<MeshModel*> loadMLP(
 				while (!el.isNull())
 				{
 					QString filen = el.attribute("fileName");
-					QFileInfo fi(filen);
-					QString nm = fi.absoluteFilePath();
-					QImage img(":/img/dummy.png");
-					try {
-						img = meshlab::loadImage(nm);
-					}
-					catch(const MLException& e){
-						unloadedImgList.push_back(nm.toStdString());
-					}
-					md.rm()->addPlane(new RasterPlane(img, nm, RasterPlane::RGBA));
+					addPagedPlane(md, projectDir.absoluteFilePath(filen), unloadedImgList);
 					el = node.nextSiblingElement("Plane");
 				}
 				raster = raster.nextSibling();
@@ -322,7 +353,6 @@ std::vector<MeshModel*> loadMLP(
 		node = node.nextSibling();
 	}
 
-	QDir::setCurrent(tmpDir.absolutePath());
 	qf.close();
 
 	if (rendOpt.size() != meshList.size()){
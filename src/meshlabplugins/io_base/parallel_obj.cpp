@@ -0,0 +1,499 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#include "parallel_obj.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QTextStream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <common/mlexception.h>
+#include <common/ml_document/texture_cache.h>
+#include <wrap/io_trimesh/io_mask.h>
+
+namespace {
+
+// minimum size of the chunks parsed by each thread
+const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+// marks a texture coordinate or a normal not given for a face vertex
+const long long NO_INDEX = LLONG_MIN;
+
+// indices relative to the chunk (i.e. negative OBJ indices) are shifted by
+// this value, so that they can be told apart from the global ones
+const long long RELATIVE_INDEX = 1LL << 40;
+
+struct Material
+{
+	vcg::Color4b color = vcg::Color4b(255, 255, 255, 255);
+	int texture = -1;
+};
+
+// the records parsed from a chunk of the file
+struct ObjChunk
+{
+	std::vector<Point3m> verts;
+	std::vector<vcg::Color4b> vertColors;
+	std::vector<vcg::Point2f> texCoords;
+	std::vector<Point3m> normals;
+	// three indices per face, see encodeIndex
+	std::vector<long long> faceVerts;
+	std::vector<long long> faceTexCoords;
+	std::vector<long long> faceNormals;
+	// the usemtl records: first face of the chunk using the material, and its name
+	std::vector<std::pair<size_t, std::string>> materials;
+	std::vector<std::string> mtlLibs;
+	bool hasVertColors = false;
+	bool hasFaceTexCoords = false;
+	bool hasFaceNormals = false;
+	bool supported = true;
+};
+
+long long encodeIndex(long i, size_t localCount)
+{
+	if (i > 0)
+		return i - 1;
+	if (i < 0)
+		return (long long) localCount + i - RELATIVE_INDEX;
+	return -1; // not valid, 0 is not an OBJ index
+}
+
+long long decodeIndex(long long i, size_t chunkBase)
+{
+	if (i < -RELATIVE_INDEX / 2)
+		return (long long) chunkBase + i + RELATIVE_INDEX;
+	return i;
+}
+
+void skipBlanks(const char*& p, const char* le)
+{
+	while (p < le && (*p == ' ' || *p == '\t'))
+		++p;
+}
+
+// the checks on le avoid strtod/strtol skipping the end of the line
+bool nextNumber(const char*& p, const char* le, double& v)
+{
+	skipBlanks(p, le);
+	if (p >= le || *p == '\r')
+		return false;
+	char* e;
+	v = std::strtod(p, &e);
+	if (e == p)
+		return false;
+	p = e;
+	return true;
+}
+
+bool nextInteger(const char*& p, const char* le, long& v)
+{
+	if (p >= le || !(std::isdigit((unsigned char) *p) || *p == '-' || *p == '+'))
+		return false;
+	char* e;
+	v = std::strtol(p, &e, 10);
+	if (e == p)
+		return false;
+	p = e;
+	return true;
+}
+
+std::string nextWord(const char*& p, const char* le)
+{
+	skipBlanks(p, le);
+	const char* b = p;
+	while (p < le && *p != '\r')
+		++p;
+	return std::string(b, p - b);
+}
+
+// parses a v, v/t, v//n or v/t/n token of a face
+bool nextFaceVertex(const char*& p, const char* le, long& v, long& t, long& n)
+{
+	skipBlanks(p, le);
+	t = n = 0;
+	if (!nextInteger(p, le, v))
+		return false;
+	if (p < le && *p == '/') {
+		++p;
+		nextInteger(p, le, t);
+		if (p < le && *p == '/') {
+			++p;
+			nextInteger(p, le, n);
+		}
+	}
+	return true;
+}
+
+void parseLine(const char* p, const char* le, ObjChunk& c)
+{
+	skipBlanks(p, le);
+	if (p >= le)
+		return;
+	const char* key = p;
+	while (p < le && *p != ' ' && *p != '\t' && *p != '\r')
+		++p;
+	const size_t keyLen = p - key;
+
+	if (keyLen == 1 && key[0] == 'v') {
+		double x = 0, y = 0, z = 0, r, g, b;
+		nextNumber(p, le, x);
+		nextNumber(p, le, y);
+		nextNumber(p, le, z);
+		c.verts.push_back(Point3m(x, y, z));
+		if (nextNumber(p, le, r) && nextNumber(p, le, g) && nextNumber(p, le, b)) {
+			// colors can be given in [0, 1] or in [0, 255]
+			const double s = (r <= 1 && g <= 1 && b <= 1) ? 255.0 : 1.0;
+			c.vertColors.push_back(vcg::Color4b(
+				(unsigned char) std::min(std::max(r * s, 0.0), 255.0),
+				(unsigned char) std::min(std::max(g * s, 0.0), 255.0),
+				(unsigned char) std::min(std::max(b * s, 0.0), 255.0),
+				255));
+			c.hasVertColors = true;
+		}
+		else {
+			c.vertColors.push_back(vcg::Color4b(vcg::Color4b::White));
+		}
+	}
+	else if (keyLen == 2 && key[0] == 'v' && key[1] == 't') {
+		double u = 0, v = 0;
+		nextNumber(p, le, u);
+		nextNumber(p, le, v);
+		c.texCoords.push_back(vcg::Point2f(u, v));
+	}
+	else if (keyLen == 2 && key[0] == 'v' && key[1] == 'n') {
+		double x = 0, y = 0, z = 0;
+		nextNumber(p, le, x);
+		nextNumber(p, le, y);
+		nextNumber(p, le, z);
+		c.normals.push_back(Point3m(x, y, z));
+	}
+	else if (keyLen == 1 && key[0] == 'f') {
+		long v, t, n;
+		int count = 0;
+		while (nextFaceVertex(p, le, v, t, n)) {
+			if (++count > 3) {
+				// polygons are triangulated by the vcg importer
+				c.supported = false;
+				return;
+			}
+			c.faceVerts.push_back(encodeIndex(v, c.verts.size()));
+			c.faceTexCoords.push_back(t != 0 ? encodeIndex(t, c.texCoords.size()) : NO_INDEX);
+			c.faceNormals.push_back(n != 0 ? encodeIndex(n, c.normals.size()) : NO_INDEX);
+			c.hasFaceTexCoords |= (t != 0);
+			c.hasFaceNormals |= (n != 0);
+		}
+		if (count != 3)
+			c.supported = false;
+	}
+	else if (keyLen == 6 && std::strncmp(key, "usemtl", 6) == 0) {
+		c.materials.push_back(std::make_pair(c.faceVerts.size() / 3, nextWord(p, le)));
+	}
+	else if (keyLen == 6 && std::strncmp(key, "mtllib", 6) == 0) {
+		c.mtlLibs.push_back(nextWord(p, le));
+	}
+	else if (keyLen == 1 && (key[0] == 'l' || key[0] == 'p')) {
+		// lines and points
+		c.supported = false;
+	}
+	// comments, groups, objects and smoothing groups are ignored
+}
+
+void parseChunk(const char* begin, const char* end, ObjChunk& c)
+{
+	const char* p = begin;
+	while (p < end && c.supported) {
+		const char* le = (const char*) std::memchr(p, '\n', end - p);
+		if (le == nullptr)
+			le = end;
+		parseLine(p, le, c);
+		p = le + 1;
+	}
+}
+
+/*
+Loads the materials of a MTL file, adding the names of their textures to
+the given list.
+*/
+void loadMTL(
+		const QString& path,
+		std::map<std::string, int>& materialIndex,
+		std::vector<Material>& materials,
+		std::vector<std::string>& textures)
+{
+	QFile f(path);
+	if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+		return;
+	QTextStream stream(&f);
+	Material* current = nullptr;
+	while (!stream.atEnd()) {
+		QString line = stream.readLine().trimmed();
+		QStringList tokens = line.split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+		if (tokens.isEmpty())
+			continue;
+		if (tokens[0] == "newmtl" && tokens.size() > 1) {
+			std::string name = line.mid(6).trimmed().toStdString();
+			auto it = materialIndex.find(name);
+			if (it == materialIndex.end()) {
+				it = materialIndex.insert(std::make_pair(name, (int) materials.size())).first;
+				materials.push_back(Material());
+			}
+			current = &materials[it->second];
+		}
+		else if (current == nullptr) {
+			continue;
+		}
+		else if (tokens[0] == "Kd" && tokens.size() > 3) {
+			for (int i = 0; i < 3; ++i)
+				current->color[i] = (unsigned char) std::min(std::max(tokens[i + 1].toDouble() * 255.0, 0.0), 255.0);
+		}
+		else if (tokens[0] == "d" && tokens.size() > 1) {
+			current->color[3] = (unsigned char) std::min(std::max(tokens[1].toDouble() * 255.0, 0.0), 255.0);
+		}
+		else if (tokens[0] == "map_Kd" && tokens.size() > 1) {
+			// the options of the map (if any) come before the file name
+			std::string name = tokens.back().toStdString();
+			auto it = std::find(textures.begin(), textures.end(), name);
+			current->texture = it - textures.begin();
+			if (it == textures.end())
+				textures.push_back(name);
+		}
+	}
+}
+
+} // namespace
+
+bool openParallelOBJ(
+		const QString& fileName,
+		MeshModel& m,
+		int& mask,
+		vcg::CallBackPos* cb)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	const size_t size = file.size();
+	if (size == 0)
+		return false;
+	// the mapping is released when the file is destroyed
+	const char* data = (const char*) file.map(0, size);
+	if (data == nullptr)
+		return false;
+	const QDir objDir = QFileInfo(fileName).absoluteDir();
+
+	// the material libraries are usually declared before the geometry: their
+	// textures are decoded while the rest of the file is parsed
+	std::map<std::string, int> materialIndex;
+	std::vector<Material> materials;
+	std::vector<std::string> textures;
+	std::vector<std::string> loadedLibs;
+	for (const char* p = data; p < data + size;) {
+		const char* le = (const char*) std::memchr(p, '\n', data + size - p);
+		if (le == nullptr)
+			break;
+		ObjChunk header;
+		parseLine(p, le, header);
+		if (!header.verts.empty() || !header.faceVerts.empty())
+			break;
+		for (const std::string& lib : header.mtlLibs) {
+			loadMTL(objDir.absoluteFilePath(QString::fromStdString(lib)), materialIndex, materials, textures);
+			loadedLibs.push_back(lib);
+		}
+		p = le + 1;
+	}
+	// MeshModel::loadTextures will get the same (possibly already decoded)
+	// images from the cache
+	for (const std::string& t : textures) {
+		QString path = objDir.absoluteFilePath(QString::fromStdString(t));
+		if (QFileInfo::exists(path))
+			TextureCache::instance().request(path);
+	}
+
+	// split the file in line aligned chunks; a last line without the final
+	// newline is copied, so that the parsing never reads past the mapping
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	size_t bodySize = size;
+	std::string tail;
+	if (data[size - 1] != '\n') {
+		while (bodySize > 0 && data[bodySize - 1] != '\n')
+			--bodySize;
+		tail.assign(data + bodySize, size - bodySize);
+	}
+	std::vector<const char*> bounds(1, data);
+	const size_t chunkSize = std::max(MIN_CHUNK_SIZE, bodySize / (threads * 4) + 1);
+	while (bounds.back() < data + bodySize) {
+		const char* b = bounds.back() + chunkSize;
+		if (b >= data + bodySize)
+			b = data + bodySize;
+		else
+			b = (const char*) std::memchr(b, '\n', data + bodySize - b) + 1;
+		bounds.push_back(b);
+	}
+	const int nChunks = bounds.size() - 1 + (tail.empty() ? 0 : 1);
+	std::vector<ObjChunk> chunks(nChunks);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < nChunks; ++i) {
+		if (i < (int) bounds.size() - 1)
+			parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+		else
+			parseChunk(tail.data(), tail.data() + tail.size(), chunks[i]);
+	}
+	if (cb != nullptr)
+		(*cb)(50, "Parsing OBJ");
+
+	bool hasVertColors = false, hasFaceTexCoords = false, hasFaceNormals = false, usesMaterials = false;
+	std::vector<size_t> vBase(nChunks + 1, 0), tBase(nChunks + 1, 0), nBase(nChunks + 1, 0), fBase(nChunks + 1, 0);
+	std::vector<int> startMaterial(nChunks, -1);
+	int currentMaterial = -1;
+	for (int i = 0; i < nChunks; ++i) {
+		const ObjChunk& c = chunks[i];
+		if (!c.supported)
+			return false;
+		hasVertColors |= c.hasVertColors;
+		hasFaceTexCoords |= c.hasFaceTexCoords;
+		hasFaceNormals |= c.hasFaceNormals;
+		usesMaterials |= !c.materials.empty();
+		vBase[i + 1] = vBase[i] + c.verts.size();
+		tBase[i + 1] = tBase[i] + c.texCoords.size();
+		nBase[i + 1] = nBase[i] + c.normals.size();
+		fBase[i + 1] = fBase[i] + c.faceVerts.size() / 3;
+		for (const std::string& lib : c.mtlLibs) {
+			if (std::find(loadedLibs.begin(), loadedLibs.end(), lib) == loadedLibs.end()) {
+				// the textures of these materials are loaded later with the mesh textures
+				loadMTL(objDir.absoluteFilePath(QString::fromStdString(lib)), materialIndex, materials, textures);
+				loadedLibs.push_back(lib);
+			}
+		}
+		startMaterial[i] = currentMaterial;
+		if (!c.materials.empty()) {
+			auto it = materialIndex.find(c.materials.back().second);
+			currentMaterial = it != materialIndex.end() ? it->second : -1;
+		}
+	}
+	const long long vn = vBase[nChunks], tn = tBase[nChunks], nn = nBase[nChunks];
+	const bool hasMaterials = !materials.empty() && usesMaterials;
+
+	mask = vcg::tri::io::Mask::IOM_VERTCOORD | vcg::tri::io::Mask::IOM_FACEINDEX;
+	if (hasVertColors)
+		mask |= vcg::tri::io::Mask::IOM_VERTCOLOR;
+	if (hasFaceTexCoords)
+		mask |= vcg::tri::io::Mask::IOM_WEDGTEXCOORD;
+	if (hasMaterials)
+		mask |= vcg::tri::io::Mask::IOM_FACECOLOR;
+	m.enable(mask);
+	CMeshO& cm = m.cm;
+	const size_t firstVert = cm.vert.size();
+	const size_t firstFace = cm.face.size();
+	vcg::tri::Allocator<CMeshO>::AddVertices(cm, vn);
+	vcg::tri::Allocator<CMeshO>::AddFaces(cm, fBase[nChunks]);
+	cm.textures.insert(cm.textures.end(), textures.begin(), textures.end());
+
+	std::vector<vcg::Point2f> texCoords(tn);
+	std::vector<Point3m> normals(nn);
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < nChunks; ++i) {
+		const ObjChunk& c = chunks[i];
+		for (size_t j = 0; j < c.verts.size(); ++j) {
+			CVertexO& v = cm.vert[firstVert + vBase[i] + j];
+			v.P() = c.verts[j];
+			if (hasVertColors)
+				v.C() = c.vertColors[j];
+		}
+		std::copy(c.texCoords.begin(), c.texCoords.end(), texCoords.begin() + tBase[i]);
+		std::copy(c.normals.begin(), c.normals.end(), normals.begin() + nBase[i]);
+	}
+
+	// the normals are kept only if they are given per vertex (i.e. each face
+	// vertex uses the normal with its same index); otherwise they are
+	// recomputed from the faces
+	std::atomic<bool> validIndices(true);
+	std::atomic<bool> perVertexNormals(hasFaceNormals && nn == vn);
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < nChunks; ++i) {
+		const ObjChunk& c = chunks[i];
+		int material = startMaterial[i];
+		size_t nextMaterial = 0;
+		const size_t nf = c.faceVerts.size() / 3;
+		for (size_t j = 0; j < nf; ++j) {
+			while (nextMaterial < c.materials.size() && c.materials[nextMaterial].first == j) {
+				auto it = materialIndex.find(c.materials[nextMaterial].second);
+				material = it != materialIndex.end() ? it->second : -1;
+				++nextMaterial;
+			}
+			CFaceO& f = cm.face[firstFace + fBase[i] + j];
+			for (int k = 0; k < 3; ++k) {
+				const long long vi = decodeIndex(c.faceVerts[3 * j + k], vBase[i]);
+				if (vi < 0 || vi >= vn) {
+					validIndices = false;
+					continue;
+				}
+				f.V(k) = &cm.vert[firstVert + vi];
+
+				const long long ni = c.faceNormals[3 * j + k];
+				if (ni == NO_INDEX || decodeIndex(ni, nBase[i]) != vi)
+					perVertexNormals = false;
+
+				if (hasFaceTexCoords) {
+					const long long ti = c.faceTexCoords[3 * j + k];
+					const long long tg = ti != NO_INDEX ? decodeIndex(ti, tBase[i]) : -1;
+					if (ti != NO_INDEX && (tg < 0 || tg >= tn)) {
+						validIndices = false;
+						continue;
+					}
+					f.WT(k).P() = tg >= 0 ? texCoords[tg] : vcg::Point2f(0, 0);
+					// as in vcg::tri::io::ImporterOBJ, faces without a material use texture 0
+					f.WT(k).N() = material >= 0 ? materials[material].texture : 0;
+				}
+			}
+			if (hasMaterials)
+				f.C() = material >= 0 ? materials[material].color : vcg::Color4b(vcg::Color4b::White);
+		}
+	}
+	if (!validIndices)
+		throw MLException("Bad vertex index in face");
+
+	if (perVertexNormals) {
+		mask |= vcg::tri::io::Mask::IOM_VERTNORMAL;
+#pragma omp parallel for schedule(static)
+		for (long long i = 0; i < vn; ++i)
+			cm.vert[firstVert + i].N() = normals[i];
+	}
+	return true;
+}
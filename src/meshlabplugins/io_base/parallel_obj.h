@@ -0,0 +1,53 @@
+/*****************************************************************************
+ * MeshLab                                                           o o     *
+ * A versatile mesh processing toolbox                             o     o   *
+ *                                                                _   O  _   *
+ * Copyright(C) 2005-2021                                           \/)\/    *
+ * Visual Computing Lab                                            /\/|      *
+ * ISTI - Italian National Research Council                           |      *
+ *                                                                    \      *
+ * All rights reserved.                                                      *
+ *                                                                           *
+ * This program is free software; you can redistribute it and/or modify      *
+ * it under the terms of the GNU General Public License as published by      *
+ * the Free Software Foundation; either version 2 of the License, or         *
+ * (at your option) any later version.                                       *
+ *                                                                           *
+ * This program is distributed in the hope that it will be useful,           *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the             *
+ * GNU General Public License (http://www.gnu.org/licenses/gpl.txt)          *
+ * for more details.                                                         *
+ *                                                                           *
+ ****************************************************************************/
+
+#ifndef PARALLEL_OBJ_H
+#define PARALLEL_OBJ_H
+
+#include <common/ml_document/mesh_model.h>
+
+/*
+Fast path for triangulated OBJ files.
+
+The file is memory mapped and split in line aligned chunks that are parsed
+in parallel; a merge step then resolves the (also relative) indices of the
+faces and fills the CMeshO containers. The textures referenced by the
+materials are requested to the TextureCache, so that they are decoded on
+other threads while the geometry is parsed.
+
+Files with polygons, lines or points return false: the caller should fall
+back to the vcg importer.
+*/
+
+/**
+ * @brief Loads a triangulated OBJ file. Returns false, without touching the
+ * mesh, if the file is not supported by the fast path; throws an MLException
+ * if the file refers to vertices that do not exist.
+ */
+bool openParallelOBJ(
+		const QString& fileName,
+		MeshModel& m,
+		int& mask,
+		vcg::CallBackPos* cb);
+
+#endif // PARALLEL_OBJ_H
@@ -22,6 +22,8 @@
 ****************************************************************************/
 #include <QUuid>
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <memory>
 
@@ -29,6 +31,10 @@
 
 #include <E57SimpleWriter.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #define E57_FILE_EXTENSION      "E57"
 #define E57_FILE_DESCRIPTION    "E57 (E57 points cloud)"
 
@@ -37,6 +43,8 @@
 #define LOADING_MESH        "Loading mesh..."
 #define DONE_LOADING        "Done!"
 
+#define DEFAULT_BLOCK_SIZE  (1 << 20)
+
 /**
  * [Macro] Throw MLException in case of failure using E57 functions.
  */
@@ -65,6 +73,25 @@ static inline std::string filenameToString(const QString& fileName) noexcept;
  */
 static inline QString formatImageFilename(const std::string& fileName, const char* format) noexcept;
 
+RichParameterList E57IOPlugin::initPreOpenParameter(const QString& format) const {
+
+    RichParameterList parlst;
+
+    if (format.toUpper() == tr(E57_FILE_EXTENSION)) {
+        parlst.addParam(RichEnum("subsampling", vcg::tri::io::E57PointSubsampler::NONE,
+                                 QStringList{"None", "Voxel Grid", "Poisson Disk"}, "Subsampling",
+                                 "Subsample the points while they are read from the file, so that the full resolution "
+                                 "clouds are never loaded in memory. <i>Voxel Grid</i> keeps one point for each cell of "
+                                 "the grid, <i>Poisson Disk</i> keeps only points that are farther than the radius from "
+                                 "the points already kept."));
+        parlst.addParam(RichFloat("subsamplingRadius", 0.01f, "Subsampling Radius",
+                                  "Voxel size or Poisson disk radius, in the units of the scans (usually meters)."));
+        parlst.addParam(RichInt("blockSize", DEFAULT_BLOCK_SIZE, "Points per Block",
+                                "Maximum number of points read from the file at once for each scan."));
+    }
+    return parlst;
+}
+
 unsigned int E57IOPlugin::numberMeshesContainedInFile(const QString& format, const QString& fileName, const RichParameterList&) const {
 
     unsigned int count;
@@ -113,66 +140,138 @@ void E57IOPlugin::open(const QString &formatName, const QString &fileName, const
         throw MLException{"No points cloud were found inside the E57 file!"};
     }
 
-    UPDATE_PROGRESS(cb, 1, START_LOADING);
+    std::vector<MeshModel*> meshModels{meshModelList.begin(), meshModelList.end()};
+    const int scanCount = static_cast<int>(std::min<int64_t>(data3DCount, meshModels.size()));
 
-    // Read clouds...
-    int scanIndex = 0;
-    bool columnIndex = false;
+    // the progress is given by the points read over the points of all the scans
+    ReadProgress progress;
+    progress.cb = cb;
+    for (int scanIndex = 0; scanIndex < scanCount; scanIndex++) {
+        bool columnIndex = false;
+        int64_t rows = 0, cols = 0;
+        int64_t numberPointSize = 0, numberGroupSize = 0, numberCountSize = 0;
+        if (e57FileReader.GetData3DSizes(
+                scanIndex, rows, cols, numberPointSize, numberGroupSize, numberCountSize, columnIndex)) {
+            progress.totalPoints += numberPointSize;
+        }
+    }
 
-    for (auto meshModel: meshModelList) {
+    // Every thread opens its own reader: the e57::Reader cannot be shared, but the scans are independent
+    // and can be decoded concurrently, each one inside its own layer.
+    E57_WRAPPER(e57FileReader.Close(), "Error while closing the E57 file!");
 
-        int mask = 0;
-        e57::Data3D scanHeader{};
+    UPDATE_PROGRESS(cb, 1, START_LOADING);
 
-        int64_t rows = 0, cols = 0;
-        int64_t numberPointSize = 0, numberGroupSize = 0, numberCountSize = 0;
+    std::vector<int> masks(meshModels.size(), 0);
+    std::vector<QString> errors(meshModels.size());
+
+    // no more readers than scans: a file with a single scan is opened once
+    int threadCount = 1;
+#ifdef _OPENMP
+    threadCount = std::max(1, std::min(scanCount, omp_get_max_threads()));
+#endif
+
+#pragma omp parallel num_threads(threadCount)
+    {
+        std::unique_ptr<e57::Reader> threadReader;
+        QString readerError;
+
+        // the readers are opened and closed one at a time: libE57Format
+        // initializes and releases its shared state (Xerces) when doing it
+#pragma omp critical(e57_reader)
+        {
+            try {
+                threadReader.reset(new e57::Reader{filenameToString(fileName)});
+                if (!threadReader->IsOpen()) {
+                    readerError = "Error while opening E57 file!";
+                }
+            }
+            catch (const std::exception& e) {
+                readerError = e.what();
+            }
+        }
+
+#pragma omp for schedule(dynamic)
+        for (int scanIndex = 0; scanIndex < scanCount; scanIndex++) {
 
-        UPDATE_PROGRESS(cb, (scanIndex * data3DCount) / 100, LOADING_MESH);
+            if (!readerError.isEmpty()) {
+                errors[scanIndex] = readerError;
+                continue;
+            }
 
-        // read 3D data
-        E57_WRAPPER(e57FileReader.ReadData3D(scanIndex, scanHeader), "Error while reading 3D from file!");
+            try {
+                loadScan(*threadReader, scanIndex, *meshModels[scanIndex], masks[scanIndex], par, progress);
+            }
+            catch (const std::exception& e) {
+                errors[scanIndex] = e.what();
+            }
+        }
 
-        // read scan's size information
-        E57_WRAPPER(e57FileReader.GetData3DSizes(
-                scanIndex, rows, cols, numberPointSize, numberGroupSize, numberCountSize, columnIndex
-        ), "Error while reading scan information!");
+#pragma omp critical(e57_reader)
+        {
+            if (threadReader && threadReader->IsOpen()) {
+                threadReader->Close();
+            }
+            threadReader.reset();
+        }
+    }
 
-        // If the name is not empty then set a name for the mesh.
-        if (!scanHeader.name.empty()) {
-            meshModel->setLabel(QString::fromStdString(scanHeader.name));
+    for (const QString& error : errors) {
+        if (!error.isEmpty()) {
+            throw MLException{error};
         }
+    }
 
-        try {
+    // Put the modified masks into the mask list.
+    for (size_t i = 0; i < meshModels.size(); i++) {
+        maskList.push_back(masks[i]);
+    }
 
-            if (numberPointSize != 0) {
+    UPDATE_PROGRESS(cb, 100, DONE_LOADING);
+}
 
-                // Does the mesh have an imageMetaAndImage from which to extract colors?
-                std::pair<e57::Image2D, QImage> imageMetaAndImage = extractMeshImage(e57FileReader, scanIndex, false);
+void E57IOPlugin::loadScan(const e57::Reader &fileReader, int scanIndex, MeshModel &meshModel, int &mask,
+                           const RichParameterList &par, ReadProgress &progress) {
 
-                // Read points from file and load them inside the MeshLab's mesh.
-                loadMesh(*meshModel, mask, scanIndex, numberPointSize, e57FileReader, scanHeader, imageMetaAndImage, par);
+    e57::Data3D scanHeader{};
 
-                // Once the mesh is loaded apply a transformation matrix to translate and rotate the points.
-                translatedAndRotateMesh(meshModel, scanHeader);
-            }
+    bool columnIndex = false;
+    int64_t rows = 0, cols = 0;
+    int64_t numberPointSize = 0, numberGroupSize = 0, numberCountSize = 0;
 
-            // Put the modified mask into the mask list.
-            maskList.push_back(mask);
+    // read 3D data
+    E57_WRAPPER(fileReader.ReadData3D(scanIndex, scanHeader), "Error while reading 3D from file!");
 
-            // Increase the scanIndex to get info about the next mesh to parse from the file.
-            scanIndex++;
-        }
-        catch (const std::exception& e) {
-            E57_WRAPPER(e57FileReader.Close(), "Error while closing the E57 file!");
-            throw MLException{e.what()};
-        }
+    // read scan's size information
+    E57_WRAPPER(fileReader.GetData3DSizes(
+            scanIndex, rows, cols, numberPointSize, numberGroupSize, numberCountSize, columnIndex
+    ), "Error while reading scan information!");
+
+    // If the name is not empty then set a name for the mesh.
+    if (!scanHeader.name.empty()) {
+        meshModel.setLabel(QString::fromStdString(scanHeader.name));
     }
 
-    UPDATE_PROGRESS(cb, 100, DONE_LOADING);
-    E57_WRAPPER(e57FileReader.Close(), "Error while closing the E57 file!");
+    if (numberPointSize != 0) {
+
+        size_t blockSize = DEFAULT_BLOCK_SIZE;
+        if (par.hasParameter("blockSize") && par.getInt("blockSize") > 0) {
+            blockSize = static_cast<size_t>(par.getInt("blockSize"));
+        }
+
+        // Does the mesh have an imageMetaAndImage from which to extract colors?
+        std::pair<e57::Image2D, QImage> imageMetaAndImage = extractMeshImage(fileReader, scanIndex, false);
+
+        // Read points from file and load them inside the MeshLab's mesh.
+        loadMesh(meshModel, mask, scanIndex, numberPointSize, std::min<size_t>(numberPointSize, blockSize),
+                 fileReader, scanHeader, imageMetaAndImage, par, progress);
+
+        // Once the mesh is loaded apply a transformation matrix to translate and rotate the points.
+        translatedAndRotateMesh(&meshModel, scanHeader);
+    }
 }
 
-void E57IOPlugin::translatedAndRotateMesh(MeshModel *meshModel, const e57::Data3D &scanHeader) const {
+void E57IOPlugin::translatedAndRotateMesh(MeshModel *meshModel, const e57::Data3D &scanHeader) {
 
     auto rotationMatrix = Matrix44m::Identity();
     auto translateMatrix = Matrix44m::Identity();
@@ -407,11 +506,21 @@ void E57IOPlugin::exportMaskCapability(const QString& format, int &capability, i
     capability = defaultBits = mask;
 }
 
-void E57IOPlugin::loadMesh(MeshModel &m, int &mask, int scanIndex, size_t buffSize,
+void E57IOPlugin::loadMesh(MeshModel &m, int &mask, int scanIndex, size_t scanSize, size_t buffSize,
                            const e57::Reader &fileReader, e57::Data3D &scanHeader,
-                           std::pair<e57::Image2D, QImage> image, const RichParameterList &par) {
+                           std::pair<e57::Image2D, QImage> image, const RichParameterList &par,
+                           ReadProgress &progress) {
 
     using Mask = vcg::tri::io::Mask;
+    using Subsampler = vcg::tri::io::E57PointSubsampler;
+
+    Subsampler::Mode subsamplingMode = Subsampler::NONE;
+    Scalarm subsamplingRadius = 0;
+    if (par.hasParameter("subsampling") && par.hasParameter("subsamplingRadius")) {
+        subsamplingMode = static_cast<Subsampler::Mode>(par.getEnum("subsampling"));
+        subsamplingRadius = par.getFloat("subsamplingRadius");
+    }
+    Subsampler subsampler{subsamplingMode, subsamplingRadius};
 
     e57::Image2D meshImageHeader = image.first;
     QImage meshImage = image.second;
@@ -435,6 +544,11 @@ void E57IOPlugin::loadMesh(MeshModel &m, int &mask, int scanIndex, size_t buffSi
     // set the mask
     m.enable(mask);
 
+    // without subsampling the final size is known: avoid the reallocations
+    if (!subsampler.isActive()) {
+        m.cm.vert.reserve(scanSize);
+    }
+
     // read the data from the E57 file
     try {
 
@@ -442,6 +556,18 @@ void E57IOPlugin::loadMesh(MeshModel &m, int &mask, int scanIndex, size_t buffSi
 
         while ((size = dataReader.read()) > 0) {
 
+            int64_t readPoints = progress.readPoints += size;
+
+            // only the calling thread can notify the progress
+#ifdef _OPENMP
+            if (omp_get_thread_num() == 0)
+#endif
+            {
+                if (progress.totalPoints > 0) {
+                    UPDATE_PROGRESS(progress.cb, static_cast<int>((readPoints * 100) / progress.totalPoints), LOADING_MESH);
+                }
+            }
+
             for (std::size_t i = 0; i < size; i++) {
 
                 Point3m coordinates;
@@ -477,6 +603,10 @@ void E57IOPlugin::loadMesh(MeshModel &m, int &mask, int scanIndex, size_t buffSi
                     continue;
                 }
 
+                if (!subsampler.accept(coordinates)) {
+                    continue;
+                }
+
                 auto vertex = vcg::tri::Allocator<CMeshO>::AddVertex(m.cm, coordinates);
 
                 // Set the normals.
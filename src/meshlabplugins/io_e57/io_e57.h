@@ -30,6 +30,12 @@
 
 #include <E57SimpleReader.h>
 
+#include <array>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 typedef typename CMeshO::VertexIterator VertexIterator;
 
 namespace vcg {
@@ -173,6 +179,80 @@ namespace vcg {
                     return data3DPointsData;
                 }
             };
+
+            /**
+             * Streaming subsampler for the points read from an E57 scan. The points are tested one at a time,
+             * in reading order, and only the accepted ones are meant to be added to the mesh: the memory used is
+             * proportional to the subsampled cloud, never to the full resolution one.
+             *
+             * - VOXEL keeps the first point falling in each cell of a grid of the given size;
+             * - POISSON_DISK keeps a point only if no point already kept is closer than the given radius.
+             */
+            class E57PointSubsampler {
+
+            public:
+
+                enum Mode { NONE = 0, VOXEL = 1, POISSON_DISK = 2 };
+
+                E57PointSubsampler(Mode mode, Scalarm radius) :
+                    mode((radius > 0) ? mode : NONE), radius(radius), sqRadius(radius * radius) {}
+
+                inline bool isActive() const { return mode != NONE; }
+
+                inline bool accept(const Point3m& p) {
+
+                    switch (mode) {
+                    case VOXEL:
+                        return cells.insert(cellOf(p)).second;
+                    case POISSON_DISK: {
+                        const Cell c = cellOf(p);
+                        // the cells are as large as the radius: the conflicting points can only be in the 27
+                        // cells around the one of the point
+                        for (int i = -1; i <= 1; ++i) {
+                            for (int j = -1; j <= 1; ++j) {
+                                for (int k = -1; k <= 1; ++k) {
+                                    auto it = grid.find(Cell{{c[0] + i, c[1] + j, c[2] + k}});
+                                    if (it == grid.end())
+                                        continue;
+                                    for (const Point3m& q : it->second) {
+                                        if (vcg::SquaredDistance(p, q) < sqRadius)
+                                            return false;
+                                    }
+                                }
+                            }
+                        }
+                        grid[c].push_back(p);
+                        return true;
+                    }
+                    default:
+                        return true;
+                    }
+                }
+
+            private:
+
+                typedef std::array<long long, 3> Cell;
+
+                struct CellHash {
+                    size_t operator()(const Cell& c) const noexcept {
+                        // same primes used by vcg::SpatialHashTable
+                        return size_t(c[0] * 73856093LL ^ c[1] * 19349663LL ^ c[2] * 83492791LL);
+                    }
+                };
+
+                inline Cell cellOf(const Point3m& p) const {
+                    return Cell{{
+                        (long long) std::floor(p[0] / radius),
+                        (long long) std::floor(p[1] / radius),
+                        (long long) std::floor(p[2] / radius)}};
+                }
+
+                Mode mode;
+                Scalarm radius;
+                Scalarm sqRadius;
+                std::unordered_set<Cell, CellHash> cells;                         // VOXEL: the occupied cells
+                std::unordered_map<Cell, std::vector<Point3m>, CellHash> grid;    // POISSON_DISK: the kept points
+            };
         }
     }
 }
@@ -191,6 +271,8 @@ public:
 
 	virtual void exportMaskCapability(const QString &format, int &capability, int &defaultBits) const;
 
+	RichParameterList initPreOpenParameter(const QString& format) const;
+
 	unsigned int numberMeshesContainedInFile(const QString& format, const QString& fileName, const RichParameterList& preParams) const;
 
 	void open(const QString &formatName, const QString &fileName, MeshModel &m,
@@ -204,33 +286,60 @@ public:
 
 private:
 
+    /***
+     * Progress of the load of the scans, shared by the loading threads: each one adds the points
+     * it reads, only the calling thread notifies the callback.
+     */
+    struct ReadProgress {
+        std::atomic<int64_t> readPoints{0};
+        int64_t totalPoints = 0;
+        vcg::CallBackPos* cb = nullptr;
+    };
+
     /***
      * Extract images contained inside the read E57 file and write them to
      * the same read file location.
      * @param fileReader The current file reader of the opened file
      * @param cb Callback to update the progressbar contained in MeshLab
      */
-    std::pair<e57::Image2D, QImage> extractMeshImage(const e57::Reader &fileReader, int scanIndex, bool saveToDisk);
+    static std::pair<e57::Image2D, QImage> extractMeshImage(const e57::Reader &fileReader, int scanIndex, bool saveToDisk);
+
+    /***
+     * Read a whole scan of the E57 file (header, image and points) inside the given mesh.
+     * Different scans can be loaded concurrently, as long as each thread uses its own file reader.
+     * @param fileReader The file reader object used to scan the file
+     * @param scanIndex Data block index given by the NewData3D
+     * @param meshModel The mesh in which the scan is loaded
+     * @param mask The mask of the loaded attributes
+     * @param par The pre-open parameters
+     * @param progress The points read so far by all the threads, and their total
+     */
+    static void loadScan(const e57::Reader &fileReader, int scanIndex, MeshModel &meshModel, int &mask,
+                         const RichParameterList &par, ReadProgress &progress);
 
     /***
      * Load the cloud points read from the E57 file, inside the mesh to display.
+     * The points are streamed in blocks of at most buffSize points, and subsampled on the fly
+     * according to the pre-open parameters.
      * @param m The mesh to display
      * @param mask
      * @param scanIndex Data block index given by the NewData3D
+     * @param scanSize Number of points of the scan
      * @param buffSize Dimension for buffer size
      * @param fileReader The file reader object used to scan the file
-     * @param cb Callback to update the progressbar contained in MeshLab
+     * @param progress The points read so far by all the threads, and their total
      */
-    void loadMesh(MeshModel &m, int &mask, int scanIndex, size_t buffSize,
-                  const e57::Reader &fileReader, e57::Data3D &scanHeader,
-                  std::pair<e57::Image2D, QImage> image, const RichParameterList &par);
+    static void loadMesh(MeshModel &m, int &mask, int scanIndex, size_t scanSize, size_t buffSize,
+                         const e57::Reader &fileReader, e57::Data3D &scanHeader,
+                         std::pair<e57::Image2D, QImage> image, const RichParameterList &par,
+                         ReadProgress &progress);
 
     /***
      * Read the transform matrix inside the e57::Data3D and apply it to the mesh
      * @param meshModel The mesh to apply the transform matrix
      * @param scanHeader The meta information about the e57 mesh, from which extract the transformation matrix
      */
-    void translatedAndRotateMesh(MeshModel *meshModel, const e57::Data3D &scanHeader) const;
+    static void translatedAndRotateMesh(MeshModel *meshModel, const e57::Data3D &scanHeader);
 };
 
 #endif
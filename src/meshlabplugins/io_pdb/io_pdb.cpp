@@ -35,10 +35,230 @@
 #include <vcg/complex/algorithms/create/platonic.h>
 #include <vcg/complex/algorithms/create/marching_cubes.h>
 #include <vcg/complex/algorithms/create/mc_trivial_walker.h>
+#include <vcg/complex/algorithms/clean.h>
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace vcg;
 typedef vcg::SimpleVoxel<MESHLAB_SCALAR> SimpleVoxelm;
+
+namespace {
+
+/*
+ * Uniform grid of atom bins, with cells as large as the cutoff radius used to
+ * build the surface: all the atoms affecting a point are in the 3x3x3 cells
+ * around it. The bins are stored in compressed form, with the cells of each x
+ * column of the grid contiguous, and the atoms of each cell in index order.
+ */
+class AtomBins
+{
+public:
+	AtomBins(const std::vector<Point3m>& atomPos, const Box3m& box, Scalarm cellSize) :
+		origin(box.min), cell(cellSize)
+	{
+		for (int d = 0; d < 3; ++d)
+			siz[d] = std::max(1, int((box.max[d] - box.min[d]) / cell) + 1);
+
+		std::vector<int> atomCell(atomPos.size());
+		cellStart.assign(size_t(siz[0]) * siz[1] * siz[2] + 1, 0);
+		for (size_t a = 0; a < atomPos.size(); ++a) {
+			atomCell[a] = cellIndex(atomPos[a]);
+			cellStart[atomCell[a] + 1]++;
+		}
+		for (size_t c = 1; c < cellStart.size(); ++c)
+			cellStart[c] += cellStart[c - 1];
+		atoms.resize(atomPos.size());
+		std::vector<int> fill(cellStart.begin(), cellStart.end() - 1);
+		for (size_t a = 0; a < atomPos.size(); ++a)
+			atoms[fill[atomCell[a]]++] = (int) a;
+	}
+
+	int columns() const { return siz[0]; }
+
+	int column(Scalarm x) const { return clamp(int(std::floor((x - origin[0]) / cell)), 0); }
+
+	// calls f on the atoms in the x columns [x0, x1] of the grid
+	template <class F>
+	void forEachInColumns(int x0, int x1, F f) const
+	{
+		x0 = std::max(x0, 0);
+		x1 = std::min(x1, siz[0] - 1);
+		if (x0 > x1)
+			return;
+		const size_t cpc = size_t(siz[1]) * siz[2]; // cells per column
+		for (int i = cellStart[x0 * cpc]; i < cellStart[(x1 + 1) * cpc]; ++i)
+			f(atoms[i]);
+	}
+
+	// calls f on the atoms in the 3x3x3 cells around p
+	template <class F>
+	void forEachNear(const Point3m& p, F f) const
+	{
+		int c[3];
+		for (int d = 0; d < 3; ++d)
+			c[d] = clamp(int(std::floor((p[d] - origin[d]) / cell)), d);
+		for (int x = std::max(c[0] - 1, 0); x <= std::min(c[0] + 1, siz[0] - 1); ++x)
+			for (int y = std::max(c[1] - 1, 0); y <= std::min(c[1] + 1, siz[1] - 1); ++y)
+				for (int z = std::max(c[2] - 1, 0); z <= std::min(c[2] + 1, siz[2] - 1); ++z) {
+					const size_t ci = (size_t(x) * siz[1] + y) * siz[2] + z;
+					for (int i = cellStart[ci]; i < cellStart[ci + 1]; ++i)
+						f(atoms[i]);
+				}
+	}
+
+private:
+	int clamp(int v, int d) const { return std::min(std::max(v, 0), siz[d] - 1); }
+
+	int cellIndex(const Point3m& p) const
+	{
+		int c[3];
+		for (int d = 0; d < 3; ++d)
+			c[d] = clamp(int(std::floor((p[d] - origin[d]) / cell)), d);
+		return (c[0] * siz[1] + c[1]) * siz[2] + c[2];
+	}
+
+	Point3m          origin;
+	Scalarm          cell;
+	int              siz[3];
+	std::vector<int> cellStart;
+	std::vector<int> atoms;
+};
+
+/*
+ * Fills the volume splatting each atom only on the voxels closer than cutoff
+ * along every axis (the same neighborhood tested by the old per voxel loop
+ * over all the atoms). The volume is filled in parallel slabs of x planes,
+ * one for each column of the bins, so that every voxel is written by a single
+ * thread; splat(val, dx, dy, dz, atomIndex) accumulates the atom in val.
+ */
+template <class SPLAT>
+void splatAtoms(
+	SimpleVolume<SimpleVoxelm>& volume,
+	const Box3m& rbb,
+	double step,
+	const std::vector<Point3m>& atomPos,
+	Scalarm cutoff,
+	Scalarm initVal,
+	SPLAT splat)
+{
+	const Point3i siz = volume.ISize();
+	AtomBins bins(atomPos, rbb, cutoff);
+
+	// x planes of each slab
+	std::vector<int> slabStart(bins.columns() + 1, siz[0]);
+	for (int i = siz[0] - 1; i >= 0; --i)
+		slabStart[bins.column(rbb.min[0] + step * i)] = i;
+	for (int s = bins.columns() - 1; s >= 0; --s)
+		slabStart[s] = std::min(slabStart[s], slabStart[s + 1]);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < bins.columns(); ++s) {
+		const int i0 = slabStart[s];
+		const int i1 = slabStart[s + 1];
+		if (i0 >= i1)
+			continue;
+
+		for (int i = i0; i < i1; ++i)
+			for (int j = 0; j < siz[1]; ++j)
+				for (int k = 0; k < siz[2]; ++k)
+					volume.Val(i, j, k) = initVal;
+
+		bins.forEachInColumns(s - 1, s + 1, [&](int atomIndex) {
+			const Point3m& ap = atomPos[atomIndex];
+			// voxel ranges of the atom, enlarged by one: the exact test is done below
+			const int iLo = std::max(i0, int(std::floor((ap[0] - cutoff - rbb.min[0]) / step)) - 1);
+			const int iHi = std::min(i1 - 1, int(std::ceil((ap[0] + cutoff - rbb.min[0]) / step)) + 1);
+			const int jLo = std::max(0, int(std::floor((ap[1] - cutoff - rbb.min[1]) / step)) - 1);
+			const int jHi = std::min(siz[1] - 1, int(std::ceil((ap[1] + cutoff - rbb.min[1]) / step)) + 1);
+			const int kLo = std::max(0, int(std::floor((ap[2] - cutoff - rbb.min[2]) / step)) - 1);
+			const int kHi = std::min(siz[2] - 1, int(std::ceil((ap[2] + cutoff - rbb.min[2]) / step)) + 1);
+
+			for (int i = iLo; i <= iHi; ++i) {
+				const float dx = float(rbb.min[0] + step * i) - ap[0];
+				if (fabs(dx) > cutoff)
+					continue;
+				for (int j = jLo; j <= jHi; ++j) {
+					const float dy = float(rbb.min[1] + step * j) - ap[1];
+					if (fabs(dy) > cutoff)
+						continue;
+					for (int k = kLo; k <= kHi; ++k) {
+						const float dz = float(rbb.min[2] + step * k) - ap[2];
+						if (fabs(dz) > cutoff)
+							continue;
+						splat(volume.Val(i, j, k), dx, dy, dz, atomIndex);
+					}
+				}
+			}
+		});
+	}
+}
+
+/*
+ * Marching cubes run in parallel on slabs of x planes of the volume. Each slab
+ * is extracted from a copy of its planes, sharing the boundary plane with the
+ * next slab; the seams are then welded removing the duplicated vertices and
+ * faces. The mesh is in voxel coordinates, as with TrivialWalker::BuildMesh.
+ */
+void parallelMarchingCubes(CMeshO& m, SimpleVolume<SimpleVoxelm>& volume, Scalarm threshold)
+{
+	typedef vcg::tri::TrivialWalker<CMeshO, SimpleVolume<SimpleVoxelm> >	MyWalker;
+	typedef vcg::tri::MarchingCubes<CMeshO, MyWalker>	MyMarchingCubes;
+
+	const Point3i siz = volume.ISize();
+	const int minSlabCells = 16;
+	int slabCount = 1;
+#ifdef _OPENMP
+	slabCount = std::max(1, std::min(omp_get_max_threads() * 2, (siz[0] - 2) / minSlabCells));
+#endif
+
+	if (slabCount == 1) {
+		MyWalker walker;
+		MyMarchingCubes	mc(m, walker);
+		walker.BuildMesh<MyMarchingCubes>(m, volume, mc, threshold);
+		return;
+	}
+
+	// the walker processes the cells [0, n-2) of a volume of n planes
+	const int cellCount = siz[0] - 2;
+	std::vector<CMeshO> slabMeshes(slabCount);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int s = 0; s < slabCount; ++s) {
+		const int c0 = (cellCount * s) / slabCount;
+		const int c1 = (cellCount * (s + 1)) / slabCount;
+		const int n = c1 - c0 + 2;
+
+		SimpleVolume<SimpleVoxelm> slab;
+		slab.Init(Point3i(n, siz[1], siz[2]), Box3m(Point3m(0, 0, 0), Point3m(n, siz[1], siz[2])));
+		for (int i = 0; i < n; ++i)
+			for (int j = 0; j < siz[1]; ++j)
+				for (int k = 0; k < siz[2]; ++k)
+					slab.Val(i, j, k) = volume.Val(c0 + i, j, k);
+
+		CMeshO& sm = slabMeshes[s];
+		MyWalker walker;
+		MyMarchingCubes	mc(sm, walker);
+		walker.BuildMesh<MyMarchingCubes>(sm, slab, mc, threshold);
+		for (CMeshO::VertexIterator vi = sm.vert.begin(); vi != sm.vert.end(); ++vi)
+			vi->P()[0] += c0;
+	}
+
+	for (CMeshO& sm : slabMeshes) {
+		tri::Append<CMeshO, CMeshO>::MeshAppendConst(m, sm);
+		sm.Clear();
+	}
+	tri::Clean<CMeshO>::RemoveDuplicateVertex(m);
+	tri::Clean<CMeshO>::RemoveDuplicateFace(m);
+	tri::Allocator<CMeshO>::CompactEveryVector(m);
+}
+
+} // namespace
 // initialize importing parameters
 RichParameterList PDBIOPlugin::initPreOpenParameter(const QString &formatName) const
 {
@@ -238,10 +458,6 @@ bool PDBIOPlugin::parsePDB(const std::string &filename, CMeshO &m, const RichPar
 	if(parlst.getBool("interpspheres") && !surfacecreated)  	// jointed spheres marching cube 
 	{
 		SimpleVolume<SimpleVoxelm> 	volume;
-	
-		typedef vcg::tri::TrivialWalker<CMeshO, SimpleVolume<SimpleVoxelm> >	MyWalker;
-		typedef vcg::tri::MarchingCubes<CMeshO, MyWalker>	MyMarchingCubes;
-		MyWalker walker;
 		
 		Box3m rbb;
 		// calculating an enlarged bbox
@@ -264,34 +480,16 @@ bool PDBIOPlugin::parsePDB(const std::string &filename, CMeshO &m, const RichPar
 		Point3i siz= Point3i::Construct((rbb.max-rbb.min)*(1.0/step));
 					
 		volume.Init(siz,rbb);
-		float xpos,ypos,zpos;
-		for(double i=0;i<siz[0];i++)
-			for(double j=0;j<siz[1];j++)
-				for(double k=0;k<siz[2];k++)
-				{
-					xpos = rbb.min[0]+step*i;
-					ypos = rbb.min[1]+step*j;
-					zpos = rbb.min[2]+step*k;
-
-					volume.Val(i,j,k)=10000;
-					for (size_t atomIndex = 0; atomIndex < atomNumber; ++atomIndex)
-					{
-						if(! (fabs(xpos-atomPos[atomIndex].X())>3.0f) )
-							if(! (fabs(ypos-atomPos[atomIndex].Y())>3.0f) )
-								if(! (fabs(zpos-atomPos[atomIndex].Z())>3.0f) )
-								{
-									float val = pow((double)(xpos-atomPos[atomIndex].X()),2.0) +
-															pow((double)(ypos-atomPos[atomIndex].Y()),2.0) +
-														pow((double)(zpos-atomPos[atomIndex].Z()),2.0) - atomRad[atomIndex];
-									if(val < volume.Val(i,j,k))
-										volume.Val(i,j,k) = val;
-								}
-					}
-				}
+		splatAtoms(volume, rbb, step, atomPos, 3.0f, 10000,
+			[&](Scalarm& v, float dx, float dy, float dz, int atomIndex) {
+				float val = dx*dx + dy*dy + dz*dz - atomRad[atomIndex];
+				if(val < v)
+					v = val;
+			});
+		if (cb != NULL)	(*cb)(50, "Building surface...");
 		
 		// MARCHING CUBES
-		MyMarchingCubes	mc(m, walker);
-		walker.BuildMesh<MyMarchingCubes>(m, volume, mc, 0);
+		parallelMarchingCubes(m, volume, 0);
 		Matrix44m tr; tr.SetIdentity(); tr.SetTranslate(rbb.min[0],rbb.min[1],rbb.min[2]);
 		Matrix44m sc; sc.SetIdentity(); sc.SetScale(step,step,step);
 		tr=tr*sc;
@@ -307,10 +505,6 @@ bool PDBIOPlugin::parsePDB(const std::string &filename, CMeshO &m, const RichPar
 	if(parlst.getBool("metaballs") && !surfacecreated)  	// metaballs marching cube 
 	{
 		SimpleVolume<SimpleVoxelm> 	volume;
-	
-		typedef vcg::tri::TrivialWalker<CMeshO, SimpleVolume<SimpleVoxelm> >	MyWalker;
-		typedef vcg::tri::MarchingCubes<CMeshO, MyWalker>	MyMarchingCubes;
-		MyWalker walker;
 		
 		Box3m rbb;
 		// calculating an enlarged bbox
@@ -336,35 +530,15 @@ bool PDBIOPlugin::parsePDB(const std::string &filename, CMeshO &m, const RichPar
 
 //	Log("Filling a Volume of %i %i %i",siz[0],siz[1],siz[2]);
 		volume.Init(siz,rbb);
-		float xpos,ypos,zpos;
-		for(double i=0;i<siz[0];i++)
-			for(double j=0;j<siz[1];j++)
-				for(double k=0;k<siz[2];k++)
-				{
-					xpos = rbb.min[0]+step*i;
-					ypos = rbb.min[1]+step*j;
-					zpos = rbb.min[2]+step*k;
-
-					volume.Val(i,j,k)=0.0;
-					for (size_t atomIndex = 0; atomIndex < atomNumber; ++atomIndex)
-					{
-						if(! (fabs(xpos-atomPos[atomIndex].X())>5.0f) )
-							if(! (fabs(ypos-atomPos[atomIndex].Y())>5.0f) )
-								if(! (fabs(zpos-atomPos[atomIndex].Z())>5.0f) )
-								{
-									float r2 = (pow((double)(xpos-atomPos[atomIndex].X()),2.0) +
-														  pow((double)(ypos-atomPos[atomIndex].Y()),2.0) +
-													  pow((double)(zpos-atomPos[atomIndex].Z()),2.0));
-									float val = exp((blobby/atomRad[atomIndex])*r2 - blobby);
-
-									volume.Val(i,j,k) += val;
-								}
-					}
-				}
+		splatAtoms(volume, rbb, step, atomPos, 5.0f, 0.0,
+			[&](Scalarm& v, float dx, float dy, float dz, int atomIndex) {
+				float r2 = dx*dx + dy*dy + dz*dz;
+				v += exp((blobby/atomRad[atomIndex])*r2 - blobby);
+			});
+		if (cb != NULL)	(*cb)(50, "Building surface...");
 		
 		// MARCHING CUBES
-		MyMarchingCubes	mc(m, walker);
-		walker.BuildMesh<MyMarchingCubes>(m, volume, mc, 1);
+		parallelMarchingCubes(m, volume, 1);
 		Matrix44m tr; tr.SetIdentity(); tr.SetTranslate(rbb.min[0],rbb.min[1],rbb.min[2]);
 		Matrix44m sc; sc.SetIdentity(); sc.SetScale(step,step,step);
 		tr=tr*sc;
@@ -378,46 +552,36 @@ bool PDBIOPlugin::parsePDB(const std::string &filename, CMeshO &m, const RichPar
 
 		//------------------------------------------------
 
-		double ww;
-		double rr;
-		double gg;
-		double bb;
+		AtomBins bins(atomPos, rbb, 5.0f);
+#pragma omp parallel for schedule(dynamic, 1024)
 		for(int vind=0; vind<m.vn ; vind++)
 		{
-			xpos = m.vert[vind].P().X();
-			ypos = m.vert[vind].P().Y(); 
-			zpos = m.vert[vind].P().Z(); 				
-			ww=rr=gg=bb=0;
+			const float xpos = m.vert[vind].P().X();
+			const float ypos = m.vert[vind].P().Y();
+			const float zpos = m.vert[vind].P().Z();
+			double ww=0, rr=0, gg=0, bb=0;
 			
-			for (size_t atomIndex = 0; atomIndex < atomNumber; ++atomIndex)
+			bins.forEachNear(m.vert[vind].P(), [&](int atomIndex) {
+				const float dx = xpos-atomPos[atomIndex].X();
+				const float dy = ypos-atomPos[atomIndex].Y();
+				const float dz = zpos-atomPos[atomIndex].Z();
+				if(fabs(dx)>5.0f || fabs(dy)>5.0f || fabs(dz)>5.0f)
+					return;
+				float r2 = (dx*dx + dy*dy + dz*dz) / atomRad[atomIndex];
+				r2 = min(2.0f,r2);
+
+				ww += r2;
+				rr += r2 * atomCol[atomIndex].X();
+				gg += r2 * atomCol[atomIndex].Y();
+				bb += r2 * atomCol[atomIndex].Z();
+			});
+
+			if (ww > 0)
 			{
-				if(! (fabs(xpos-atomPos[atomIndex].X())>5.0f) )
-				{
-					if(! (fabs(ypos-atomPos[atomIndex].Y())>5.0f) )
-					{
-						if(! (fabs(zpos-atomPos[atomIndex].Z())>5.0f) )
-						{
-							float r2 = (pow((double)(xpos-atomPos[atomIndex].X()),2.0) + 
-												  pow((double)(ypos-atomPos[atomIndex].Y()),2.0) + 
-								    		  pow((double)(zpos-atomPos[atomIndex].Z()),2.0));
-							r2 = r2 / atomRad[atomIndex];
-							r2 = min(2.0f,r2);
-
-							ww += r2;
-							rr += r2 * atomCol[atomIndex].X();
-							gg += r2 * atomCol[atomIndex].Y();
-							bb += r2 * atomCol[atomIndex].Z();
-
-						}
-					}
-				}
-
 				m.vert[vind].C().X() = rr/ww;
 				m.vert[vind].C().Y() = gg/ww;
 				m.vert[vind].C().Z() = bb/ww;
 			}
-
-
 		}
 
 		//------------------------------------------------
@@ -22,13 +22,28 @@
 ****************************************************************************/
 #include <Qt>
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<charconv>) && __cplusplus >= 201703L
+#include <charconv>
+#if defined(__cpp_lib_to_chars)
+#define TXT_HAS_FROM_CHARS
+#endif
+#endif
+#endif
+
 #include "io_txt.h"
 
 //#include <wrap/io_trimesh/export.h>
 
 using namespace vcg;
 
-bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError);
+bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError, CallBackPos *cb);
 
 RichParameterList TxtIOPlugin::initPreOpenParameter(const QString &format) const
 {
@@ -61,7 +76,7 @@ RichParameterList TxtIOPlugin::initPreOpenParameter(const QString &format) const
     return parlst;
 }
 
-void TxtIOPlugin::open(const QString &formatName, const QString &fileName, MeshModel &m, int& mask, const RichParameterList &parlst, CallBackPos * /*cb*/)
+void TxtIOPlugin::open(const QString &formatName, const QString &fileName, MeshModel &m, int& mask, const RichParameterList &parlst, CallBackPos *cb)
 {
 	if(formatName.toUpper() == tr("TXT")) {
 		int rowToSkip = parlst.getInt("rowToSkip");
@@ -79,7 +94,7 @@ void TxtIOPlugin::open(const QString &formatName, const QString &fileName, MeshM
 
 		m.enable(mask);
 
-		if (!parseTXT(fileName, m.cm, rowToSkip, dataSeparator, dataFormat, rgbMode, onError))
+		if (!parseTXT(fileName, m.cm, rowToSkip, dataSeparator, dataFormat, rgbMode, onError, cb))
 			throw MLException("Error while opening TXT file.");
 	}
 	else {
@@ -124,496 +139,259 @@ void TxtIOPlugin::exportMaskCapability(const QString & /*format*/, int &capabili
 }
  
 
-bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError)
+namespace {
+
+enum TxtField { X = 0, Y, Z, REFLECTANCE, RED, GREEN, BLUE, NX, NY, NZ, FIELD_NUMBER };
+
+// the fields of each point format, in the order they appear in the line (same order of the "strformat" enum)
+const std::vector<std::vector<TxtField>> txtFormats = {
+	{X, Y, Z},
+	{X, Y, Z, REFLECTANCE},
+	{X, Y, Z, REFLECTANCE, RED, GREEN, BLUE},
+	{X, Y, Z, REFLECTANCE, NX, NY, NZ},
+	{X, Y, Z, REFLECTANCE, RED, GREEN, BLUE, NX, NY, NZ},
+	{X, Y, Z, REFLECTANCE, NX, NY, NZ, RED, GREEN, BLUE},
+	{X, Y, Z, RED, GREEN, BLUE},
+	{X, Y, Z, RED, GREEN, BLUE, REFLECTANCE},
+	{X, Y, Z, RED, GREEN, BLUE, REFLECTANCE, NX, NY, NZ},
+	{X, Y, Z, RED, GREEN, BLUE, NX, NY, NZ, REFLECTANCE},
+	{X, Y, Z, NX, NY, NZ},
+	{X, Y, Z, NX, NY, NZ, RED, GREEN, BLUE, REFLECTANCE},
+	{X, Y, Z, NX, NY, NZ, REFLECTANCE, RED, GREEN, BLUE}};
+
+const size_t TXT_CHUNK_SIZE = 4 << 20;
+
+inline bool isBlank(char c)
 {
-    QFile impFile(filename);
-    int ii;
-
-    if(impFile.open(QIODevice::ReadOnly))
-    {
-        QString freshLine;
-        QStringList tokenizedLine;
-        QString separator;
-        float XX,YY,ZZ;
-        float NX,NY,NZ;
-        float RR,GG,BB;
-        float Qual;
-        bool parseOK[10];
-
-        //skipping first rowToSkip lines,because it's the header
-        for(ii=0; ii<rowToSkip; ii++)
-        {
-            if(!impFile.atEnd())
-                freshLine = QString(impFile.readLine()).simplified();
-            else
-            {
-                impFile.close();
-                return false;
-            }
-        }
-
-        switch(dataSeparator)
-        {
-            case 0: separator = ";"; break;
-            case 1: separator = ","; break;
-            case 2: separator = " "; break;
-        }
-
-        //now, the data
-        while(!impFile.atEnd())
-        {
-            // reading and tokenizing
-            freshLine = QString(impFile.readLine()).simplified();
-            tokenizedLine = freshLine.split(separator, Qt::SkipEmptyParts);
-
-            switch(dataFormat)
-            {
-                case 0: // X Y Z
-                    {
-                        // number of token mismatch
-						if (tokenizedLine.size()<3)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							if (parseOK[0] && parseOK[1] && parseOK[2])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 1: // X Y Z Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<4)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 2: // X Y Z Reflectance R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<7)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							RR = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							GG = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							BB = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5] && parseOK[6])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 3: // X Y Z Reflectance Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<7)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NX = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NY = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							NZ = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5] && parseOK[6])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 4: // X Y Z Reflectance R G B Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							RR = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							GG = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							BB = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							NX = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							NY = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							NZ = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 5: // X Y Z Reflectance Nx Ny Nz R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							Qual = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NX = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NY = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							NZ = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							RR = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							GG = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							BB = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 6: // X Y Z R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<6)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 7: // X Y Z R G B Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<7)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							Qual = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5] && parseOK[6])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 8: // X Y Z R G B Reflectance Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							Qual = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							NX = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							NY = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							NZ = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 9: // X Y Z R G B Nx Ny Nz Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							RR = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							GG = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							BB = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							NX = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							NY = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							NZ = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							Qual = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 10: // X Y Z Nx Ny Nz
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<6)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							NX = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NY = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NZ = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4] && parseOK[5])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 11: // X Y Z Nx Ny Nz R G B Reflectance
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							NX = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NY = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NZ = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							RR = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							GG = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							BB = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							Qual = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-                case 12: // X Y Z Nx Ny Nz Reflectance R G B
-                    {
-                        // number of token mismatch
-                        if(tokenizedLine.size()<10)
-						{
-							if (onError == 1){ impFile.close(); return true; }
-						}
-						else
-						{
-							XX = tokenizedLine.at(0).toFloat(&(parseOK[0]));
-							YY = tokenizedLine.at(1).toFloat(&(parseOK[1]));
-							ZZ = tokenizedLine.at(2).toFloat(&(parseOK[2]));
-							NX = tokenizedLine.at(3).toFloat(&(parseOK[3]));
-							NY = tokenizedLine.at(4).toFloat(&(parseOK[4]));
-							NZ = tokenizedLine.at(5).toFloat(&(parseOK[5]));
-							Qual = tokenizedLine.at(6).toFloat(&(parseOK[6]));
-							RR = tokenizedLine.at(7).toFloat(&(parseOK[7]));
-							GG = tokenizedLine.at(8).toFloat(&(parseOK[8]));
-							BB = tokenizedLine.at(9).toFloat(&(parseOK[9]));
-
-							if (rgbMode == 1) //[0.0-1.0]
-							{
-								RR *= 255; GG *= 255; BB *= 255;
-							}
-							if (parseOK[0] && parseOK[1] && parseOK[2] && parseOK[3] && parseOK[4]
-								&& parseOK[5] && parseOK[6] && parseOK[7] && parseOK[8] && parseOK[9])    // no parsing error
-							{
-								CMeshO::VertexIterator vi = tri::Allocator<CMeshO>::AddVertices(m, 1);
-								(*vi).P().Import(Point3f(XX, YY, ZZ));
-								(*vi).Q() = Qual;
-								(*vi).C() = Color4b(RR, GG, BB, 255);
-								(*vi).N().Import(Point3f(NX, NY, NZ));
-							}
-							else
-								if (onError == 1){ impFile.close(); return true; }
-						}
-                    }
-                    break;
-
-            }
-
-
-        }
-
-        impFile.close();
-        return true;
-    }
-    else
-        return false;
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
 
+// parses a whole token as a float, like QString::toFloat does
+inline bool parseFloat(const char* b, const char* e, float& v)
+{
+	if (b < e && *b == '+')
+		++b;
+	if (b == e)
+		return false;
+#ifdef TXT_HAS_FROM_CHARS
+	std::from_chars_result r = std::from_chars(b, e, v);
+	return r.ec == std::errc() && r.ptr == e;
+#else
+	// MeshLab runs with the "C" locale, so strtof is not locale dependent
+	char buf[64];
+	if (e - b >= (std::ptrdiff_t) sizeof(buf))
+		return false;
+	std::memcpy(buf, b, e - b);
+	buf[e - b] = '\0';
+	char* end;
+	v = std::strtof(buf, &end);
+	return end == buf + (e - b);
+#endif
 }
 
+/*
+ * Parses the first n values of the line [b, e), with the same rules of the
+ * QString::simplified(), split(separator, Qt::SkipEmptyParts) and toFloat()
+ * sequence used by the previous importer: returns false if the line has less
+ * than n values or if one of them is not a number.
+ */
+bool parseLine(const char* b, const char* e, char separator, size_t n, float* values)
+{
+	while (b < e && isBlank(*b))
+		++b;
+	while (e > b && isBlank(e[-1]))
+		--e;
+
+	size_t count = 0;
+	const char* p = b;
+	while (count < n && p < e) {
+		if (separator == ' ') {
+			const char* te = p;
+			while (te < e && !isBlank(*te))
+				++te;
+			if (!parseFloat(p, te, values[count++]))
+				return false;
+			p = te;
+			while (p < e && isBlank(*p))
+				++p;
+		}
+		else {
+			const char* te = std::find(p, e, separator);
+			if (te != p) { // empty parts are skipped
+				const char* tb = p;
+				const char* tt = te;
+				while (tb < tt && isBlank(*tb))
+					++tb;
+				while (tt > tb && isBlank(tt[-1]))
+					--tt;
+				if (!parseFloat(tb, tt, values[count++]))
+					return false;
+			}
+			p = (te < e) ? te + 1 : e;
+		}
+	}
+	return count == n;
+}
+
+size_t countLines(const char* b, const char* e)
+{
+	size_t lines = 0;
+	const char* p = b;
+	while (p < e) {
+		const char* nl = static_cast<const char*>(std::memchr(p, '\n', e - p));
+		++lines;
+		p = (nl != nullptr) ? nl + 1 : e;
+	}
+	return lines;
+}
+
+} // namespace
+
+/*
+ * The file is memory mapped and split in line aligned chunks. Lines are first
+ * counted, so that all the vertices are allocated at once, and then the chunks
+ * are parsed in parallel, each one writing directly in its own range of
+ * vertices. The lines that cannot be parsed leave a deleted vertex, removed by
+ * a final compaction; when onError is "stop", all the vertices after the first
+ * wrong line are discarded as well.
+ */
+bool parseTXT(QString filename, CMeshO &m, int rowToSkip, int dataSeparator, int dataFormat, int rgbMode, int onError, CallBackPos *cb)
+{
+	QFile impFile(filename);
+	if (!impFile.open(QIODevice::ReadOnly))
+		return false;
+	if (dataFormat < 0 || dataFormat >= (int) txtFormats.size())
+		return false;
+
+	const qint64 fileSize = impFile.size();
+	const char* data = nullptr;
+	if (fileSize > 0) {
+		data = reinterpret_cast<const char*>(impFile.map(0, fileSize));
+		if (data == nullptr)
+			return false;
+	}
+	const char* end = data + fileSize;
+
+	//skipping first rowToSkip lines,because it's the header
+	const char* begin = data;
+	for (int i = 0; i < rowToSkip; i++) {
+		if (begin >= end)
+			return false;
+		const char* nl = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+		begin = (nl != nullptr) ? nl + 1 : end;
+	}
+
+	char separator = ' ';
+	switch(dataSeparator)
+	{
+		case 0: separator = ';'; break;
+		case 1: separator = ','; break;
+		case 2: separator = ' '; break;
+	}
+
+	const std::vector<TxtField>& fields = txtFormats[dataFormat];
+	int fieldPos[FIELD_NUMBER];
+	std::fill(fieldPos, fieldPos + FIELD_NUMBER, -1);
+	for (size_t i = 0; i < fields.size(); ++i)
+		fieldPos[fields[i]] = (int) i;
+	const bool hasQuality = fieldPos[REFLECTANCE] >= 0;
+	const bool hasColor = fieldPos[RED] >= 0;
+	const bool hasNormal = fieldPos[NX] >= 0;
+
+	// line aligned chunks
+	std::vector<const char*> bounds = {begin};
+	while (bounds.back() < end) {
+		const char* p = bounds.back() + TXT_CHUNK_SIZE;
+		const char* nl = (p < end) ? static_cast<const char*>(std::memchr(p, '\n', end - p)) : nullptr;
+		bounds.push_back((nl != nullptr) ? nl + 1 : end);
+	}
+	const int nChunks = (int) bounds.size() - 1;
+
+	std::vector<size_t> lineOffset(nChunks + 1, 0);
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < nChunks; ++c)
+		lineOffset[c + 1] = countLines(bounds[c], bounds[c + 1]);
+	for (int c = 0; c < nChunks; ++c)
+		lineOffset[c + 1] += lineOffset[c];
+
+	const size_t lineCount = lineOffset[nChunks];
+	if (lineCount == 0)
+		return true;
+	if (cb != nullptr)
+		cb(10, "Parsing points");
+
+	const size_t base = tri::Allocator<CMeshO>::AddVertices(m, lineCount) - m.vert.begin();
+
+	const size_t noError = std::numeric_limits<size_t>::max();
+	std::vector<size_t> validCount(nChunks, 0);
+	std::vector<size_t> firstError(nChunks, noError);
+
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < nChunks; ++c) {
+		size_t line = lineOffset[c];
+		const char* p = bounds[c];
+		const char* e = bounds[c + 1];
+		float values[FIELD_NUMBER];
+		while (p < e) {
+			const char* nl = static_cast<const char*>(std::memchr(p, '\n', e - p));
+			const char* le = (nl != nullptr) ? nl : e;
+			CVertexO& v = m.vert[base + line];
+
+			if (parseLine(p, le, separator, fields.size(), values)) {
+				v.P().Import(Point3f(values[fieldPos[X]], values[fieldPos[Y]], values[fieldPos[Z]]));
+				if (hasQuality)
+					v.Q() = values[fieldPos[REFLECTANCE]];
+				if (hasColor) {
+					float RR = values[fieldPos[RED]];
+					float GG = values[fieldPos[GREEN]];
+					float BB = values[fieldPos[BLUE]];
+					if (rgbMode == 1) //[0.0-1.0]
+					{
+						RR *= 255; GG *= 255; BB *= 255;
+					}
+					v.C() = Color4b(RR, GG, BB, 255);
+				}
+				if (hasNormal)
+					v.N().Import(Point3f(values[fieldPos[NX]], values[fieldPos[NY]], values[fieldPos[NZ]]));
+				validCount[c]++;
+			}
+			else {
+				v.SetD();
+				if (firstError[c] == noError)
+					firstError[c] = line;
+			}
+			++line;
+			p = (nl != nullptr) ? nl + 1 : e;
+		}
+	}
+
+	size_t valid = 0;
+	size_t stopLine = lineCount;
+	for (int c = 0; c < nChunks; ++c) {
+		if (onError == 1 && firstError[c] != noError) {
+			// all the lines before the first wrong one are valid
+			stopLine = firstError[c];
+			valid = stopLine;
+			break;
+		}
+		valid += validCount[c];
+	}
+
+	if (stopLine < lineCount) {
+#pragma omp parallel for
+		for (long long i = (long long) stopLine; i < (long long) lineCount; ++i) {
+			if (!m.vert[base + i].IsD())
+				m.vert[base + i].SetD();
+		}
+	}
+
+	if (valid != lineCount) {
+		m.vn -= (int) (lineCount - valid);
+		tri::Allocator<CMeshO>::CompactVertexVector(m);
+	}
+	if (cb != nullptr)
+		cb(100, "Done");
+	return true;
+}
 
- 
- 
 MESHLAB_PLUGIN_NAME_EXPORTER(TxtIOPlugin)